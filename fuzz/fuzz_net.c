@@ -12,5 +12,8 @@ int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
     if (net_unpack_game_state(data, size, (GameState*)&gs)) {
         net_free_unpacked_game_state((GameState*)&gs);
     }
+    /* and into arrays left over from a previous state, as a receive loop would */
+    static GameState reused;
+    (void)net_unpack_game_state_into(data, size, &reused);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,37 @@
+#include <stdint.h>
+#include <stddef.h>
+#include "game.h"
+#include "net.h"
+#include "net_delta.h"
+#include "net_json.h"
+
+static Game* fuzz_game(void) {
+    GameConfig* cfg = game_config_create();
+    if (!cfg) return NULL;
+    game_config_set_num_players(cfg, 1);
+    game_config_set_max_players(cfg, SNAKE_MAX_PLAYERS);
+    Game* g = game_create(cfg, 0);
+    game_config_destroy(cfg);
+    return g;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    static Game* g = NULL;
+    /* Kept across inputs so a keyframe in one input can serve as the base of a delta in a later one */
+    static NetDelta* delta = NULL;
+    /* Start over once every slot is taken so later inputs still reach the add-player and body paths */
+    if (g && game_get_num_players(g) >= SNAKE_MAX_PLAYERS) {
+        game_destroy(g);
+        g = NULL;
+    }
+    if (!g) g = fuzz_game();
+    if (!delta) delta = net_delta_create("fuzz");
+    if (!g || !delta) return 0;
+    /* The buffer is not NUL-terminated, so the parser must stay inside `size`; odd sizes act as host to skip food */
+    (void)net_json_apply_state(g, delta, (const char*)data, size, (size & 1) != 0);
+    /* The same bytes as a binary state payload, which the "bstate" envelope carries base64-encoded */
+    (void)net_apply_packed_state(g, data, size, (size & 1) != 0);
+    (void)net_delta_apply(delta, g, data, size, (size & 1) != 0);
+    return 0;
+}
@@ -1,4 +1,7 @@
 #pragma once
+#include "msg_ring.h"
+#include "net_shaper.h"
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct mpclient mpclient;
@@ -6,15 +9,40 @@ typedef struct mpclient mpclient;
 mpclient* mpclient_create(const char* host, uint16_t port, const char* identifier);
 void mpclient_destroy(mpclient* c);
 
-/* Connect to server and start receiver thread. Returns 0 on success. */
+/* Starts the I/O thread, which resolves the server and connects to it without blocking the caller. Returns 0 once the
+   thread runs; a failed connect fails the pending session request through its callback. */
 int mpclient_connect_and_start(mpclient* c);
 
-/* Attempt to join first public session; if none exists, host one. Uses name as display name. Returns 0 on success. */
+/* Session negotiation runs on the I/O thread: the request functions below only queue the first command and return, and
+   the connection coming up, then each server reply (or a 2 s timeout per step) moves the request on to the next state */
+typedef enum {
+    MPCLIENT_SESSION_IDLE,
+    MPCLIENT_SESSION_CONNECTING,
+    MPCLIENT_SESSION_LISTING,
+    MPCLIENT_SESSION_HOSTING,
+    MPCLIENT_SESSION_JOINING,
+    MPCLIENT_SESSION_READY,
+    MPCLIENT_SESSION_FAILED
+} MpClientSessionState;
+/* Called once per request from mpclient_poll_session(), on the thread that polls: ok is 1 when the session is ready
+   (session and is_host describe it), 0 when the connect failed, the server did not answer or the connection dropped */
+typedef void (*mpclient_session_cb)(mpclient* c, int ok, const char* session, int is_host, void* user);
+void mpclient_set_session_callback(mpclient* c, mpclient_session_cb cb, void* user);
+
+/* Starts joining the first public session, or hosting one if the list is empty or does not arrive in time. Uses name
+   as display name. Never waits for the server. Returns 0 once the request is under way. */
 int mpclient_auto_join_or_host(mpclient* c, const char* name);
 
-/* Join a specific session id (e.g. from config). Returns 0 on success. */
+/* Starts joining a specific session id (e.g. from config). Never waits for the server. Returns 0 once the request is
+   under way. */
 int mpclient_join(mpclient* c, const char* sessionId, const char* name);
 
+/* Current state of the last session request */
+MpClientSessionState mpclient_session_state(mpclient* c);
+/* Runs the completion callback if the last request finished since the previous call; returns the current state. Call
+   it from the game loop. */
+MpClientSessionState mpclient_poll_session(mpclient* c);
+
 /* Returns non-zero if client has an active session id assigned (host or joined). */
 int mpclient_has_session(mpclient* c);
 /* Returns non-zero if client is currently hosting a session. */
@@ -24,12 +52,42 @@ int mpclient_is_host(mpclient* c);
 int mpclient_get_session(mpclient* c, char* out, int maxlen);
 /* Send arbitrary JSON string as "data" in a game message. Returns 0 on success. */
 int mpclient_send_game(mpclient* c, const char* data_json);
+/* Latest-wins variant for state snapshots: the message waits in a single slot until everything queued before it has
+   been written and the send-rate cap allows, and a newer state replaces it there instead of queueing behind it. Never
+   blocks. Returns 0 on success. */
+int mpclient_send_state(mpclient* c, const char* data_json);
+/* Caps mpclient_send_state() deliveries at max_per_sec (0 = uncapped, the default) */
+void mpclient_set_send_rate(mpclient* c, int max_per_sec);
+/* TCP_NODELAY (on by default) and TCP_CORK around each batched flush (off by default); takes effect immediately when
+   connected */
+void mpclient_set_tcp_options(mpclient* c, int nodelay, int cork);
+
+/* Simulated network conditions for local testing (NULL = none, the default), applied to both directions from the next
+   mpclient_connect_and_start(): every command and received line is delayed, game messages may also be dropped or
+   reordered, and the bandwidth cap makes state sends back up as they would on a slow link */
+void mpclient_set_conditions(mpclient* c, const NetShaperConfig* cfg);
+
+/* Lowest "caps" value advertised by the peers seen in this session; 0 while any peer has not advertised one or none has
+   been seen. Decides whether state may be sent in a newer encoding than plain JSON. */
+int mpclient_peer_caps(mpclient* c);
 
+/* Non-blocking view of the next received message without copying it: NUL-terminated, `len_out` (optional) receives its
+   length, valid until mpclient_release_message(). Returns NULL if no message is available. Game thread only. */
+const char* mpclient_peek_message(mpclient* c, size_t* len_out);
+void mpclient_release_message(mpclient* c);
 /* Non-blocking poll for next received game message. If a message is present, copies up to maxlen bytes into out (null-terminated) and returns 1. Returns 0 if no message available. */
 int mpclient_poll_message(mpclient* c, char* out, int maxlen);
-
-/* Returns non-zero if client has an active session id assigned (host or joined). */
-int mpclient_has_session(mpclient* c);
+/* Inbox counters: messages queued, consumed and dropped because the inbox was full, and its high-water marks */
+void mpclient_get_queue_stats(mpclient* c, MsgRingStats* out);
+typedef struct {
+    /* Commands queued and the socket writes that carried them (fewer when queued commands coalesced) */
+    uint64_t cmds;
+    uint64_t writes;
+    /* States handed to the queue and states overwritten in the slot by a newer one before that */
+    uint64_t states_sent;
+    uint64_t states_replaced;
+} MpClientSendStats;
+void mpclient_get_send_stats(mpclient* c, MpClientSendStats* out);
 
 /* Close socket and stop threads */
 void mpclient_stop(mpclient* c);
@@ -0,0 +1,30 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+/* Lock-free single-producer/single-consumer queue of variable-length messages in one preallocated byte arena. Each
+   message is stored once, NUL-terminated, behind an 8-byte length header; a record that would run past the end of the
+   arena leaves a wrap marker and starts again at the front. The producer never touches the consumer's records, so a
+   full ring drops the new message rather than the oldest, and counts it. */
+typedef struct MsgRing MsgRing;
+typedef struct {
+    uint64_t pushed;
+    uint64_t popped;
+    uint64_t dropped;
+    /* Most bytes and messages held at once */
+    size_t high_water_bytes;
+    size_t high_water_msgs;
+    size_t capacity;
+} MsgRingStats;
+// Returns a newly allocated MsgRing holding up to `capacity` bytes (rounded up to 8); caller must call msg_ring_destroy()
+MsgRing* msg_ring_create(size_t capacity);
+void msg_ring_destroy(MsgRing* r);
+/* Producer: copies `len` bytes in. Returns false, counting a drop, when there is no room or len is 0. A message whose
+   record (len + 1 rounded to 8, plus the header) exceeds half the capacity is always dropped; anything smaller always
+   fits once the ring has drained. */
+bool msg_ring_push(MsgRing* r, const char* data, size_t len);
+/* Consumer: a view of the oldest message, NUL-terminated and valid until msg_ring_pop(), or NULL when empty */
+const char* msg_ring_peek(MsgRing* r, size_t* len_out);
+void msg_ring_pop(MsgRing* r);
+/* Counters are read without stopping either side, so a snapshot may be a message behind */
+void msg_ring_get_stats(const MsgRing* r, MsgRingStats* out);
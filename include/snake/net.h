@@ -7,8 +7,74 @@ NetClient* net_connect(const char* host, int port);
 void net_disconnect(NetClient* client);
 bool net_send_input(NetClient* client, const InputState* input);
 bool net_recv_state(NetClient* client, GameState* out_game);
+/* net_recv_state into `out_game`'s existing arrays (see net_unpack_game_state_into) */
+bool net_recv_state_into(NetClient* client, GameState* out_game);
+/* Join frame for snakeserver (see snake_server.h); an empty `session` asks for any session with a free slot */
+bool net_send_join(NetClient* client, const char* session, const char* name);
+/* Blocks for the next length-prefixed frame and copies its payload into `buf`. Returns the payload length, or 0 on
+   a closed connection or a frame larger than `buf_size` (which is skipped). */
+size_t net_recv_frame(NetClient* client, unsigned char* buf, size_t buf_size);
+/* Blocks for the next frame and returns its payload in place, valid until the next receive on `client`; NULL on a
+   closed connection or a malformed stream. Reads take whatever the socket has, so one read often yields several
+   frames and the following calls return without a syscall. */
+const unsigned char* net_recv_frame_view(NetClient* client, size_t* len);
+/* Sends each payload behind its own length prefix, straight from the caller's buffers, in as few sendmsg calls as
+   the socket allows (one for up to NET_SEND_FRAMES_MAX frames). Anything queued with net_queue_input goes first. An
+   empty or missing frame fails the call before anything is sent; a failed write also drops the queued frames. */
+typedef struct {
+    const void* data;
+    size_t len;
+} NetFrame;
+#define NET_SEND_FRAMES_MAX 256
+bool net_send_frames(NetClient* client, const NetFrame* frames, int count);
+/* Batching: the frame is packed into the client's send buffer and goes out with the rest of the batch on net_flush()
+   or the next send, in one write; a full buffer is flushed first */
+bool net_queue_input(NetClient* client, const InputState* input);
+bool net_flush(NetClient* client);
 void net_free_unpacked_game_state(GameState* out);
 size_t net_pack_input(const InputState* input, unsigned char* buf, size_t buf_size);
 bool net_unpack_input(const unsigned char* buf, size_t buf_size, InputState* out);
 size_t net_pack_game_state(const GameState* game, unsigned char* buf, size_t buf_size);
 bool net_unpack_game_state(const unsigned char* buf, size_t buf_size, GameState* out);
+/* Unpacks into the food and players arrays `out` already has (zeroed, or from a previous unpack), growing them only
+   when the counts exceed max_food / max_players, so a steady stream of states allocates nothing. On failure the
+   counts are 0 and the arrays stay; release them with net_free_unpacked_game_state(). */
+bool net_unpack_game_state_into(const unsigned char* buf, size_t buf_size, GameState* out);
+/* Fixed set of GameStates for received states that outlive the next receive (interpolation, hand-off to another
+   thread). Slots keep their arrays between uses, so once warm, acquire/unpack/release never allocates. */
+typedef struct NetStatePool NetStatePool;
+// Returns a newly allocated NetStatePool of `capacity` slots; caller must call net_state_pool_destroy()
+NetStatePool* net_state_pool_create(int capacity);
+void net_state_pool_destroy(NetStatePool* pool);
+/* A free slot with zero counts, or NULL when every slot is in use */
+GameState* net_state_pool_acquire(NetStatePool* pool);
+void net_state_pool_release(NetStatePool* pool, GameState* gs);
+/* Acquires a slot and unpacks into it; NULL when the pool is exhausted or the buffer is malformed */
+GameState* net_state_pool_unpack(NetStatePool* pool, const unsigned char* buf, size_t buf_size);
+/* Versioned full-state encoding for peer-to-peer state messages. It extends the net_pack_game_state header with the
+   tick, then per active player: name, color, score, direction and the body as a head position plus one 2-bit move per
+   further segment (raw coordinates when a body is not contiguous). */
+#define NET_STATE_VERSION 1
+/* Largest encoding of a GameState within SNAKE_MAX_PLAYERS / SNAKE_BODY_MAX_LEN / SNAKE_MAX_FOOD */
+#define NET_STATE_MAX_PACKED (24 + SNAKE_MAX_FOOD * 8 + SNAKE_MAX_PLAYERS * (24 + PERSIST_PLAYER_NAME_MAX + SNAKE_BODY_MAX_LEN * 8))
+size_t net_pack_state(const GameState* game, int tick, unsigned char* buf, size_t buf_size);
+/* Interest management for a server that packs one state per receiver. The receiver's own snake, and every snake with a
+   segment within `radius` cells of its head (Chebyshev distance) or up to `view_range` cells ahead of it inside the
+   90-degree cone it faces, go out in full. The others go out as summaries (head, length, score, direction) once every
+   `far_ticks` ticks, staggered by receiver, and are left out in between; the receiver moves the body it already has
+   along behind a summary's head. radius 0 turns the filter off. */
+typedef struct {
+    int radius;
+    int view_range;
+    int far_ticks;
+} NetInterest;
+/* net_pack_state as player `viewer` should see it under `interest`; identical to net_pack_state when `interest` is
+   NULL or off, or the viewer has no live snake */
+size_t net_pack_state_for(const GameState* game, int tick, int viewer, const NetInterest* interest, unsigned char* buf, size_t buf_size);
+/* Applies an encoded state to `g` the same way net_json_apply_state applies a JSON one. Returns false on an unknown
+   version or a truncated buffer; entries decoded before the error stay applied. */
+bool net_apply_packed_state(Game* g, const unsigned char* buf, size_t buf_size, bool is_host);
+/* Standard base64 with padding. encode NUL-terminates and returns the length written, or 0 when `out` is too small;
+   decode returns false on invalid input or a short `out`. */
+size_t net_base64_encode(const unsigned char* in, size_t n, char* out, size_t out_size);
+bool net_base64_decode(const char* in, size_t n, unsigned char* out, size_t out_size, size_t* out_len);
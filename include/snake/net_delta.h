@@ -0,0 +1,30 @@
+#pragma once
+#include "game.h"
+#include "net.h"
+#include <stdbool.h>
+#include <stddef.h>
+/* Delta-compressed peer state. Each message carries the sender's sequence number and, for every peer it has heard
+   from, the newest sequence it reconstructed from that peer. A sender encodes against the newest of its own states
+   that all live peers have acknowledged: per player only the head segments added since, the new length (which
+   implies the tail trim), and score or direction when they changed; food is resent only when it differs. A keyframe
+   with the full state is sent when there is no common acknowledged base in the history and at least every
+   NET_DELTA_KEYFRAME_INTERVAL messages, so a peer that lost sync recovers. */
+#define NET_DELTA_CAPS 2
+#define NET_DELTA_HISTORY 16
+#define NET_DELTA_KEYFRAME_INTERVAL 64
+#define NET_DELTA_MAX_PEERS SNAKE_MAX_PLAYERS
+/* Largest message: a keyframe plus the sender name and one ack per peer */
+#define NET_DELTA_MAX_PACKED (NET_STATE_MAX_PACKED + 16 + (NET_DELTA_MAX_PEERS + 1) * (6 + PERSIST_PLAYER_NAME_MAX))
+typedef struct NetDelta NetDelta;
+// Returns a newly allocated NetDelta for the player named `self_name`; caller must call net_delta_destroy()
+NetDelta* net_delta_create(const char* self_name);
+void net_delta_destroy(NetDelta* d);
+/* Encodes `gs` as the next message into `buf`, which must hold NET_DELTA_MAX_PACKED bytes. Returns the number of bytes
+   written, or 0 when `buf_size` is smaller. */
+size_t net_delta_encode(NetDelta* d, const GameState* gs, int tick, unsigned char* buf, size_t buf_size);
+/* Applies a peer's message to `g` as net_apply_packed_state would and records its acknowledgement of our states.
+   Returns false for a malformed message or a delta whose base we no longer hold; nothing is applied and no peer is
+   added or updated then, and the sender falls back to a keyframe once our acknowledgement goes stale. */
+bool net_delta_apply(NetDelta* d, Game* g, const unsigned char* buf, size_t buf_size, bool is_host);
+/* Messages encoded so far as keyframes and as deltas */
+void net_delta_get_stats(const NetDelta* d, int* keyframes, int* deltas);
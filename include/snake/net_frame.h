@@ -0,0 +1,25 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+/* Streaming decoder for the length-prefixed frames of the binary protocol (u32 big-endian payload length, then the
+   payload). Socket reads go straight into its arena, whatever they happen to cut, and complete frames are handed out
+   in place without copying. The arena is reused from frame to frame and only grows for a frame larger than any before
+   it. */
+typedef struct NetFrameDecoder NetFrameDecoder;
+// Returns a newly allocated NetFrameDecoder accepting payloads up to `max_frame` bytes; caller must call
+// net_frame_decoder_destroy()
+NetFrameDecoder* net_frame_decoder_create(size_t max_frame);
+void net_frame_decoder_destroy(NetFrameDecoder* d);
+/* Free space at the end of the arena for the next read (at least one byte unless allocation fails, NULL then). Moves
+   pending bytes, so payloads returned earlier are invalid afterwards. */
+unsigned char* net_frame_decoder_space(NetFrameDecoder* d, size_t* avail);
+/* Marks `n` bytes read into the space as received */
+void net_frame_decoder_commit(NetFrameDecoder* d, size_t n);
+/* Copies `n` received bytes in; false when the arena cannot grow */
+bool net_frame_decoder_feed(NetFrameDecoder* d, const void* data, size_t n);
+/* Next complete frame: 1 with its payload (valid until the next space or feed call), 0 when more bytes are needed,
+   -1 for an empty or oversized frame, after which the stream is unusable */
+int net_frame_decoder_next(NetFrameDecoder* d, const unsigned char** payload, size_t* len);
+/* Bytes received but not yet handed out as frames */
+size_t net_frame_decoder_pending(const NetFrameDecoder* d);
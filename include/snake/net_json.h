@@ -0,0 +1,32 @@
+#pragma once
+#include "game.h"
+#include "net_delta.h"
+#include <stdbool.h>
+#include <stddef.h>
+/* Applies a peer's {"type":"state",...} message to `g` in one forward pass over the first `len` bytes of `json`.
+   Nothing is copied or allocated: names are unescaped into stack buffers and body segments are written straight into
+   the matching remote PlayerState. Our own player reflected back is skipped, unknown remote players are added, and
+   food is only taken when `is_host` is false. A body that appears before the player's "name" key is attributed to
+   the player named so far (empty), matching the old lookup. Returns false when the buffer is not a state message;
+   a state message that turns out malformed part-way keeps whatever was applied before the error. "dstate" messages go
+   through `delta`, which tracks the sender's history; with a NULL `delta` they are recognized but dropped. */
+bool net_json_apply_state(Game* g, NetDelta* delta, const char* json, size_t len, bool is_host);
+/* Serializes game state into the {"type":"state",...} message read by net_json_apply_state. The writer owns an output
+   buffer that is reused across ticks and only grows, and keeps each player's escaped name until the name changes, so
+   a steady-state tick performs no allocation and no printf. */
+typedef struct NetJsonWriter NetJsonWriter;
+// Returns a newly allocated NetJsonWriter; caller must call net_json_writer_destroy()
+NetJsonWriter* net_json_writer_create(void);
+void net_json_writer_destroy(NetJsonWriter* w);
+/* Returns the NUL-terminated message, owned by `w` and valid until the next call, or NULL when the buffer cannot
+   grow. `len_out` (optional) receives its length. */
+const char* net_json_write_state(NetJsonWriter* w, const GameState* gs, int tick, size_t* len_out);
+/* Advertises the binary state version this client decodes as a "caps" member of every message it writes, which peers
+   use to decide whether they may send binary. 0, the default, leaves it out. */
+void net_json_writer_set_caps(NetJsonWriter* w, int state_version);
+/* Writes {"type":"bstate","caps":N,"b64":"..."}: the net_pack_state encoding, base64-wrapped so it can travel in the
+   mpapi data field. net_json_apply_state accepts both forms. Returns NULL when the state cannot be encoded. */
+const char* net_json_write_packed_state(NetJsonWriter* w, const GameState* gs, int tick, size_t* len_out);
+/* Writes {"type":"dstate","caps":N,"b64":"..."} carrying the next net_delta_encode message for `gs`. Returns NULL when
+   the state cannot be encoded. */
+const char* net_json_write_delta_state(NetJsonWriter* w, NetDelta* delta, const GameState* gs, int tick, size_t* len_out);
@@ -1,19 +1,50 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Asynchronous network log. Each thread formats its records into its own lock-free ring, and a background writer
+   drains all rings in batches, so logging never takes a lock or touches the file on the caller's thread. A full ring
+   drops the record and the writer reports how many. The file is logs/net_io.log, or $SNAKE_NET_LOG.
+
+   Levels: records above the runtime level (SNAKE_NET_LOG_LEVEL = off|error|info|debug|io, default io) are skipped
+   before their arguments are evaluated, and records above NET_LOG_MAX_LEVEL are compiled out altogether (build with
+   e.g. -DNET_LOG_MAX_LEVEL=NET_LOG_INFO to drop the per-message lines and hex dumps). */
+#define NET_LOG_OFF 0
+#define NET_LOG_ERROR 1
+#define NET_LOG_INFO 2
+/* Per-message and per-player lines on the hot path */
+#define NET_LOG_DEBUG 3
+/* Hex dumps of every socket read and write */
+#define NET_LOG_IO 4
+#ifndef NET_LOG_MAX_LEVEL
+#define NET_LOG_MAX_LEVEL NET_LOG_IO
+#endif
+
 void net_log_init(void);
+/* Writes out everything logged so far and stops the writer; logging again starts it over */
 void net_log_close(void);
+/* Blocks until every record logged before the call is in the file */
+void net_log_flush(void);
+void net_log_set_level(int level);
+int net_log_get_level(void);
+bool net_log_enabled(int level);
 
-void net_log_info(const char* fmt, ...);
-void net_log_error(const char* fmt, ...);
+void net_log_write(int level, const char* fmt, ...);
+void net_log_io(const char* dir, int fd, const void* buf, size_t len, const char* note);
 
-void net_log_send(int fd, const void* buf, size_t len, const char* note);
-void net_log_recv(int fd, const void* buf, size_t len, const char* note);
+#define NET_LOG_AT(level, ...) (((level) <= NET_LOG_MAX_LEVEL && net_log_enabled(level)) ? net_log_write((level), __VA_ARGS__) : (void)0)
+#define net_log_error(...) NET_LOG_AT(NET_LOG_ERROR, __VA_ARGS__)
+#define net_log_info(...) NET_LOG_AT(NET_LOG_INFO, __VA_ARGS__)
+#define net_log_debug(...) NET_LOG_AT(NET_LOG_DEBUG, __VA_ARGS__)
+#define net_log_send(fd, buf, len, note)                                                                               \
+    ((NET_LOG_IO <= NET_LOG_MAX_LEVEL && net_log_enabled(NET_LOG_IO)) ? net_log_io("SEND", (fd), (buf), (len), (note)) : (void)0)
+#define net_log_recv(fd, buf, len, note)                                                                               \
+    ((NET_LOG_IO <= NET_LOG_MAX_LEVEL && net_log_enabled(NET_LOG_IO)) ? net_log_io("RECV", (fd), (buf), (len), (note)) : (void)0)
 
 #ifdef __cplusplus
 }
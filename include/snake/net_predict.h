@@ -0,0 +1,29 @@
+#pragma once
+#include "game.h"
+#include <stdint.h>
+/* Client-side prediction of remote snakes. Every snake is simulated by its owner, so the only inputs a receiver can
+   replay are each remote snake's last known direction: between snapshots a remote snake keeps moving one cell per
+   local tick, up to `max_ahead` ticks past its newest authoritative body. When a snapshot lands, the ticks it covers
+   are matched against the ones already predicted and only the remainder is replayed on top of it, so a correct
+   prediction causes no visible change and a wrong one glides to the corrected pose over the next tick instead of
+   snapping back. Snapshots older than the one already applied are ignored. */
+#define NET_PREDICT_MAX_AHEAD 8
+typedef struct NetPredict NetPredict;
+typedef struct {
+    /* Cells advanced without a snapshot */
+    uint64_t predicted;
+    /* Snapshots that matched the prediction, that needed a correction, and that arrived out of date */
+    uint64_t confirmed;
+    uint64_t corrected;
+    uint64_t stale;
+} NetPredictStats;
+// Returns a newly allocated NetPredict running up to `max_ahead` ticks (clamped to NET_PREDICT_MAX_AHEAD) ahead of the
+// newest snapshot, 0 disabling prediction; caller must call net_predict_destroy()
+NetPredict* net_predict_create(int max_ahead);
+void net_predict_destroy(NetPredict* p);
+/* After applying received states: rebases every remote snake that got a snapshot and replays the predicted ticks it
+   does not cover yet */
+void net_predict_reconcile(NetPredict* p, Game* g);
+/* After game_step(): moves every predicted remote snake one cell along its direction */
+void net_predict_step(NetPredict* p, Game* g);
+void net_predict_get_stats(const NetPredict* p, NetPredictStats* out);
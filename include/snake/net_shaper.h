@@ -0,0 +1,43 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+/* Network conditioning for local testing: a timed queue that holds each message for a simulated one-way delay plus
+   jitter after serializing it through a bandwidth cap, and drops or reorders a share of the droppable ones. It works on
+   whole messages, so a TCP line stream stays well formed, and releases them in order except for the ones picked to
+   overtake the message queued before them. Single-threaded; times are platform_now_ms() values. */
+typedef struct {
+    int delay_ms;
+    /* Each message's delay varies uniformly by up to +-jitter_ms; a late message holds back the ones behind it */
+    int jitter_ms;
+    /* Link rate in kilobits per second; 0 = unlimited */
+    int kbps;
+    /* Percent of droppable messages lost, and of the rest that overtake the message before them */
+    int drop_pct;
+    int reorder_pct;
+} NetShaperConfig;
+typedef struct {
+    uint64_t queued;
+    uint64_t released;
+    uint64_t dropped;
+    uint64_t reordered;
+    size_t high_water_msgs;
+} NetShaperStats;
+typedef struct NetShaper NetShaper;
+/* True when any setting would change traffic */
+bool net_shaper_config_active(const NetShaperConfig* cfg);
+// Returns a newly allocated NetShaper with `cfg` clamped to sane ranges and its random stream seeded by `seed`; caller
+// must call net_shaper_destroy()
+NetShaper* net_shaper_create(const NetShaperConfig* cfg, uint32_t seed);
+void net_shaper_destroy(NetShaper* s);
+/* Copies `len` bytes in, due after the link and delay allow. Only `droppable` messages are ever dropped or reordered.
+   Returns false when the message was dropped or could not be stored. */
+bool net_shaper_push(NetShaper* s, const char* data, size_t len, bool droppable, uint64_t now_ms);
+/* The oldest message if it is due: NUL-terminated and valid until net_shaper_pop(), or NULL */
+const char* net_shaper_peek(const NetShaper* s, uint64_t now_ms, size_t* len_out);
+void net_shaper_pop(NetShaper* s);
+/* Milliseconds until the next message is due (0 = now), or -1 when nothing is queued */
+int net_shaper_timeout_ms(const NetShaper* s, uint64_t now_ms);
+/* Milliseconds the link still needs for earlier messages (0 = idle); while busy, a real socket would push back */
+int net_shaper_busy_ms(const NetShaper* s, uint64_t now_ms);
+void net_shaper_get_stats(const NetShaper* s, NetShaperStats* out);
@@ -32,6 +32,12 @@
 #define PERSIST_CONFIG_DEFAULT_TAIL_SCALE 0.50f
 #define PERSIST_CONFIG_DEFAULT_WALL_TEXTURE_SCALE 1.0f
 #define PERSIST_CONFIG_DEFAULT_FLOOR_TEXTURE_SCALE 1.0f
+/* Dynamic resolution: 0 disables it; otherwise the render scale moves between the bounds to hold this rate */
+#define PERSIST_CONFIG_DEFAULT_TARGET_FPS 0
+#define PERSIST_CONFIG_DEFAULT_RENDER_SCALE_MIN 0.50f
+#define PERSIST_CONFIG_DEFAULT_RENDER_SCALE_MAX 1.0f
+/* Reuse floor rows across frames while the camera moves less than half a pixel's worth */
+#define PERSIST_CONFIG_DEFAULT_FLOOR_REPROJECTION 0
 #define PERSIST_TEXTURE_PATH_MAX 128
 #define PERSIST_CONFIG_DEFAULT_WALL_TEXTURE "assets/wall.png"
 #define PERSIST_CONFIG_DEFAULT_FLOOR_TEXTURE "assets/floor.png"
@@ -105,6 +111,14 @@ void game_config_set_wall_texture_scale(GameConfig* cfg, float v);
 float game_config_get_wall_texture_scale(const GameConfig* cfg);
 void game_config_set_floor_texture_scale(GameConfig* cfg, float v);
 float game_config_get_floor_texture_scale(const GameConfig* cfg);
+void game_config_set_target_fps(GameConfig* cfg, int fps);
+int game_config_get_target_fps(const GameConfig* cfg);
+void game_config_set_render_scale_min(GameConfig* cfg, float v);
+float game_config_get_render_scale_min(const GameConfig* cfg);
+void game_config_set_render_scale_max(GameConfig* cfg, float v);
+float game_config_get_render_scale_max(const GameConfig* cfg);
+void game_config_set_floor_reprojection(GameConfig* cfg, int v);
+int game_config_get_floor_reprojection(const GameConfig* cfg);
 void game_config_set_key_quit(GameConfig* cfg, char c);
 char game_config_get_key_quit(const GameConfig* cfg);
 void game_config_set_key_restart(GameConfig* cfg, char c);
@@ -133,6 +147,12 @@ int game_config_get_active_player(const GameConfig* cfg);
 #define PERSIST_MP_IDENTIFIER_MAX 37
 #define PERSIST_MP_HOST_MAX 128
 #define PERSIST_MP_SESSION_MAX 16
+/* Most state messages sent per second; 0 leaves them paced by the tick alone */
+#define PERSIST_CONFIG_DEFAULT_MP_SEND_HZ 30
+/* Ticks a remote snake may be extrapolated past its newest snapshot; 0 shows snapshots as they arrive */
+#define PERSIST_CONFIG_DEFAULT_MP_PREDICT_TICKS 2
+/* Ticks between summaries of snakes outside a receiver's interest, when snakeserver filters by interest */
+#define PERSIST_CONFIG_DEFAULT_SERVER_INTEREST_FAR_TICKS 10
 
 void game_config_set_mp_enabled(GameConfig* cfg, int v);
 int game_config_get_mp_enabled(const GameConfig* cfg);
@@ -149,6 +169,40 @@ const char* game_config_get_mp_session(const GameConfig* cfg);
 /* mp_is_host: hint for whether to spawn food locally (host) or sync from server (client) */
 int game_config_get_mp_is_host(const GameConfig* cfg);
 
+/* Outbound state pacing and socket options: mp_send_hz caps state sends per second (0-1000, 0 = uncapped), mp_tcp_nodelay
+   disables Nagle (default on), mp_tcp_cork holds each batched flush until it is complete (default off) */
+void game_config_set_mp_send_hz(GameConfig* cfg, int hz);
+int game_config_get_mp_send_hz(const GameConfig* cfg);
+void game_config_set_mp_tcp_nodelay(GameConfig* cfg, int v);
+int game_config_get_mp_tcp_nodelay(const GameConfig* cfg);
+void game_config_set_mp_tcp_cork(GameConfig* cfg, int v);
+int game_config_get_mp_tcp_cork(const GameConfig* cfg);
+/* mp_predict_ticks: client-side prediction horizon for remote snakes (0-8, 0 = off) */
+void game_config_set_mp_predict_ticks(GameConfig* cfg, int ticks);
+int game_config_get_mp_predict_ticks(const GameConfig* cfg);
+/* Simulated network conditions for local testing, all 0 (off) by default: one-way mp_sim_delay_ms (0-60000) varied by up
+   to +-mp_sim_jitter_ms, an mp_sim_kbps link cap (0 = unlimited), and the percent of game messages dropped
+   (mp_sim_drop_pct) or reordered (mp_sim_reorder_pct) */
+void game_config_set_mp_sim_delay_ms(GameConfig* cfg, int v);
+int game_config_get_mp_sim_delay_ms(const GameConfig* cfg);
+void game_config_set_mp_sim_jitter_ms(GameConfig* cfg, int v);
+int game_config_get_mp_sim_jitter_ms(const GameConfig* cfg);
+void game_config_set_mp_sim_kbps(GameConfig* cfg, int v);
+int game_config_get_mp_sim_kbps(const GameConfig* cfg);
+void game_config_set_mp_sim_drop_pct(GameConfig* cfg, int v);
+int game_config_get_mp_sim_drop_pct(const GameConfig* cfg);
+void game_config_set_mp_sim_reorder_pct(GameConfig* cfg, int v);
+int game_config_get_mp_sim_reorder_pct(const GameConfig* cfg);
+/* snakeserver interest management (see NetInterest), off by default: full detail for snakes within
+   server_interest_radius cells (0 = off, 0-1000) or server_interest_view cells ahead (0-1000), summaries of the rest
+   every server_interest_far_ticks ticks (0 = never, 0-1000) */
+void game_config_set_server_interest_radius(GameConfig* cfg, int v);
+int game_config_get_server_interest_radius(const GameConfig* cfg);
+void game_config_set_server_interest_view(GameConfig* cfg, int v);
+int game_config_get_server_interest_view(const GameConfig* cfg);
+void game_config_set_server_interest_far_ticks(GameConfig* cfg, int v);
+int game_config_get_server_interest_far_ticks(const GameConfig* cfg);
+
 /* Headless mode: run without TTY/SDL graphics, print state to stdout */
 void game_config_set_headless(GameConfig* cfg, int v);
 int game_config_get_headless(const GameConfig* cfg);
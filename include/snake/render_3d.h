@@ -2,6 +2,8 @@
 #include "game.h"
 #include "persist.h"
 #include <stdbool.h>
+#include <stdint.h>
+struct Camera3D;
 struct SDL3DContext;
 typedef struct {
     int active_player;
@@ -14,6 +16,10 @@ typedef struct {
     float tail_height_scale;
     float wall_texture_scale;
     float floor_texture_scale;
+    int target_fps;         /* 0 keeps the full window resolution */
+    float render_scale_min; /* bounds for the dynamic render scale, fraction of the window size */
+    float render_scale_max;
+    bool floor_reprojection; /* shift cached floor rows into place while they stay within half a texel of the true floor */
     char wall_texture_path[PERSIST_TEXTURE_PATH_MAX];
     char floor_texture_path[PERSIST_TEXTURE_PATH_MAX];
 } Render3DConfig;
@@ -29,4 +35,31 @@ void render_3d_draw_death_overlay(const GameState* game, int anim_frame, bool sh
 void render_3d_draw_congrats_overlay(int score, const char* name_entered);
 void render_3d_draw_winner_overlay(const GameState* game, int winner, int score);
 void render_3d_draw_minimap_into(struct SDL3DContext* ctx, const GameState* gs);
-int render_3d_compute_minimap_cell_px(int display_w, int display_h, int map_w, int map_h);
\ No newline at end of file
+int render_3d_compute_minimap_cell_px(int display_w, int display_h, int map_w, int map_h);
+/* Self-contained renderer instance with no window and no global state. Each call draws a full frame (floor, walls,
+   sprites, minimap) as seen from `camera` into caller-owned ARGB8888 `pixels` of width*height; the camera is only
+   read for its interpolated pose. Config screen size is ignored in favour of the per-call size. */
+typedef struct Render3DContext Render3DContext;
+/* Reference-counted textures; contexts created from the same shared block load them only once. */
+typedef struct Render3DShared Render3DShared;
+Render3DShared* render_3d_shared_create(const Render3DConfig* config);
+void render_3d_shared_retain(Render3DShared* shared);
+void render_3d_shared_release(Render3DShared* shared);
+Render3DContext* render_3d_context_create(const Render3DConfig* config);
+// Retains `shared`; pass NULL to load a private set of textures
+Render3DContext* render_3d_context_create_shared(const Render3DConfig* config, Render3DShared* shared);
+void render_3d_context_destroy(Render3DContext* ctx);
+bool render_3d_render_offscreen(Render3DContext* ctx, const GameState* game_state, struct Camera3D* camera, uint32_t* pixels, int width, int height);
+// Floor rows the last frame took from the reprojection cache instead of sampling
+int render_3d_context_get_floor_rows_reused(const Render3DContext* ctx);
+#define RENDER_3D_MAX_VIEWPORTS 4
+typedef struct {
+    int x, y, width, height; /* region of the target buffer */
+    struct Camera3D* camera;
+    int player; /* whose own head is hidden in this view; -1 for none */
+} Render3DViewport;
+/* Split-screen: renders every viewport into its region of one width*height buffer in a single call. Each viewport
+   keeps its own projection, depth buffer and sprite list while sharing the context's textures and sprite lighting; with
+   `parallel` the other viewports render on worker threads the context starts once and keeps, and must use distinct
+   cameras. */
+bool render_3d_render_viewports(Render3DContext* ctx, const GameState* game_state, const Render3DViewport* viewports, int count, uint32_t* pixels, int width, int height, bool parallel);
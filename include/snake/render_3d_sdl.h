@@ -4,9 +4,18 @@
 typedef struct SDL3DContext SDL3DContext;
 // Returns a newly allocated SDL3DContext; caller must call render_3d_sdl_destroy()
 SDL3DContext* render_3d_sdl_create(int width, int height, int vsync);
+// Wraps caller-owned pixels (rows `pitch` pixels apart) without creating a window; present never uploads anything
+SDL3DContext* render_3d_sdl_create_offscreen(int width, int height, int pitch, uint32_t* pixels);
 void render_3d_sdl_destroy(SDL3DContext* ctx);
 int render_3d_sdl_get_width(const SDL3DContext* ctx);
 int render_3d_sdl_get_height(const SDL3DContext* ctx);
+int render_3d_sdl_get_pitch(const SDL3DContext* ctx);
+int render_3d_sdl_get_max_width(const SDL3DContext* ctx);
+int render_3d_sdl_get_max_height(const SDL3DContext* ctx);
+/* Draws into the top-left width x height corner of the allocated buffer, which present stretches over the whole
+   window. Sizes are clamped to the allocated size; returns true when the size changed, after which the caller must
+   redraw every pixel. */
+bool render_3d_sdl_set_render_size(SDL3DContext* ctx, int width, int height);
 uint32_t* render_3d_sdl_get_pixels(SDL3DContext* ctx);
 bool render_3d_sdl_init(int width, int height, int vsync, SDL3DContext* ctx_out);
 void render_3d_sdl_shutdown(SDL3DContext* ctx);
@@ -16,5 +25,22 @@ void render_3d_sdl_set_pixel(SDL3DContext* ctx, int x, int y, uint32_t col);
 void render_3d_sdl_blend_pixel(SDL3DContext* ctx, int x, int y, uint32_t src_col);
 void render_3d_sdl_draw_filled_circle(SDL3DContext* ctx, int center_x, int center_y, int radius, uint32_t col);
 void render_3d_sdl_draw_filled_rect(SDL3DContext* ctx, int x, int y, int w, int h, uint32_t col);
+/* Uploads only the regions marked dirty since the last call and skips the present entirely when nothing changed. */
 bool render_3d_sdl_present(SDL3DContext* ctx);
+/* Moves the copy (and format conversion) of each frame into the streaming texture to a worker thread fed from a ring
+   of CPU framebuffers, so drawing the next frame overlaps it. Every SDL call, including the texture lock, stays on the
+   presenting thread as SDL requires; a frame reaches the screen on the following present, one frame later than
+   synchronous presentation. Returns whether async presentation is active; it stays off when there is no renderer
+   (SDL unavailable or bare-buffer fallback). The pixel pointer changes on every present. */
+bool render_3d_sdl_set_async_present(SDL3DContext* ctx, bool enable);
+bool render_3d_sdl_is_async_present(const SDL3DContext* ctx);
+bool render_3d_sdl_has_renderer(const SDL3DContext* ctx);
+/* Frames the async path has copied on the worker and presented */
+int render_3d_sdl_get_async_presented(const SDL3DContext* ctx);
+/* Draw primitives mark what they touch; callers writing through render_3d_sdl_get_pixels() must mark before writing.
+   mark_all_dirty promises the caller overwrites every pixel. */
+void render_3d_sdl_mark_dirty(SDL3DContext* ctx, int x, int y, int w, int h);
+void render_3d_sdl_mark_all_dirty(SDL3DContext* ctx);
+int render_3d_sdl_get_dirty_count(const SDL3DContext* ctx);
+bool render_3d_sdl_get_dirty_rect(const SDL3DContext* ctx, int idx, int* x, int* y, int* w, int* h);
 static inline uint32_t render_3d_sdl_color(uint8_t r, uint8_t g, uint8_t b, uint8_t a) { return ((uint32_t)a << 24) | ((uint32_t)r << 16) | ((uint32_t)g << 8) | (uint32_t)b; }
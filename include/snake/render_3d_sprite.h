@@ -11,6 +11,8 @@ typedef struct SpriteRenderer3D SpriteRenderer3D;
 SpriteRenderer3D* sprite_create(int max_sprites, const Camera3D* camera, const Projection3D* proj);
 void sprite_destroy(SpriteRenderer3D* sr);
 void sprite_init(SpriteRenderer3D* sr, int max_sprites, const Camera3D* camera, const Projection3D* proj);
+/* Rebinds the camera and projection used for projecting sprites */
+void sprite_set_view(SpriteRenderer3D* sr, const Camera3D* camera, const Projection3D* proj);
 void sprite_clear(SpriteRenderer3D* sr);
 bool sprite_add(SpriteRenderer3D* sr, float world_x, float world_y, float world_height, float pivot, bool face_camera, int texture_id, int frame);
 bool sprite_add_color(SpriteRenderer3D* sr, float world_x, float world_y, float world_height, float pivot, bool face_camera, int texture_id, int frame, uint32_t color);
@@ -18,6 +20,15 @@ bool sprite_add_rect_color(SpriteRenderer3D* sr, float world_x, float world_y, f
 /* New shaded variants: draw as faux spheres with simple lighting */
 bool sprite_add_color_shaded(SpriteRenderer3D* sr, float world_x, float world_y, float world_height, float pivot, bool face_camera, int texture_id, int frame, uint32_t color);
 bool sprite_add_rect_color_shaded(SpriteRenderer3D* sr, float world_x, float world_y, float world_height, float pivot, bool face_camera, int texture_id, int frame, uint32_t color);
+/* Lighting for the shaded variants: intensity over a grid spanning the sphere's disc, 0 outside it. Read-only once
+   built, so one table serves any number of renderers and threads. */
+#define SPRITE_LIGHT_TABLE_SIZE 32
+typedef struct {
+float intensity[SPRITE_LIGHT_TABLE_SIZE][SPRITE_LIGHT_TABLE_SIZE];
+} SpriteLighting;
+void sprite_lighting_build(SpriteLighting* lt);
+/* Shades with `lt`, which must outlive `sr`; without one a process-wide table is built on first use */
+void sprite_set_lighting(SpriteRenderer3D* sr, const SpriteLighting* lt);
 void sprite_project_all(SpriteRenderer3D* sr);
 void sprite_sort_by_depth(SpriteRenderer3D* sr);
 void sprite_draw(SpriteRenderer3D* sr, SDL3DContext* ctx, const float* column_depths);
@@ -0,0 +1,36 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+/* Per-pass render timing collected into fixed-size log-linear histograms (about 3% resolution, 1 ns to minutes).
+   Recording is lock-free and allocation-free so it can stay on in profiling runs without skewing frame times.
+   Enabled by SNAKE_DEBUG_3D_TIMING or SNAKE_SPRITE_PROFILE; the histograms are written as JSON at exit and whenever
+   the process receives SIGUSR1. */
+typedef enum {
+    RENDER_PASS_DECALS= 0,
+    RENDER_PASS_FLOOR,
+    RENDER_PASS_WALLS,
+    RENDER_PASS_SPRITES,
+    RENDER_PASS_SPRITE_PROJECT,
+    RENDER_PASS_SPRITE_SORT,
+    RENDER_PASS_SPRITE_DRAW,
+    RENDER_PASS_MINIMAP,
+    RENDER_PASS_PRESENT,
+    RENDER_PASS_FRAME,
+    RENDER_PASS_COUNT
+} RenderPass;
+#define RENDER_TIMING_DEFAULT_PATH "logs/render_timing.json"
+bool render_timing_enabled(void);
+void render_timing_set_enabled(bool enabled);
+uint64_t render_timing_now_ns(void);
+void render_timing_record(RenderPass pass, uint64_t ns);
+// Returns a start stamp, or 0 when timing is off so render_timing_end() is a no-op
+uint64_t render_timing_begin(void);
+void render_timing_end(RenderPass pass, uint64_t start);
+const char* render_timing_pass_name(RenderPass pass);
+uint64_t render_timing_count(RenderPass pass);
+// Value at percentile `pct` (0..100), accurate to the histogram bucket width
+uint64_t render_timing_percentile_ns(RenderPass pass, double pct);
+void render_timing_reset(void);
+bool render_timing_write_json(const char* path);
+// Writes the JSON dump if SIGUSR1 arrived since the last call; call once per frame
+void render_timing_poll(void);
@@ -0,0 +1,59 @@
+#pragma once
+#include "persist.h"
+#include <stdint.h>
+/* Authoritative game server: every session runs its own Game on the server and clients only send inputs. Sessions are
+   sharded across worker threads, one per core and pinned to it. Each shard owns its listening socket (SO_REUSEPORT),
+   its clients' sockets, its sessions and their games, and drives them all from one non-blocking epoll loop where a
+   session is a task that wakes on its own tick deadline, so nothing on the tick path is shared or locked. A named
+   session belongs to the shard its name hashes to: a join that arrives on another shard hands the connection over
+   through a lock-free queue, and auto-matched sessions get names that hash to the shard creating them.
+
+   Wire format, both directions: u32 big-endian payload length, then the payload (as net_send_input / net_recv_state).
+   Client to server:
+     1 byte              input flags from net_pack_input (moves only; quit closes the connection)
+     'J' len session name  join `session` (empty = any session with a free slot) as `name`; must come first
+   Server to client:
+     'W' len session name  welcome: the session joined and the (possibly de-duplicated) name to find oneself by
+     net_pack_state()      the session's state after every tick; with server_interest_radius set, each client gets
+                           its own net_pack_state_for() view instead, where far snakes are summarized or left out
+   A session restarts its round whenever a player joins or leaves, and when the round is over. */
+#define SNAKE_SERVER_SESSION_MAX 16
+#define SNAKE_SERVER_DEFAULT_PORT 9100
+#define SNAKE_SERVER_MAX_SHARDS 256
+typedef struct SnakeServer SnakeServer;
+/* All fields are uint64_t: shards publish them word by word */
+typedef struct {
+    /* Current sessions and connections */
+    uint64_t sessions;
+    uint64_t clients;
+    uint64_t ticks;
+    uint64_t inputs;
+    /* States queued to clients, and states skipped for a client still behind on earlier ones */
+    uint64_t states_sent;
+    uint64_t states_dropped;
+    uint64_t bytes_out;
+    /* Time spent stepping and broadcasting session ticks, and the latest a tick started past its deadline */
+    uint64_t tick_ns_total;
+    uint64_t tick_ns_max;
+    uint64_t lag_ms_max;
+    /* Joins passed to the shard owning their session, taken over from other shards, and lost to a full queue */
+    uint64_t handoffs_out;
+    uint64_t handoffs_in;
+    uint64_t handoffs_dropped;
+} SnakeServerStats;
+// Returns a newly allocated SnakeServer listening on `port` (0 = any free port) with `shards` worker shards (0 = one
+// per online CPU) and sessions built from `cfg` (board size, tick rate, food); caller must call snake_server_destroy()
+SnakeServer* snake_server_create(const GameConfig* cfg, int port, int shards);
+void snake_server_destroy(SnakeServer* s);
+int snake_server_get_port(const SnakeServer* s);
+/* Starts the shard threads. Returns 0 on success. */
+int snake_server_start(SnakeServer* s);
+/* Stops and joins the shard threads; connections and sessions stay until snake_server_destroy() */
+void snake_server_stop(SnakeServer* s);
+int snake_server_get_shard_count(const SnakeServer* s);
+/* Core a shard's thread is pinned to, or -1 before it starts or when pinning failed */
+int snake_server_get_shard_cpu(const SnakeServer* s, int shard);
+/* Counters as of each shard's last loop pass; safe while the server runs. The totals add up the shards, taking the
+   largest of the maxima. */
+void snake_server_get_shard_stats(const SnakeServer* s, int shard, SnakeServerStats* out);
+void snake_server_get_stats(const SnakeServer* s, SnakeServerStats* out);
@@ -0,0 +1,19 @@
+#pragma once
+#include <stdbool.h>
+/* Chrome trace-event recorder (load the output in chrome://tracing or Perfetto). Build with TRACE=1, which defines
+   SNAKE_TRACE; otherwise every TRACE_* macro expands to nothing. Events go into a per-thread lock-free ring and are
+   written to $SNAKE_TRACE_FILE (default logs/trace.json) at exit or on trace_flush(). Names must be string literals. */
+#ifdef SNAKE_TRACE
+void trace_begin(const char* name);
+void trace_end(const char* name);
+void trace_set_thread_name(const char* name);
+#define TRACE_BEGIN(name) trace_begin(name)
+#define TRACE_END(name) trace_end(name)
+#define TRACE_THREAD_NAME(name) trace_set_thread_name(name)
+#else
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
+// Writes everything still in the rings; NULL uses the default path. Returns false when tracing is compiled out.
+bool trace_flush(const char* path);
@@ -5,6 +5,7 @@
 #include "input.h"
 #include "persist.h"
 #include "player.h"
+#include "trace.h"
 #include "utils.h"
 #include <limits.h>
 #include <stddef.h>
@@ -56,12 +57,14 @@ return 0;
 }
 void game_step(Game* g, GameEvents* out_events) {
 if(!g) return;
+TRACE_BEGIN("game_step");
 if(out_events) (void)memset(out_events, 0, sizeof(*out_events));
 g->state.last_food_respawned= false;
 game_tick(&g->state);
 if(out_events && g->state.last_food_respawned) out_events->food_respawned= true;
 g->state.last_food_respawned= false;
 int num_players= game_state_get_num_players(&g->state);
+TRACE_END("game_step");
 if(!out_events) return;
 out_events->died_count= 0;
 for(int i= 0; i < num_players && out_events->died_count < GAME_EVENTS_MAX_PLAYERS; i++) {
@@ -136,6 +139,8 @@ s->players[idx].active= true;
 s->players[idx].needs_reset= false;
 s->players[idx].length= 0;
 s->players[idx].is_remote= true;
+s->players[idx].net_predicted= false;
+s->players[idx].net_snapshot= false;
 return idx;
 }
 void game_set_food_sync_only(Game* g, bool enable) {
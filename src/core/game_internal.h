@@ -24,6 +24,10 @@ SnakePointF prev_head;
 SnakePointF prev_segment[SNAKE_BODY_MAX_LEN];
 float interp_time; /* Per-player interpolation timer, resets on position change */
 bool is_remote;
+/* Remote players under client-side prediction: the network decoders flag each authoritative body they write in
+   net_snapshot and leave the interpolation state to net_predict */
+bool net_predicted;
+bool net_snapshot;
 };
 
 
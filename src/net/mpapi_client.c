@@ -1,100 +1,147 @@
 #include "mpapi_client.h"
+#include "msg_ring.h"
+#include "net_shaper.h"
 #include "platform.h"
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
-#define MSG_QUEUE_SIZE 64
-#define LINE_BUF_CAP 4096
+/* Inbound bytes are read in large chunks and split on '\n' in place; a line longer than MP_LINE_MAX is skipped */
+#define MP_READ_CHUNK 65536
+#define MP_LINE_MAX (1u << 20)
+/* Inbound game/lobby messages waiting for the game loop; room for dozens of full-size states. The ring only takes
+   messages up to half its size, so it is sized for the longest line MP_LINE_MAX lets through. */
+#define MSG_RING_BYTES (4u * MP_LINE_MAX)
+/* Outbound commands queued but not yet accepted by the socket */
+#define MP_OUT_MAX (4u << 20)
+#define MAX_PEERS 8
+/* How long each step of a session request waits for its reply, and each connect attempt for the server */
+#define MP_HANDSHAKE_MS 2000
+#define MP_CONNECT_MS 2000
+/* identifier, optional ",\"session\":\"<id>\"" in three parts, cmd, data */
+#define MP_CMD_FMT "{\"identifier\":\"%s\"%s%s%s,\"cmd\":\"%s\",\"data\":%s}\n"
 struct mpclient {
 char server_host[128];
 uint16_t server_port;
 char identifier[37];
 int sockfd;
-pthread_t recv_thread;
+/* The I/O thread resolves the server and connects without blocking: the addresses still to try and when the attempt in
+   progress gives up are its own, `connected` is written under `lock` */
+struct addrinfo* conn_addrs;
+struct addrinfo* conn_next;
+uint64_t conn_deadline_ms;
+int connected;
+/* One I/O thread waits on the non-blocking socket and wakefd (written when commands are queued) with epoll */
+int epfd;
+int wakefd;
+pthread_t io_thread;
 int thread_started; /* 1 if thread was created, 0 otherwise */
 int running;
 pthread_mutex_t lock;
-/* simple ring buffer of strings (malloc'd) */
-char* msgs[MSG_QUEUE_SIZE];
-int head;
-int tail;
-/* session id assigned after host/join */
+/* Inbound line buffer, owned by the I/O thread */
+char* in_buf;
+size_t in_len;
+size_t in_cap;
+int in_skip;
+/* Outbound queue under `lock`: commands append, the I/O thread sends [out_off, out_len) in as few writes as the socket
+   allows, so commands queued while one write is pending go out together */
+char* out_buf;
+size_t out_off;
+size_t out_len;
+size_t out_cap;
+int want_out;
+uint64_t out_cmds;
+uint64_t out_writes;
+/* Latest-wins state slot under `lock`: a newer state replaces one still waiting here, and it only moves to the queue
+   once the queue has drained and the send-rate cap allows */
+char* state_buf;
+size_t state_len;
+size_t state_cap;
+int state_pending;
+uint64_t state_next_ms;
+unsigned state_interval_ms;
+uint64_t states_sent;
+uint64_t states_replaced;
+int tcp_nodelay;
+int tcp_cork;
+/* Optional conditioning for local testing: outbound commands wait in `shape_out` (under `lock`) before the queue,
+   inbound lines wait in `shape_in` (I/O thread only) before process_line */
+NetShaperConfig shape_cfg;
+NetShaper* shape_out;
+NetShaper* shape_in;
+/* Filled by the I/O thread only, drained by the game loop only */
+MsgRing* inbox;
+/* session id assigned after host/join; written by the I/O thread under `lock` */
 char session[16];
 char clientId[64];
 int is_host;
+/* Session request under `lock`: started by the game thread, advanced by the I/O thread as replies and deadlines come
+   in, and reported once through hs_cb by mpclient_poll_session() */
+MpClientSessionState hs_state;
+MpClientSessionState hs_next; /* what a request started while connecting waits for once connected */
+char hs_name[64];
+uint64_t hs_deadline_ms;
+int hs_reported;
+mpclient_session_cb hs_cb;
+void* hs_user;
+/* Peers seen in this session and the "caps" they advertise in their game messages (0 until they do) */
+struct {
+char id[64];
+int caps;
+} peers[MAX_PEERS];
+int peer_count;
+int peer_overflow;
 };
-static int connect_to_server(const char* host, uint16_t port) {
-if(!host) host= "127.0.0.1";
-char port_str[16];
-snprintf(port_str, sizeof(port_str), "%u", (unsigned int)port);
-struct addrinfo hints;
-memset(&hints, 0, sizeof(hints));
-hints.ai_family= AF_UNSPEC;
-hints.ai_socktype= SOCK_STREAM;
-struct addrinfo* res= NULL;
-int err= getaddrinfo(host, port_str, &hints, &res);
-if(err != 0) return -1;
-int fd= -1;
-for(struct addrinfo* rp= res; rp != NULL; rp= rp->ai_next) {
-fd= socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
-if(fd == -1) continue;
-int opt= 1;
-setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-if(connect(fd, rp->ai_addr, rp->ai_addrlen) == 0) break;
-close(fd);
-fd= -1;
-}
-freeaddrinfo(res);
-return fd;
-}
 #include "console.h"
 #include "net_log.h"
-static int send_all(int fd, const char* buf, size_t len) {
-size_t sent= 0;
-while(sent < len) {
-ssize_t rc= send(fd, buf + sent, len - sent, 0);
-if(rc <= 0) return -1;
-/* log this chunk */
-net_log_send(fd, buf + sent, (size_t)rc, "mpclient send_all: chunk");
-sent+= (size_t)rc;
-}
-return 0;
-}
+#include "trace.h"
 static void enqueue_msg(struct mpclient* c, const char* s) {
 if(!c || !s) return;
-pthread_mutex_lock(&c->lock);
-int next= (c->tail + 1) % MSG_QUEUE_SIZE;
-if(next == c->head) {
-/* full, drop oldest */
-free(c->msgs[c->head]);
-c->head= (c->head + 1) % MSG_QUEUE_SIZE;
+size_t len= strlen(s);
+if(!msg_ring_push(c->inbox, s, len)) net_log_info("mpclient: inbox full, dropped %zu byte message", len);
 }
-c->msgs[c->tail]= strdup(s);
-c->tail= next;
-pthread_mutex_unlock(&c->lock);
+const char* mpclient_peek_message(mpclient* c, size_t* len_out) {
+if(!c) return NULL;
+return msg_ring_peek(c->inbox, len_out);
+}
+void mpclient_release_message(mpclient* c) {
+if(c) msg_ring_pop(c->inbox);
 }
 int mpclient_poll_message(mpclient* c, char* out, int maxlen) {
 if(!c || !out || maxlen <= 0) return 0;
-pthread_mutex_lock(&c->lock);
-if(c->head == c->tail) {
-pthread_mutex_unlock(&c->lock);
-return 0;
+size_t len= 0;
+const char* s= msg_ring_peek(c->inbox, &len);
+if(!s) return 0;
+if(len > (size_t)maxlen - 1) len= (size_t)maxlen - 1;
+memcpy(out, s, len);
+out[len]= '\0';
+msg_ring_pop(c->inbox);
+return 1;
+}
+void mpclient_get_queue_stats(mpclient* c, MsgRingStats* out) {
+msg_ring_get_stats(c ? c->inbox : NULL, out);
 }
-char* s= c->msgs[c->head];
-c->msgs[c->head]= NULL;
-c->head= (c->head + 1) % MSG_QUEUE_SIZE;
+void mpclient_get_send_stats(mpclient* c, MpClientSendStats* out) {
+if(!out) return;
+memset(out, 0, sizeof *out);
+if(!c) return;
+pthread_mutex_lock(&c->lock);
+out->cmds= c->out_cmds;
+out->writes= c->out_writes;
+out->states_sent= c->states_sent;
+out->states_replaced= c->states_replaced;
 pthread_mutex_unlock(&c->lock);
-strncpy(out, s, (size_t)maxlen - 1);
-out[maxlen - 1]= '\0';
-free(s);
-return 1;
 }
 int mpclient_get_session(mpclient* c, char* out, int maxlen) {
 if(!c || !out || maxlen <= 0) return 0;
@@ -110,13 +157,20 @@ return 0;
 }
 int mpclient_has_session(mpclient* c) {
 if(!c) return 0;
-return c->session[0] != '\0';
+pthread_mutex_lock(&c->lock);
+int has= c->session[0] != '\0';
+pthread_mutex_unlock(&c->lock);
+return has;
 }
 int mpclient_is_host(mpclient* c) {
 if(!c) return 0;
-return c->is_host;
+pthread_mutex_lock(&c->lock);
+int is_host= c->is_host;
+pthread_mutex_unlock(&c->lock);
+return is_host;
 }
-static char* extract_json_field(const char* line, const char* key) {
+/* Locates the value of "key": a string's contents without the quotes, or a balanced object including its braces */
+static const char* json_field_span(const char* line, const char* key, size_t* len_out) {
 /* Find "key" and the following ':' then locate object or string */
 char needle[128];
 snprintf(needle, sizeof(needle), "\"%s\"", key);
@@ -135,12 +189,8 @@ p+= 2;
 else
 p++;
 }
-size_t len= (size_t)(p - start);
-char* out= (char*)malloc(len + 1);
-if(!out) return NULL;
-memcpy(out, start, len);
-out[len]= '\0';
-return out;
+*len_out= (size_t)(p - start);
+return start;
 } else if(*p == '{') {
 /* extract balanced object */
 const char* start= p;
@@ -157,14 +207,129 @@ break;
 }
 p++;
 }
-size_t len= (size_t)(p - start);
+*len_out= (size_t)(p - start);
+return start;
+}
+return NULL;
+}
+static char* extract_json_field(const char* line, const char* key) {
+size_t len= 0;
+const char* start= json_field_span(line, key, &len);
+if(!start) return NULL;
 char* out= (char*)malloc(len + 1);
 if(!out) return NULL;
 memcpy(out, start, len);
 out[len]= '\0';
 return out;
 }
-return NULL;
+/* Our game messages put "caps" right after "type", so only the head of the data object is searched */
+static int data_caps(const char* data, size_t len) {
+for(size_t i= 0; i < 64 && i < len; i++) {
+if(data[i] == '"' && strncmp(data + i, "\"caps\":", 7) == 0) return atoi(data + i + 7);
+}
+return 0;
+}
+/* Records (or updates) a peer; caps < 0 leaves a known peer's caps unchanged. Caller holds c->lock. */
+static void peer_seen(struct mpclient* c, const char* id, int caps) {
+for(int i= 0; i < c->peer_count; i++) {
+if(strcmp(c->peers[i].id, id) == 0) {
+if(caps >= 0) c->peers[i].caps= caps;
+return;
+}
+}
+if(c->peer_count >= MAX_PEERS) {
+c->peer_overflow= 1;
+return;
+}
+snprintf(c->peers[c->peer_count].id, sizeof(c->peers[0].id), "%s", id);
+c->peers[c->peer_count].caps= caps > 0 ? caps : 0;
+c->peer_count++;
+}
+static void peer_left(struct mpclient* c, const char* id) {
+for(int i= 0; i < c->peer_count; i++) {
+if(strcmp(c->peers[i].id, id) == 0) {
+c->peers[i]= c->peers[--c->peer_count];
+return;
+}
+}
+}
+int mpclient_peer_caps(mpclient* c) {
+if(!c) return 0;
+pthread_mutex_lock(&c->lock);
+int caps= (c->peer_count > 0 && !c->peer_overflow) ? c->peers[0].caps : 0;
+for(int i= 1; i < c->peer_count; i++)
+if(c->peers[i].caps < caps) caps= c->peers[i].caps;
+pthread_mutex_unlock(&c->lock);
+return caps;
+}
+static int hs_pending(MpClientSessionState st) { return st == MPCLIENT_SESSION_CONNECTING || st == MPCLIENT_SESSION_LISTING || st == MPCLIENT_SESSION_HOSTING || st == MPCLIENT_SESSION_JOINING; }
+static void hs_finish(struct mpclient* c, MpClientSessionState st) {
+pthread_mutex_lock(&c->lock);
+if(hs_pending(c->hs_state)) c->hs_state= st;
+pthread_mutex_unlock(&c->lock);
+}
+static int send_command(struct mpclient* c, const char* cmd, const char* session, const char* data_json);
+/* Second step of mpclient_auto_join_or_host(), once the list reply (or its deadline) is in: joins the first listed
+   session, or hosts one. I/O thread only. */
+static void hs_list_reply(struct mpclient* c, const char* found) {
+char name[64];
+pthread_mutex_lock(&c->lock);
+if(c->hs_state != MPCLIENT_SESSION_LISTING) {
+pthread_mutex_unlock(&c->lock);
+return;
+}
+c->hs_state= found ? MPCLIENT_SESSION_JOINING : MPCLIENT_SESSION_HOSTING;
+c->hs_deadline_ms= platform_now_ms() + MP_HANDSHAKE_MS;
+snprintf(name, sizeof(name), "%s", c->hs_name);
+pthread_mutex_unlock(&c->lock);
+char payload[256];
+int rc;
+if(found) {
+net_log_info("mpclient: auto-discovered session: %s", found);
+snprintf(payload, sizeof(payload), "{\"name\":\"%s\"}", name);
+rc= send_command(c, "join", found, payload);
+} else {
+net_log_info("mpclient: no session listed, hosting one");
+snprintf(payload, sizeof(payload), "{\"name\":\"%s\",\"private\":false}", name);
+rc= send_command(c, "host", NULL, payload);
+}
+if(rc != 0) hs_finish(c, MPCLIENT_SESSION_FAILED);
+}
+/* Fails or moves on a request whose reply is overdue: a missing list means there is nothing to join. The connect has
+   its own deadline. I/O thread only. */
+static void hs_check_deadline(struct mpclient* c) {
+pthread_mutex_lock(&c->lock);
+MpClientSessionState st= c->hs_state;
+int overdue= hs_pending(st) && st != MPCLIENT_SESSION_CONNECTING && platform_now_ms() >= c->hs_deadline_ms;
+pthread_mutex_unlock(&c->lock);
+if(!overdue) return;
+if(st == MPCLIENT_SESSION_LISTING) {
+hs_list_reply(c, NULL);
+return;
+}
+net_log_error("mpclient: no reply to %s within %d ms", st == MPCLIENT_SESSION_HOSTING ? "host" : "join", MP_HANDSHAKE_MS);
+hs_finish(c, MPCLIENT_SESSION_FAILED);
+}
+/* A host or join reply: records the session and our clientId, and completes the request waiting for it */
+static void session_reply(struct mpclient* c, const char* line, int is_host) {
+char* sid= extract_json_field(line, "session");
+char* cid= extract_json_field(line, "clientId");
+pthread_mutex_lock(&c->lock);
+if(sid) {
+snprintf(c->session, sizeof(c->session), "%s", sid);
+c->is_host= is_host;
+/* A new session starts with no known peers */
+c->peer_count= 0;
+c->peer_overflow= 0;
+}
+if(cid) snprintf(c->clientId, sizeof(c->clientId), "%s", cid);
+if(c->hs_state == (is_host ? MPCLIENT_SESSION_HOSTING : MPCLIENT_SESSION_JOINING)) c->hs_state= sid ? MPCLIENT_SESSION_READY : MPCLIENT_SESSION_FAILED;
+pthread_mutex_unlock(&c->lock);
+if(sid) net_log_info("mpclient: recv cmd=%s session=%s (%s)", is_host ? "host" : "join", sid, is_host ? "HOST" : "CLIENT");
+else net_log_error("mpclient: recv cmd=%s without a session", is_host ? "host" : "join");
+if(cid) net_log_info("mpclient: assigned clientId=%s", cid);
+free(sid);
+free(cid);
 }
 static void process_line(struct mpclient* c, const char* line) {
 if(!c || !line) return;
@@ -177,45 +342,28 @@ if(cid && c->clientId[0] && strcmp(cid, c->clientId) == 0) {
 free(cid);
 return;
 }
+/* The data object goes from the line buffer straight into the inbox */
+size_t data_len= 0;
+const char* data= json_field_span(line, "data", &data_len);
+if(cid && data) {
+pthread_mutex_lock(&c->lock);
+peer_seen(c, cid, data_caps(data, data_len));
+pthread_mutex_unlock(&c->lock);
+}
 if(cid) free(cid);
-char* data= extract_json_field(line, "data");
 if(data) {
-net_log_info("mpclient: recv cmd=game data_len=%zu", strlen(data));
-enqueue_msg(c, data);
-free(data);
+net_log_debug("mpclient: recv cmd=game data_len=%zu", data_len);
+if(!msg_ring_push(c->inbox, data, data_len)) net_log_info("mpclient: inbox full, dropped %zu byte message", data_len);
 }
 } else if(strstr(line, "\"cmd\":\"host\"") != NULL || strstr(line, "\"cmd\": \"host\"") != NULL) {
-char* sid= extract_json_field(line, "session");
-if(sid) {
-snprintf(c->session, sizeof(c->session), "%s", sid);
-c->is_host= 1;
-net_log_info("mpclient: recv cmd=host session=%s (HOST)", sid);
-free(sid);
-}
-char* cid= extract_json_field(line, "clientId");
-if(cid) {
-snprintf(c->clientId, sizeof(c->clientId), "%s", cid);
-net_log_info("mpclient: assigned clientId=%s", cid);
-free(cid);
-}
+session_reply(c, line, 1);
 } else if(strstr(line, "\"cmd\":\"join\"") != NULL || strstr(line, "\"cmd\": \"join\"") != NULL) {
-char* sid= extract_json_field(line, "session");
-if(sid) {
-snprintf(c->session, sizeof(c->session), "%s", sid);
-c->is_host= 0;
-net_log_info("mpclient: recv cmd=join session=%s (CLIENT)", sid);
-free(sid);
-}
-char* cid= extract_json_field(line, "clientId");
-if(cid) {
-snprintf(c->clientId, sizeof(c->clientId), "%s", cid);
-net_log_info("mpclient: assigned clientId=%s", cid);
-free(cid);
-}
+session_reply(c, line, 0);
 } else if(strstr(line, "\"cmd\":\"list\"") != NULL || strstr(line, "\"cmd\": \"list\"") != NULL) {
 /* Log the full raw line first to see exactly what we got */
-net_log_info("mpclient: DEBUG raw list response: %s", line);
+net_log_debug("mpclient: raw list response: %s", line);
 char* data= extract_json_field(line, "data");
+char* sid= NULL;
 if(data) {
 net_log_info("mpclient: recv cmd=list data=%s", data);
 /* Try to extract first session id from list array */
@@ -226,21 +374,16 @@ if(list_start) {
 list_start++;
 /* Find first object in array */
 const char* obj= strchr(list_start, '{');
-if(obj && obj < strchr(list_start, ']')) {
 /* Extract "id" field from first session object */
-char* sid= extract_json_field(obj, "id");
-if(sid && sid[0] && !c->session[0]) {
-snprintf(c->session, sizeof(c->session), "%s", sid);
-net_log_info("mpclient: auto-discovered session: %s", sid);
-}
-if(sid) free(sid);
-}
+if(obj && obj < strchr(list_start, ']')) sid= extract_json_field(obj, "id");
 }
 }
 free(data);
 } else {
 net_log_info("mpclient: recv cmd=list (no data)");
 }
+hs_list_reply(c, sid && sid[0] ? sid : NULL);
+free(sid);
 } else if(strstr(line, "\"cmd\":\"joined\"") != NULL || strstr(line, "\"cmd\": \"joined\"") != NULL) {
 char* data= extract_json_field(line, "data");
 char* cid= extract_json_field(line, "clientId");
@@ -263,12 +406,20 @@ else
 snprintf(msg, sizeof(msg), "A player joined");
 net_log_info("mpclient: %s", msg);
 enqueue_msg(c, msg);
+if(cid && strcmp(cid, c->clientId) != 0) {
+pthread_mutex_lock(&c->lock);
+peer_seen(c, cid, -1);
+pthread_mutex_unlock(&c->lock);
+}
 if(cid) free(cid);
 } else if(strstr(line, "\"cmd\":\"left\"") != NULL || strstr(line, "\"cmd\": \"left\"") != NULL) {
 char* cid= extract_json_field(line, "clientId");
 char msg[128];
 if(cid) {
 snprintf(msg, sizeof(msg), "Player left: %s", cid);
+pthread_mutex_lock(&c->lock);
+peer_left(c, cid);
+pthread_mutex_unlock(&c->lock);
 free(cid);
 } else {
 snprintf(msg, sizeof(msg), "A player left");
@@ -277,36 +428,306 @@ net_log_info("mpclient: %s", msg);
 enqueue_msg(c, msg);
 }
 }
-static void* recv_thread_main(void* arg) {
-struct mpclient* c= (struct mpclient*)arg;
-if(!c) return NULL;
-char buf[LINE_BUF_CAP];
-size_t buf_len= 0;
-while(c->running) {
-char tmp[512];
-ssize_t rc= recv(c->sockfd, tmp, sizeof(tmp), 0);
-if(rc <= 0) {
-/* connection closed or error */
-net_log_info("mpclient: recv thread connection closed (fd=%d)", c->sockfd);
-break;
+static int is_game_line(const char* line) { return strstr(line, "\"cmd\":\"game\"") != NULL || strstr(line, "\"cmd\": \"game\"") != NULL; }
+/* Hands a complete inbound line to process_line, or to the inbound shaper to be processed once it is due */
+static void io_deliver_line(struct mpclient* c, const char* line, size_t len) {
+if(c->shape_in)
+(void)net_shaper_push(c->shape_in, line, len, is_game_line(line), platform_now_ms());
+else
+process_line(c, line);
+}
+static void io_release_in(struct mpclient* c) {
+if(!c->shape_in) return;
+uint64_t now= platform_now_ms();
+const char* line;
+while((line= net_shaper_peek(c->shape_in, now, NULL)) != NULL) {
+process_line(c, line);
+net_shaper_pop(c->shape_in);
+}
+}
+/* Reads everything the socket has, splitting complete lines in place with memchr. Returns -1 once the connection is
+   gone. */
+static int io_read(struct mpclient* c) {
+for(;;) {
+if(c->in_cap - c->in_len < MP_READ_CHUNK) {
+size_t cap= c->in_cap ? c->in_cap * 2 : 2 * MP_READ_CHUNK;
+if(cap > MP_LINE_MAX + MP_READ_CHUNK) {
+/* Overlong line: drop what we have and everything up to its newline */
+net_log_info("mpclient: dropped line over %u bytes", MP_LINE_MAX);
+c->in_len= 0;
+c->in_skip= 1;
+} else {
+char* grown= realloc(c->in_buf, cap);
+if(!grown) return -1;
+c->in_buf= grown;
+c->in_cap= cap;
+}
+}
+ssize_t rc= recv(c->sockfd, c->in_buf + c->in_len, c->in_cap - c->in_len - 1, 0);
+if(rc == 0) return -1;
+if(rc < 0) {
+if(errno == EINTR) continue;
+return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
 }
+TRACE_BEGIN("mpclient_io_read");
 /* log the raw bytes received */
-net_log_recv(c->sockfd, tmp, (size_t)rc, "mpclient recv_thread: raw");
-for(ssize_t i= 0; i < rc; ++i) {
-char ch= tmp[i];
-if(ch == '\n') {
-buf[buf_len]= '\0';
-if(buf_len > 0) process_line(c, buf);
-buf_len= 0;
-} else if(buf_len + 1 < LINE_BUF_CAP) {
-buf[buf_len++]= ch;
+net_log_recv(c->sockfd, c->in_buf + c->in_len, (size_t)rc, "mpclient io: raw");
+char* line= c->in_buf;
+char* scan= c->in_buf + c->in_len;
+char* end= scan + rc;
+char* nl;
+/* Earlier bytes held no newline, so only the new ones are searched */
+while((nl= memchr(scan, '\n', (size_t)(end - scan))) != NULL) {
+*nl= '\0';
+if(c->in_skip)
+c->in_skip= 0;
+else if(nl > line)
+io_deliver_line(c, line, (size_t)(nl - line));
+line= scan= nl + 1;
+}
+c->in_len= (size_t)(end - line);
+if(c->in_skip) c->in_len= 0;
+else if(line != c->in_buf && c->in_len) memmove(c->in_buf, line, c->in_len);
+TRACE_END("mpclient_io_read");
+}
+}
+/* Makes room for `need` more bytes in the outbound queue; caller holds `lock` */
+static int out_reserve(struct mpclient* c, size_t need) {
+if(c->out_off > 0 && c->out_cap - c->out_len < need) {
+/* Reclaim what the socket already took before growing */
+memmove(c->out_buf, c->out_buf + c->out_off, c->out_len - c->out_off);
+c->out_len-= c->out_off;
+c->out_off= 0;
+}
+if(c->out_cap - c->out_len >= need) return 0;
+size_t cap= c->out_cap ? c->out_cap : 4096;
+while(cap - c->out_len < need) cap*= 2;
+char* grown= cap <= MP_OUT_MAX ? realloc(c->out_buf, cap) : NULL;
+if(!grown) return -1;
+c->out_buf= grown;
+c->out_cap= cap;
+return 0;
+}
+/* Moves shaped commands that are due into the outbound queue; caller holds `lock` */
+static void io_release_out(struct mpclient* c, uint64_t now) {
+const char* cmd;
+size_t len= 0;
+while((cmd= net_shaper_peek(c->shape_out, now, &len)) != NULL && out_reserve(c, len) == 0) {
+memcpy(c->out_buf + c->out_len, cmd, len);
+c->out_len+= len;
+net_shaper_pop(c->shape_out);
+}
+}
+/* Moves the pending state into the drained queue if the rate cap allows; caller holds `lock` */
+static void state_promote(struct mpclient* c, uint64_t now) {
+if(!c->state_pending || c->out_len > c->out_off || now < c->state_next_ms) return;
+if(c->shape_out) {
+/* A shaped link pushes back while it is still carrying earlier bytes, as a full socket would */
+if(net_shaper_busy_ms(c->shape_out, now) > 0) return;
+(void)net_shaper_push(c->shape_out, c->state_buf, c->state_len, true, now);
 } else {
-/* overflow, reset */
-buf_len= 0;
+if(out_reserve(c, c->state_len) != 0) return;
+memcpy(c->out_buf + c->out_len, c->state_buf, c->state_len);
+c->out_len+= c->state_len;
+}
+c->state_pending= 0;
+c->states_sent++;
+c->state_next_ms= now + c->state_interval_ms;
+}
+static void apply_nodelay(struct mpclient* c) {
+int on= c->tcp_nodelay;
+if(c->sockfd >= 0 && setsockopt(c->sockfd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on) != 0)
+net_log_info("mpclient: TCP_NODELAY=%d failed (errno=%d)", on, errno);
+}
+static void set_cork(struct mpclient* c, int on) {
+if(c->tcp_cork) (void)setsockopt(c->sockfd, IPPROTO_TCP, TCP_CORK, &on, sizeof on);
+}
+/* Sends what the socket takes without blocking, promoting the pending state whenever the queue drains, and asks epoll
+   for EPOLLOUT while anything is left. Returns -1 on a socket error. */
+static int io_flush(struct mpclient* c) {
+/* Commands queued while connecting wait for the connection */
+if(!c->connected) return 0;
+int rc_out= 0;
+pthread_mutex_lock(&c->lock);
+uint64_t now= platform_now_ms();
+state_promote(c, now);
+io_release_out(c, now);
+if(c->out_len > c->out_off) {
+set_cork(c, 1);
+while(c->out_len > c->out_off) {
+ssize_t rc= send(c->sockfd, c->out_buf + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+if(rc < 0 && errno == EINTR) continue;
+if(rc <= 0) {
+if(rc < 0 && errno != EAGAIN && errno != EWOULDBLOCK) rc_out= -1;
+break;
 }
+net_log_send(c->sockfd, c->out_buf + c->out_off, (size_t)rc, "mpclient io: write");
+c->out_off+= (size_t)rc;
+c->out_writes++;
+if(c->out_off == c->out_len) {
+c->out_off= c->out_len= 0;
+state_promote(c, now);
 }
 }
-c->running= 0;
+set_cork(c, 0);
+}
+int want= c->out_len > c->out_off;
+if(rc_out == 0 && want != c->want_out) {
+struct epoll_event ev= {0};
+ev.events= EPOLLIN | (want ? EPOLLOUT : 0u);
+ev.data.fd= c->sockfd;
+if(epoll_ctl(c->epfd, EPOLL_CTL_MOD, c->sockfd, &ev) == 0) c->want_out= want;
+}
+pthread_mutex_unlock(&c->lock);
+return rc_out;
+}
+/* How long epoll may sleep: until the rate cap lets a waiting state out, or indefinitely */
+static int io_timeout(struct mpclient* c) {
+int ms= -1;
+pthread_mutex_lock(&c->lock);
+uint64_t now= platform_now_ms();
+if(c->state_pending && c->out_len == c->out_off) {
+ms= c->state_next_ms > now ? (int)(c->state_next_ms - now) : 0;
+int busy= net_shaper_busy_ms(c->shape_out, now);
+if(busy > ms) ms= busy;
+}
+/* ...or until a shaped message falls due */
+int due= net_shaper_timeout_ms(c->shape_out, now);
+if(due >= 0 && (ms < 0 || due < ms)) ms= due;
+/* ...or until a session request gives up on its reply */
+if(hs_pending(c->hs_state) && c->hs_state != MPCLIENT_SESSION_CONNECTING) {
+due= c->hs_deadline_ms > now ? (int)(c->hs_deadline_ms - now) : 0;
+if(ms < 0 || due < ms) ms= due;
+}
+pthread_mutex_unlock(&c->lock);
+due= net_shaper_timeout_ms(c->shape_in, now);
+if(due >= 0 && (ms < 0 || due < ms)) ms= due;
+/* ...or until the connect attempt gives up */
+if(!c->connected) {
+due= c->conn_deadline_ms > now ? (int)(c->conn_deadline_ms - now) : 0;
+if(ms < 0 || due < ms) ms= due;
+}
+return ms;
+}
+/* Starts a non-blocking connect to the next resolved address and waits for it with EPOLLOUT. Returns -1 once no
+   address is left. I/O thread only. */
+static int io_connect_next(struct mpclient* c) {
+while(c->conn_next) {
+struct addrinfo* rp= c->conn_next;
+c->conn_next= rp->ai_next;
+int fd= socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+if(fd == -1) continue;
+int opt= 1;
+setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+int flags= fcntl(fd, F_GETFL, 0);
+struct epoll_event ev= {0};
+ev.events= EPOLLOUT;
+ev.data.fd= fd;
+if(flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0 || (connect(fd, rp->ai_addr, rp->ai_addrlen) != 0 && errno != EINPROGRESS) ||
+   epoll_ctl(c->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+close(fd);
+continue;
+}
+pthread_mutex_lock(&c->lock);
+c->sockfd= fd;
+pthread_mutex_unlock(&c->lock);
+c->conn_deadline_ms= platform_now_ms() + MP_CONNECT_MS;
+return 0;
+}
+return -1;
+}
+static void io_close_attempt(struct mpclient* c) {
+(void)epoll_ctl(c->epfd, EPOLL_CTL_DEL, c->sockfd, NULL);
+close(c->sockfd);
+pthread_mutex_lock(&c->lock);
+c->sockfd= -1;
+pthread_mutex_unlock(&c->lock);
+}
+/* First state of every connection: resolves the server and starts connecting. I/O thread only. */
+static int io_connect_start(struct mpclient* c) {
+char port_str[16];
+snprintf(port_str, sizeof(port_str), "%u", (unsigned int)c->server_port);
+struct addrinfo hints;
+memset(&hints, 0, sizeof(hints));
+hints.ai_family= AF_UNSPEC;
+hints.ai_socktype= SOCK_STREAM;
+int err= getaddrinfo(c->server_host, port_str, &hints, &c->conn_addrs);
+if(err != 0) {
+net_log_error("mpclient: cannot resolve %s: %s", c->server_host, gai_strerror(err));
+c->conn_addrs= NULL;
+return -1;
+}
+c->conn_next= c->conn_addrs;
+return io_connect_next(c);
+}
+/* The attempt in progress finished: on success the queued commands can go out and a request waiting for the connection
+   moves on to its first step, on failure the next address is tried. Returns -1 once none is left. I/O thread only. */
+static int io_connect_done(struct mpclient* c) {
+int err= 0;
+socklen_t len= sizeof err;
+if(getsockopt(c->sockfd, SOL_SOCKET, SO_ERROR, &err, &len) != 0) err= errno;
+if(err != 0) {
+net_log_info("mpclient: connect attempt failed (errno=%d)", err);
+io_close_attempt(c);
+return io_connect_next(c);
+}
+freeaddrinfo(c->conn_addrs);
+c->conn_addrs= c->conn_next= NULL;
+struct epoll_event ev= {0};
+ev.events= EPOLLIN | EPOLLOUT;
+ev.data.fd= c->sockfd;
+(void)epoll_ctl(c->epfd, EPOLL_CTL_MOD, c->sockfd, &ev);
+net_log_info("mpclient: connect success fd=%d", c->sockfd);
+pthread_mutex_lock(&c->lock);
+c->connected= 1;
+c->want_out= 1;
+apply_nodelay(c);
+if(c->hs_state == MPCLIENT_SESSION_CONNECTING) {
+c->hs_state= c->hs_next;
+c->hs_deadline_ms= platform_now_ms() + MP_HANDSHAKE_MS;
+}
+pthread_mutex_unlock(&c->lock);
+return 0;
+}
+static void* io_thread_main(void* arg) {
+struct mpclient* c= (struct mpclient*)arg;
+if(!c) return NULL;
+TRACE_THREAD_NAME("mpclient_io");
+int closed= io_connect_start(c) != 0;
+while(!closed && __atomic_load_n(&c->running, __ATOMIC_ACQUIRE)) {
+struct epoll_event evs[4];
+int n= epoll_wait(c->epfd, evs, 4, io_timeout(c));
+if(n < 0 && errno == EINTR) continue;
+if(n < 0) break;
+for(int i= 0; i < n && !closed; i++) {
+if(evs[i].data.fd == c->wakefd) {
+uint64_t v;
+(void)!read(c->wakefd, &v, sizeof v);
+} else if(!c->connected) {
+if(io_connect_done(c) != 0) closed= 1;
+} else if(evs[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+if(io_read(c) != 0) closed= 1;
+}
+}
+if(!closed && !c->connected && platform_now_ms() >= c->conn_deadline_ms) {
+net_log_info("mpclient: connect attempt timed out after %d ms", MP_CONNECT_MS);
+io_close_attempt(c);
+if(io_connect_next(c) != 0) closed= 1;
+}
+if(closed) break;
+io_release_in(c);
+hs_check_deadline(c);
+if(io_flush(c) != 0) closed= 1;
+}
+if(!c->connected)
+net_log_error("mpclient: connect failed to %s:%u", c->server_host, (unsigned int)c->server_port);
+else if(closed)
+net_log_info("mpclient: io thread connection closed (fd=%d)", c->sockfd);
+freeaddrinfo(c->conn_addrs);
+c->conn_addrs= c->conn_next= NULL;
+__atomic_store_n(&c->running, 0, __ATOMIC_RELEASE);
+/* No reply can come now */
+hs_finish(c, MPCLIENT_SESSION_FAILED);
 return NULL;
 }
 mpclient* mpclient_create(const char* host, uint16_t port, const char* identifier) {
@@ -317,126 +738,273 @@ snprintf(c->server_host, sizeof(c->server_host), "%s", host);
 c->server_port= port;
 snprintf(c->identifier, sizeof(c->identifier), "%s", identifier);
 c->sockfd= -1;
+c->epfd= -1;
+c->wakefd= -1;
+c->tcp_nodelay= 1;
+c->inbox= msg_ring_create(MSG_RING_BYTES);
+if(!c->inbox) {
+free(c);
+return NULL;
+}
 pthread_mutex_init(&c->lock, NULL);
-c->head= c->tail= 0;
 c->running= 0;
 c->session[0]= '\0';
 return c;
 }
 int mpclient_connect_and_start(mpclient* c) {
 if(!c) return -1;
-if(c->sockfd >= 0) return 0;
+if(c->thread_started) return 0;
 net_log_info("mpclient: connecting to %s:%u..", c->server_host, (unsigned int)c->server_port);
-int fd= connect_to_server(c->server_host, c->server_port);
-if(fd < 0) {
-net_log_error("mpclient: connect failed to %s:%u", c->server_host, (unsigned int)c->server_port);
-return -1;
-}
-c->sockfd= fd;
-net_log_info("mpclient: connect success fd=%d", fd);
+c->epfd= epoll_create1(EPOLL_CLOEXEC);
+c->wakefd= eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+struct epoll_event wake= {0};
+wake.events= EPOLLIN;
+wake.data.fd= c->wakefd;
+if(c->epfd < 0 || c->wakefd < 0 || epoll_ctl(c->epfd, EPOLL_CTL_ADD, c->wakefd, &wake) != 0) {
+console_warn("mpclient: failed to set up the event loop");
+goto fail;
+}
+c->connected= 0;
+c->want_out= 0;
+net_shaper_destroy(c->shape_out);
+net_shaper_destroy(c->shape_in);
+c->shape_out= c->shape_in= NULL;
+if(net_shaper_config_active(&c->shape_cfg)) {
+uint32_t seed= (uint32_t)platform_now_ms();
+c->shape_out= net_shaper_create(&c->shape_cfg, seed);
+c->shape_in= net_shaper_create(&c->shape_cfg, seed * 2654435761u);
+net_log_info("mpclient: conditioning on: delay=%dms jitter=%dms kbps=%d drop=%d%% reorder=%d%%", c->shape_cfg.delay_ms, c->shape_cfg.jitter_ms,
+             c->shape_cfg.kbps, c->shape_cfg.drop_pct, c->shape_cfg.reorder_pct);
+}
+/* Resolving and connecting happen on the I/O thread, so this never waits for the network */
 c->running= 1;
-if(pthread_create(&c->recv_thread, NULL, recv_thread_main, c) != 0) {
+if(pthread_create(&c->io_thread, NULL, io_thread_main, c) != 0) {
 c->running= 0;
-console_warn("mpclient: failed to start recv thread");
-close(c->sockfd);
-c->sockfd= -1;
-return -1;
+console_warn("mpclient: failed to start io thread");
+goto fail;
 }
 c->thread_started= 1;
 return 0;
+fail:
+if(c->epfd >= 0) close(c->epfd);
+if(c->wakefd >= 0) close(c->wakefd);
+c->epfd= c->wakefd= -1;
+return -1;
 }
+/* Formats one command line into buf like snprintf */
+static int format_command(const struct mpclient* c, char* buf, size_t size, const char* cmd, const char* session, const char* data_json) {
+int has_session= session && session[0];
+return snprintf(buf, size, MP_CMD_FMT, c->identifier, has_session ? ",\"session\":\"" : "", has_session ? session : "", has_session ? "\"" : "", cmd,
+                data_json ? data_json : "{}");
+}
+static void io_wake(struct mpclient* c) {
+uint64_t one= 1;
+(void)!write(c->wakefd, &one, sizeof one);
+}
+/* Appends one command line to the outbound queue and wakes the I/O thread if the queue was idle; never blocks on the
+   socket */
 static int send_command(struct mpclient* c, const char* cmd, const char* session, const char* data_json) {
 if(!c || !cmd) return -1;
-char msg[2048];
-if(session && session[0]) {
-if(data_json)
-snprintf(msg, sizeof(msg), "{\"identifier\":\"%s\",\"session\":\"%s\",\"cmd\":\"%s\",\"data\":%s}\n", c->identifier, session, cmd, data_json);
-else
-snprintf(msg, sizeof(msg), "{\"identifier\":\"%s\",\"session\":\"%s\",\"cmd\":\"%s\",\"data\":{}}\n", c->identifier, session, cmd);
+if(!__atomic_load_n(&c->running, __ATOMIC_ACQUIRE)) return -1;
+int n= format_command(c, NULL, 0, cmd, session, data_json);
+if(n < 0) return -1;
+pthread_mutex_lock(&c->lock);
+size_t need= (size_t)n + 1;
+if(out_reserve(c, need) != 0) {
+pthread_mutex_unlock(&c->lock);
+net_log_error("mpclient: outbound queue full, dropped cmd=%s", cmd);
+return -1;
+}
+int was_idle= (c->out_len == c->out_off);
+(void)format_command(c, c->out_buf + c->out_len, need, cmd, session, data_json);
+if(c->shape_out) {
+/* Formatted in the spare queue space, then copied into the shaper; the I/O thread queues it once it is due */
+(void)net_shaper_push(c->shape_out, c->out_buf + c->out_len, (size_t)n, strcmp(cmd, "game") == 0, platform_now_ms());
+was_idle= 1;
 } else {
-if(data_json)
-snprintf(msg, sizeof(msg), "{\"identifier\":\"%s\",\"cmd\":\"%s\",\"data\":%s}\n", c->identifier, cmd, data_json);
-else
-snprintf(msg, sizeof(msg), "{\"identifier\":\"%s\",\"cmd\":\"%s\",\"data\":{}}\n", c->identifier, cmd);
+c->out_len+= (size_t)n;
 }
+c->out_cmds++;
+pthread_mutex_unlock(&c->lock);
 /* Log the outgoing command at a higher level (written to log only) */
-net_log_info("mpclient: sending cmd=%s session=%s len=%zu", cmd, session ? session : "(none)", strlen(msg));
-net_log_send(c->sockfd, msg, strlen(msg), "mpclient send_command: full msg");
-return send_all(c->sockfd, msg, strlen(msg));
+net_log_debug("mpclient: sending cmd=%s session=%s len=%d", cmd, session ? session : "(none)", n);
+if(was_idle) io_wake(c);
+return 0;
 }
-int mpclient_auto_join_or_host(mpclient* c, const char* name) {
-if(!c || !name) return -1;
-/* ensure connected */
-if(mpclient_connect_and_start(c) != 0) return -1;
-/* Send list */
-if(send_command(c, "list", NULL, "{\"type\":\"sessions\"}") != 0) return -1;
-/* Wait briefly for response */
-int waited= 0;
-while(waited < 2000) {
+/* Opens a session request in state `st`; fails while another one is still waiting for the server */
+static int hs_begin(struct mpclient* c, MpClientSessionState st, const char* name) {
 pthread_mutex_lock(&c->lock);
+if(hs_pending(c->hs_state)) {
 pthread_mutex_unlock(&c->lock);
-if(c->session[0]) break;
-platform_sleep_ms(100);
-waited+= 100;
+return -1;
 }
-if(c->session[0]) {
-/* If session already set (unlikely), join it */
-char payload[256];
-snprintf(payload, sizeof(payload), "{\"name\":\"%s\"}", name);
-if(send_command(c, "join", c->session, payload) != 0) return -1;
+/* A request made before the connection is up waits for it first */
+c->hs_state= c->connected ? st : MPCLIENT_SESSION_CONNECTING;
+c->hs_next= st;
+snprintf(c->hs_name, sizeof(c->hs_name), "%s", name ? name : "");
+c->hs_deadline_ms= platform_now_ms() + MP_HANDSHAKE_MS;
+c->hs_reported= 0;
+pthread_mutex_unlock(&c->lock);
 return 0;
 }
-/* No session yet; host a new session */
-char payload[256];
-snprintf(payload, sizeof(payload), "{\"name\":\"%s\",\"private\":false}", name);
-if(send_command(c, "host", NULL, payload) != 0) return -1;
-/* wait for host response and session id to be populated */
-waited= 0;
-while(waited < 2000) {
-if(c->session[0]) return 0;
-platform_sleep_ms(100);
-waited+= 100;
+int mpclient_auto_join_or_host(mpclient* c, const char* name) {
+if(!c || !name) return -1;
+/* ensure connected */
+if(mpclient_connect_and_start(c) != 0) return -1;
+if(hs_begin(c, MPCLIENT_SESSION_LISTING, name) != 0) return -1;
+/* The reply (or its deadline) decides between join and host on the I/O thread */
+if(send_command(c, "list", NULL, "{\"type\":\"sessions\"}") != 0) {
+hs_finish(c, MPCLIENT_SESSION_FAILED);
+return -1;
 }
 return 0;
 }
 int mpclient_join(mpclient* c, const char* sessionId, const char* name) {
 if(!c || !sessionId) return -1;
 if(mpclient_connect_and_start(c) != 0) return -1;
+if(hs_begin(c, MPCLIENT_SESSION_JOINING, name) != 0) return -1;
 char payload[256];
 snprintf(payload, sizeof(payload), "{\"name\":\"%s\"}", name ? name : "");
-if(send_command(c, "join", sessionId, payload) != 0) return -1;
-int waited= 0;
-while(waited < 2000) {
-if(c->session[0]) return 0;
-platform_sleep_ms(100);
-waited+= 100;
+if(send_command(c, "join", sessionId, payload) != 0) {
+hs_finish(c, MPCLIENT_SESSION_FAILED);
+return -1;
 }
 return 0;
 }
+void mpclient_set_session_callback(mpclient* c, mpclient_session_cb cb, void* user) {
+if(!c) return;
+pthread_mutex_lock(&c->lock);
+c->hs_cb= cb;
+c->hs_user= user;
+pthread_mutex_unlock(&c->lock);
+}
+MpClientSessionState mpclient_session_state(mpclient* c) {
+if(!c) return MPCLIENT_SESSION_IDLE;
+pthread_mutex_lock(&c->lock);
+MpClientSessionState st= c->hs_state;
+pthread_mutex_unlock(&c->lock);
+return st;
+}
+MpClientSessionState mpclient_poll_session(mpclient* c) {
+if(!c) return MPCLIENT_SESSION_IDLE;
+char session[16];
+pthread_mutex_lock(&c->lock);
+MpClientSessionState st= c->hs_state;
+int done= (st == MPCLIENT_SESSION_READY || st == MPCLIENT_SESSION_FAILED) && !c->hs_reported;
+mpclient_session_cb cb= c->hs_cb;
+void* user= c->hs_user;
+int is_host= c->is_host;
+memcpy(session, c->session, sizeof(session));
+if(done) c->hs_reported= 1;
+pthread_mutex_unlock(&c->lock);
+/* Outside the lock, so the callback may call back into the client */
+if(done && cb) cb(c, st == MPCLIENT_SESSION_READY, session, is_host, user);
+return st;
+}
+/* Copies the session id, which the I/O thread may be writing */
+static void session_copy(struct mpclient* c, char* out) {
+pthread_mutex_lock(&c->lock);
+memcpy(out, c->session, sizeof(c->session));
+pthread_mutex_unlock(&c->lock);
+}
 int mpclient_send_game(mpclient* c, const char* data_json) {
 if(!c || !data_json) return -1;
-if(send_command(c, "game", c->session[0] ? c->session : NULL, data_json) != 0) return -1;
+char session[16];
+session_copy(c, session);
+if(send_command(c, "game", session[0] ? session : NULL, data_json) != 0) return -1;
+return 0;
+}
+int mpclient_send_state(mpclient* c, const char* data_json) {
+if(!c || !data_json) return -1;
+if(!__atomic_load_n(&c->running, __ATOMIC_ACQUIRE)) return -1;
+char sid[16];
+session_copy(c, sid);
+const char* session= sid[0] ? sid : NULL;
+int n= format_command(c, NULL, 0, "game", session, data_json);
+if(n < 0) return -1;
+size_t need= (size_t)n + 1;
+pthread_mutex_lock(&c->lock);
+if(c->state_cap < need) {
+char* grown= need <= MP_LINE_MAX ? realloc(c->state_buf, need) : NULL;
+if(!grown) {
+pthread_mutex_unlock(&c->lock);
+return -1;
+}
+c->state_buf= grown;
+c->state_cap= need;
+}
+int was_pending= c->state_pending;
+(void)format_command(c, c->state_buf, need, "game", session, data_json);
+c->state_len= (size_t)n;
+c->state_pending= 1;
+if(was_pending) c->states_replaced++;
+pthread_mutex_unlock(&c->lock);
+if(!was_pending) io_wake(c);
 return 0;
 }
+void mpclient_set_send_rate(mpclient* c, int max_per_sec) {
+if(!c) return;
+pthread_mutex_lock(&c->lock);
+c->state_interval_ms= max_per_sec > 0 ? 1000u / (unsigned)max_per_sec : 0u;
+pthread_mutex_unlock(&c->lock);
+}
+void mpclient_set_tcp_options(mpclient* c, int nodelay, int cork) {
+if(!c) return;
+pthread_mutex_lock(&c->lock);
+c->tcp_nodelay= nodelay ? 1 : 0;
+c->tcp_cork= cork ? 1 : 0;
+apply_nodelay(c);
+pthread_mutex_unlock(&c->lock);
+}
+void mpclient_set_conditions(mpclient* c, const NetShaperConfig* cfg) {
+if(!c) return;
+pthread_mutex_lock(&c->lock);
+if(cfg)
+c->shape_cfg= *cfg;
+else
+memset(&c->shape_cfg, 0, sizeof c->shape_cfg);
+pthread_mutex_unlock(&c->lock);
+}
 void mpclient_stop(mpclient* c) {
 if(!c) return;
-c->running= 0;
+__atomic_store_n(&c->running, 0, __ATOMIC_RELEASE);
+if(c->thread_started) {
+io_wake(c);
+pthread_join(c->io_thread, NULL);
+c->thread_started= 0;
+}
 if(c->sockfd >= 0) {
 shutdown(c->sockfd, SHUT_RDWR);
 close(c->sockfd);
 c->sockfd= -1;
 }
-if(c->thread_started) {
-pthread_join(c->recv_thread, NULL);
-c->thread_started= 0;
-}
+if(c->epfd >= 0) close(c->epfd);
+if(c->wakefd >= 0) close(c->wakefd);
+c->epfd= c->wakefd= -1;
 }
 void mpclient_destroy(mpclient* c) {
 if(!c) return;
 mpclient_stop(c);
 pthread_mutex_destroy(&c->lock);
-/* free queued messages */
-for(int i= 0; i < MSG_QUEUE_SIZE; ++i)
-if(c->msgs[i]) free(c->msgs[i]);
+MsgRingStats st;
+msg_ring_get_stats(c->inbox, &st);
+net_log_info("mpclient: inbox pushed=%llu popped=%llu dropped=%llu high_water=%zu bytes / %zu msgs of %zu", (unsigned long long)st.pushed,
+             (unsigned long long)st.popped, (unsigned long long)st.dropped, st.high_water_bytes, st.high_water_msgs, st.capacity);
+net_log_info("mpclient: %llu commands sent in %llu writes; %llu states sent, %llu replaced before sending", (unsigned long long)c->out_cmds,
+             (unsigned long long)c->out_writes, (unsigned long long)c->states_sent, (unsigned long long)c->states_replaced);
+msg_ring_destroy(c->inbox);
+if(c->shape_out) {
+NetShaperStats out, in;
+net_shaper_get_stats(c->shape_out, &out);
+net_shaper_get_stats(c->shape_in, &in);
+net_log_info("mpclient: conditioned sends queued=%llu dropped=%llu reordered=%llu; receives queued=%llu dropped=%llu reordered=%llu",
+             (unsigned long long)out.queued, (unsigned long long)out.dropped, (unsigned long long)out.reordered, (unsigned long long)in.queued,
+             (unsigned long long)in.dropped, (unsigned long long)in.reordered);
+}
+net_shaper_destroy(c->shape_out);
+net_shaper_destroy(c->shape_in);
+free(c->in_buf);
+free(c->out_buf);
+free(c->state_buf);
 free(c);
 }
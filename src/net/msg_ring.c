@@ -0,0 +1,109 @@
+#include "msg_ring.h"
+#include <stdlib.h>
+#include <string.h>
+#define RING_ALIGN 8
+#define RING_HEADER 8
+/* Length value of a record that only says "continue at the front" */
+#define RING_WRAP UINT32_MAX
+struct MsgRing {
+unsigned char* buf;
+size_t cap;
+/* Free-running byte positions: `tail` is written by the producer only, `head` by the consumer only */
+uint64_t head;
+uint64_t tail;
+uint64_t pushed;
+uint64_t popped;
+uint64_t dropped;
+size_t high_water_bytes;
+size_t high_water_msgs;
+};
+static size_t ring_round(size_t n) { return (n + RING_ALIGN - 1) & ~(size_t)(RING_ALIGN - 1); }
+MsgRing* msg_ring_create(size_t capacity) {
+if(capacity < 2 * RING_HEADER) return NULL;
+MsgRing* r= calloc(1, sizeof *r);
+if(!r) return NULL;
+r->cap= ring_round(capacity);
+r->buf= malloc(r->cap);
+if(!r->buf) {
+free(r);
+return NULL;
+}
+return r;
+}
+void msg_ring_destroy(MsgRing* r) {
+if(!r) return;
+free(r->buf);
+free(r);
+}
+static void ring_put_len(unsigned char* p, uint32_t len) { memcpy(p, &len, sizeof len); }
+static uint32_t ring_get_len(const unsigned char* p) {
+uint32_t len;
+memcpy(&len, p, sizeof len);
+return len;
+}
+bool msg_ring_push(MsgRing* r, const char* data, size_t len) {
+if(!r || !data) return false;
+size_t rec= RING_HEADER + ring_round(len + 1);
+uint64_t tail= r->tail;
+uint64_t head= __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+size_t at= (size_t)(tail % r->cap);
+/* Records never straddle the end: the rest of the arena is skipped when this one does not fit before it */
+size_t skip= (r->cap - at < rec) ? r->cap - at : 0;
+size_t used= (size_t)(tail - head);
+/* A record over half the arena could need more padding than an empty ring has room for, so whether it fit would
+   depend on where the last one ended; refuse it every time instead */
+if(len == 0 || len >= RING_WRAP || rec > r->cap / 2 || used + skip + rec > r->cap) {
+__atomic_store_n(&r->dropped, r->dropped + 1, __ATOMIC_RELAXED);
+return false;
+}
+if(skip) {
+ring_put_len(r->buf + at, RING_WRAP);
+at= 0;
+}
+ring_put_len(r->buf + at, (uint32_t)len);
+memcpy(r->buf + at + RING_HEADER, data, len);
+r->buf[at + RING_HEADER + len]= '\0';
+used+= skip + rec;
+uint64_t pushed= r->pushed + 1;
+size_t depth= (size_t)(pushed - __atomic_load_n(&r->popped, __ATOMIC_RELAXED));
+if(used > r->high_water_bytes) __atomic_store_n(&r->high_water_bytes, used, __ATOMIC_RELAXED);
+if(depth > r->high_water_msgs) __atomic_store_n(&r->high_water_msgs, depth, __ATOMIC_RELAXED);
+__atomic_store_n(&r->pushed, pushed, __ATOMIC_RELAXED);
+/* Publishes the record: the consumer's acquire load of tail sees the bytes written above */
+__atomic_store_n(&r->tail, tail + skip + rec, __ATOMIC_RELEASE);
+return true;
+}
+const char* msg_ring_peek(MsgRing* r, size_t* len_out) {
+if(!r) return NULL;
+uint64_t tail= __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+if(r->head == tail) return NULL;
+size_t at= (size_t)(r->head % r->cap);
+uint32_t len= ring_get_len(r->buf + at);
+if(len == RING_WRAP) {
+/* Step over the marker, handing the skipped bytes back; the producer published it together with the record at the
+   front */
+__atomic_store_n(&r->head, r->head + (r->cap - at), __ATOMIC_RELEASE);
+at= 0;
+len= ring_get_len(r->buf);
+}
+if(len_out) *len_out= len;
+return (const char*)r->buf + at + RING_HEADER;
+}
+void msg_ring_pop(MsgRing* r) {
+if(!r) return;
+size_t len= 0;
+if(!msg_ring_peek(r, &len)) return;
+__atomic_store_n(&r->popped, r->popped + 1, __ATOMIC_RELAXED);
+__atomic_store_n(&r->head, r->head + RING_HEADER + ring_round(len + 1), __ATOMIC_RELEASE);
+}
+void msg_ring_get_stats(const MsgRing* r, MsgRingStats* out) {
+if(!out) return;
+memset(out, 0, sizeof *out);
+if(!r) return;
+out->pushed= __atomic_load_n(&r->pushed, __ATOMIC_RELAXED);
+out->popped= __atomic_load_n(&r->popped, __ATOMIC_RELAXED);
+out->dropped= __atomic_load_n(&r->dropped, __ATOMIC_RELAXED);
+out->high_water_bytes= __atomic_load_n(&r->high_water_bytes, __ATOMIC_RELAXED);
+out->high_water_msgs= __atomic_load_n(&r->high_water_msgs, __ATOMIC_RELAXED);
+out->capacity= r->cap;
+}
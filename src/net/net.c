@@ -1,10 +1,17 @@
 #include "net.h"
 #include "game_internal.h"
+#include "net_frame.h"
+#include "net_remote.h"
 #include <arpa/inet.h>
+#include <errno.h>
 #include <limits.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 size_t net_pack_input(const InputState* input, unsigned char* buf, size_t buf_size) {
 if(!input || !buf || buf_size < 1) return 0;
@@ -76,55 +83,52 @@ p+= 4;
 }
 return needed;
 }
-bool net_unpack_game_state(const unsigned char* buf, size_t buf_size, GameState* out) {
+/* Makes room for `count` entries of `size` bytes in *arr, which has room for *cap; grows only past the previous maximum */
+static bool unpack_reserve(void** arr, int* cap, int count, size_t size) {
+if(count <= *cap) return true;
+if((size_t)count > SIZE_MAX / size) return false;
+void* grown= realloc(*arr, (size_t)count * size);
+if(!grown) return false;
+*arr= grown;
+*cap= count;
+return true;
+}
+bool net_unpack_game_state_into(const unsigned char* buf, size_t buf_size, GameState* out) {
 if(!buf || !out || buf_size < 24) return false;
-out->food= NULL;
-out->players= NULL;
-out->max_food= 0;
-out->max_players= 0;
-bool ok= false;
 const unsigned char* p= buf;
 uint32_t v;
+int width, height, num_players, food_count;
 memcpy(&v, p, 4);
-out->width= (int)ntohl(v);
+width= (int)ntohl(v);
 p+= 4;
 memcpy(&v, p, 4);
-out->height= (int)ntohl(v);
+height= (int)ntohl(v);
 p+= 4;
-/* Reject non-positive dimensions early */
-if(out->width <= 0 || out->height <= 0) goto out;
+memcpy(&v, p + 8, 4);
+num_players= (int)ntohl(v);
+memcpy(&v, p + 12, 4);
+food_count= (int)ntohl(v);
+/* Reject non-positive dimensions and negative or truncated counts before touching `out` */
+if(width <= 0 || height <= 0 || num_players < 0 || food_count < 0) goto fail;
+if(buf_size < 24 + (size_t)food_count * 8 + (size_t)num_players * 8) goto fail;
+void* food= out->food;
+void* players= out->players;
+bool grown= unpack_reserve(&food, &out->max_food, food_count, sizeof *out->food);
+out->food= food;
+grown= grown && unpack_reserve(&players, &out->max_players, num_players, sizeof *out->players);
+out->players= players;
+if(!grown) goto fail;
+out->width= width;
+out->height= height;
 memcpy(&v, p, 4);
 out->rng_state= ntohl(v);
 p+= 4;
 memcpy(&v, p, 4);
 out->status= (GameStatus)ntohl(v);
-p+= 4;
-memcpy(&v, p, 4);
-out->num_players= (int)ntohl(v);
-p+= 4;
-memcpy(&v, p, 4);
-out->food_count= (int)ntohl(v);
-p+= 4;
-size_t expected= 24 + (size_t)out->food_count * 8 + (size_t)out->num_players * 8;
-if(buf_size < expected) goto out;
-if(out->food_count > 0) {
-if((size_t)out->food_count > SIZE_MAX / sizeof(SnakePoint)) goto out;
-out->food= malloc((size_t)out->food_count * sizeof *out->food);
-if(!out->food) goto out;
-out->max_food= out->food_count;
-}
-if(out->num_players > 0) {
-if((size_t)out->num_players > SIZE_MAX / sizeof(PlayerState)) goto out;
-out->players= malloc((size_t)out->num_players * sizeof *out->players);
-if(!out->players) goto out;
-out->max_players= out->num_players;
-for(int i= 0; i < out->num_players; i++) {
-memset(&out->players[i], 0, sizeof(out->players[i]));
-out->players[i].active= false;
-out->players[i].needs_reset= false;
-}
-}
-for(int i= 0; i < out->food_count; i++) {
+p+= 12;
+out->num_players= num_players;
+out->food_count= food_count;
+for(int i= 0; i < food_count; i++) {
 memcpy(&v, p, 4);
 out->food[i].x= (int)ntohl(v);
 p+= 4;
@@ -132,7 +136,8 @@ memcpy(&v, p, 4);
 out->food[i].y= (int)ntohl(v);
 p+= 4;
 }
-for(int i= 0; i < out->num_players; i++) {
+for(int i= 0; i < num_players; i++) {
+memset(&out->players[i], 0, sizeof(out->players[i]));
 memcpy(&v, p, 4);
 out->players[i].score= (int)ntohl(v);
 p+= 4;
@@ -140,37 +145,297 @@ memcpy(&v, p, 4);
 out->players[i].length= (int)ntohl(v);
 p+= 4;
 }
-ok= true;
-out:
-if(!ok) {
-free(out->food);
-out->food= NULL;
+return true;
+fail:
+/* The arrays and their capacity stay for the next state */
 out->food_count= 0;
-out->max_food= 0;
-free(out->players);
-out->players= NULL;
 out->num_players= 0;
-out->max_players= 0;
+return false;
 }
-return ok;
+bool net_unpack_game_state(const unsigned char* buf, size_t buf_size, GameState* out) {
+if(!out) return false;
+out->food= NULL;
+out->players= NULL;
+out->max_food= 0;
+out->max_players= 0;
+if(net_unpack_game_state_into(buf, buf_size, out)) return true;
+net_free_unpacked_game_state(out);
+return false;
 }
 void net_free_unpacked_game_state(GameState* out) {
 if(!out) return;
-if(out->food) {
 free(out->food);
 out->food= NULL;
 out->food_count= 0;
 out->max_food= 0;
-}
-if(out->players) {
 free(out->players);
 out->players= NULL;
 out->num_players= 0;
 out->max_players= 0;
 }
+struct NetStatePool {
+GameState* slots;
+/* Indices of the free slots, most recently released last so its arrays are still warm */
+int* free_slots;
+int free_count;
+int capacity;
+};
+NetStatePool* net_state_pool_create(int capacity) {
+if(capacity <= 0) return NULL;
+NetStatePool* pool= calloc(1, sizeof *pool);
+if(!pool) return NULL;
+pool->slots= calloc((size_t)capacity, sizeof *pool->slots);
+pool->free_slots= malloc((size_t)capacity * sizeof *pool->free_slots);
+if(!pool->slots || !pool->free_slots) {
+free(pool->slots);
+free(pool->free_slots);
+free(pool);
+return NULL;
+}
+pool->capacity= capacity;
+for(int i= 0; i < capacity; i++) pool->free_slots[i]= capacity - 1 - i;
+pool->free_count= capacity;
+return pool;
+}
+void net_state_pool_destroy(NetStatePool* pool) {
+if(!pool) return;
+for(int i= 0; i < pool->capacity; i++) net_free_unpacked_game_state(&pool->slots[i]);
+free(pool->slots);
+free(pool->free_slots);
+free(pool);
+}
+GameState* net_state_pool_acquire(NetStatePool* pool) {
+if(!pool || pool->free_count == 0) return NULL;
+GameState* gs= &pool->slots[pool->free_slots[--pool->free_count]];
+gs->food_count= 0;
+gs->num_players= 0;
+return gs;
+}
+void net_state_pool_release(NetStatePool* pool, GameState* gs) {
+if(!pool || !gs || gs < pool->slots || gs >= pool->slots + pool->capacity || pool->free_count == pool->capacity) return;
+pool->free_slots[pool->free_count++]= (int)(gs - pool->slots);
 }
+GameState* net_state_pool_unpack(NetStatePool* pool, const unsigned char* buf, size_t buf_size) {
+GameState* gs= net_state_pool_acquire(pool);
+if(gs && !net_unpack_game_state_into(buf, buf_size, gs)) {
+net_state_pool_release(pool, gs);
+return NULL;
+}
+return gs;
+}
+#define NET_STATE_MAGIC 0x53
+/* How much of a player a receiver gets in its packed state */
+typedef enum { NET_SEND_NONE, NET_SEND_SUMMARY, NET_SEND_FULL } NetSendLevel;
+static NetSendLevel interest_level(const GameState* game, int tick, int viewer, const NetInterest* in, int i) {
+if(!in || in->radius <= 0 || viewer < 0 || viewer >= game->num_players || i == viewer) return NET_SEND_FULL;
+const PlayerState* me= &game->players[viewer];
+if(!me->active || me->length <= 0) return NET_SEND_FULL;
+const PlayerState* pl= &game->players[i];
+int len= pl->length < 0 ? 0 : (pl->length > SNAKE_BODY_MAX_LEN ? SNAKE_BODY_MAX_LEN : pl->length);
+SnakePoint h= me->body[0];
+int fx= me->current_dir == SNAKE_DIR_RIGHT ? 1 : (me->current_dir == SNAKE_DIR_LEFT ? -1 : 0);
+int fy= me->current_dir == SNAKE_DIR_DOWN ? 1 : (me->current_dir == SNAKE_DIR_UP ? -1 : 0);
+for(int k= 0; k < len; k++) {
+long dx= (long)pl->body[k].x - h.x, dy= (long)pl->body[k].y - h.y;
+long adx= dx < 0 ? -dx : dx, ady= dy < 0 ? -dy : dy;
+if(adx <= in->radius && ady <= in->radius) return NET_SEND_FULL;
+/* Ahead by `ahead`, and no further to the side than that */
+long ahead= dx * fx + dy * fy, side= fx ? ady : adx;
+if(ahead > 0 && ahead <= in->view_range && side <= ahead) return NET_SEND_FULL;
+}
+if(in->far_ticks > 0 && (tick + viewer) % in->far_ticks == 0) return NET_SEND_SUMMARY;
+return NET_SEND_NONE;
+}
+size_t net_pack_state(const GameState* game, int tick, unsigned char* buf, size_t buf_size) { return net_pack_state_for(game, tick, -1, NULL, buf, buf_size); }
+size_t net_pack_state_for(const GameState* game, int tick, int viewer, const NetInterest* interest, unsigned char* buf, size_t buf_size) {
+if(!game || !buf || game->num_players > 255) return 0;
+unsigned char level[255];
+int food= game->food_count < 0 ? 0 : (game->food_count > game->max_food ? game->max_food : game->food_count);
+int players= 0;
+size_t needed= 24 + (size_t)food * 8;
+for(int i= 0; i < game->num_players; i++) {
+const PlayerState* pl= &game->players[i];
+level[i]= (unsigned char)(pl->active ? interest_level(game, tick, viewer, interest, i) : NET_SEND_NONE);
+if(level[i] == NET_SEND_NONE) continue;
+int len= pl->length < 0 ? 0 : (pl->length > SNAKE_BODY_MAX_LEN ? SNAKE_BODY_MAX_LEN : pl->length);
+players++;
+needed+= 11 + strnlen(pl->name, PERSIST_PLAYER_NAME_MAX - 1) + (level[i] == NET_SEND_FULL ? NET_BODY_MAX_PACKED(len) : 11);
+}
+if(buf_size < needed) return 0;
+unsigned char* p= buf;
+*p++= NET_STATE_MAGIC;
+*p++= NET_STATE_VERSION;
+p= net_put_u32(p, (uint32_t)tick);
+/* Same leading fields as net_pack_game_state */
+p= net_put_u32(p, (uint32_t)game->width);
+p= net_put_u32(p, (uint32_t)game->height);
+p= net_put_u32(p, game->rng_state);
+p= net_put_u32(p, (uint32_t)game->status);
+*p++= (unsigned char)players;
+*p++= (unsigned char)food;
+for(int i= 0; i < food; i++) {
+p= net_put_u32(p, (uint32_t)game->food[i].x);
+p= net_put_u32(p, (uint32_t)game->food[i].y);
+}
+for(int i= 0; i < game->num_players; i++) {
+if(level[i] == NET_SEND_NONE) continue;
+const PlayerState* pl= &game->players[i];
+int len= pl->length < 0 ? 0 : (pl->length > SNAKE_BODY_MAX_LEN ? SNAKE_BODY_MAX_LEN : pl->length);
+size_t name_len= strnlen(pl->name, PERSIST_PLAYER_NAME_MAX - 1);
+*p++= (unsigned char)i;
+*p++= (unsigned char)name_len;
+memcpy(p, pl->name, name_len);
+p+= name_len;
+p= net_put_u32(p, pl->color);
+p= net_put_u32(p, (uint32_t)pl->score);
+*p++= (unsigned char)pl->current_dir;
+if(level[i] == NET_SEND_FULL || len == 0) {
+p= net_remote_put_body(p, pl->body, len);
+} else {
+*p++= NET_BODY_SUMMARY;
+p= net_put_u16(p, (uint32_t)len);
+p= net_put_u32(p, (uint32_t)pl->body[0].x);
+p= net_put_u32(p, (uint32_t)pl->body[0].y);
+}
+}
+return (size_t)(p - buf);
+}
+/* A summary's head leads the body we already had, cut to its length */
+static bool apply_packed_summary(NetReader* r, Game* g, GameState* gs, const char* name, uint32_t color, uint32_t score, uint32_t dir) {
+uint32_t enc, len;
+SnakePoint head;
+if(!net_get_u8(r, &enc) || !net_get_u16(r, &len) || !net_get_point(r, &head)) return false;
+if(len == 0 || len > SNAKE_BODY_MAX_LEN) return false;
+int idx= net_remote_resolve(g, gs, name, color);
+if(idx < 0) return true;
+PlayerState* pl= &gs->players[idx];
+SnakePoint old[SNAKE_BODY_MAX_LEN];
+int old_len= pl->length < 0 ? 0 : (pl->length > SNAKE_BODY_MAX_LEN ? SNAKE_BODY_MAX_LEN : pl->length);
+memcpy(old, pl->body, (size_t)old_len * sizeof old[0]);
+/* An unmoved head is not repeated */
+int k= (old_len > 0 && old[0].x == head.x && old[0].y == head.y) ? 1 : 0;
+NetRemoteBody b;
+net_remote_body_begin(&b, pl);
+net_remote_body_push(&b, head);
+for(int n= 1; k < old_len && n < (int)len; k++, n++) net_remote_body_push(&b, old[k]);
+net_remote_body_end(&b);
+net_remote_finish(pl, idx, name, (int)score, (int)dir, true);
+return true;
+}
+static bool apply_packed_player(NetReader* r, Game* g, GameState* gs) {
+uint32_t id, name_len, color, score, dir;
+char name[PERSIST_PLAYER_NAME_MAX];
+SnakePoint body[SNAKE_BODY_MAX_LEN];
+int len;
+if(!net_get_u8(r, &id) || !net_get_u8(r, &name_len)) return false;
+if(name_len >= PERSIST_PLAYER_NAME_MAX || r->end - r->p < (ptrdiff_t)name_len) return false;
+memcpy(name, r->p, name_len);
+name[name_len]= '\0';
+r->p+= name_len;
+if(!net_get_u32(r, &color) || !net_get_u32(r, &score) || !net_get_u8(r, &dir)) return false;
+if(r->p < r->end && *r->p == NET_BODY_SUMMARY) return apply_packed_summary(r, g, gs, name, color, score, dir);
+if(!net_remote_get_body(r, body, &len)) return false;
+int idx= net_remote_resolve(g, gs, name, color);
+if(idx < 0) return true;
+NetRemoteBody b;
+net_remote_body_begin(&b, &gs->players[idx]);
+for(int k= 0; k < len; k++) net_remote_body_push(&b, body[k]);
+net_remote_body_end(&b);
+net_remote_finish(&gs->players[idx], idx, name, (int)score, (int)dir, true);
+return true;
+}
+bool net_apply_packed_state(Game* g, const unsigned char* buf, size_t buf_size, bool is_host) {
+if(!g || !buf) return false;
+GameState* gs= (GameState*)game_get_state(g);
+if(!gs) return false;
+NetReader r= {buf, buf + buf_size};
+uint32_t magic, version, v, players, food;
+if(!net_get_u8(&r, &magic) || !net_get_u8(&r, &version) || magic != NET_STATE_MAGIC || version != NET_STATE_VERSION) return false;
+/* tick, width, height, rng_state and status are informational for peers */
+for(int i= 0; i < 5; i++)
+if(!net_get_u32(&r, &v)) return false;
+if(!net_get_u8(&r, &players) || !net_get_u8(&r, &food)) return false;
+if(r.end - r.p < (ptrdiff_t)food * 8) return false;
+if(!is_host) {
+int old_count= net_remote_food_begin(gs);
+for(uint32_t i= 0; i < food; i++) {
+SnakePoint pt;
+(void)net_get_point(&r, &pt);
+net_remote_food_push(gs, pt);
+}
+net_remote_food_end(gs, old_count);
+} else {
+r.p+= food * 8;
+}
+for(uint32_t i= 0; i < players; i++)
+if(!apply_packed_player(&r, g, gs)) return false;
+return true;
+}
+static const char BASE64_ALPHABET[]= "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+size_t net_base64_encode(const unsigned char* in, size_t n, char* out, size_t out_size) {
+if(!in || !out) return 0;
+size_t need= (n + 2) / 3 * 4;
+if(out_size < need + 1) return 0;
+char* q= out;
+size_t i= 0;
+for(; i + 3 <= n; i+= 3) {
+uint32_t v= ((uint32_t)in[i] << 16) | ((uint32_t)in[i + 1] << 8) | (uint32_t)in[i + 2];
+*q++= BASE64_ALPHABET[(v >> 18) & 63];
+*q++= BASE64_ALPHABET[(v >> 12) & 63];
+*q++= BASE64_ALPHABET[(v >> 6) & 63];
+*q++= BASE64_ALPHABET[v & 63];
+}
+if(i < n) {
+uint32_t v= (uint32_t)in[i] << 16;
+if(i + 1 < n) v|= (uint32_t)in[i + 1] << 8;
+*q++= BASE64_ALPHABET[(v >> 18) & 63];
+*q++= BASE64_ALPHABET[(v >> 12) & 63];
+*q++= i + 1 < n ? BASE64_ALPHABET[(v >> 6) & 63] : '=';
+*q++= '=';
+}
+*q= '\0';
+return need;
+}
+static int base64_value(char c) {
+if(c >= 'A' && c <= 'Z') return c - 'A';
+if(c >= 'a' && c <= 'z') return c - 'a' + 26;
+if(c >= '0' && c <= '9') return c - '0' + 52;
+if(c == '+') return 62;
+if(c == '/') return 63;
+return -1;
+}
+bool net_base64_decode(const char* in, size_t n, unsigned char* out, size_t out_size, size_t* out_len) {
+if(!in || !out || (n & 3) != 0) return false;
+size_t len= 0;
+for(size_t i= 0; i < n; i+= 4) {
+int pad= (in[i + 3] == '=') + (in[i + 2] == '=' && in[i + 3] == '=');
+/* Padding is only valid in the final quad */
+if(pad && i + 4 != n) return false;
+int a= base64_value(in[i]), b= base64_value(in[i + 1]);
+int c= pad >= 2 ? 0 : base64_value(in[i + 2]);
+int d= pad >= 1 ? 0 : base64_value(in[i + 3]);
+if(a < 0 || b < 0 || c < 0 || d < 0) return false;
+uint32_t v= ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6) | (uint32_t)d;
+size_t bytes= 3u - (size_t)pad;
+if(out_size - len < bytes) return false;
+out[len++]= (unsigned char)(v >> 16);
+if(bytes > 1) out[len++]= (unsigned char)(v >> 8);
+if(bytes > 2) out[len++]= (unsigned char)v;
+}
+if(out_len) *out_len= len;
+return true;
+}
+/* Largest frame a client accepts; states are far smaller */
+#define NET_CLIENT_FRAME_MAX 1000000u
+/* Send buffer for queued frames: a few thousand inputs */
+#define NET_CLIENT_TX_BYTES (16u << 10)
 struct NetClient {
 int fd;
+/* Receive arena and frame splitter, reused for every frame */
+NetFrameDecoder* rx;
+/* Frames queued by net_queue_input, length prefixes included */
+unsigned char* tx;
+size_t tx_len;
 };
 NetClient* net_connect(const char* host, int port) {
 if(!host || port <= 0) return NULL;
@@ -187,8 +452,20 @@ if(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
 close(fd);
 return NULL;
 }
-NetClient* c= malloc(sizeof *c);
-if(!c) {
+/* Writes are already whole frames or batches of them; Nagle would only hold them back */
+int one= 1;
+setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+NetClient* c= calloc(1, sizeof *c);
+if(c) {
+c->rx= net_frame_decoder_create(NET_CLIENT_FRAME_MAX);
+c->tx= malloc(NET_CLIENT_TX_BYTES);
+}
+if(!c || !c->rx || !c->tx) {
+if(c) {
+net_frame_decoder_destroy(c->rx);
+free(c->tx);
+free(c);
+}
 close(fd);
 return NULL;
 }
@@ -197,45 +474,143 @@ return c;
 }
 void net_disconnect(NetClient* client) {
 if(!client) return;
+/* Queued inputs still go out */
+(void)net_flush(client);
 close(client->fd);
+net_frame_decoder_destroy(client->rx);
+free(client->tx);
 free(client);
 }
 #include "net_log.h"
-bool net_send_input(NetClient* client, const InputState* input) {
+/* Writes every iovec, resuming after partial writes */
+static bool sendmsg_all(int fd, struct iovec* iov, int count) {
+while(count > 0) {
+struct msghdr mh= {0};
+mh.msg_iov= iov;
+mh.msg_iovlen= (size_t)count;
+ssize_t n= sendmsg(fd, &mh, MSG_NOSIGNAL);
+if(n < 0 && errno == EINTR) continue;
+if(n <= 0) return false;
+size_t left= (size_t)n;
+while(count > 0 && left >= iov->iov_len) {
+left-= iov->iov_len;
+iov++;
+count--;
+}
+if(count > 0) {
+iov->iov_base= (char*)iov->iov_base + left;
+iov->iov_len-= left;
+}
+}
+return true;
+}
+bool net_send_frames(NetClient* client, const NetFrame* frames, int count) {
+if(!client || (count > 0 && !frames) || count < 0) return false;
+/* Refuse the whole call before anything is written, so a bad frame never leaves earlier batches half sent */
+for(int i= 0; i < count; i++) {
+if(frames[i].len == 0 || frames[i].len > UINT32_MAX || !frames[i].data) return false;
+}
+unsigned char hdr[NET_SEND_FRAMES_MAX][4];
+struct iovec iov[1 + 2 * NET_SEND_FRAMES_MAX];
+int done= 0;
+do {
+int k= 0, n= 0;
+/* The queued batch leads, so frames keep the order they were issued in */
+if(client->tx_len > 0) {
+iov[k].iov_base= client->tx;
+iov[k++].iov_len= client->tx_len;
+}
+for(; n < NET_SEND_FRAMES_MAX && done + n < count; n++) {
+const NetFrame* f= &frames[done + n];
+net_put_u32(hdr[n], (uint32_t)f->len);
+iov[k].iov_base= hdr[n];
+iov[k++].iov_len= 4;
+iov[k].iov_base= (void*)(uintptr_t)f->data;
+iov[k++].iov_len= f->len;
+}
+if(k > 0 && !sendmsg_all(client->fd, iov, k)) {
+/* Some of the queue may be on the wire already; resending it would corrupt the stream */
+client->tx_len= 0;
+return false;
+}
+if(client->tx_len > 0) net_log_send(client->fd, client->tx, client->tx_len, "net_send_frames: queued");
+client->tx_len= 0;
+for(int i= 0; i < n; i++) net_log_send(client->fd, frames[done + i].data, frames[done + i].len, "net_send_frames");
+done+= n;
+} while(done < count);
+return true;
+}
+bool net_flush(NetClient* client) { return net_send_frames(client, NULL, 0); }
+bool net_queue_input(NetClient* client, const InputState* input) {
 if(!client || !input) return false;
 unsigned char buf[256];
 size_t sz= net_pack_input(input, buf, sizeof(buf));
 if(sz == 0) return false;
-uint32_t nsz= htonl((uint32_t)sz);
-ssize_t r= send(client->fd, &nsz, sizeof(nsz), 0);
-if(r != sizeof(nsz)) return false;
-/* log header */
-net_log_send(client->fd, &nsz, sizeof(nsz), "net_send_input: header");
-r= send(client->fd, buf, sz, 0);
-if(r != (ssize_t)sz) return false;
-/* log payload */
-net_log_send(client->fd, buf, sz, "net_send_input: payload");
+if(client->tx_len + 4 + sz > NET_CLIENT_TX_BYTES && !net_flush(client)) return false;
+net_put_u32(client->tx + client->tx_len, (uint32_t)sz);
+memcpy(client->tx + client->tx_len + 4, buf, sz);
+client->tx_len+= 4 + sz;
 return true;
 }
+bool net_send_input(NetClient* client, const InputState* input) {
+if(!client || !input) return false;
+unsigned char buf[256];
+size_t sz= net_pack_input(input, buf, sizeof(buf));
+if(sz == 0) return false;
+/* Length prefix and payload in one sendmsg */
+NetFrame f= {buf, sz};
+return net_send_frames(client, &f, 1);
+}
+bool net_send_join(NetClient* client, const char* session, const char* name) {
+if(!client || !session || !name) return false;
+size_t sl= strlen(session), nl= strlen(name);
+unsigned char buf[2 + 255 + PERSIST_PLAYER_NAME_MAX];
+if(sl > 255 || nl >= PERSIST_PLAYER_NAME_MAX) return false;
+buf[0]= 'J';
+buf[1]= (unsigned char)sl;
+memcpy(buf + 2, session, sl);
+memcpy(buf + 2 + sl, name, nl);
+NetFrame f= {buf, 2 + sl + nl};
+return net_send_frames(client, &f, 1);
+}
+const unsigned char* net_recv_frame_view(NetClient* client, size_t* len) {
+if(!client) return NULL;
+for(;;) {
+const unsigned char* payload;
+size_t n= 0;
+int rc= net_frame_decoder_next(client->rx, &payload, &n);
+if(rc < 0) return NULL;
+if(rc > 0) {
+if(len) *len= n;
+return payload;
+}
+size_t avail= 0;
+unsigned char* dst= net_frame_decoder_space(client->rx, &avail);
+if(!dst) return NULL;
+ssize_t r= recv(client->fd, dst, avail, 0);
+if(r < 0 && errno == EINTR) continue;
+if(r <= 0) return NULL;
+net_log_recv(client->fd, dst, (size_t)r, "net_recv_frame_view");
+net_frame_decoder_commit(client->rx, (size_t)r);
+}
+}
+size_t net_recv_frame(NetClient* client, unsigned char* buf, size_t buf_size) {
+if(!client || !buf) return 0;
+size_t n= 0;
+const unsigned char* payload= net_recv_frame_view(client, &n);
+if(!payload || n > buf_size) return 0;
+memcpy(buf, payload, n);
+return n;
+}
 bool net_recv_state(NetClient* client, GameState* out_game) {
 if(!client || !out_game) return false;
-uint32_t nsz= 0;
-ssize_t r= recv(client->fd, &nsz, sizeof(nsz), MSG_WAITALL);
-if(r != sizeof(nsz)) return false;
-/* log header */
-net_log_recv(client->fd, &nsz, sizeof(nsz), "net_recv_state: header");
-nsz= ntohl(nsz);
-if(nsz == 0 || nsz > 1000000) return false;
-unsigned char* buf= malloc(nsz);
-if(!buf) return false;
-r= recv(client->fd, buf, nsz, MSG_WAITALL);
-if(r != (ssize_t)nsz) {
-free(buf);
-return false;
+size_t n= 0;
+const unsigned char* payload= net_recv_frame_view(client, &n);
+return payload && net_unpack_game_state(payload, n, out_game);
 }
-/* log payload */
-net_log_recv(client->fd, buf, nsz, "net_recv_state: payload");
-bool ok= net_unpack_game_state(buf, (size_t)nsz, out_game);
-free(buf);
-return ok;
+bool net_recv_state_into(NetClient* client, GameState* out_game) {
+if(!client || !out_game) return false;
+size_t n= 0;
+const unsigned char* payload= net_recv_frame_view(client, &n);
+return payload && net_unpack_game_state_into(payload, n, out_game);
 }
@@ -0,0 +1,368 @@
+#include "net_delta.h"
+#include "game_internal.h"
+#include "net_log.h"
+#include "net_remote.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define NET_DELTA_MAGIC 0x44
+#define NET_DELTA_VERSION 1
+#define DELTA_FLAG_KEYFRAME 0x01
+#define DELTA_FLAG_FOOD 0x02
+/* Entry kind in the low bits, which fields a diff entry carries above them */
+#define DELTA_ENTRY_FULL 0
+#define DELTA_ENTRY_DIFF 1
+#define DELTA_ENTRY_KIND 0x03
+#define DELTA_DIFF_SCORE 0x04
+#define DELTA_DIFF_DIR 0x08
+/* Longest head run a diff entry carries; anything longer goes out as a full entry */
+#define DELTA_MAX_APPEND 255
+/* A compact copy of the replicated part of a GameState, kept for the states a base may refer to */
+typedef struct {
+char name[PERSIST_PLAYER_NAME_MAX];
+uint32_t color;
+int id;
+int score;
+int dir;
+int length;
+SnakePoint body[SNAKE_BODY_MAX_LEN];
+} DeltaPlayer;
+typedef struct {
+uint32_t seq;
+uint32_t tick;
+uint32_t width;
+uint32_t height;
+uint32_t rng_state;
+uint32_t status;
+int num_players;
+DeltaPlayer players[SNAKE_MAX_PLAYERS];
+int food_count;
+SnakePoint food[SNAKE_MAX_FOOD];
+} DeltaState;
+typedef struct {
+char name[PERSIST_PLAYER_NAME_MAX];
+/* Newest sequence we reconstructed from the peer, and its acknowledgement of ours; 0 means none */
+uint32_t recv_seq;
+uint32_t acked;
+/* Messages we encoded since we last heard from the peer; it is dropped once this passes the keyframe interval */
+int idle;
+DeltaState history[NET_DELTA_HISTORY];
+} DeltaPeer;
+struct NetDelta {
+char self[PERSIST_PLAYER_NAME_MAX];
+uint32_t seq;
+uint32_t last_keyframe;
+int keyframes;
+int deltas;
+DeltaState sent[NET_DELTA_HISTORY];
+DeltaState scratch;
+DeltaPeer* peers[NET_DELTA_MAX_PEERS];
+};
+NetDelta* net_delta_create(const char* self_name) {
+NetDelta* d= calloc(1, sizeof *d);
+if(!d) return NULL;
+if(self_name) snprintf(d->self, sizeof(d->self), "%s", self_name);
+return d;
+}
+void net_delta_destroy(NetDelta* d) {
+if(!d) return;
+for(int i= 0; i < NET_DELTA_MAX_PEERS; i++) free(d->peers[i]);
+free(d);
+}
+void net_delta_get_stats(const NetDelta* d, int* keyframes, int* deltas) {
+if(keyframes) *keyframes= d ? d->keyframes : 0;
+if(deltas) *deltas= d ? d->deltas : 0;
+}
+static DeltaState* history_find(DeltaState* history, uint32_t seq) {
+DeltaState* st= &history[seq % NET_DELTA_HISTORY];
+return (seq != 0 && st->seq == seq) ? st : NULL;
+}
+static void delta_capture(DeltaState* st, const GameState* gs, uint32_t seq, int tick) {
+st->seq= seq;
+st->tick= (uint32_t)tick;
+st->width= (uint32_t)gs->width;
+st->height= (uint32_t)gs->height;
+st->rng_state= gs->rng_state;
+st->status= (uint32_t)gs->status;
+st->num_players= 0;
+for(int i= 0; i < gs->num_players && st->num_players < SNAKE_MAX_PLAYERS; i++) {
+const PlayerState* pl= &gs->players[i];
+if(!pl->active) continue;
+DeltaPlayer* dp= &st->players[st->num_players++];
+snprintf(dp->name, sizeof(dp->name), "%s", pl->name);
+dp->color= pl->color;
+dp->id= i;
+dp->score= pl->score;
+dp->dir= (int)pl->current_dir;
+dp->length= pl->length < 0 ? 0 : (pl->length > SNAKE_BODY_MAX_LEN ? SNAKE_BODY_MAX_LEN : pl->length);
+memcpy(dp->body, pl->body, (size_t)dp->length * sizeof(SnakePoint));
+}
+int food= gs->food_count < 0 ? 0 : (gs->food_count > gs->max_food ? gs->max_food : gs->food_count);
+st->food_count= food > SNAKE_MAX_FOOD ? SNAKE_MAX_FOOD : food;
+if(st->food_count > 0) memcpy(st->food, gs->food, (size_t)st->food_count * sizeof(SnakePoint));
+}
+static const DeltaPlayer* state_player(const DeltaState* st, int id) {
+for(int i= 0; i < st->num_players; i++)
+if(st->players[i].id == id) return &st->players[i];
+return NULL;
+}
+/* Smallest head run `k` such that `cur` is k new segments in front of the first cur->length - k segments of `base`,
+   each a neighbour of the next; -1 when there is none */
+static int body_appended(const DeltaPlayer* base, const DeltaPlayer* cur) {
+int max_k= cur->length < DELTA_MAX_APPEND ? cur->length : DELTA_MAX_APPEND;
+for(int k= 0; k <= max_k; k++) {
+int keep= cur->length - k;
+if(keep > base->length) continue;
+if(k > 0 && (base->length == 0 || net_body_step(base->body[0], cur->body[k - 1]) < 0)) continue;
+if(memcmp(cur->body + k, base->body, (size_t)keep * sizeof(SnakePoint)) != 0) continue;
+bool contiguous= true;
+for(int i= k - 1; i > 0 && contiguous; i--) contiguous= net_body_step(cur->body[i], cur->body[i - 1]) >= 0;
+if(contiguous) return k;
+}
+return -1;
+}
+static unsigned char* put_name(unsigned char* p, const char* name) {
+size_t n= strnlen(name, PERSIST_PLAYER_NAME_MAX - 1);
+*p++= (unsigned char)n;
+memcpy(p, name, n);
+return p + n;
+}
+static unsigned char* put_player(unsigned char* p, const DeltaPlayer* base, const DeltaPlayer* cur) {
+*p++= (unsigned char)cur->id;
+int k= -1;
+if(base && base->color == cur->color && strcmp(base->name, cur->name) == 0) k= body_appended(base, cur);
+if(k < 0) {
+*p++= DELTA_ENTRY_FULL;
+p= put_name(p, cur->name);
+p= net_put_u32(p, cur->color);
+p= net_put_u32(p, (uint32_t)cur->score);
+*p++= (unsigned char)cur->dir;
+return net_remote_put_body(p, cur->body, cur->length);
+}
+unsigned char fields= DELTA_ENTRY_DIFF;
+if(cur->score != base->score) fields|= DELTA_DIFF_SCORE;
+if(cur->dir != base->dir) fields|= DELTA_DIFF_DIR;
+*p++= fields;
+if(fields & DELTA_DIFF_SCORE) p= net_put_u32(p, (uint32_t)cur->score);
+if(fields & DELTA_DIFF_DIR) *p++= (unsigned char)cur->dir;
+*p++= (unsigned char)k;
+p= net_put_u16(p, (uint32_t)cur->length);
+if(k == 0) return p;
+/* New segments as moves outward from the base head, ending at the new head */
+SnakePoint run[DELTA_MAX_APPEND + 1];
+run[0]= base->body[0];
+for(int i= 0; i < k; i++) run[i + 1]= cur->body[k - 1 - i];
+return net_put_moves(p, run, k + 1);
+}
+static DeltaPeer* peer_find(NetDelta* d, const char* name, bool add) {
+DeltaPeer** slot= NULL;
+for(int i= 0; i < NET_DELTA_MAX_PEERS; i++) {
+if(d->peers[i] && strcmp(d->peers[i]->name, name) == 0) return d->peers[i];
+if(!d->peers[i] && !slot) slot= &d->peers[i];
+}
+if(!add || !slot) return NULL;
+*slot= calloc(1, sizeof **slot);
+if(*slot) snprintf((*slot)->name, sizeof((*slot)->name), "%s", name);
+return *slot;
+}
+/* The newest of our states every live peer has acknowledged and that we still hold, or NULL for a keyframe */
+static const DeltaState* delta_base(NetDelta* d) {
+if(d->seq - d->last_keyframe >= NET_DELTA_KEYFRAME_INTERVAL) return NULL;
+uint32_t base= 0;
+bool any= false;
+for(int i= 0; i < NET_DELTA_MAX_PEERS; i++) {
+DeltaPeer* peer= d->peers[i];
+if(!peer) continue;
+if(peer->acked == 0) return NULL;
+if(!any || peer->acked < base) base= peer->acked;
+any= true;
+}
+if(!any || d->seq - base >= NET_DELTA_HISTORY) return NULL;
+return history_find(d->sent, base);
+}
+size_t net_delta_encode(NetDelta* d, const GameState* gs, int tick, unsigned char* buf, size_t buf_size) {
+if(!d || !gs || !buf || buf_size < NET_DELTA_MAX_PACKED) return 0;
+/* Forget peers that went quiet so they stop holding the base back */
+for(int i= 0; i < NET_DELTA_MAX_PEERS; i++) {
+if(d->peers[i] && ++d->peers[i]->idle > NET_DELTA_KEYFRAME_INTERVAL) {
+net_log_info("net_delta: dropped idle peer '%s'", d->peers[i]->name);
+free(d->peers[i]);
+d->peers[i]= NULL;
+}
+}
+d->seq++;
+DeltaState* cur= &d->sent[d->seq % NET_DELTA_HISTORY];
+delta_capture(cur, gs, d->seq, tick);
+const DeltaState* base= delta_base(d);
+bool food= !base || base->food_count != cur->food_count ||
+           memcmp(base->food, cur->food, (size_t)cur->food_count * sizeof(SnakePoint)) != 0;
+unsigned char* p= buf;
+*p++= NET_DELTA_MAGIC;
+*p++= NET_DELTA_VERSION;
+*p++= (unsigned char)((base ? 0 : DELTA_FLAG_KEYFRAME) | (food ? DELTA_FLAG_FOOD : 0));
+p= put_name(p, d->self);
+unsigned char* ack_count= p++;
+*ack_count= 0;
+for(int i= 0; i < NET_DELTA_MAX_PEERS; i++) {
+DeltaPeer* peer= d->peers[i];
+if(!peer || peer->recv_seq == 0) continue;
+p= put_name(p, peer->name);
+p= net_put_u32(p, peer->recv_seq);
+(*ack_count)++;
+}
+p= net_put_u32(p, d->seq);
+/* The base as a distance back from seq, always below NET_DELTA_HISTORY; 0 in keyframes */
+*p++= (unsigned char)(base ? d->seq - base->seq : 0);
+p= net_put_u32(p, cur->tick);
+if(!base) {
+p= net_put_u32(p, cur->width);
+p= net_put_u32(p, cur->height);
+p= net_put_u32(p, cur->rng_state);
+p= net_put_u32(p, cur->status);
+}
+if(food) {
+*p++= (unsigned char)cur->food_count;
+for(int i= 0; i < cur->food_count; i++) {
+p= net_put_u32(p, (uint32_t)cur->food[i].x);
+p= net_put_u32(p, (uint32_t)cur->food[i].y);
+}
+}
+*p++= (unsigned char)cur->num_players;
+for(int i= 0; i < cur->num_players; i++)
+p= put_player(p, base ? state_player(base, cur->players[i].id) : NULL, &cur->players[i]);
+if(base) {
+d->deltas++;
+} else {
+d->keyframes++;
+d->last_keyframe= d->seq;
+}
+return (size_t)(p - buf);
+}
+static bool get_name(NetReader* r, char* out) {
+uint32_t n;
+if(!net_get_u8(r, &n) || n >= PERSIST_PLAYER_NAME_MAX || r->end - r->p < (ptrdiff_t)n) return false;
+memcpy(out, r->p, n);
+out[n]= '\0';
+r->p+= n;
+return true;
+}
+static bool get_player(NetReader* r, const DeltaState* base, DeltaPlayer* out) {
+uint32_t id, fields, v;
+if(!net_get_u8(r, &id) || !net_get_u8(r, &fields)) return false;
+out->id= (int)id;
+if(fields == DELTA_ENTRY_FULL) {
+uint32_t color, score, dir;
+if(!get_name(r, out->name) || !net_get_u32(r, &color) || !net_get_u32(r, &score) || !net_get_u8(r, &dir)) return false;
+out->color= color;
+out->score= (int)score;
+out->dir= (int)dir;
+return net_remote_get_body(r, out->body, &out->length);
+}
+const DeltaPlayer* prev= base ? state_player(base, (int)id) : NULL;
+uint32_t k, len;
+if((fields & DELTA_ENTRY_KIND) != DELTA_ENTRY_DIFF || !prev) return false;
+snprintf(out->name, sizeof(out->name), "%s", prev->name);
+out->color= prev->color;
+out->score= prev->score;
+out->dir= prev->dir;
+if((fields & DELTA_DIFF_SCORE) && !net_get_u32(r, &v)) return false;
+if(fields & DELTA_DIFF_SCORE) out->score= (int)v;
+if((fields & DELTA_DIFF_DIR) && !net_get_u8(r, &v)) return false;
+if(fields & DELTA_DIFF_DIR) out->dir= (int)v;
+if(!net_get_u8(r, &k) || !net_get_u16(r, &len)) return false;
+if(len > SNAKE_BODY_MAX_LEN || k > len || (int)(len - k) > prev->length || (k > 0 && prev->length == 0)) return false;
+SnakePoint run[DELTA_MAX_APPEND];
+if(k > 0 && !net_get_moves(r, prev->body[0], run, (int)k)) return false;
+for(uint32_t i= 0; i < k; i++) out->body[i]= run[k - 1 - i];
+memcpy(out->body + k, prev->body, (size_t)(len - k) * sizeof(SnakePoint));
+out->length= (int)len;
+return true;
+}
+/* Pushes a reconstructed state into the game through the same path as the full-state decoders */
+static void delta_apply_state(Game* g, GameState* gs, const DeltaState* st, bool is_host) {
+if(!is_host) {
+int old_count= net_remote_food_begin(gs);
+for(int i= 0; i < st->food_count; i++) net_remote_food_push(gs, st->food[i]);
+net_remote_food_end(gs, old_count);
+}
+for(int i= 0; i < st->num_players; i++) {
+const DeltaPlayer* dp= &st->players[i];
+int idx= net_remote_resolve(g, gs, dp->name, dp->color);
+if(idx < 0) continue;
+NetRemoteBody b;
+net_remote_body_begin(&b, &gs->players[idx]);
+for(int k= 0; k < dp->length; k++) net_remote_body_push(&b, dp->body[k]);
+net_remote_body_end(&b);
+net_remote_finish(&gs->players[idx], idx, dp->name, dp->score, dp->dir, true);
+}
+}
+bool net_delta_apply(NetDelta* d, Game* g, const unsigned char* buf, size_t buf_size, bool is_host) {
+if(!d || !g || !buf) return false;
+GameState* gs= (GameState*)game_get_state(g);
+if(!gs) return false;
+NetReader r= {buf, buf + buf_size};
+uint32_t magic, version, flags, acks, seq, base_seq, v;
+char from[PERSIST_PLAYER_NAME_MAX];
+if(!net_get_u8(&r, &magic) || !net_get_u8(&r, &version) || !net_get_u8(&r, &flags)) return false;
+if(magic != NET_DELTA_MAGIC || version != NET_DELTA_VERSION || !get_name(&r, from) || !net_get_u8(&r, &acks)) return false;
+if(strcmp(from, d->self) == 0) return false;
+uint32_t acked= 0;
+for(uint32_t i= 0; i < acks; i++) {
+char name[PERSIST_PLAYER_NAME_MAX];
+if(!get_name(&r, name) || !net_get_u32(&r, &v)) return false;
+if(strcmp(name, d->self) == 0) acked= v;
+}
+if(!net_get_u32(&r, &seq) || !net_get_u8(&r, &base_seq) || seq == 0) return false;
+base_seq= seq - base_seq;
+/* The whole message is decoded into scratch before any peer state changes, so a malformed one from a new name does
+   not register a peer that would hold everyone's sends at keyframes until it idles out */
+DeltaPeer* peer= peer_find(d, from, false);
+bool stale= peer && seq <= peer->recv_seq;
+DeltaState* st= &d->scratch;
+const DeltaState* base= NULL;
+if(!(flags & DELTA_FLAG_KEYFRAME)) {
+base= peer ? history_find(peer->history, base_seq) : NULL;
+if(!base) {
+if(stale) return true;
+net_log_info("net_delta: no base %u for '%s', waiting for a keyframe", base_seq, from);
+return false;
+}
+}
+st->seq= seq;
+if(!net_get_u32(&r, &st->tick)) return false;
+if(base) {
+st->width= base->width;
+st->height= base->height;
+st->rng_state= base->rng_state;
+st->status= base->status;
+} else if(!net_get_u32(&r, &st->width) || !net_get_u32(&r, &st->height) || !net_get_u32(&r, &st->rng_state) ||
+          !net_get_u32(&r, &st->status)) {
+return false;
+}
+if(flags & DELTA_FLAG_FOOD) {
+if(!net_get_u8(&r, &v) || v > SNAKE_MAX_FOOD) return false;
+st->food_count= (int)v;
+for(int i= 0; i < st->food_count; i++)
+if(!net_get_point(&r, &st->food[i])) return false;
+} else if(base) {
+st->food_count= base->food_count;
+memcpy(st->food, base->food, sizeof(st->food));
+} else {
+return false;
+}
+if(!net_get_u8(&r, &v) || v > SNAKE_MAX_PLAYERS) return false;
+st->num_players= (int)v;
+for(int i= 0; i < st->num_players; i++)
+if(!get_player(&r, base, &st->players[i])) return false;
+if(!peer) peer= peer_find(d, from, true);
+if(!peer) return false;
+peer->idle= 0;
+/* Acks only move forward; an ack for a sequence we never sent is ignored */
+if(acked > peer->acked && acked <= d->seq) peer->acked= acked;
+if(stale) return true;
+peer->history[seq % NET_DELTA_HISTORY]= *st;
+peer->recv_seq= seq;
+delta_apply_state(g, gs, st, is_host);
+return true;
+}
@@ -0,0 +1,96 @@
+#include "net_frame.h"
+#include <stdlib.h>
+#include <string.h>
+/* Room for a typical burst of states in one read before the arena has to grow */
+#define NET_FRAME_ARENA_MIN (64u << 10)
+struct NetFrameDecoder {
+unsigned char* buf;
+size_t cap;
+/* Pending bytes are buf[start, start + len) */
+size_t start;
+size_t len;
+size_t max_frame;
+bool broken;
+};
+NetFrameDecoder* net_frame_decoder_create(size_t max_frame) {
+NetFrameDecoder* d= calloc(1, sizeof *d);
+if(!d) return NULL;
+d->max_frame= max_frame;
+d->cap= NET_FRAME_ARENA_MIN;
+d->buf= malloc(d->cap);
+if(!d->buf) {
+free(d);
+return NULL;
+}
+return d;
+}
+void net_frame_decoder_destroy(NetFrameDecoder* d) {
+if(!d) return;
+free(d->buf);
+free(d);
+}
+static uint32_t frame_len(const unsigned char* p) { return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3]; }
+/* Moves pending bytes to the front and makes room for at least `want` of them in total */
+static bool arena_reserve(NetFrameDecoder* d, size_t want) {
+if(d->start > 0) {
+memmove(d->buf, d->buf + d->start, d->len);
+d->start= 0;
+}
+if(want <= d->cap) return true;
+size_t cap= d->cap;
+while(cap < want) cap*= 2;
+unsigned char* grown= realloc(d->buf, cap);
+if(!grown) return false;
+d->buf= grown;
+d->cap= cap;
+return true;
+}
+unsigned char* net_frame_decoder_space(NetFrameDecoder* d, size_t* avail) {
+if(!d || !avail) return NULL;
+/* A partial frame that cannot fit needs the arena to grow; anything else only needs one free byte */
+size_t want= d->len + 1;
+if(d->len >= 4) {
+uint32_t n= frame_len(d->buf + d->start);
+if(n <= d->max_frame && 4 + (size_t)n > want) want= 4 + (size_t)n;
+}
+/* Compacting only when the frame cannot complete in the tail keeps moves rare */
+if(d->start + want > d->cap && !arena_reserve(d, want)) return NULL;
+*avail= d->cap - d->start - d->len;
+return d->buf + d->start + d->len;
+}
+void net_frame_decoder_commit(NetFrameDecoder* d, size_t n) {
+if(d) d->len+= n;
+}
+bool net_frame_decoder_feed(NetFrameDecoder* d, const void* data, size_t n) {
+if(!d || (!data && n)) return false;
+const unsigned char* p= data;
+while(n > 0) {
+size_t avail= 0;
+unsigned char* dst= net_frame_decoder_space(d, &avail);
+if(!dst) return false;
+size_t k= n < avail ? n : avail;
+memcpy(dst, p, k);
+d->len+= k;
+p+= k;
+n-= k;
+}
+return true;
+}
+int net_frame_decoder_next(NetFrameDecoder* d, const unsigned char** payload, size_t* len) {
+if(!d || d->broken) return -1;
+if(d->len < 4) return 0;
+uint32_t n= frame_len(d->buf + d->start);
+if(n == 0 || n > d->max_frame) {
+d->broken= true;
+return -1;
+}
+if(d->len - 4 < n) return 0;
+if(payload) *payload= d->buf + d->start + 4;
+if(len) *len= n;
+d->start+= 4 + (size_t)n;
+d->len-= 4 + (size_t)n;
+/* Nothing pending: the next read starts at the front without a move */
+if(d->len == 0) d->start= 0;
+return 1;
+}
+size_t net_frame_decoder_pending(const NetFrameDecoder* d) { return d ? d->len : 0; }
@@ -0,0 +1,557 @@
+#include "net_json.h"
+#include "game_internal.h"
+#include "net.h"
+#include "net_log.h"
+#include "net_remote.h"
+#include "trace.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+/* Forward-only cursor over a JSON buffer that is not necessarily NUL-terminated */
+typedef struct {
+const char* p;
+const char* end;
+} JsonCursor;
+/* Numbers are saturated well inside int64 so the accumulator can never overflow */
+#define JSON_NUM_LIMIT 1000000000000LL
+static void json_skip_ws(JsonCursor* c) {
+while(c->p < c->end && (*c->p == ' ' || *c->p == '\t' || *c->p == '\n' || *c->p == '\r')) c->p++;
+}
+static bool json_eat(JsonCursor* c, char ch) {
+json_skip_ws(c);
+if(c->p >= c->end || *c->p != ch) return false;
+c->p++;
+return true;
+}
+/* Raw span of a string without unescaping; used for keys, which never carry escapes in our messages */
+static bool json_raw_string(JsonCursor* c, const char** s, size_t* n) {
+if(!json_eat(c, '"')) return false;
+const char* start= c->p;
+while(c->p < c->end && *c->p != '"') {
+if(*c->p == '\\') c->p++;
+c->p++;
+}
+if(c->p >= c->end) return false;
+*s= start;
+*n= (size_t)(c->p - start);
+c->p++;
+return true;
+}
+static bool json_key_is(const char* s, size_t n, const char* key) { return strlen(key) == n && memcmp(s, key, n) == 0; }
+static int json_hex(char ch) {
+if(ch >= '0' && ch <= '9') return ch - '0';
+if(ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+if(ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+return -1;
+}
+/* Unescapes into `out`, silently truncating to cap - 1 bytes; non-ASCII \u escapes become '?' */
+static bool json_string(JsonCursor* c, char* out, size_t cap) {
+size_t n= 0;
+if(!json_eat(c, '"')) return false;
+while(c->p < c->end && *c->p != '"') {
+char ch= *c->p++;
+if(ch == '\\') {
+if(c->p >= c->end) return false;
+char e= *c->p++;
+switch(e) {
+case 'b': ch= '\b'; break;
+case 'f': ch= '\f'; break;
+case 'n': ch= '\n'; break;
+case 'r': ch= '\r'; break;
+case 't': ch= '\t'; break;
+case 'u': {
+int v= 0;
+for(int i= 0; i < 4; i++) {
+int h= c->p < c->end ? json_hex(*c->p) : -1;
+if(h < 0) return false;
+v= v * 16 + h;
+c->p++;
+}
+ch= v < 0x80 ? (char)v : '?';
+break;
+}
+default: ch= e; break;
+}
+}
+if(n + 1 < cap) out[n++]= ch;
+}
+if(c->p >= c->end) return false;
+c->p++;
+out[n]= '\0';
+return true;
+}
+/* Integer part of a JSON number; any fraction or exponent is consumed and dropped */
+static bool json_int(JsonCursor* c, long long* out) {
+json_skip_ws(c);
+bool neg= false;
+if(c->p < c->end && *c->p == '-') {
+neg= true;
+c->p++;
+}
+if(c->p >= c->end || *c->p < '0' || *c->p > '9') return false;
+long long v= 0;
+while(c->p < c->end && *c->p >= '0' && *c->p <= '9') {
+if(v < JSON_NUM_LIMIT) v= v * 10 + (*c->p - '0');
+c->p++;
+}
+while(c->p < c->end && ((*c->p >= '0' && *c->p <= '9') || *c->p == '.' || *c->p == 'e' || *c->p == 'E' || *c->p == '+' || *c->p == '-')) c->p++;
+*out= neg ? -v : v;
+return true;
+}
+static int json_clamp_int(long long v) {
+if(v > INT32_MAX) return INT32_MAX;
+if(v < INT32_MIN) return INT32_MIN;
+return (int)v;
+}
+/* Skips one value of any type. Containers are matched by depth alone, so mismatched brackets inside a skipped value
+   are tolerated; quotes are tracked so brackets inside strings do not count. */
+static bool json_skip(JsonCursor* c) {
+json_skip_ws(c);
+if(c->p >= c->end) return false;
+if(*c->p == '"') {
+const char* s;
+size_t n;
+return json_raw_string(c, &s, &n);
+}
+if(*c->p != '{' && *c->p != '[') {
+const char* start= c->p;
+while(c->p < c->end && *c->p != ',' && *c->p != '}' && *c->p != ']' && *c->p != ' ' && *c->p != '\t' && *c->p != '\n' && *c->p != '\r') c->p++;
+return c->p > start;
+}
+int depth= 0;
+while(c->p < c->end) {
+char ch= *c->p++;
+if(ch == '"') {
+while(c->p < c->end && *c->p != '"') {
+if(*c->p == '\\') c->p++;
+c->p++;
+}
+if(c->p >= c->end) return false;
+c->p++;
+} else if(ch == '{' || ch == '[') {
+depth++;
+} else if(ch == '}' || ch == ']') {
+if(--depth == 0) return true;
+}
+}
+return false;
+}
+/* Walks the "key": value members of an object: after json_object_begin, each json_object_next sets `*key` and leaves
+   the cursor at the value, or sets `*done` at the closing brace. Returns false on malformed input. */
+static bool json_object_begin(JsonCursor* c) { return json_eat(c, '{'); }
+static bool json_object_next(JsonCursor* c, bool* first, const char** key, size_t* key_len, bool* done) {
+*done= false;
+if(json_eat(c, '}')) {
+*done= true;
+return true;
+}
+if(!*first && !json_eat(c, ',')) return false;
+*first= false;
+if(!json_raw_string(c, key, key_len)) return false;
+return json_eat(c, ':');
+}
+/* Same shape for arrays: returns true with *done set at ']', otherwise leaves the cursor at the next element */
+static bool json_array_next(JsonCursor* c, bool* first, bool* done) {
+*done= false;
+if(json_eat(c, ']')) {
+*done= true;
+return true;
+}
+if(!*first && !json_eat(c, ',')) return false;
+*first= false;
+return true;
+}
+/* Matches `lit` at the cursor without skipping whitespace */
+static bool json_lit(JsonCursor* c, const char* lit, size_t n) {
+if((size_t)(c->end - c->p) < n || memcmp(c->p, lit, n) != 0) return false;
+c->p+= n;
+return true;
+}
+static bool json_point(JsonCursor* c, SnakePoint* out) {
+bool first= true, done= false;
+const char* key;
+size_t key_len;
+long long v, w;
+out->x= 0;
+out->y= 0;
+json_skip_ws(c);
+/* Fast path for the compact {"x":N,"y":N} our serializer writes for every segment */
+const char* save= c->p;
+if(json_lit(c, "{\"x\":", 5) && json_int(c, &v) && json_lit(c, ",\"y\":", 5) && json_int(c, &w) && json_lit(c, "}", 1)) {
+out->x= json_clamp_int(v);
+out->y= json_clamp_int(w);
+return true;
+}
+c->p= save;
+if(!json_object_begin(c)) return false;
+while(json_object_next(c, &first, &key, &key_len, &done)) {
+if(done) return true;
+if(json_key_is(key, key_len, "x") || json_key_is(key, key_len, "y")) {
+if(!json_int(c, &v)) return false;
+if(key[0] == 'x')
+out->x= json_clamp_int(v);
+else
+out->y= json_clamp_int(v);
+} else if(!json_skip(c)) {
+return false;
+}
+}
+return false;
+}
+/* Fields of one player object seen so far; the PlayerState is looked up lazily, at "body" or at the closing brace */
+typedef struct {
+char name[PERSIST_PLAYER_NAME_MAX];
+uint32_t color;
+int score;
+int dir;
+bool resolved;
+int idx; /* -1 when skipped (ourselves, or no free slot) */
+} JsonPlayer;
+static void resolve_player(Game* g, GameState* gs, JsonPlayer* jp) {
+jp->resolved= true;
+jp->idx= net_remote_resolve(g, gs, jp->name, jp->color);
+}
+static bool parse_body(JsonCursor* c, PlayerState* pl) {
+NetRemoteBody b;
+bool first= true, done= false;
+if(!json_eat(c, '[')) return false;
+net_remote_body_begin(&b, pl);
+while(json_array_next(c, &first, &done) && !done) {
+SnakePoint pt;
+if(!json_point(c, &pt)) break;
+net_remote_body_push(&b, pt);
+}
+net_remote_body_end(&b);
+return done;
+}
+static bool parse_player(JsonCursor* c, Game* g, GameState* gs) {
+JsonPlayer jp;
+bool first= true, done= false, have_body= false;
+const char* key;
+size_t key_len;
+long long v;
+jp.name[0]= '\0';
+jp.color= 0;
+jp.score= 0;
+jp.dir= -1;
+jp.resolved= false;
+jp.idx= -1;
+if(!json_object_begin(c)) return false;
+while(json_object_next(c, &first, &key, &key_len, &done)) {
+if(done) break;
+bool ok;
+if(json_key_is(key, key_len, "name")) {
+ok= json_string(c, jp.name, sizeof(jp.name));
+} else if(json_key_is(key, key_len, "color")) {
+ok= json_int(c, &v);
+jp.color= (uint32_t)v;
+} else if(json_key_is(key, key_len, "score")) {
+ok= json_int(c, &v);
+jp.score= json_clamp_int(v);
+} else if(json_key_is(key, key_len, "dir")) {
+ok= json_int(c, &v);
+jp.dir= json_clamp_int(v);
+} else if(json_key_is(key, key_len, "body")) {
+if(!jp.resolved) resolve_player(g, gs, &jp);
+if(jp.idx < 0) {
+ok= json_skip(c);
+} else {
+ok= parse_body(c, &gs->players[jp.idx]);
+have_body= true;
+}
+} else {
+ok= json_skip(c);
+}
+if(!ok) return false;
+}
+if(!done) return false;
+if(!jp.resolved) resolve_player(g, gs, &jp);
+if(jp.idx < 0) return true;
+net_remote_finish(&gs->players[jp.idx], jp.idx, jp.name, jp.score, jp.dir, have_body);
+return true;
+}
+static bool parse_players(JsonCursor* c, Game* g, GameState* gs) {
+bool first= true, done= false;
+if(!json_eat(c, '[')) return false;
+while(json_array_next(c, &first, &done)) {
+if(done) return true;
+if(!parse_player(c, g, gs)) return false;
+}
+return false;
+}
+static bool parse_food(JsonCursor* c, GameState* gs) {
+bool first= true, done= false;
+if(!json_eat(c, '[')) return false;
+int old_count= net_remote_food_begin(gs);
+while(json_array_next(c, &first, &done) && !done) {
+SnakePoint pt;
+if(!json_point(c, &pt)) break;
+net_remote_food_push(gs, pt);
+}
+net_remote_food_end(gs, old_count);
+return done;
+}
+/* Decodes the base64 payload of a "bstate" or "dstate" message onto the stack and applies it */
+static bool apply_packed(Game* g, NetDelta* delta, const char* b64, size_t b64_len, bool is_host) {
+unsigned char packed[NET_DELTA_MAX_PACKED];
+size_t n= 0;
+if(!net_base64_decode(b64, b64_len, packed, sizeof(packed), &n)) return false;
+if(delta) return net_delta_apply(delta, g, packed, n, is_host);
+return net_apply_packed_state(g, packed, n, is_host);
+}
+bool net_json_apply_state(Game* g, NetDelta* delta, const char* json, size_t len, bool is_host) {
+if(!g || !json) return false;
+GameState* gs= (GameState*)game_get_state(g);
+if(!gs) return false;
+JsonCursor c= {json, json + len};
+/* "players"/"food" seen before "type" are revisited once the type is known; our own messages lead with it */
+const char* players_at= NULL;
+const char* food_at= NULL;
+const char* b64= NULL;
+size_t b64_len= 0;
+bool is_state= false, is_packed= false, is_delta= false;
+bool first= true, done= false;
+const char* key;
+size_t key_len;
+if(!json_object_begin(&c)) return false;
+TRACE_BEGIN("parse_remote_game_state");
+while(json_object_next(&c, &first, &key, &key_len, &done) && !done) {
+bool ok= true;
+if(json_key_is(key, key_len, "type")) {
+char type[16];
+ok= json_string(&c, type, sizeof(type));
+if(ok && strcmp(type, "state") != 0 && strcmp(type, "bstate") != 0 && strcmp(type, "dstate") != 0) break;
+if(ok) {
+is_state= true;
+is_packed= (type[0] != 's');
+is_delta= (type[0] == 'd');
+net_log_debug("parse_remote_game_state: RECEIVED %s message (is_host=%d)", type, is_host);
+}
+} else if(json_key_is(key, key_len, "b64")) {
+ok= json_raw_string(&c, &b64, &b64_len);
+} else if(is_packed) {
+ok= json_skip(&c);
+} else if(json_key_is(key, key_len, "players")) {
+if(is_state) {
+ok= parse_players(&c, g, gs);
+} else {
+players_at= c.p;
+ok= json_skip(&c);
+}
+} else if(json_key_is(key, key_len, "food")) {
+/* Parse food (sync only if we are a client) */
+if(is_state && !is_host) {
+ok= parse_food(&c, gs);
+} else {
+if(!is_state) food_at= c.p;
+ok= json_skip(&c);
+}
+} else {
+ok= json_skip(&c);
+}
+if(!ok) break;
+}
+if(is_delta && !delta) {
+net_log_info("parse_remote_game_state: dropped dstate message, delta decoding is off");
+} else if(is_packed) {
+if(!b64 || !apply_packed(g, is_delta ? delta : NULL, b64, b64_len, is_host))
+net_log_info("parse_remote_game_state: dropped %s message", is_delta ? "dstate" : "malformed bstate");
+} else if(is_state) {
+if(players_at) {
+c.p= players_at;
+(void)parse_players(&c, g, gs);
+}
+if(food_at && !is_host) {
+c.p= food_at;
+(void)parse_food(&c, gs);
+}
+}
+TRACE_END("parse_remote_game_state");
+return is_state;
+}
+/* Worst-case output sizes; the writer reserves a whole message up front and then appends without bounds checks */
+#define JSON_INT_MAX_CHARS 11
+#define JSON_NAME_ESC_MAX (PERSIST_PLAYER_NAME_MAX * 6)
+#define JSON_PLAYER_FIXED 256
+#define JSON_POINT_MAX (14 + 2 * JSON_INT_MAX_CHARS)
+struct NetJsonWriter {
+char* buf;
+size_t cap;
+int caps;
+unsigned char packed[NET_DELTA_MAX_PACKED];
+/* Escaped name per player slot, rebuilt only when the raw name differs from `name_src` */
+char name_src[SNAKE_MAX_PLAYERS][PERSIST_PLAYER_NAME_MAX];
+char name_esc[SNAKE_MAX_PLAYERS][JSON_NAME_ESC_MAX];
+size_t name_esc_len[SNAKE_MAX_PLAYERS];
+bool name_valid[SNAKE_MAX_PLAYERS];
+};
+NetJsonWriter* net_json_writer_create(void) { return calloc(1, sizeof(NetJsonWriter)); }
+void net_json_writer_destroy(NetJsonWriter* w) {
+if(!w) return;
+free(w->buf);
+free(w);
+}
+#define JSON_PUT_LIT(q, lit) (memcpy((q), (lit), sizeof(lit) - 1), (q) + sizeof(lit) - 1)
+static char* json_put_int(char* q, int v) {
+char tmp[JSON_INT_MAX_CHARS];
+int n= 0;
+/* Magnitude as unsigned so INT_MIN does not overflow */
+unsigned int u= v < 0 ? 0u - (unsigned int)v : (unsigned int)v;
+do {
+tmp[n++]= (char)('0' + (u % 10));
+u/= 10;
+} while(u);
+if(v < 0) *q++= '-';
+while(n) *q++= tmp[--n];
+return q;
+}
+static char* json_put_point(char* q, bool comma, SnakePoint pt) {
+if(comma) *q++= ',';
+q= JSON_PUT_LIT(q, "{\"x\":");
+q= json_put_int(q, pt.x);
+q= JSON_PUT_LIT(q, ",\"y\":");
+q= json_put_int(q, pt.y);
+*q++= '}';
+return q;
+}
+/* Same escapes the JSON writer always used: quote, backslash, \n \r \t, other control bytes as \u00xx */
+static size_t json_escape_name(char* out, const char* s) {
+static const char hex[]= "0123456789abcdef";
+char* q= out;
+for(size_t i= 0; i < PERSIST_PLAYER_NAME_MAX && s[i]; i++) {
+unsigned char c= (unsigned char)s[i];
+if(c == '"' || c == '\\') {
+*q++= '\\';
+*q++= (char)c;
+} else if(c == '\n') {
+q= JSON_PUT_LIT(q, "\\n");
+} else if(c == '\r') {
+q= JSON_PUT_LIT(q, "\\r");
+} else if(c == '\t') {
+q= JSON_PUT_LIT(q, "\\t");
+} else if(c < 0x20) {
+q= JSON_PUT_LIT(q, "\\u00");
+*q++= hex[c >> 4];
+*q++= hex[c & 15];
+} else {
+*q++= (char)c;
+}
+}
+return (size_t)(q - out);
+}
+static const char* writer_name(NetJsonWriter* w, int idx, const char* name, size_t* len, char* scratch) {
+if(idx >= SNAKE_MAX_PLAYERS) {
+*len= json_escape_name(scratch, name);
+return scratch;
+}
+if(!w->name_valid[idx] || strncmp(w->name_src[idx], name, PERSIST_PLAYER_NAME_MAX) != 0) {
+memcpy(w->name_src[idx], name, PERSIST_PLAYER_NAME_MAX);
+w->name_esc_len[idx]= json_escape_name(w->name_esc[idx], name);
+w->name_valid[idx]= true;
+}
+*len= w->name_esc_len[idx];
+return w->name_esc[idx];
+}
+static int json_clamp_count(int n, int max) { return n < 0 ? 0 : (n > max ? max : n); }
+static bool writer_grow(NetJsonWriter* w, size_t need) {
+if(need <= w->cap) return true;
+size_t cap= w->cap ? w->cap : 1024;
+while(cap < need) cap*= 2;
+char* nb= realloc(w->buf, cap);
+if(!nb) return false;
+w->buf= nb;
+w->cap= cap;
+return true;
+}
+static bool writer_reserve(NetJsonWriter* w, const GameState* gs) {
+size_t need= JSON_PLAYER_FIXED + (size_t)json_clamp_count(gs->food_count, gs->max_food) * JSON_POINT_MAX;
+for(int i= 0; i < gs->num_players; i++)
+need+= JSON_PLAYER_FIXED + JSON_NAME_ESC_MAX + (size_t)json_clamp_count(gs->players[i].length, SNAKE_BODY_MAX_LEN) * JSON_POINT_MAX;
+return writer_grow(w, need);
+}
+void net_json_writer_set_caps(NetJsonWriter* w, int state_version) {
+if(w) w->caps= state_version > 0 ? state_version : 0;
+}
+static char* writer_put_caps(const NetJsonWriter* w, char* q) {
+if(w->caps <= 0) return q;
+q= JSON_PUT_LIT(q, ",\"caps\":");
+return json_put_int(q, w->caps);
+}
+const char* net_json_write_state(NetJsonWriter* w, const GameState* gs, int tick, size_t* len_out) {
+if(!w || !gs) return NULL;
+if(!writer_reserve(w, gs)) return NULL;
+char* q= w->buf;
+q= JSON_PUT_LIT(q, "{\"type\":\"state\"");
+q= writer_put_caps(w, q);
+q= JSON_PUT_LIT(q, ",\"tick\":");
+q= json_put_int(q, tick);
+q= JSON_PUT_LIT(q, ",\"w\":");
+q= json_put_int(q, gs->width);
+q= JSON_PUT_LIT(q, ",\"h\":");
+q= json_put_int(q, gs->height);
+q= JSON_PUT_LIT(q, ",\"players\":[");
+bool first= true;
+for(int i= 0; i < gs->num_players; ++i) {
+const PlayerState* p= &gs->players[i];
+if(!p->active) continue;
+int len= json_clamp_count(p->length, SNAKE_BODY_MAX_LEN);
+char scratch[JSON_NAME_ESC_MAX];
+size_t name_len;
+const char* name= writer_name(w, i, p->name, &name_len, scratch);
+if(!first) *q++= ',';
+first= false;
+q= JSON_PUT_LIT(q, "{\"id\":");
+q= json_put_int(q, i);
+q= JSON_PUT_LIT(q, ",\"name\":\"");
+memcpy(q, name, name_len);
+q+= name_len;
+q= JSON_PUT_LIT(q, "\",\"x\":");
+q= json_put_int(q, len > 0 ? p->body[0].x : 0);
+q= JSON_PUT_LIT(q, ",\"y\":");
+q= json_put_int(q, len > 0 ? p->body[0].y : 0);
+q= JSON_PUT_LIT(q, ",\"len\":");
+q= json_put_int(q, p->length);
+q= JSON_PUT_LIT(q, ",\"score\":");
+q= json_put_int(q, p->score);
+q= JSON_PUT_LIT(q, ",\"color\":");
+q= json_put_int(q, (int)p->color);
+q= JSON_PUT_LIT(q, ",\"dir\":");
+q= json_put_int(q, (int)p->current_dir);
+q= JSON_PUT_LIT(q, ",\"body\":[");
+for(int bi= 0; bi < len; ++bi) q= json_put_point(q, bi > 0, p->body[bi]);
+q= JSON_PUT_LIT(q, "]}");
+}
+q= JSON_PUT_LIT(q, "],\"food\":[");
+int food= json_clamp_count(gs->food_count, gs->max_food);
+for(int i= 0; i < food; ++i) q= json_put_point(q, i > 0, gs->food[i]);
+q= JSON_PUT_LIT(q, "]}");
+*q= '\0';
+if(len_out) *len_out= (size_t)(q - w->buf);
+return w->buf;
+}
+/* Wraps the `n` bytes in w->packed as {"type":"<type>","caps":N,"b64":"..."} */
+static const char* writer_put_packed(NetJsonWriter* w, const char* type, size_t n, size_t* len_out) {
+if(n == 0) return NULL;
+if(!writer_grow(w, JSON_PLAYER_FIXED + (n + 2) / 3 * 4)) return NULL;
+char* q= w->buf;
+q= JSON_PUT_LIT(q, "{\"type\":\"");
+size_t type_len= strlen(type);
+memcpy(q, type, type_len);
+q+= type_len;
+*q++= '"';
+q= writer_put_caps(w, q);
+q= JSON_PUT_LIT(q, ",\"b64\":\"");
+q+= net_base64_encode(w->packed, n, q, w->cap - (size_t)(q - w->buf));
+q= JSON_PUT_LIT(q, "\"}");
+*q= '\0';
+if(len_out) *len_out= (size_t)(q - w->buf);
+return w->buf;
+}
+const char* net_json_write_packed_state(NetJsonWriter* w, const GameState* gs, int tick, size_t* len_out) {
+if(!w || !gs) return NULL;
+return writer_put_packed(w, "bstate", net_pack_state(gs, tick, w->packed, sizeof(w->packed)), len_out);
+}
+const char* net_json_write_delta_state(NetJsonWriter* w, NetDelta* delta, const GameState* gs, int tick, size_t* len_out) {
+if(!w || !delta || !gs) return NULL;
+return writer_put_packed(w, "dstate", net_delta_encode(delta, gs, tick, w->packed, sizeof(w->packed)), len_out);
+}
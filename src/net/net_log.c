@@ -1,28 +1,82 @@
 #include "net_log.h"
+#include "msg_ring.h"
 #include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
-/* Simple thread-safe logger for network I/O. Default file is ./net_io.log
- * Override path with environment variable SNAKE_NET_LOG. Limits payload dump to
+/* Asynchronous logger for network I/O. Default file is logs/net_io.log; override the path with SNAKE_NET_LOG. Callers
+ * only format into their thread's ring; timestamps and hex dumps are formatted by the writer. Limits payload dump to
  * MAX_DUMP bytes. */
 #define MAX_DUMP 256
-static FILE* g_log= NULL;
+#define LOG_TEXT_MAX 1024
+#define LOG_NOTE_MAX 255
+#define LOG_RING_BYTES (128u * 1024u)
+/* How long the writer sleeps between passes when nobody asks for a flush */
+#define LOG_WRITER_IDLE_MS 20
+#define LOG_FILE_BUFFER (64u * 1024u)
+enum { LOG_IDLE, LOG_RUNNING, LOG_FAILED };
+/* Header of every ring record; text records follow it with the message, I/O records with the note then the dump */
+typedef struct {
+uint64_t us;
+int32_t fd;
+uint32_t len;
+uint8_t kind;
+uint8_t note_len;
+} LogHead;
+#define LOG_KIND_SEND 'S'
+#define LOG_KIND_RECV 'R'
+typedef struct LogRing {
+MsgRing* ring;
+uint64_t dropped_seen;
+/* Set when the owning thread exits; the writer frees the ring once it is empty */
+int orphaned;
+struct LogRing* next;
+} LogRing;
 static pthread_mutex_t g_lock= PTHREAD_MUTEX_INITIALIZER;
-/* forward */
-static void timestr(char* buf, size_t buflen);
-#include <errno.h>
-#include <stdarg.h>
-#include <sys/stat.h>
-#include <sys/types.h>
-static void open_log_if_needed(void) {
-if(g_log) return;
-static int tried= 0;
-if(tried) return;
-tried= 1;
+static pthread_cond_t g_wake= PTHREAD_COND_INITIALIZER;
+static pthread_cond_t g_flushed= PTHREAD_COND_INITIALIZER;
+static pthread_once_t g_key_once= PTHREAD_ONCE_INIT;
+static pthread_key_t g_key;
+/* Everything below is under g_lock except g_state and g_level, which callers read without it */
+static int g_state= LOG_IDLE;
+static int g_level= -1;
+static int g_stop;
+static int g_exiting;
+static int g_atexit;
+static pthread_t g_writer;
+static FILE* g_log= NULL;
+static char* g_file_buf;
+static LogRing* g_rings;
+static uint64_t g_flush_req;
+static uint64_t g_flush_done;
+/* Under g_lock: the second whose local time is cached in g_ts_prefix */
+static time_t g_ts_sec= (time_t)-1;
+static char g_ts_prefix[80];
+static uint64_t now_us(void) {
+struct timeval tv;
+gettimeofday(&tv, NULL);
+return (uint64_t)tv.tv_sec * 1000000u + (uint64_t)tv.tv_usec;
+}
+/* "YYYY-MM-DD HH:MM:SS.mmm", formatting the date and time only when the second changes */
+static void timestr(uint64_t us, char* buf, size_t buflen) {
+time_t sec= (time_t)(us / 1000000u);
+if(sec != g_ts_sec) {
+struct tm tm;
+localtime_r(&sec, &tm);
+snprintf(g_ts_prefix, sizeof(g_ts_prefix), "%04d-%02d-%02d %02d:%02d:%02d", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min,
+         tm.tm_sec);
+g_ts_sec= sec;
+}
+snprintf(buf, buflen, "%s.%03u", g_ts_prefix, (unsigned)(us % 1000000u / 1000u));
+}
+static FILE* open_log(void) {
 const char* path= getenv("SNAKE_NET_LOG");
 if(!path) path= "logs/net_io.log";
 /* Ensure logs directory exists if using default path structure */
@@ -33,112 +87,246 @@ int existed= (access(path, F_OK) == 0);
 FILE* f= fopen(path, "a");
 if(!f) {
 /* try fallback silently */
-const char* fallback= "/tmp/net_io.log";
-int fb_existed= (access(fallback, F_OK) == 0);
-f= fopen(fallback, "a");
-if(!f) { return; }
-g_log= f;
-if(!fb_existed) {
-char ts[64];
-timestr(ts, sizeof(ts));
-fprintf(g_log, "[%s] INFO net_log: logging to fallback '%s' pid=%d\n", ts, fallback, (int)getpid());
-fflush(g_log);
+path= "/tmp/net_io.log";
+existed= (access(path, F_OK) == 0);
+f= fopen(path, "a");
+if(!f) return NULL;
+}
+/* One large stdio buffer: the writer hands the kernel a whole pass worth of records at a time */
+if(!g_file_buf) g_file_buf= malloc(LOG_FILE_BUFFER);
+if(g_file_buf) setvbuf(f, g_file_buf, _IOFBF, LOG_FILE_BUFFER);
+if(!existed) {
+char ts[96];
+timestr(now_us(), ts, sizeof(ts));
+fprintf(f, "[%s] INFO net_log: logging to '%s' pid=%d\n", ts, path, (int)getpid());
+fflush(f);
 }
+return f;
+}
+static const char* level_name(int kind) {
+switch(kind) {
+case NET_LOG_ERROR: return "ERROR";
+case NET_LOG_DEBUG: return "DEBUG";
+default: return "INFO";
+}
+}
+static void write_hex(FILE* f, const unsigned char* data, size_t len) {
+static const char digits[]= "0123456789abcdef";
+char line[3 * MAX_DUMP];
+size_t n= 0;
+for(size_t i= 0; i < len && i < MAX_DUMP; ++i) {
+if(i) line[n++]= ' ';
+line[n++]= digits[data[i] >> 4];
+line[n++]= digits[data[i] & 15];
+}
+fwrite(line, 1, n, f);
+}
+static void write_record(FILE* f, const char* rec, size_t len) {
+LogHead h;
+if(len < sizeof h) return;
+memcpy(&h, rec, sizeof h);
+const char* body= rec + sizeof h;
+size_t body_len= len - sizeof h;
+char ts[96];
+timestr(h.us, ts, sizeof(ts));
+if(h.kind != LOG_KIND_SEND && h.kind != LOG_KIND_RECV) {
+fprintf(f, "[%s] %s %.*s\n", ts, level_name(h.kind), (int)body_len, body);
 return;
 }
-g_log= f;
-if(!existed) {
-char ts[64];
-timestr(ts, sizeof(ts));
-fprintf(g_log, "[%s] INFO net_log: logging to '%s' pid=%d\n", ts, path, (int)getpid());
-fflush(g_log);
+size_t note_len= h.note_len < body_len ? h.note_len : body_len;
+size_t dump_len= body_len - note_len;
+fprintf(f, "[%s] %s fd=%d len=%u %.*s\n", ts, h.kind == LOG_KIND_SEND ? "SEND" : "RECV", (int)h.fd, (unsigned)h.len, (int)note_len, body);
+if(dump_len > 0) {
+fprintf(f, "data(hex,%zu): ", dump_len);
+write_hex(f, (const unsigned char*)body + note_len, dump_len);
+if(dump_len < h.len) fputs(" ... (truncated)", f);
+fputc('\n', f);
+}
 }
+/* One writer pass over every ring, then a single flush; caller holds g_lock and is the only consumer */
+static void drain_all(void) {
+int wrote= 0;
+LogRing** link= &g_rings;
+while(*link) {
+LogRing* r= *link;
+const char* rec;
+size_t len= 0;
+while((rec= msg_ring_peek(r->ring, &len)) != NULL) {
+if(g_log) write_record(g_log, rec, len);
+msg_ring_pop(r->ring);
+wrote= 1;
 }
-void net_log_info(const char* fmt, ...) {
+MsgRingStats st;
+msg_ring_get_stats(r->ring, &st);
+if(st.dropped > r->dropped_seen && g_log) {
+char ts[96];
+timestr(now_us(), ts, sizeof(ts));
+fprintf(g_log, "[%s] ERROR net_log: dropped %llu records, a thread's log ring was full\n", ts, (unsigned long long)(st.dropped - r->dropped_seen));
+r->dropped_seen= st.dropped;
+wrote= 1;
+}
+if(__atomic_load_n(&r->orphaned, __ATOMIC_ACQUIRE) && !msg_ring_peek(r->ring, NULL)) {
+*link= r->next;
+msg_ring_destroy(r->ring);
+free(r);
+} else {
+link= &r->next;
+}
+}
+if(wrote && g_log) fflush(g_log);
+}
+static void* writer_main(void* arg) {
+(void)arg;
 pthread_mutex_lock(&g_lock);
-open_log_if_needed();
-if(!g_log) {
-pthread_mutex_unlock(&g_lock);
-return;
+while(!g_stop) {
+uint64_t want= g_flush_req;
+drain_all();
+g_flush_done= want;
+pthread_cond_broadcast(&g_flushed);
+if(g_stop || g_flush_req != want) continue;
+struct timespec ts;
+clock_gettime(CLOCK_REALTIME, &ts);
+ts.tv_nsec+= LOG_WRITER_IDLE_MS * 1000000L;
+if(ts.tv_nsec >= 1000000000L) {
+ts.tv_sec++;
+ts.tv_nsec-= 1000000000L;
+}
+pthread_cond_timedwait(&g_wake, &g_lock, &ts);
 }
-char ts[64];
-timestr(ts, sizeof(ts));
-fprintf(g_log, "[%s] INFO ", ts);
-va_list ap;
-va_start(ap, fmt);
-vfprintf(g_log, fmt, ap);
-va_end(ap);
-fprintf(g_log, "\n");
-fflush(g_log);
 pthread_mutex_unlock(&g_lock);
+return NULL;
 }
-void net_log_error(const char* fmt, ...) {
+static void at_exit_close(void) {
 pthread_mutex_lock(&g_lock);
-open_log_if_needed();
-if(!g_log) {
+g_exiting= 1;
 pthread_mutex_unlock(&g_lock);
-return;
+net_log_close();
 }
-char ts[64];
-timestr(ts, sizeof(ts));
-fprintf(g_log, "[%s] ERROR ", ts);
-va_list ap;
-va_start(ap, fmt);
-vfprintf(g_log, fmt, ap);
-va_end(ap);
-fprintf(g_log, "\n");
-fflush(g_log);
-pthread_mutex_unlock(&g_lock);
+/* Opens the file and starts the writer the first time anything is logged; false while logging is unavailable */
+static int ensure_started(void) {
+int state= __atomic_load_n(&g_state, __ATOMIC_ACQUIRE);
+if(state != LOG_IDLE) return state == LOG_RUNNING;
+pthread_mutex_lock(&g_lock);
+if(g_state == LOG_IDLE && !g_exiting) {
+g_log= open_log();
+g_stop= 0;
+if(g_log && pthread_create(&g_writer, NULL, writer_main, NULL) == 0) {
+if(!g_atexit) g_atexit= (atexit(at_exit_close) == 0);
+__atomic_store_n(&g_state, LOG_RUNNING, __ATOMIC_RELEASE);
+} else {
+if(g_log) fclose(g_log);
+g_log= NULL;
+__atomic_store_n(&g_state, LOG_FAILED, __ATOMIC_RELEASE);
 }
-static void timestr(char* buf, size_t buflen) {
-struct timeval tv;
-gettimeofday(&tv, NULL);
-struct tm tm;
-localtime_r(&tv.tv_sec, &tm);
-int ms= (int)(tv.tv_usec / 1000);
-snprintf(buf, buflen, "%04d-%02d-%02d %02d:%02d:%02d.%03d", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, ms);
 }
-static void hex_dump_to_file(FILE* f, const unsigned char* data, size_t len) {
-size_t i;
-for(i= 0; i < len; ++i) {
-fprintf(f, "%02x", data[i]);
-if(i + 1 < len) fprintf(f, " ");
+state= g_state;
+pthread_mutex_unlock(&g_lock);
+return state == LOG_RUNNING;
 }
+static void ring_orphan(void* p) { __atomic_store_n(&((LogRing*)p)->orphaned, 1, __ATOMIC_RELEASE); }
+static void make_key(void) { (void)pthread_key_create(&g_key, ring_orphan); }
+/* The calling thread's ring, registered with the writer on first use */
+static LogRing* thread_ring(void) {
+pthread_once(&g_key_once, make_key);
+LogRing* r= pthread_getspecific(g_key);
+if(r) return r;
+r= calloc(1, sizeof *r);
+if(!r) return NULL;
+r->ring= msg_ring_create(LOG_RING_BYTES);
+if(!r->ring) {
+free(r);
+return NULL;
 }
-static void log_io(const char* dir, int fd, const void* buf, size_t len, const char* note) {
-if(!buf) return;
 pthread_mutex_lock(&g_lock);
-open_log_if_needed();
-if(!g_log) {
+r->next= g_rings;
+g_rings= r;
 pthread_mutex_unlock(&g_lock);
-return;
+pthread_setspecific(g_key, r);
+return r;
 }
-char ts[64];
-timestr(ts, sizeof(ts));
-fprintf(g_log, "[%s] %s fd=%d len=%zu %s\n", ts, dir, fd, len, note ? note : "");
-size_t dump_len= len < MAX_DUMP ? len : MAX_DUMP;
-if(dump_len > 0) {
-fprintf(g_log, "data(hex,%zu): ", dump_len);
-hex_dump_to_file(g_log, (const unsigned char*)buf, dump_len);
-if(dump_len < len) fprintf(g_log, " ... (truncated)");
-fprintf(g_log, "\n");
+static int level_from_env(void) {
+const char* v= getenv("SNAKE_NET_LOG_LEVEL");
+if(!v || !v[0]) return NET_LOG_IO;
+static const char* const names[]= {"off", "error", "info", "debug", "io"};
+for(int i= 0; i <= NET_LOG_IO; i++)
+if(strcmp(v, names[i]) == 0) return i;
+int n= atoi(v);
+return n < NET_LOG_OFF ? NET_LOG_OFF : (n > NET_LOG_IO ? NET_LOG_IO : n);
 }
-fflush(g_log);
-pthread_mutex_unlock(&g_lock);
+void net_log_set_level(int level) {
+__atomic_store_n(&g_level, level < NET_LOG_OFF ? NET_LOG_OFF : (level > NET_LOG_IO ? NET_LOG_IO : level), __ATOMIC_RELAXED);
+}
+int net_log_get_level(void) {
+int level= __atomic_load_n(&g_level, __ATOMIC_RELAXED);
+if(level < 0) {
+level= level_from_env();
+int unset= -1;
+/* Whoever reads the environment first wins; an explicit net_log_set_level() in between is kept */
+if(!__atomic_compare_exchange_n(&g_level, &unset, level, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) level= unset;
+}
+return level;
+}
+bool net_log_enabled(int level) { return level > NET_LOG_OFF && level <= net_log_get_level(); }
+static void push(const char* rec, size_t len) {
+if(!ensure_started()) return;
+LogRing* r= thread_ring();
+/* A full ring counts the drop, which the writer reports */
+if(r) (void)msg_ring_push(r->ring, rec, len);
+}
+void net_log_write(int level, const char* fmt, ...) {
+if(!fmt) return;
+char rec[sizeof(LogHead) + LOG_TEXT_MAX];
+LogHead h= {now_us(), 0, 0, (uint8_t)level, 0};
+memcpy(rec, &h, sizeof h);
+va_list ap;
+va_start(ap, fmt);
+int n= vsnprintf(rec + sizeof h, LOG_TEXT_MAX, fmt, ap);
+va_end(ap);
+if(n < 0) return;
+size_t text= (size_t)n < LOG_TEXT_MAX ? (size_t)n : LOG_TEXT_MAX - 1;
+push(rec, sizeof h + text);
+}
+void net_log_io(const char* dir, int fd, const void* buf, size_t len, const char* note) {
+if(!buf || !dir) return;
+char rec[sizeof(LogHead) + LOG_NOTE_MAX + MAX_DUMP];
+size_t note_len= note ? strlen(note) : 0;
+if(note_len > LOG_NOTE_MAX) note_len= LOG_NOTE_MAX;
+size_t dump_len= len < MAX_DUMP ? len : MAX_DUMP;
+LogHead h= {now_us(), (int32_t)fd, len > UINT32_MAX ? UINT32_MAX : (uint32_t)len, (uint8_t)(dir[0] == 'S' ? LOG_KIND_SEND : LOG_KIND_RECV),
+            (uint8_t)note_len};
+memcpy(rec, &h, sizeof h);
+if(note_len) memcpy(rec + sizeof h, note, note_len);
+memcpy(rec + sizeof h + note_len, buf, dump_len);
+push(rec, sizeof h + note_len + dump_len);
 }
-void net_log_send(int fd, const void* buf, size_t len, const char* note) { log_io("SEND", fd, buf, len, note); }
-void net_log_recv(int fd, const void* buf, size_t len, const char* note) { log_io("RECV", fd, buf, len, note); }
 /* Public init/close so the program can create the log file at startup */
-void net_log_init(void) {
+void net_log_init(void) { (void)ensure_started(); }
+void net_log_flush(void) {
+if(__atomic_load_n(&g_state, __ATOMIC_ACQUIRE) != LOG_RUNNING) return;
 pthread_mutex_lock(&g_lock);
-open_log_if_needed();
+uint64_t mine= ++g_flush_req;
+pthread_cond_signal(&g_wake);
+while(g_flush_done < mine && g_state == LOG_RUNNING) pthread_cond_wait(&g_flushed, &g_lock);
 pthread_mutex_unlock(&g_lock);
 }
 void net_log_close(void) {
 pthread_mutex_lock(&g_lock);
-if(g_log) {
+if(g_state != LOG_RUNNING) {
+/* A failed open is retried on the next record */
+if(g_state == LOG_FAILED) __atomic_store_n(&g_state, LOG_IDLE, __ATOMIC_RELEASE);
+pthread_mutex_unlock(&g_lock);
+return;
+}
+g_stop= 1;
+pthread_cond_signal(&g_wake);
+pthread_mutex_unlock(&g_lock);
+pthread_join(g_writer, NULL);
+pthread_mutex_lock(&g_lock);
+drain_all();
 fclose(g_log);
 g_log= NULL;
-}
+g_flush_done= g_flush_req;
+__atomic_store_n(&g_state, LOG_IDLE, __ATOMIC_RELEASE);
+pthread_cond_broadcast(&g_flushed);
 pthread_mutex_unlock(&g_lock);
 }
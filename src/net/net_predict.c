@@ -0,0 +1,158 @@
+#include "net_predict.h"
+#include "collision.h"
+#include "game_internal.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+typedef struct {
+char name[PERSIST_PLAYER_NAME_MAX];
+bool have_auth;
+/* Ticks the shown body runs ahead of `auth` */
+int ahead;
+int auth_len;
+SnakePoint auth[SNAKE_BODY_MAX_LEN];
+/* What is on screen after the last step or reconcile, and the direction it was predicted with */
+int shown_len;
+SnakeDir shown_dir;
+SnakePoint shown[SNAKE_BODY_MAX_LEN];
+} PredictSlot;
+struct NetPredict {
+int max_ahead;
+PredictSlot slots[SNAKE_MAX_PLAYERS];
+NetPredictStats stats;
+};
+NetPredict* net_predict_create(int max_ahead) {
+NetPredict* p= calloc(1, sizeof *p);
+if(!p) return NULL;
+p->max_ahead= max_ahead < 0 ? 0 : (max_ahead > NET_PREDICT_MAX_AHEAD ? NET_PREDICT_MAX_AHEAD : max_ahead);
+return p;
+}
+void net_predict_destroy(NetPredict* p) { free(p); }
+static bool same_point(SnakePoint a, SnakePoint b) { return a.x == b.x && a.y == b.y; }
+/* Whether a predicted head may enter `pt`: not a wall and not a segment that stays put this tick */
+static bool cell_free(const GameState* gs, SnakePoint pt) {
+if(collision_is_wall(pt, gs->width, gs->height)) return false;
+for(int i= 0; i < gs->num_players; i++) {
+const PlayerState* o= &gs->players[i];
+if(!o->active) continue;
+for(int k= 0; k < o->length - 1; k++)
+if(same_point(o->body[k], pt)) return false;
+}
+return true;
+}
+/* One tick of the game's own movement rule without eating: growth and score only come from snapshots */
+static bool predict_move(const GameState* gs, PlayerState* pl) {
+if(pl->length <= 0) return false;
+SnakePoint next= collision_next_head(pl->body[0], pl->current_dir);
+if(!cell_free(gs, next)) return false;
+memmove(pl->body + 1, pl->body, (size_t)(pl->length - 1) * sizeof(SnakePoint));
+pl->body[0]= next;
+return true;
+}
+/* Interpolate from `from` (segments past its end start where they are) towards the current body */
+static void set_prev(PlayerState* pl, const SnakePoint* from, int from_len) {
+const SnakePoint* head= from_len > 0 ? &from[0] : &pl->body[0];
+pl->prev_head.x= (float)head->x + 0.5f;
+pl->prev_head.y= (float)head->y + 0.5f;
+for(int i= 0; i < pl->length; i++) {
+SnakePoint s= i < from_len ? from[i] : pl->body[i];
+pl->prev_segment[i].x= (float)s.x + 0.5f;
+pl->prev_segment[i].y= (float)s.y + 0.5f;
+}
+pl->interp_time= 0.0f;
+}
+static void remember_shown(PredictSlot* slot, const PlayerState* pl) {
+slot->shown_len= pl->length;
+slot->shown_dir= pl->current_dir;
+memcpy(slot->shown, pl->body, (size_t)pl->length * sizeof(SnakePoint));
+}
+/* An out-of-date snapshot (reordered, or relayed late by another peer) has its head and neck further down the newest
+   authoritative body */
+static bool is_stale(const PredictSlot* slot, const PlayerState* pl) {
+for(int j= 1; j + 1 < slot->auth_len; j++) {
+if(!same_point(slot->auth[j], pl->body[0])) continue;
+if(pl->length < 2 || same_point(slot->auth[j + 1], pl->body[1])) return true;
+}
+return false;
+}
+static PredictSlot* slot_for(NetPredict* p, int idx, const PlayerState* pl) {
+PredictSlot* slot= &p->slots[idx];
+if(strcmp(slot->name, pl->name) != 0) {
+memset(slot, 0, sizeof *slot);
+snprintf(slot->name, sizeof slot->name, "%s", pl->name);
+}
+return slot;
+}
+void net_predict_reconcile(NetPredict* p, Game* g) {
+if(!p || !g || p->max_ahead == 0) return;
+GameState* gs= (GameState*)game_get_state(g);
+for(int i= 0; i < gs->num_players && i < SNAKE_MAX_PLAYERS; i++) {
+PlayerState* pl= &gs->players[i];
+if(!pl->is_remote) continue;
+PredictSlot* slot= slot_for(p, i, pl);
+bool first= !pl->net_predicted;
+pl->net_predicted= true;
+if(!pl->net_snapshot) continue;
+pl->net_snapshot= false;
+if(!pl->active || pl->length <= 0) {
+slot->have_auth= false;
+slot->ahead= 0;
+slot->shown_len= 0;
+continue;
+}
+int ahead= 0;
+if(slot->have_auth && slot->auth_len > 0) {
+if(is_stale(slot, pl)) {
+pl->length= slot->shown_len;
+pl->current_dir= slot->shown_dir;
+memcpy(pl->body, slot->shown, (size_t)slot->shown_len * sizeof(SnakePoint));
+p->stats.stale++;
+continue;
+}
+/* The snapshot covers the predicted ticks up to where the previous authoritative head sits in its body */
+for(int k= 0; k < pl->length && k <= slot->ahead; k++) {
+if(same_point(pl->body[k], slot->auth[0])) {
+ahead= slot->ahead - k;
+break;
+}
+}
+}
+slot->have_auth= true;
+slot->auth_len= pl->length;
+memcpy(slot->auth, pl->body, (size_t)pl->length * sizeof(SnakePoint));
+int replayed= 0;
+while(replayed < ahead && predict_move(gs, pl)) replayed++;
+slot->ahead= replayed;
+if(slot->shown_len == pl->length && memcmp(slot->shown, pl->body, (size_t)pl->length * sizeof(SnakePoint)) == 0) {
+p->stats.confirmed++;
+} else {
+if(!first) p->stats.corrected++;
+set_prev(pl, slot->shown, slot->shown_len);
+}
+remember_shown(slot, pl);
+}
+}
+void net_predict_step(NetPredict* p, Game* g) {
+if(!p || !g || p->max_ahead == 0) return;
+GameState* gs= (GameState*)game_get_state(g);
+for(int i= 0; i < gs->num_players && i < SNAKE_MAX_PLAYERS; i++) {
+PlayerState* pl= &gs->players[i];
+if(!pl->is_remote || !pl->net_predicted || !pl->active) continue;
+PredictSlot* slot= slot_for(p, i, pl);
+if(!slot->have_auth || slot->ahead >= p->max_ahead) continue;
+if(!predict_move(gs, pl)) continue;
+slot->ahead++;
+p->stats.predicted++;
+set_prev(pl, slot->shown, slot->shown_len);
+remember_shown(slot, pl);
+}
+}
+void net_predict_get_stats(const NetPredict* p, NetPredictStats* out) {
+if(!out) return;
+if(!p) {
+memset(out, 0, sizeof *out);
+return;
+}
+*out= p->stats;
+}
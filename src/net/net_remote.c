@@ -0,0 +1,163 @@
+#include "net_remote.h"
+#include "net_log.h"
+#include <string.h>
+int net_remote_resolve(Game* g, GameState* gs, const char* name, uint32_t color) {
+int idx= -1;
+for(int i= 0; i < gs->num_players; i++) {
+/* Skip if this is our own player state reflected back */
+if(!gs->players[i].is_remote && strcmp(gs->players[i].name, name) == 0) return -1;
+}
+for(int i= 0; i < gs->num_players; i++) {
+if(gs->players[i].is_remote && strcmp(gs->players[i].name, name) == 0) {
+idx= i;
+break;
+}
+}
+if(idx == -1) {
+idx= game_add_remote_player(g, name, color);
+net_log_info("parse_remote_game_state: ADDED new remote player '%s' at idx %d", name, idx);
+}
+/* Force active to true initially if found in state */
+if(idx != -1) gs->players[idx].active= true;
+return idx;
+}
+void net_remote_body_begin(NetRemoteBody* b, PlayerState* pl) {
+b->pl= pl;
+b->old_len= pl->length;
+b->new_len= 0;
+b->moved= false;
+b->first_update= (pl->length == 0);
+}
+void net_remote_body_push(NetRemoteBody* b, SnakePoint pt) {
+PlayerState* pl= b->pl;
+if(b->new_len >= SNAKE_BODY_MAX_LEN) return;
+int i= b->new_len++;
+if(pl->net_predicted) {
+/* net_predict reconciles the body and owns the interpolation state */
+pl->body[i]= pt;
+return;
+}
+if(i == 0 && b->old_len > 0 && (pt.x != pl->body[0].x || pt.y != pl->body[0].y)) {
+b->moved= true;
+/* Save current to prev for interpolation */
+pl->prev_head.x= (float)pl->body[0].x + 0.5f;
+pl->prev_head.y= (float)pl->body[0].y + 0.5f;
+pl->interp_time= 0.0f;
+}
+if(b->moved && i < b->old_len) {
+pl->prev_segment[i].x= (float)pl->body[i].x + 0.5f;
+pl->prev_segment[i].y= (float)pl->body[i].y + 0.5f;
+}
+pl->body[i]= pt;
+/* Init prev for new segments or first update */
+if(b->first_update || i >= b->old_len) {
+pl->prev_segment[i].x= (float)pt.x + 0.5f;
+pl->prev_segment[i].y= (float)pt.y + 0.5f;
+}
+}
+void net_remote_body_end(NetRemoteBody* b) {
+PlayerState* pl= b->pl;
+pl->net_snapshot= true;
+if(pl->net_predicted) {
+pl->length= b->new_len;
+pl->active= (b->new_len > 0);
+return;
+}
+if(b->moved) {
+for(int i= b->new_len; i < b->old_len && i < SNAKE_BODY_MAX_LEN; i++) {
+pl->prev_segment[i].x= (float)pl->body[i].x + 0.5f;
+pl->prev_segment[i].y= (float)pl->body[i].y + 0.5f;
+}
+}
+pl->length= b->new_len;
+pl->active= (b->new_len > 0);
+if(b->first_update && b->new_len > 0) {
+pl->prev_head.x= (float)pl->body[0].x + 0.5f;
+pl->prev_head.y= (float)pl->body[0].y + 0.5f;
+}
+}
+void net_remote_finish(PlayerState* pl, int idx, const char* name, int score, int dir, bool have_body) {
+pl->score= score;
+if(dir >= 0 && dir <= 3) pl->current_dir= (SnakeDir)dir;
+if(!have_body) return;
+if(pl->active)
+net_log_debug("parse: Player %d '%s' updated. Len=%d Head=(%d,%d)", idx, name, pl->length, pl->body[0].x, pl->body[0].y);
+else
+net_log_debug("parse: Player %d '%s' inactive or empty body", idx, name);
+}
+int net_remote_food_begin(GameState* gs) {
+int old_count= gs->food_count;
+gs->food_count= 0;
+return old_count;
+}
+void net_remote_food_push(GameState* gs, SnakePoint pt) {
+if(gs->food_count < gs->max_food) gs->food[gs->food_count++]= pt;
+}
+void net_remote_food_end(GameState* gs, int old_count) {
+if(gs->food_count != old_count) net_log_info("parse_remote_game_state: SYNCED food (count: %d -> %d)", old_count, gs->food_count);
+}
+int net_body_step(SnakePoint a, SnakePoint b) {
+int dx= b.x - a.x, dy= b.y - a.y;
+if(dx == 0 && dy == -1) return SNAKE_DIR_UP;
+if(dx == 0 && dy == 1) return SNAKE_DIR_DOWN;
+if(dx == -1 && dy == 0) return SNAKE_DIR_LEFT;
+if(dx == 1 && dy == 0) return SNAKE_DIR_RIGHT;
+return -1;
+}
+SnakePoint net_body_follow(SnakePoint pt, unsigned int dir) {
+static const int dx[4]= {0, 0, -1, 1};
+static const int dy[4]= {-1, 1, 0, 0};
+pt.x= (int)((unsigned int)pt.x + (unsigned int)dx[dir]);
+pt.y= (int)((unsigned int)pt.y + (unsigned int)dy[dir]);
+return pt;
+}
+unsigned char* net_put_moves(unsigned char* p, const SnakePoint* pts, int n) {
+unsigned int acc= 0;
+int k;
+for(k= 1; k < n; k++) {
+acc= (acc << 2) | (unsigned int)net_body_step(pts[k - 1], pts[k]);
+if((k & 3) == 0) {
+*p++= (unsigned char)acc;
+acc= 0;
+}
+}
+if(n > 1 && ((k - 1) & 3) != 0) *p++= (unsigned char)(acc << (2 * (4 - ((k - 1) & 3))));
+return p;
+}
+bool net_get_moves(NetReader* r, SnakePoint from, SnakePoint* out, int n) {
+if(r->end - r->p < (ptrdiff_t)((n + 3) / 4)) return false;
+for(int k= 0; k < n; k++) {
+unsigned int shift= 6u - 2u * ((unsigned int)k & 3u);
+from= net_body_follow(from, (*r->p >> shift) & 3u);
+out[k]= from;
+if((k & 3) == 3 || k == n - 1) r->p++;
+}
+return true;
+}
+unsigned char* net_remote_put_body(unsigned char* p, const SnakePoint* body, int len) {
+bool contiguous= true;
+for(int k= 1; k < len && contiguous; k++) contiguous= net_body_step(body[k - 1], body[k]) >= 0;
+*p++= contiguous ? NET_BODY_MOVES : NET_BODY_RAW;
+p= net_put_u16(p, (uint32_t)len);
+if(len == 0) return p;
+p= net_put_u32(p, (uint32_t)body[0].x);
+p= net_put_u32(p, (uint32_t)body[0].y);
+if(contiguous) return net_put_moves(p, body, len);
+for(int k= 1; k < len; k++) {
+p= net_put_u32(p, (uint32_t)body[k].x);
+p= net_put_u32(p, (uint32_t)body[k].y);
+}
+return p;
+}
+bool net_remote_get_body(NetReader* r, SnakePoint* body, int* len_out) {
+uint32_t enc, len;
+if(!net_get_u8(r, &enc) || !net_get_u16(r, &len)) return false;
+if((enc != NET_BODY_MOVES && enc != NET_BODY_RAW) || len > SNAKE_BODY_MAX_LEN) return false;
+*len_out= (int)len;
+if(len == 0) return true;
+if(!net_get_point(r, &body[0])) return false;
+if(enc == NET_BODY_MOVES) return net_get_moves(r, body[0], body + 1, (int)len - 1);
+for(uint32_t k= 1; k < len; k++)
+if(!net_get_point(r, &body[k])) return false;
+return true;
+}
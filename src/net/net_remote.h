@@ -0,0 +1,88 @@
+#pragma once
+#include "game.h"
+#include "game_internal.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+/* Applying a peer's player entries to our GameState, shared by the JSON and binary state decoders */
+/* Index of the remote slot for `name`, adding the player if needed; -1 for our own player reflected back or when
+   every slot is taken. The slot is marked active. */
+int net_remote_resolve(Game* g, GameState* gs, const char* name, uint32_t color);
+/* Streams a new body into pl->body. prev_segment must hold the old body when the head moved, so each old segment is
+   copied to prev just before it is overwritten and the tail beyond the new length is copied at the end. A predicted
+   player only gets the body and net_snapshot set; net_predict_reconcile() does the rest. */
+typedef struct {
+PlayerState* pl;
+int old_len;
+int new_len;
+bool moved;
+bool first_update;
+} NetRemoteBody;
+void net_remote_body_begin(NetRemoteBody* b, PlayerState* pl);
+void net_remote_body_push(NetRemoteBody* b, SnakePoint pt);
+void net_remote_body_end(NetRemoteBody* b);
+/* Score, direction and the per-player log line once an entry is complete */
+void net_remote_finish(PlayerState* pl, int idx, const char* name, int score, int dir, bool have_body);
+/* Food sync for clients: food_begin clears the list and returns the old count for food_end's log line */
+int net_remote_food_begin(GameState* gs);
+void net_remote_food_push(GameState* gs, SnakePoint pt);
+void net_remote_food_end(GameState* gs, int old_count);
+/* Big-endian cursor helpers shared by the binary state encodings */
+static inline unsigned char* net_put_u16(unsigned char* p, uint32_t v) {
+p[0]= (unsigned char)(v >> 8);
+p[1]= (unsigned char)v;
+return p + 2;
+}
+static inline unsigned char* net_put_u32(unsigned char* p, uint32_t v) {
+p[0]= (unsigned char)(v >> 24);
+p[1]= (unsigned char)(v >> 16);
+p[2]= (unsigned char)(v >> 8);
+p[3]= (unsigned char)v;
+return p + 4;
+}
+typedef struct {
+const unsigned char* p;
+const unsigned char* end;
+} NetReader;
+static inline bool net_get_u8(NetReader* r, uint32_t* v) {
+if(r->end - r->p < 1) return false;
+*v= *r->p++;
+return true;
+}
+static inline bool net_get_u16(NetReader* r, uint32_t* v) {
+if(r->end - r->p < 2) return false;
+*v= ((uint32_t)r->p[0] << 8) | (uint32_t)r->p[1];
+r->p+= 2;
+return true;
+}
+static inline bool net_get_u32(NetReader* r, uint32_t* v) {
+if(r->end - r->p < 4) return false;
+*v= ((uint32_t)r->p[0] << 24) | ((uint32_t)r->p[1] << 16) | ((uint32_t)r->p[2] << 8) | (uint32_t)r->p[3];
+r->p+= 4;
+return true;
+}
+static inline bool net_get_point(NetReader* r, SnakePoint* pt) {
+uint32_t x, y;
+if(!net_get_u32(r, &x) || !net_get_u32(r, &y)) return false;
+pt->x= (int)x;
+pt->y= (int)y;
+return true;
+}
+/* Move code from one segment to the next, in SnakeDir order, or -1 when the two are not neighbours */
+int net_body_step(SnakePoint a, SnakePoint b);
+/* collision_next_head without signed overflow on hostile coordinates */
+SnakePoint net_body_follow(SnakePoint pt, unsigned int dir);
+/* Body as u8 encoding, u16 length, head, then one 2-bit move per further segment (four per byte, first move in the high
+   bits) or raw coordinates when the body is not contiguous. NET_BODY_MAX_PACKED bounds the output. */
+#define NET_BODY_MOVES 0
+#define NET_BODY_RAW 1
+#define NET_BODY_MAX_PACKED(len) (3 + (size_t)(len) * 8)
+/* Packed state only: u16 length and the head, for a snake outside the receiver's interest (see NetInterest) */
+#define NET_BODY_SUMMARY 2
+unsigned char* net_remote_put_body(unsigned char* p, const SnakePoint* body, int len);
+/* Reads a body of at most SNAKE_BODY_MAX_LEN segments into `body`; false when truncated, longer or malformed */
+bool net_remote_get_body(NetReader* r, SnakePoint* body, int* len_out);
+/* The move form on its own: the n - 1 steps along pts[0..n), which must be contiguous, and reading `n` steps from
+   `from` into out[0..n) */
+unsigned char* net_put_moves(unsigned char* p, const SnakePoint* pts, int n);
+bool net_get_moves(NetReader* r, SnakePoint from, SnakePoint* out, int n);
@@ -0,0 +1,133 @@
+#include "net_shaper.h"
+#include <stdlib.h>
+#include <string.h>
+#define SHAPER_MAX_DELAY_MS 60000
+#define SHAPER_MAX_KBPS 10000000
+typedef struct {
+uint64_t due;
+size_t len;
+char* data;
+} ShapedMsg;
+struct NetShaper {
+NetShaperConfig cfg;
+uint32_t rng;
+/* Queue sorted by `due`: live entries are [head, count) */
+ShapedMsg* q;
+size_t head;
+size_t count;
+size_t cap;
+/* When the simulated link finishes sending what it was given, and the latest release time handed out */
+uint64_t link_free;
+uint64_t last_due;
+NetShaperStats stats;
+};
+static int clamp_pct(int v) { return v < 0 ? 0 : (v > 100 ? 100 : v); }
+static int clamp_range(int v, int max) { return v < 0 ? 0 : (v > max ? max : v); }
+bool net_shaper_config_active(const NetShaperConfig* cfg) {
+return cfg && (cfg->delay_ms > 0 || cfg->jitter_ms > 0 || cfg->kbps > 0 || cfg->drop_pct > 0 || cfg->reorder_pct > 0);
+}
+NetShaper* net_shaper_create(const NetShaperConfig* cfg, uint32_t seed) {
+if(!cfg) return NULL;
+NetShaper* s= calloc(1, sizeof *s);
+if(!s) return NULL;
+s->cfg.delay_ms= clamp_range(cfg->delay_ms, SHAPER_MAX_DELAY_MS);
+s->cfg.jitter_ms= clamp_range(cfg->jitter_ms, SHAPER_MAX_DELAY_MS);
+s->cfg.kbps= clamp_range(cfg->kbps, SHAPER_MAX_KBPS);
+s->cfg.drop_pct= clamp_pct(cfg->drop_pct);
+s->cfg.reorder_pct= clamp_pct(cfg->reorder_pct);
+s->rng= seed ? seed : 0x9e3779b9u;
+return s;
+}
+void net_shaper_destroy(NetShaper* s) {
+if(!s) return;
+for(size_t i= s->head; i < s->count; i++) free(s->q[i].data);
+free(s->q);
+free(s);
+}
+/* xorshift32: reproducible for a given seed, which is what a test run wants */
+static uint32_t shaper_rand(NetShaper* s) {
+uint32_t x= s->rng;
+x^= x << 13;
+x^= x >> 17;
+x^= x << 5;
+s->rng= x;
+return x;
+}
+static bool shaper_roll(NetShaper* s, int pct) { return pct > 0 && (int)(shaper_rand(s) % 100u) < pct; }
+/* Room for one more entry at the end, compacting consumed entries before growing */
+static bool shaper_reserve(NetShaper* s) {
+if(s->head > 0 && s->count == s->cap) {
+memmove(s->q, s->q + s->head, (s->count - s->head) * sizeof *s->q);
+s->count-= s->head;
+s->head= 0;
+}
+if(s->count < s->cap) return true;
+size_t cap= s->cap ? s->cap * 2 : 64;
+ShapedMsg* grown= realloc(s->q, cap * sizeof *grown);
+if(!grown) return false;
+s->q= grown;
+s->cap= cap;
+return true;
+}
+bool net_shaper_push(NetShaper* s, const char* data, size_t len, bool droppable, uint64_t now_ms) {
+if(!s || !data) return false;
+if(droppable && shaper_roll(s, s->cfg.drop_pct)) {
+s->stats.dropped++;
+return false;
+}
+if(!shaper_reserve(s)) return false;
+char* copy= malloc(len + 1);
+if(!copy) return false;
+memcpy(copy, data, len);
+copy[len]= '\0';
+/* Serialization: the link carries kbps bits per millisecond, one message after another */
+uint64_t start= s->link_free > now_ms ? s->link_free : now_ms;
+uint64_t tx= s->cfg.kbps ? ((uint64_t)len * 8u + (uint64_t)s->cfg.kbps - 1u) / (uint64_t)s->cfg.kbps : 0u;
+s->link_free= start + tx;
+int64_t delay= s->cfg.delay_ms;
+if(s->cfg.jitter_ms) delay+= (int64_t)(shaper_rand(s) % (2u * (uint32_t)s->cfg.jitter_ms + 1u)) - s->cfg.jitter_ms;
+uint64_t due= s->link_free + (uint64_t)(delay > 0 ? delay : 0);
+size_t at= s->count;
+if(droppable && s->count > s->head && shaper_roll(s, s->cfg.reorder_pct)) {
+/* Overtake the last queued message: go out no later than it, and no earlier than the one before it */
+at= s->count - 1;
+if(due > s->q[at].due) due= s->q[at].due;
+if(at > s->head && due < s->q[at - 1].due) due= s->q[at - 1].due;
+memmove(s->q + at + 1, s->q + at, sizeof *s->q);
+s->stats.reordered++;
+} else if(due < s->last_due) {
+/* In order: a message never leaves before the one queued ahead of it */
+due= s->last_due;
+}
+if(due > s->last_due) s->last_due= due;
+s->q[at]= (ShapedMsg){due, len, copy};
+s->count++;
+s->stats.queued++;
+if(s->count - s->head > s->stats.high_water_msgs) s->stats.high_water_msgs= s->count - s->head;
+return true;
+}
+const char* net_shaper_peek(const NetShaper* s, uint64_t now_ms, size_t* len_out) {
+if(!s || s->head == s->count || s->q[s->head].due > now_ms) return NULL;
+if(len_out) *len_out= s->q[s->head].len;
+return s->q[s->head].data;
+}
+void net_shaper_pop(NetShaper* s) {
+if(!s || s->head == s->count) return;
+free(s->q[s->head].data);
+s->head++;
+s->stats.released++;
+if(s->head == s->count) s->head= s->count= 0;
+}
+int net_shaper_timeout_ms(const NetShaper* s, uint64_t now_ms) {
+if(!s || s->head == s->count) return -1;
+uint64_t due= s->q[s->head].due;
+return due > now_ms ? (int)(due - now_ms) : 0;
+}
+int net_shaper_busy_ms(const NetShaper* s, uint64_t now_ms) { return (s && s->link_free > now_ms) ? (int)(s->link_free - now_ms) : 0; }
+void net_shaper_get_stats(const NetShaper* s, NetShaperStats* out) {
+if(!out) return;
+if(s)
+*out= s->stats;
+else
+memset(out, 0, sizeof *out);
+}
@@ -72,6 +72,9 @@ float wall_height_scale;
 float tail_height_scale;
 float wall_texture_scale;
 float floor_texture_scale;
+int target_fps;
+float render_scale_min, render_scale_max;
+int floor_reprojection;
 char wall_texture[PERSIST_TEXTURE_PATH_MAX];
 char floor_texture[PERSIST_TEXTURE_PATH_MAX];
 char key_left;
@@ -92,6 +95,18 @@ int mp_server_port;
 char mp_identifier[PERSIST_MP_IDENTIFIER_MAX];
 char mp_session[PERSIST_MP_SESSION_MAX];
 int mp_is_host;
+int mp_send_hz;
+int mp_tcp_nodelay;
+int mp_tcp_cork;
+int mp_predict_ticks;
+int mp_sim_delay_ms;
+int mp_sim_jitter_ms;
+int mp_sim_kbps;
+int mp_sim_drop_pct;
+int mp_sim_reorder_pct;
+int server_interest_radius;
+int server_interest_view;
+int server_interest_far_ticks;
 /* Headless mode: no TTY/SDL graphics */
 int headless;
 /* Autoplay mode: snake turns right every 3rd tick (testing) */
@@ -125,6 +140,10 @@ c->wall_height_scale= (float)PERSIST_CONFIG_DEFAULT_WALL_SCALE;
 c->tail_height_scale= (float)PERSIST_CONFIG_DEFAULT_TAIL_SCALE;
 c->wall_texture_scale= (float)PERSIST_CONFIG_DEFAULT_WALL_TEXTURE_SCALE;
 c->floor_texture_scale= (float)PERSIST_CONFIG_DEFAULT_FLOOR_TEXTURE_SCALE;
+c->target_fps= PERSIST_CONFIG_DEFAULT_TARGET_FPS;
+c->render_scale_min= (float)PERSIST_CONFIG_DEFAULT_RENDER_SCALE_MIN;
+c->render_scale_max= (float)PERSIST_CONFIG_DEFAULT_RENDER_SCALE_MAX;
+c->floor_reprojection= PERSIST_CONFIG_DEFAULT_FLOOR_REPROJECTION;
 snprintf(c->wall_texture, PERSIST_TEXTURE_PATH_MAX, PERSIST_CONFIG_DEFAULT_WALL_TEXTURE);
 snprintf(c->floor_texture, PERSIST_TEXTURE_PATH_MAX, "%s", PERSIST_CONFIG_DEFAULT_FLOOR_TEXTURE);
 c->key_left= PERSIST_CONFIG_DEFAULT_KEY_LEFT;
@@ -141,6 +160,11 @@ snprintf(c->mp_identifier, PERSIST_MP_IDENTIFIER_MAX, "%s", "67bdb04f-6e7c-4d76-
 /* Optional default session (empty = none) */
 c->mp_session[0]= '\0';
 c->mp_is_host= 1;
+c->mp_send_hz= PERSIST_CONFIG_DEFAULT_MP_SEND_HZ;
+c->mp_tcp_nodelay= 1;
+c->mp_tcp_cork= 0;
+c->mp_predict_ticks= PERSIST_CONFIG_DEFAULT_MP_PREDICT_TICKS;
+c->server_interest_far_ticks= PERSIST_CONFIG_DEFAULT_SERVER_INTEREST_FAR_TICKS;
 /* default per-player bindings to match input defaults; use centralized macros */
 if(SNAKE_MAX_PLAYERS >= 1) {
 c->key_left_arr[0]= PERSIST_CONFIG_DEFAULT_KEY_LEFT;
@@ -268,6 +292,22 @@ void game_config_set_floor_texture_scale(GameConfig* cfg, float v) {
 if(cfg) cfg->floor_texture_scale= v;
 }
 float game_config_get_floor_texture_scale(const GameConfig* cfg) { return cfg ? cfg->floor_texture_scale : 1.0f; }
+void game_config_set_target_fps(GameConfig* cfg, int fps) {
+if(cfg) cfg->target_fps= clamp_int(fps, 0, 1000);
+}
+int game_config_get_target_fps(const GameConfig* cfg) { return cfg ? cfg->target_fps : 0; }
+void game_config_set_render_scale_min(GameConfig* cfg, float v) {
+if(cfg) cfg->render_scale_min= v;
+}
+float game_config_get_render_scale_min(const GameConfig* cfg) { return cfg ? cfg->render_scale_min : 1.0f; }
+void game_config_set_render_scale_max(GameConfig* cfg, float v) {
+if(cfg) cfg->render_scale_max= v;
+}
+float game_config_get_render_scale_max(const GameConfig* cfg) { return cfg ? cfg->render_scale_max : 1.0f; }
+void game_config_set_floor_reprojection(GameConfig* cfg, int v) {
+if(cfg) cfg->floor_reprojection= (v != 0) ? 1 : 0;
+}
+int game_config_get_floor_reprojection(const GameConfig* cfg) { return cfg ? cfg->floor_reprojection : 0; }
 void game_config_set_wall_texture(GameConfig* cfg, const char* path) {
 if(!cfg || !path) return;
 snprintf(cfg->wall_texture, PERSIST_TEXTURE_PATH_MAX, "%s", path);
@@ -367,6 +407,54 @@ snprintf(cfg->mp_session, PERSIST_MP_SESSION_MAX, "%s", session);
 }
 const char* game_config_get_mp_session(const GameConfig* cfg) { return cfg ? cfg->mp_session : NULL; }
 int game_config_get_mp_is_host(const GameConfig* cfg) { return cfg ? cfg->mp_is_host : 1; }
+void game_config_set_mp_send_hz(GameConfig* cfg, int hz) {
+if(cfg) cfg->mp_send_hz= clamp_int(hz, 0, 1000);
+}
+int game_config_get_mp_send_hz(const GameConfig* cfg) { return cfg ? cfg->mp_send_hz : 0; }
+void game_config_set_mp_tcp_nodelay(GameConfig* cfg, int v) {
+if(cfg) cfg->mp_tcp_nodelay= v ? 1 : 0;
+}
+int game_config_get_mp_tcp_nodelay(const GameConfig* cfg) { return cfg ? cfg->mp_tcp_nodelay : 1; }
+void game_config_set_mp_tcp_cork(GameConfig* cfg, int v) {
+if(cfg) cfg->mp_tcp_cork= v ? 1 : 0;
+}
+int game_config_get_mp_tcp_cork(const GameConfig* cfg) { return cfg ? cfg->mp_tcp_cork : 0; }
+void game_config_set_mp_predict_ticks(GameConfig* cfg, int ticks) {
+if(cfg) cfg->mp_predict_ticks= clamp_int(ticks, 0, 8);
+}
+int game_config_get_mp_predict_ticks(const GameConfig* cfg) { return cfg ? cfg->mp_predict_ticks : 0; }
+void game_config_set_mp_sim_delay_ms(GameConfig* cfg, int v) {
+if(cfg) cfg->mp_sim_delay_ms= clamp_int(v, 0, 60000);
+}
+int game_config_get_mp_sim_delay_ms(const GameConfig* cfg) { return cfg ? cfg->mp_sim_delay_ms : 0; }
+void game_config_set_mp_sim_jitter_ms(GameConfig* cfg, int v) {
+if(cfg) cfg->mp_sim_jitter_ms= clamp_int(v, 0, 60000);
+}
+int game_config_get_mp_sim_jitter_ms(const GameConfig* cfg) { return cfg ? cfg->mp_sim_jitter_ms : 0; }
+void game_config_set_mp_sim_kbps(GameConfig* cfg, int v) {
+if(cfg) cfg->mp_sim_kbps= clamp_int(v, 0, 10000000);
+}
+int game_config_get_mp_sim_kbps(const GameConfig* cfg) { return cfg ? cfg->mp_sim_kbps : 0; }
+void game_config_set_mp_sim_drop_pct(GameConfig* cfg, int v) {
+if(cfg) cfg->mp_sim_drop_pct= clamp_int(v, 0, 100);
+}
+int game_config_get_mp_sim_drop_pct(const GameConfig* cfg) { return cfg ? cfg->mp_sim_drop_pct : 0; }
+void game_config_set_mp_sim_reorder_pct(GameConfig* cfg, int v) {
+if(cfg) cfg->mp_sim_reorder_pct= clamp_int(v, 0, 100);
+}
+int game_config_get_mp_sim_reorder_pct(const GameConfig* cfg) { return cfg ? cfg->mp_sim_reorder_pct : 0; }
+void game_config_set_server_interest_radius(GameConfig* cfg, int v) {
+if(cfg) cfg->server_interest_radius= clamp_int(v, 0, 1000);
+}
+int game_config_get_server_interest_radius(const GameConfig* cfg) { return cfg ? cfg->server_interest_radius : 0; }
+void game_config_set_server_interest_view(GameConfig* cfg, int v) {
+if(cfg) cfg->server_interest_view= clamp_int(v, 0, 1000);
+}
+int game_config_get_server_interest_view(const GameConfig* cfg) { return cfg ? cfg->server_interest_view : 0; }
+void game_config_set_server_interest_far_ticks(GameConfig* cfg, int v) {
+if(cfg) cfg->server_interest_far_ticks= clamp_int(v, 0, 1000);
+}
+int game_config_get_server_interest_far_ticks(const GameConfig* cfg) { return cfg ? cfg->server_interest_far_ticks : 0; }
 void game_config_set_headless(GameConfig* cfg, int v) {
 if(!cfg) return;
 cfg->headless= v ? 1 : 0;
@@ -518,6 +606,15 @@ if(scores[i]) highscore_destroy(scores[i]);
 }
 free(scores);
 }
+/* Parses a decimal integer setting, saturated to the int range; the setter then clamps it to the key's own range */
+static bool parse_config_int(const char* value, int* out) {
+char* endptr= NULL;
+errno= 0;
+long v= strtol(value, &endptr, 10);
+if(errno != 0 || endptr == value) return false;
+*out= v > INT_MAX ? INT_MAX : (v < INT_MIN ? INT_MIN : (int)v);
+return true;
+}
 static void parse_graphics_config(GameConfig* config, const char* key, char* value) {
 if(strcmp(key, "render_glyphs") == 0 || strcmp(key, "glyphs") == 0 || strcmp(key, "charset") == 0) {
 if(isdigit((unsigned char)value[0])) {
@@ -563,6 +660,25 @@ char* endptr= NULL;
 errno= 0;
 double dv= strtod(value, &endptr);
 if(errno == 0 && endptr != value) config->floor_texture_scale= (float)dv;
+} else if(strcmp(key, "target_fps") == 0) {
+int v;
+if(parse_config_int(value, &v)) game_config_set_target_fps(config, v);
+} else if(strcmp(key, "render_scale_min") == 0) {
+char* endptr= NULL;
+errno= 0;
+double dv= strtod(value, &endptr);
+if(errno == 0 && endptr != value) config->render_scale_min= (float)dv;
+} else if(strcmp(key, "render_scale_max") == 0) {
+char* endptr= NULL;
+errno= 0;
+double dv= strtod(value, &endptr);
+if(errno == 0 && endptr != value) config->render_scale_max= (float)dv;
+} else if(strcmp(key, "floor_reprojection") == 0) {
+for(char* p= value; *p; p++) *p= (char)tolower((unsigned char)*p);
+if(strcmp(value, "true") == 0 || strcmp(value, "yes") == 0 || strcmp(value, "1") == 0)
+config->floor_reprojection= 1;
+else if(strcmp(value, "false") == 0 || strcmp(value, "no") == 0 || strcmp(value, "0") == 0)
+config->floor_reprojection= 0;
 } else if(strcmp(key, "wall_texture") == 0) {
 snprintf(config->wall_texture, PERSIST_TEXTURE_PATH_MAX, "%s", value);
 } else if(strcmp(key, "floor_texture") == 0) {
@@ -634,6 +750,43 @@ if(strcmp(value, "true") == 0 || strcmp(value, "yes") == 0 || strcmp(value, "1")
 config->mp_is_host= 1;
 else if(strcmp(value, "false") == 0 || strcmp(value, "no") == 0 || strcmp(value, "0") == 0)
 config->mp_is_host= 0;
+} else if(strcmp(key, "mp_send_hz") == 0) {
+int v;
+if(parse_config_int(value, &v)) game_config_set_mp_send_hz(config, v);
+} else if(strcmp(key, "mp_predict_ticks") == 0) {
+int v;
+if(parse_config_int(value, &v)) game_config_set_mp_predict_ticks(config, v);
+} else if(strcmp(key, "mp_sim_delay_ms") == 0) {
+int v;
+if(parse_config_int(value, &v)) game_config_set_mp_sim_delay_ms(config, v);
+} else if(strcmp(key, "mp_sim_jitter_ms") == 0) {
+int v;
+if(parse_config_int(value, &v)) game_config_set_mp_sim_jitter_ms(config, v);
+} else if(strcmp(key, "mp_sim_kbps") == 0) {
+int v;
+if(parse_config_int(value, &v)) game_config_set_mp_sim_kbps(config, v);
+} else if(strcmp(key, "mp_sim_drop_pct") == 0) {
+int v;
+if(parse_config_int(value, &v)) game_config_set_mp_sim_drop_pct(config, v);
+} else if(strcmp(key, "mp_sim_reorder_pct") == 0) {
+int v;
+if(parse_config_int(value, &v)) game_config_set_mp_sim_reorder_pct(config, v);
+} else if(strcmp(key, "server_interest_radius") == 0) {
+int v;
+if(parse_config_int(value, &v)) game_config_set_server_interest_radius(config, v);
+} else if(strcmp(key, "server_interest_view") == 0) {
+int v;
+if(parse_config_int(value, &v)) game_config_set_server_interest_view(config, v);
+} else if(strcmp(key, "server_interest_far_ticks") == 0) {
+int v;
+if(parse_config_int(value, &v)) game_config_set_server_interest_far_ticks(config, v);
+} else if(strcmp(key, "mp_tcp_nodelay") == 0 || strcmp(key, "mp_tcp_cork") == 0) {
+int* flag= (strcmp(key, "mp_tcp_nodelay") == 0) ? &config->mp_tcp_nodelay : &config->mp_tcp_cork;
+for(char* p= value; *p; p++) *p= (char)tolower((unsigned char)*p);
+if(strcmp(value, "true") == 0 || strcmp(value, "yes") == 0 || strcmp(value, "1") == 0)
+*flag= 1;
+else if(strcmp(value, "false") == 0 || strcmp(value, "no") == 0 || strcmp(value, "0") == 0)
+*flag= 0;
 }
 }
 static void parse_legacy_keys(GameConfig* config, const char* key, char* value) {
@@ -742,6 +895,10 @@ if(fprintf(fp, "max_food=%d\n", config->max_food) < 0) goto write_fail;
 if(fprintf(fp, "wall_height_scale=%.2f\n", config->wall_height_scale) < 0) goto write_fail;
 if(fprintf(fp, "wall_texture_scale=%.2f\n", config->wall_texture_scale) < 0) goto write_fail;
 if(fprintf(fp, "floor_texture_scale=%.2f\n", config->floor_texture_scale) < 0) goto write_fail;
+if(fprintf(fp, "target_fps=%d\n", config->target_fps) < 0) goto write_fail;
+if(fprintf(fp, "render_scale_min=%.2f\n", config->render_scale_min) < 0) goto write_fail;
+if(fprintf(fp, "render_scale_max=%.2f\n", config->render_scale_max) < 0) goto write_fail;
+if(fprintf(fp, "floor_reprojection=%s\n", config->floor_reprojection ? "true" : "false") < 0) goto write_fail;
 if(fprintf(fp, "wall_texture=%s\n", config->wall_texture) < 0) goto write_fail;
 if(fprintf(fp, "floor_texture=%s\n", config->floor_texture) < 0) goto write_fail;
 if(fprintf(fp, "key_left=%c\n", config->key_left) < 0) goto write_fail;
@@ -752,6 +909,18 @@ if(fprintf(fp, "mp_server_port=%d\n", config->mp_server_port) < 0) goto write_fa
 if(fprintf(fp, "mp_identifier=%s\n", config->mp_identifier) < 0) goto write_fail;
 if(fprintf(fp, "mp_session=%s\n", config->mp_session) < 0) goto write_fail;
 if(fprintf(fp, "mp_is_host=%s\n", (config->mp_is_host ? "true" : "false")) < 0) goto write_fail;
+if(fprintf(fp, "mp_send_hz=%d\n", config->mp_send_hz) < 0) goto write_fail;
+if(fprintf(fp, "mp_tcp_nodelay=%s\n", (config->mp_tcp_nodelay ? "true" : "false")) < 0) goto write_fail;
+if(fprintf(fp, "mp_tcp_cork=%s\n", (config->mp_tcp_cork ? "true" : "false")) < 0) goto write_fail;
+if(fprintf(fp, "mp_predict_ticks=%d\n", config->mp_predict_ticks) < 0) goto write_fail;
+if(fprintf(fp, "mp_sim_delay_ms=%d\n", config->mp_sim_delay_ms) < 0) goto write_fail;
+if(fprintf(fp, "mp_sim_jitter_ms=%d\n", config->mp_sim_jitter_ms) < 0) goto write_fail;
+if(fprintf(fp, "mp_sim_kbps=%d\n", config->mp_sim_kbps) < 0) goto write_fail;
+if(fprintf(fp, "mp_sim_drop_pct=%d\n", config->mp_sim_drop_pct) < 0) goto write_fail;
+if(fprintf(fp, "mp_sim_reorder_pct=%d\n", config->mp_sim_reorder_pct) < 0) goto write_fail;
+if(fprintf(fp, "server_interest_radius=%d\n", config->server_interest_radius) < 0) goto write_fail;
+if(fprintf(fp, "server_interest_view=%d\n", config->server_interest_view) < 0) goto write_fail;
+if(fprintf(fp, "server_interest_far_ticks=%d\n", config->server_interest_far_ticks) < 0) goto write_fail;
 if(fprintf(fp, "key_right=%c\n", config->key_right) < 0) goto write_fail;
 /* write per-player bindings for players 2..max_players using p{N}_left/right */
 for(int p= 1; p < config->max_players; ++p) {
@@ -836,6 +1005,10 @@ if(strcmp(key, "wall_height_scale") == 0) return true;
 if(strcmp(key, "tail_height_scale") == 0) return true;
 if(strcmp(key, "wall_texture_scale") == 0) return true;
 if(strcmp(key, "floor_texture_scale") == 0) return true;
+if(strcmp(key, "target_fps") == 0) return true;
+if(strcmp(key, "render_scale_min") == 0) return true;
+if(strcmp(key, "render_scale_max") == 0) return true;
+if(strcmp(key, "floor_reprojection") == 0) return true;
 if(strcmp(key, "wall_texture") == 0) return true;
 if(strcmp(key, "floor_texture") == 0) return true;
 /* Accept legacy key_left, key_right optionally suffixed with _N (player index 1-based) */
@@ -1,4 +1,5 @@
 #include "tty.h"
+#include "trace.h"
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
@@ -268,8 +269,7 @@ if(!ctx) return;
 struct ascii_pixel default_pixel= PIXEL_MAKE(' ', COLOR_DEFAULT_FG, COLOR_DEFAULT_BG);
 for(int i= 0; i < ctx->width * ctx->height; i++) ctx->front[i]= default_pixel;
 }
-void tty_flip(tty_context* ctx) {
-if(!ctx || !ctx->dirty) return;
+static void tty_flip_spans(tty_context* ctx) {
 char* buf= ctx->write_buffer;
 size_t pos= 0;
 size_t remaining= ctx->write_buffer_size;
@@ -339,6 +339,12 @@ ssize_t written= write(ctx->tty_fd, buf, pos);
 (void)written;
 ctx->dirty= false;
 }
+void tty_flip(tty_context* ctx) {
+if(!ctx || !ctx->dirty) return;
+TRACE_BEGIN("tty_flip");
+tty_flip_spans(ctx);
+TRACE_END("tty_flip");
+}
 void tty_force_redraw(tty_context* ctx) {
 if(!ctx) return;
 memset(ctx->front, 0, (size_t)ctx->width * (size_t)ctx->height * sizeof(struct ascii_pixel));
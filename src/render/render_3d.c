@@ -10,9 +10,12 @@
 #include "render_3d_sdl.h"
 #include "render_3d_sprite.h"
 #include "render_3d_texture.h"
+#include "render_3d_timing.h"
+#include "trace.h"
 #include "types.h"
 #include <ctype.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -32,7 +35,25 @@ typedef struct {
 short count;
 short ids[16];
 } TileBucket;
-typedef struct {
+/* Floor reprojection: a cached row is shifted into place while every reused pixel lands within this of its true texel */
+#define RENDER_3D_REPROJECT_MAX_ERROR_TEXELS 0.5f
+#define RENDER_3D_REPROJECT_MAX_CHANGED 64
+/* Textures and sprite lighting shared by every context created from the same config; freed with the last reference */
+struct Render3DShared {
+pthread_mutex_t lock;
+int refs;
+Texture3D* texture;
+Texture3D* wall_texture;
+Texture3D* floor_texture;
+/* Built before the block is handed out and only read afterwards, so viewport threads share it without locking */
+SpriteLighting lighting;
+};
+struct Render3DContext {
+Render3DShared* shared;
+/* Per-viewport child contexts, created on first use by render_3d_render_viewports */
+Render3DContext* views[RENDER_3D_MAX_VIEWPORTS];
+/* Threads for the other viewports of a parallel render_3d_render_viewports, started on first use and kept */
+struct Render3DWorkers* workers;
 const GameState* game_state;
 Camera3D* camera;
 Raycaster3D* raycaster;
@@ -48,11 +69,14 @@ float* column_depths;
 float frame_times[60];
 int frame_time_idx;
 float current_fps;
+/* Dynamic resolution: fraction of the window actually rendered, driven by a moving average of render cost */
+float render_scale;
+float render_cost_avg_ms;
+int render_scale_cooldown;
 float* cos_offsets;
 float* sin_offsets;
 int offsets_cap;
 /* Cached env_bool flags (avoid per-frame getenv) */
-int cached_debug_timing;
 int cached_fast_wall_tex;
 int cached_fast_floor_tex;
 int cached_debug_textures;
@@ -62,7 +86,20 @@ Decal* decal_pool;
 int decal_pool_cap;
 TileBucket* bucket_pool;
 int bucket_pool_cap;
-} Render3DContext;
+/* Floor reprojection: floor-only copy of recent frames and the world span (left x, y, step x, y) each row sampled */
+uint32_t* floor_cache;
+float* floor_row_span;
+int floor_cache_w, floor_cache_h;
+float floor_cache_wall_scale, floor_cache_tex_scale;
+bool floor_cache_fast_tex;
+bool floor_cache_valid;
+int floor_rows_reused; /* last frame */
+/* Per-cell decal signatures; cells whose shadows changed this frame force the rows crossing them to resample */
+uint32_t* cell_sig;
+int cell_sig_cap;
+int changed_cells[RENDER_3D_REPROJECT_MAX_CHANGED];
+int changed_count;
+};
 static Render3DContext g_render_3d= {0};
 /* Return a darker version of `col` by `pct` percent (pct in 0..100). */
 static uint32_t render_3d_shade_color(uint32_t col, int pct) {
@@ -197,41 +234,95 @@ tmp.display= ctx;
 tmp.game_state= gs;
 render_3d_draw_minimap(&tmp, 0.0f);
 }
-static void render_3d_update_fps(float delta_seconds) {
+static void render_3d_update_fps(Render3DContext* r, float delta_seconds) {
 if(delta_seconds <= 0.0f) return;
-g_render_3d.frame_times[g_render_3d.frame_time_idx]= delta_seconds;
-g_render_3d.frame_time_idx= (g_render_3d.frame_time_idx + 1) % 60;
+r->frame_times[r->frame_time_idx]= delta_seconds;
+r->frame_time_idx= (r->frame_time_idx + 1) % 60;
 float avg_time= 0.0f;
-for(int i= 0; i < 60; i++) { avg_time+= g_render_3d.frame_times[i]; }
+for(int i= 0; i < 60; i++) { avg_time+= r->frame_times[i]; }
 avg_time/= 60.0f;
-g_render_3d.current_fps= (avg_time > 0.0f) ? (1.0f / avg_time) : 0.0f;
+r->current_fps= (avg_time > 0.0f) ? (1.0f / avg_time) : 0.0f;
+}
+#define RENDER_3D_SCALE_STEP 0.05f
+#define RENDER_3D_SCALE_COOLDOWN_FRAMES 15
+static void render_3d_scale_bounds(const Render3DConfig* c, float* lo, float* hi) {
+*lo= c->render_scale_min;
+*hi= c->render_scale_max;
+if(!(*hi <= 1.0f)) *hi= 1.0f;
+if(!(*hi >= 0.1f)) *hi= 0.1f;
+if(!(*lo >= 0.1f)) *lo= 0.1f;
+if(*lo > *hi) *lo= *hi;
+}
+static void render_3d_apply_render_scale(Render3DContext* r, float scale) {
+int w= (int)((float)render_3d_sdl_get_max_width(r->display) * scale + 0.5f);
+int h= (int)((float)render_3d_sdl_get_max_height(r->display) * scale + 0.5f);
+if(render_3d_sdl_set_render_size(r->display, w, h)) projection_init(r->projector, render_3d_sdl_get_width(r->display), render_3d_sdl_get_height(r->display), r->config.fov_degrees * 3.14159265359f / 180.0f, r->config.wall_height_scale);
+r->render_scale= scale;
+}
+/* Step the render scale toward the target_fps budget. Only the CPU cost of drawing and handing off the frame is
+   measured, since that is what the scale controls; time spent waiting on the game loop or vsync is not. */
+static void render_3d_update_render_scale(Render3DContext* r, float cost_ms) {
+if(r->config.target_fps <= 0 || !r->display) return;
+r->render_cost_avg_ms= r->render_cost_avg_ms > 0.0f ? r->render_cost_avg_ms * 0.9f + cost_ms * 0.1f : cost_ms;
+if(r->render_scale_cooldown > 0) {
+r->render_scale_cooldown--;
+return;
 }
-static void render_3d_draw_fps_counter(void) {
-if(!g_render_3d.display) return;
+float lo, hi;
+render_3d_scale_bounds(&r->config, &lo, &hi);
+float budget= 1000.0f / (float)r->config.target_fps;
+float scale= r->render_scale;
+/* Hysteresis band: grow only with clear headroom, since cost rises with the square of the scale */
+if(r->render_cost_avg_ms > budget) scale-= RENDER_3D_SCALE_STEP;
+else if(r->render_cost_avg_ms < budget * 0.7f) scale+= RENDER_3D_SCALE_STEP;
+if(scale < lo) scale= lo;
+if(scale > hi) scale= hi;
+if(scale == r->render_scale) return;
+render_3d_apply_render_scale(r, scale);
+r->render_scale_cooldown= RENDER_3D_SCALE_COOLDOWN_FRAMES;
+}
+static void render_3d_draw_fps_counter(Render3DContext* r) {
+if(!r->display) return;
 char fps_buf[32];
-snprintf(fps_buf, sizeof(fps_buf), "FPS: %.1f", g_render_3d.current_fps);
+snprintf(fps_buf, sizeof(fps_buf), "FPS: %.1f", r->current_fps);
 uint32_t fps_color= render_3d_sdl_color(0, 255, 0, 255);
-render_3d_draw_char(g_render_3d.display, 4, 4, 'F', fps_color, 1);
-render_3d_draw_char(g_render_3d.display, 10, 4, 'P', fps_color, 1);
-render_3d_draw_char(g_render_3d.display, 16, 4, 'S', fps_color, 1);
-render_3d_draw_char(g_render_3d.display, 22, 4, ':', fps_color, 1);
+render_3d_draw_char(r->display, 4, 4, 'F', fps_color, 1);
+render_3d_draw_char(r->display, 10, 4, 'P', fps_color, 1);
+render_3d_draw_char(r->display, 16, 4, 'S', fps_color, 1);
+render_3d_draw_char(r->display, 22, 4, ':', fps_color, 1);
 int x= 28;
-int int_part= (int)g_render_3d.current_fps;
-int frac_part= (int)((g_render_3d.current_fps - (float)int_part) * 10.0f);
+int int_part= (int)r->current_fps;
+int frac_part= (int)((r->current_fps - (float)int_part) * 10.0f);
 if(int_part >= 100) {
-render_3d_draw_char(g_render_3d.display, x, 4, (char)('0' + (int_part / 100)), fps_color, 1);
+render_3d_draw_char(r->display, x, 4, (char)('0' + (int_part / 100)), fps_color, 1);
 x+= 6;
 int_part%= 100;
 }
-if(int_part >= 10 || (int)g_render_3d.current_fps >= 10) {
-render_3d_draw_char(g_render_3d.display, x, 4, (char)('0' + (int_part / 10)), fps_color, 1);
+if(int_part >= 10 || (int)r->current_fps >= 10) {
+render_3d_draw_char(r->display, x, 4, (char)('0' + (int_part / 10)), fps_color, 1);
 x+= 6;
 }
-render_3d_draw_char(g_render_3d.display, x, 4, (char)('0' + (int_part % 10)), fps_color, 1);
+render_3d_draw_char(r->display, x, 4, (char)('0' + (int_part % 10)), fps_color, 1);
+x+= 6;
+render_3d_draw_char(r->display, x, 4, '.', fps_color, 1);
+x+= 6;
+render_3d_draw_char(r->display, x, 4, (char)('0' + frac_part), fps_color, 1);
+if(r->config.target_fps <= 0) return;
+/* Second line: render scale in percent of the window */
+int pct= (int)(r->render_scale * 100.0f + 0.5f);
+render_3d_draw_char(r->display, 4, 13, 'R', fps_color, 1);
+render_3d_draw_char(r->display, 10, 13, 'E', fps_color, 1);
+render_3d_draw_char(r->display, 16, 13, 'S', fps_color, 1);
+x= 28;
+if(pct >= 100) {
+render_3d_draw_char(r->display, x, 13, (char)('0' + (pct / 100) % 10), fps_color, 1);
 x+= 6;
-render_3d_draw_char(g_render_3d.display, x, 4, '.', fps_color, 1);
+}
+if(pct >= 10) {
+render_3d_draw_char(r->display, x, 13, (char)('0' + (pct / 10) % 10), fps_color, 1);
 x+= 6;
-render_3d_draw_char(g_render_3d.display, x, 4, (char)('0' + frac_part), fps_color, 1);
+}
+render_3d_draw_char(r->display, x, 13, (char)('0' + pct % 10), fps_color, 1);
 }
 static const uint8_t font5x7_A_Z[][7]= {
     {0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11},
@@ -290,7 +381,9 @@ return;
 uint32_t* pix= render_3d_sdl_get_pixels(disp);
 int w= render_3d_sdl_get_width(disp);
 int h= render_3d_sdl_get_height(disp);
+int pitch= render_3d_sdl_get_pitch(disp);
 if(!pix) return;
+render_3d_sdl_mark_dirty(disp, x, y, 5 * scale, 7 * scale);
 for(int row= 0; row < 7; row++) {
 uint8_t bits= glyph[row];
 for(int colbit= 0; colbit < 5; colbit++) {
@@ -299,7 +392,7 @@ int px= x + colbit * scale;
 int py= y + row * scale;
 for(int yy= 0; yy < scale; yy++) {
 if(py + yy < 0 || py + yy >= h) continue;
-uint32_t* row_pix= &pix[(py + yy) * w];
+uint32_t* row_pix= &pix[(py + yy) * pitch];
 for(int xx= 0; xx < scale; xx++) {
 if(px + xx < 0 || px + xx >= w) continue;
 row_pix[px + xx]= col;
@@ -401,6 +494,99 @@ int cell_px= target / max_dim;
 if(cell_px < MINIMAP_MIN_CELL_PIXELS) cell_px= MINIMAP_MIN_CELL_PIXELS;
 return cell_px;
 }
+static void render_3d_default_config(Render3DConfig* c) {
+c->active_player= 0;
+c->fov_degrees= 90.0f;
+c->show_sprite_debug= false;
+c->screen_width= 800;
+c->screen_height= 600;
+c->wall_height_scale= (float)PERSIST_CONFIG_DEFAULT_WALL_SCALE;
+c->tail_height_scale= (float)PERSIST_CONFIG_DEFAULT_TAIL_SCALE;
+c->target_fps= PERSIST_CONFIG_DEFAULT_TARGET_FPS;
+c->render_scale_min= (float)PERSIST_CONFIG_DEFAULT_RENDER_SCALE_MIN;
+c->render_scale_max= (float)PERSIST_CONFIG_DEFAULT_RENDER_SCALE_MAX;
+c->floor_reprojection= PERSIST_CONFIG_DEFAULT_FLOOR_REPROJECTION != 0;
+c->wall_texture_path[0]= '\0';
+c->floor_texture_path[0]= '\0';
+}
+Render3DShared* render_3d_shared_create(const Render3DConfig* config) {
+Render3DConfig defaults;
+if(!config) {
+render_3d_default_config(&defaults);
+config= &defaults;
+}
+Render3DShared* sh= calloc(1, sizeof *sh);
+if(!sh) return NULL;
+if(pthread_mutex_init(&sh->lock, NULL) != 0) {
+free(sh);
+return NULL;
+}
+sh->refs= 1;
+sprite_lighting_build(&sh->lighting);
+sh->texture= texture_create();
+sh->wall_texture= texture_create();
+sh->floor_texture= texture_create();
+if(!sh->texture || !sh->wall_texture || !sh->floor_texture) {
+render_3d_shared_release(sh);
+return NULL;
+}
+if(config->wall_texture_path[0]) {
+if(!texture_load_from_file(sh->wall_texture, config->wall_texture_path)) {
+fprintf(stderr,
+    "render_3d_init: failed to load %s (using procedural "
+    "fallback)\n",
+    config->wall_texture_path);
+}
+} else {
+if(!texture_load_from_file(sh->wall_texture, PERSIST_CONFIG_DEFAULT_WALL_TEXTURE)) {
+fprintf(stderr,
+    "render_3d_init: failed to load %s (using procedural "
+    "fallback)\n",
+    PERSIST_CONFIG_DEFAULT_WALL_TEXTURE);
+}
+}
+if(config->floor_texture_path[0]) {
+if(!texture_load_from_file(sh->floor_texture, config->floor_texture_path)) { fprintf(stderr, "render_3d_init: failed to load %s (using flat floor color)\n", config->floor_texture_path); }
+} else {
+if(!texture_load_from_file(sh->floor_texture, PERSIST_CONFIG_DEFAULT_FLOOR_TEXTURE)) { fprintf(stderr, "render_3d_init: failed to load %s (using flat floor color)\n", PERSIST_CONFIG_DEFAULT_FLOOR_TEXTURE); }
+}
+return sh;
+}
+void render_3d_shared_retain(Render3DShared* sh) {
+if(!sh) return;
+pthread_mutex_lock(&sh->lock);
+sh->refs++;
+pthread_mutex_unlock(&sh->lock);
+}
+void render_3d_shared_release(Render3DShared* sh) {
+if(!sh) return;
+pthread_mutex_lock(&sh->lock);
+int left= --sh->refs;
+pthread_mutex_unlock(&sh->lock);
+if(left > 0) return;
+texture_destroy(sh->texture);
+texture_destroy(sh->wall_texture);
+texture_destroy(sh->floor_texture);
+pthread_mutex_destroy(&sh->lock);
+free(sh);
+}
+/* Textures (retained from `shared`, or loaded privately when NULL) and the sprite renderer; camera and projector must already exist */
+static bool render_3d_load_resources(Render3DContext* r, Render3DShared* shared) {
+if(shared) {
+render_3d_shared_retain(shared);
+r->shared= shared;
+} else {
+r->shared= render_3d_shared_create(&r->config);
+}
+if(!r->shared) return false;
+r->texture= r->shared->texture;
+r->wall_texture= r->shared->wall_texture;
+r->floor_texture= r->shared->floor_texture;
+r->sprite_renderer= sprite_create(100, r->camera, r->projector);
+if(!r->sprite_renderer) return false;
+sprite_set_lighting(r->sprite_renderer, &r->shared->lighting);
+return true;
+}
 bool render_3d_init(const GameState* game_state, const Render3DConfig* config) {
 if(g_render_3d.initialized) return true;
 if(!game_state) return false;
@@ -408,15 +594,7 @@ g_render_3d.game_state= game_state;
 if(config) {
 g_render_3d.config= *config;
 } else {
-g_render_3d.config.active_player= 0;
-g_render_3d.config.fov_degrees= 90.0f;
-g_render_3d.config.show_sprite_debug= false;
-g_render_3d.config.screen_width= 800;
-g_render_3d.config.screen_height= 600;
-g_render_3d.config.wall_height_scale= (float)PERSIST_CONFIG_DEFAULT_WALL_SCALE;
-g_render_3d.config.tail_height_scale= (float)PERSIST_CONFIG_DEFAULT_TAIL_SCALE;
-g_render_3d.config.wall_texture_path[0]= '\0';
-g_render_3d.config.floor_texture_path[0]= '\0';
+render_3d_default_config(&g_render_3d.config);
 }
 {
 FILE* f= fopen("logs/debug_init.log", "a");
@@ -428,40 +606,25 @@ fclose(f);
 }
 g_render_3d.display= render_3d_sdl_create(g_render_3d.config.screen_width, g_render_3d.config.screen_height, g_render_3d.config.vsync);
 if(!g_render_3d.display) return false;
+/* Opt-in: it trades a frame of latency for overlapping the texture copy with drawing */
+if(env_bool("SNAKE_3D_ASYNC_PRESENT", 0)) (void)render_3d_sdl_set_async_present(g_render_3d.display, true);
 g_render_3d.camera= camera_create(g_render_3d.config.fov_degrees, g_render_3d.config.screen_width, 0.5f);
 if(!g_render_3d.camera) return false;
 g_render_3d.raycaster= raycaster_create(game_state->width, game_state->height, NULL);
 if(!g_render_3d.raycaster) return false;
 g_render_3d.projector= projection_create(g_render_3d.config.screen_width, g_render_3d.config.screen_height, g_render_3d.config.fov_degrees * 3.14159265359f / 180.0f, g_render_3d.config.wall_height_scale);
 if(!g_render_3d.projector) return false;
-g_render_3d.texture= texture_create();
-g_render_3d.wall_texture= texture_create();
-g_render_3d.floor_texture= texture_create();
-if(!g_render_3d.texture || !g_render_3d.wall_texture || !g_render_3d.floor_texture) return false;
-if(g_render_3d.config.wall_texture_path[0]) {
-if(!texture_load_from_file(g_render_3d.wall_texture, g_render_3d.config.wall_texture_path)) {
-fprintf(stderr,
-    "render_3d_init: failed to load %s (using procedural "
-    "fallback)\n",
-    g_render_3d.config.wall_texture_path);
-}
-} else {
-if(!texture_load_from_file(g_render_3d.wall_texture, PERSIST_CONFIG_DEFAULT_WALL_TEXTURE)) {
-fprintf(stderr,
-    "render_3d_init: failed to load %s (using procedural "
-    "fallback)\n",
-    PERSIST_CONFIG_DEFAULT_WALL_TEXTURE);
-}
-}
-if(g_render_3d.config.floor_texture_path[0]) {
-if(!texture_load_from_file(g_render_3d.floor_texture, g_render_3d.config.floor_texture_path)) { fprintf(stderr, "render_3d_init: failed to load %s (using flat floor color)\n", g_render_3d.config.floor_texture_path); }
-} else {
-if(!texture_load_from_file(g_render_3d.floor_texture, PERSIST_CONFIG_DEFAULT_FLOOR_TEXTURE)) { fprintf(stderr, "render_3d_init: failed to load %s (using flat floor color)\n", PERSIST_CONFIG_DEFAULT_FLOOR_TEXTURE); }
-}
 g_render_3d.column_depths= calloc((size_t)render_3d_sdl_get_width(g_render_3d.display), sizeof(float));
 if(!g_render_3d.column_depths) return false;
-g_render_3d.sprite_renderer= sprite_create(100, g_render_3d.camera, g_render_3d.projector);
-if(!g_render_3d.sprite_renderer) return false;
+if(!render_3d_load_resources(&g_render_3d, NULL)) return false;
+g_render_3d.render_scale= 1.0f;
+g_render_3d.render_cost_avg_ms= 0.0f;
+g_render_3d.render_scale_cooldown= 0;
+if(g_render_3d.config.target_fps > 0) {
+float lo, hi;
+render_3d_scale_bounds(&g_render_3d.config, &lo, &hi);
+render_3d_apply_render_scale(&g_render_3d, hi);
+}
 g_render_3d.initialized= true;
 return true;
 }
@@ -472,7 +635,7 @@ if(wp) {
 for(int yy= 0; yy < 16; yy++) {
 for(int xx= 0; xx < 16; xx++) {
 uint32_t c= texture_sample(r->wall_texture, (float)xx / 16.0f, (float)yy / 16.0f, true);
-if(8 + xx >= 0 && 8 + xx < render_3d_sdl_get_width(r->display) && 8 + yy >= 0 && 8 + yy < render_3d_sdl_get_height(r->display)) render_3d_sdl_get_pixels(r->display)[(8 + yy) * render_3d_sdl_get_width(r->display) + (8 + xx)]= c;
+if(8 + xx >= 0 && 8 + xx < render_3d_sdl_get_width(r->display) && 8 + yy >= 0 && 8 + yy < render_3d_sdl_get_height(r->display)) render_3d_sdl_get_pixels(r->display)[(8 + yy) * render_3d_sdl_get_pitch(r->display) + (8 + xx)]= c;
 }
 }
 }
@@ -481,7 +644,7 @@ if(fp) {
 for(int yy= 0; yy < 16; yy++) {
 for(int xx= 0; xx < 16; xx++) {
 uint32_t c= texture_sample(r->floor_texture, (float)xx / 16.0f, (float)yy / 16.0f, true);
-if(8 + xx >= 0 && 8 + xx < render_3d_sdl_get_width(r->display) && 28 + yy >= 0 && 28 + yy < render_3d_sdl_get_height(r->display)) render_3d_sdl_get_pixels(r->display)[(28 + yy) * render_3d_sdl_get_width(r->display) + (8 + xx)]= c;
+if(8 + xx >= 0 && 8 + xx < render_3d_sdl_get_width(r->display) && 28 + yy >= 0 && 28 + yy < render_3d_sdl_get_height(r->display)) render_3d_sdl_get_pixels(r->display)[(28 + yy) * render_3d_sdl_get_pitch(r->display) + (8 + xx)]= c;
 }
 }
 }
@@ -550,10 +713,144 @@ if(b->count < (int)(sizeof(b->ids) / sizeof(b->ids[0]))) b->ids[b->count++]= (sh
 }
 *decal_count_out= decal_count;
 }
-static void render_3d_draw_floor_ceiling_pass(Render3DContext* r, int screen_w, int screen_h, int horizon, float interp_cam_x, float interp_cam_y, float cos_cam, float sin_cam, Decal* decals, TileBucket* buckets, int decal_count) {
+static uint32_t render_3d_float_bits(float f) {
+uint32_t u;
+memcpy(&u, &f, sizeof u);
+return u;
+}
+/* Diff per-cell decal signatures against the previous frame; changed_count is -1 when too many cells changed to track */
+static void render_3d_track_decal_changes(Render3DContext* r, const GameState* gs, const Decal* decals, const TileBucket* buckets) {
+int cells= gs->width * gs->height;
+r->changed_count= 0;
+if(!buckets || cells <= 0) {
+r->changed_count= -1;
+return;
+}
+if(cells != r->cell_sig_cap) {
+uint32_t* sig= realloc(r->cell_sig, (size_t)cells * sizeof *sig);
+if(!sig) {
+r->changed_count= -1;
+return;
+}
+r->cell_sig= sig;
+memset(sig, 0, (size_t)cells * sizeof *sig);
+r->cell_sig_cap= cells;
+r->floor_cache_valid= false;
+}
+for(int c= 0; c < cells; c++) {
+const TileBucket* b= &buckets[c];
+uint32_t h= (uint32_t)b->count;
+for(int i= 0; i < b->count; i++) {
+const Decal* d= &decals[b->ids[i]];
+h= h * 31u + render_3d_float_bits(d->x);
+h= h * 31u + render_3d_float_bits(d->y);
+h= h * 31u + render_3d_float_bits(d->radius);
+}
+if(h == r->cell_sig[c]) continue;
+r->cell_sig[c]= h;
+if(r->changed_count >= 0 && r->changed_count < RENDER_3D_REPROJECT_MAX_CHANGED) r->changed_cells[r->changed_count++]= c;
+else r->changed_count= -1;
+}
+}
+/* Slab test of the segment (x0,y0)-(x1,y1) against an axis-aligned box */
+static bool render_3d_segment_hits_box(float x0, float y0, float x1, float y1, float bx0, float by0, float bx1, float by1) {
+float t0= 0.0f, t1= 1.0f;
+float d[2]= {x1 - x0, y1 - y0}, o[2]= {x0, y0}, lo[2]= {bx0, by0}, hi[2]= {bx1, by1};
+for(int a= 0; a < 2; a++) {
+if(fabsf(d[a]) < 1e-9f) {
+if(o[a] < lo[a] || o[a] > hi[a]) return false;
+continue;
+}
+float ta= (lo[a] - o[a]) / d[a], tb= (hi[a] - o[a]) / d[a];
+if(ta > tb) {
+float t= ta;
+ta= tb;
+tb= t;
+}
+if(ta > t0) t0= ta;
+if(tb < t1) t1= tb;
+if(t0 > t1) return false;
+}
+return true;
+}
+/* (Re)size the floor cache and drop it whenever anything but the camera pose changed how the floor is sampled */
+static bool render_3d_prepare_floor_cache(Render3DContext* r, int screen_w, int screen_h, float wall_scale) {
+if(!r->config.floor_reprojection) {
+r->floor_cache_valid= false;
+return false;
+}
+if(r->floor_cache_w != screen_w || r->floor_cache_h != screen_h || !r->floor_cache) {
+free(r->floor_cache);
+free(r->floor_row_span);
+r->floor_cache= malloc((size_t)screen_w * (size_t)screen_h * sizeof *r->floor_cache);
+r->floor_row_span= malloc((size_t)screen_h * 4 * sizeof *r->floor_row_span);
+if(!r->floor_cache || !r->floor_row_span) {
+free(r->floor_cache);
+free(r->floor_row_span);
+r->floor_cache= NULL;
+r->floor_row_span= NULL;
+r->floor_cache_w= r->floor_cache_h= 0;
+r->floor_cache_valid= false;
+return false;
+}
+r->floor_cache_w= screen_w;
+r->floor_cache_h= screen_h;
+r->floor_cache_valid= false;
+}
+if(r->floor_cache_wall_scale != wall_scale || r->floor_cache_tex_scale != r->config.floor_texture_scale || r->floor_cache_fast_tex != (r->cached_fast_floor_tex != 0)) {
+r->floor_cache_wall_scale= wall_scale;
+r->floor_cache_tex_scale= r->config.floor_texture_scale;
+r->floor_cache_fast_tex= r->cached_fast_floor_tex != 0;
+r->floor_cache_valid= false;
+}
+/* Too many shadow changes to test row by row: resample everything this frame */
+if(r->changed_count < 0) r->floor_cache_valid= false;
+return true;
+}
+/* Whether the cached copy of a floor row, shifted by *shift_out columns, still samples within the error bound. The
+   row's world points are affine in the column, so the error is largest at the ends of the reused range. */
+static bool render_3d_floor_row_reusable(const Render3DContext* r, int y, float wx_l, float wy_l, float step_x, float step_y, int screen_w, float texels_x, float texels_y, int* shift_out) {
+const float* span= &r->floor_row_span[y * 4];
+float step_sq= span[2] * span[2] + span[3] * span[3];
+if(step_sq <= 0.0f) return false;
+/* Without a floor texture the sampling grid is the pixel footprint */
+if(texels_x <= 0.0f) texels_x= texels_y= 1.0f / sqrtf(step_sq);
+int last_x= screen_w - 1;
+float mid= 0.5f * (float)last_x;
+float ox= wx_l - span[0], oy= wy_l - span[1];
+float gx= step_x - span[2], gy= step_y - span[3];
+/* Whole columns the row slid sideways, measured at its centre */
+float slide= ((ox + mid * gx) * span[2] + (oy + mid * gy) * span[3]) / step_sq;
+if(fabsf(slide) > 0.25f * (float)screen_w) return false;
+int shift= (int)lroundf(slide);
+ox-= (float)shift * span[2];
+oy-= (float)shift * span[3];
+int x0= shift < 0 ? -shift : 0;
+int x1= shift > 0 ? last_x - shift : last_x;
+float ex0= ox + (float)x0 * gx, ey0= oy + (float)x0 * gy;
+float ex1= ox + (float)x1 * gx, ey1= oy + (float)x1 * gy;
+float err_x= fmaxf(fabsf(ex0), fabsf(ex1)), err_y= fmaxf(fabsf(ey0), fabsf(ey1));
+if(fmaxf(err_x * texels_x, err_y * texels_y) >= RENDER_3D_REPROJECT_MAX_ERROR_TEXELS) return false;
+/* Changed shadows under either the cached or the current stretch of floor force a resample */
+float margin= fmaxf(err_x, err_y);
+float cx_l= span[0], cy_l= span[1], cx_r= span[0] + (float)last_x * span[2], cy_r= span[1] + (float)last_x * span[3];
+float wx_r= wx_l + (float)last_x * step_x, wy_r= wy_l + (float)last_x * step_y;
+int map_w= r->game_state->width;
+for(int i= 0; i < r->changed_count; i++) {
+float cx= (float)(r->changed_cells[i] % map_w), cy= (float)(r->changed_cells[i] / map_w);
+if(render_3d_segment_hits_box(wx_l, wy_l, wx_r, wy_r, cx - margin, cy - margin, cx + 1.0f + margin, cy + 1.0f + margin)) return false;
+if(render_3d_segment_hits_box(cx_l, cy_l, cx_r, cy_r, cx - margin, cy - margin, cx + 1.0f + margin, cy + 1.0f + margin)) return false;
+}
+*shift_out= shift;
+return true;
+}
+static void render_3d_draw_floor_ceiling_pass(Render3DContext* r, int screen_w, int screen_h, int horizon, float interp_cam_x, float interp_cam_y, float interp_cam_angle, float cos_cam, float sin_cam, Decal* decals, TileBucket* buckets, int decal_count) {
 uint32_t floor_color= render_3d_sdl_color(139, 69, 19, 255);
 uint32_t ceiling_color= render_3d_sdl_color(65, 105, 225, 255);
+/* Floor and ceiling cover every pixel, so the whole frame is uploaded */
+render_3d_sdl_mark_all_dirty(r->display);
 uint32_t* pix= render_3d_sdl_get_pixels(r->display);
+const int pitch= render_3d_sdl_get_pitch(r->display);
 float wall_scale= projection_get_wall_scale(r->projector);
 const uint32_t* floor_pix= texture_get_pixels(r->floor_texture);
 int floor_w= texture_get_img_w(r->floor_texture);
@@ -562,9 +859,14 @@ float floor_tex_scale= r->config.floor_texture_scale;
 int map_w= r->game_state->width;
 int map_h= r->game_state->height;
 bool fast_floor_tex= r->cached_fast_floor_tex;
+bool reproject= render_3d_prepare_floor_cache(r, screen_w, screen_h, wall_scale);
+bool reuse_ok= reproject && r->floor_cache_valid;
+float texels_x= floor_pix ? floor_tex_scale * (float)floor_w : 0.0f;
+float texels_y= floor_pix ? floor_tex_scale * (float)floor_h_tex : 0.0f;
+r->floor_rows_reused= 0;
 for(int y= 0; y < screen_h; y++) {
 if(y < horizon) {
-uint32_t* row_pix= &pix[y * screen_w];
+uint32_t* row_pix= &pix[y * pitch];
 for(int x= 0; x < screen_w; x++) row_pix[x]= ceiling_color;
 continue;
 }
@@ -572,7 +874,7 @@ float p= (float)(y - horizon);
 if(p < 1.0f) p= 1.0f;
 float pos_z= 0.5f * (float)screen_h * wall_scale;
 float row_distance_center= pos_z / p;
-uint32_t* row_pix= &pix[y * screen_w];
+uint32_t* row_pix= &pix[y * pitch];
 /* DDA approach: compute world-space endpoints of this scanline */
 /* Leftmost ray (x=0) */
 float cos_a_left= cos_cam * r->cos_offsets[0] - sin_cam * r->sin_offsets[0];
@@ -593,9 +895,24 @@ float wy_right= interp_cam_y + sin_a_right * perp_right;
 /* Incremental step across scanline */
 float dx= (wx_right - wx_left) / (float)last_x;
 float dy= (wy_right - wy_left) / (float)last_x;
-float floor_x= wx_left;
-float floor_y= wy_left;
-for(int x= 0; x < screen_w; x++) {
+uint32_t* cache_row= reproject ? &r->floor_cache[(size_t)y * (size_t)screen_w] : NULL;
+/* Columns to sample; a reused row only samples the edge its shift uncovered and stays anchored to its cached span */
+int x_begin= 0, x_end= screen_w;
+uint32_t* store_row= cache_row;
+int shift= 0;
+if(reuse_ok && render_3d_floor_row_reusable(r, y, wx_left, wy_left, dx, dy, screen_w, texels_x, texels_y, &shift)) {
+int c0= shift < 0 ? -shift : 0;
+int c1= shift > 0 ? screen_w - shift : screen_w;
+memcpy(row_pix + c0, cache_row + c0 + shift, (size_t)(c1 - c0) * sizeof *row_pix);
+r->floor_rows_reused++;
+if(shift == 0) continue;
+x_begin= shift < 0 ? 0 : c1;
+x_end= shift < 0 ? c0 : screen_w;
+store_row= NULL;
+}
+float floor_x= wx_left + dx * (float)x_begin;
+float floor_y= wy_left + dy * (float)x_begin;
+for(int x= x_begin; x < x_end; x++) {
 uint32_t base_col;
 bool in_shadow= false;
 uint32_t shadow_factor_256= 256;
@@ -634,18 +951,27 @@ uint32_t blue= base_col & 0xFF;
 red= (red * shadow_factor_256) >> 8;
 green= (green * shadow_factor_256) >> 8;
 blue= (blue * shadow_factor_256) >> 8;
-row_pix[x]= (0xFFu << 24) | (red << 16) | (green << 8) | blue;
-} else {
-row_pix[x]= base_col;
+base_col= (0xFFu << 24) | (red << 16) | (green << 8) | blue;
 }
+row_pix[x]= base_col;
+if(store_row) store_row[x]= base_col;
 /* Increment floor position for next column */
 floor_x+= dx;
 floor_y+= dy;
 }
+if(store_row) {
+float* span= &r->floor_row_span[y * 4];
+span[0]= wx_left;
+span[1]= wy_left;
+span[2]= dx;
+span[3]= dy;
 }
 }
+if(reproject) r->floor_cache_valid= true;
+}
 static void render_3d_draw_walls_pass(Render3DContext* r, int screen_w, int screen_h, int horizon, float interp_cam_x, float interp_cam_y, float interp_cam_angle, float cos_cam, float sin_cam) {
 uint32_t* pix= render_3d_sdl_get_pixels(r->display);
+const int pitch= render_3d_sdl_get_pitch(r->display);
 const float* s_angle_offsets= camera_get_cached_angle_offsets(r->camera);
 const uint32_t* wall_pix= texture_get_pixels(r->wall_texture);
 int wall_w= texture_get_img_w(r->wall_texture);
@@ -678,14 +1004,14 @@ int ty_step_fixed= (int)(tex_v_coord_step * (float)wall_h_tex * (float)FRAC_ONE
 for(int yy= proj.draw_start; yy <= proj.draw_end; yy++) {
 int ty= (ty_fixed >> FRAC_BITS) % wall_h_tex;
 if(ty < 0) ty+= wall_h_tex;
-if(pix && yy >= 0 && yy < screen_h) pix[yy * screen_w + x]= wall_pix[ty * wall_w + tx];
+if(pix && yy >= 0 && yy < screen_h) pix[yy * pitch + x]= wall_pix[ty * wall_w + tx];
 ty_fixed+= ty_step_fixed;
 }
 } else {
 float tex_v_c= tex_v_start;
 for(int yy= proj.draw_start; yy <= proj.draw_end; yy++) {
 uint32_t col= texture_sample(r->wall_texture, tex_coord, tex_v_c, !fast_wall_tex);
-if(pix && yy >= 0 && yy < screen_h) pix[yy * screen_w + x]= col;
+if(pix && yy >= 0 && yy < screen_h) pix[yy * pitch + x]= col;
 tex_v_c+= tex_v_coord_step;
 }
 }
@@ -694,89 +1020,127 @@ r->column_depths[x]= INFINITY;
 }
 }
 }
-void render_3d_draw(const GameState* gs, const char* name, const void* sc, int scc, float dt) {
-(void)name;
-(void)sc;
-(void)scc;
-if(!g_render_3d.initialized || !gs) return;
-g_render_3d.game_state= gs;
-float c_dt= dt > 0.5f ? 0.5f : dt;
-if(!g_render_3d.env_cached) {
-g_render_3d.cached_debug_timing= env_bool("SNAKE_DEBUG_3D_TIMING", 0);
-g_render_3d.cached_fast_wall_tex= env_bool("SNAKE_3D_FAST_WALLS", 1);
-g_render_3d.cached_fast_floor_tex= env_bool("SNAKE_3D_FAST_FLOOR", 1);
-g_render_3d.cached_debug_textures= env_bool("SNAKE_DEBUG_TEXTURES", 0);
-g_render_3d.env_cached= true;
-}
-double t0= g_render_3d.cached_debug_timing ? render_3d_now() : 0.0;
-camera_update_interpolation(g_render_3d.camera, c_dt);
-render_3d_update_fps(dt);
-float f_interp= camera_get_interpolation_fraction(g_render_3d.camera);
-const int sw= render_3d_sdl_get_width(g_render_3d.display), sh= render_3d_sdl_get_height(g_render_3d.display);
+static void render_3d_cache_env(Render3DContext* r) {
+if(r->env_cached) return;
+r->cached_fast_wall_tex= env_bool("SNAKE_3D_FAST_WALLS", 1);
+r->cached_fast_floor_tex= env_bool("SNAKE_3D_FAST_FLOOR", 1);
+r->cached_debug_textures= env_bool("SNAKE_DEBUG_TEXTURES", 0);
+r->env_cached= true;
+}
+/* Draws one full frame into r->display without presenting; r->camera must already be interpolated */
+static void render_3d_draw_scene(Render3DContext* r, const GameState* gs, float c_dt) {
+float f_interp= camera_get_interpolation_fraction(r->camera);
+const int sw= render_3d_sdl_get_width(r->display), sh= render_3d_sdl_get_height(r->display);
 int horizon= sh / 2;
-camera_prepare_angle_offsets(g_render_3d.camera, sw);
-const float* offsets= camera_get_cached_angle_offsets(g_render_3d.camera);
-if(sw != g_render_3d.offsets_cap && offsets) {
-g_render_3d.cos_offsets= realloc(g_render_3d.cos_offsets, (size_t)sw * sizeof(float));
-g_render_3d.sin_offsets= realloc(g_render_3d.sin_offsets, (size_t)sw * sizeof(float));
+camera_prepare_angle_offsets(r->camera, sw);
+const float* offsets= camera_get_cached_angle_offsets(r->camera);
+if(sw != r->offsets_cap && offsets) {
+r->cos_offsets= realloc(r->cos_offsets, (size_t)sw * sizeof(float));
+r->sin_offsets= realloc(r->sin_offsets, (size_t)sw * sizeof(float));
 for(int i= 0; i < sw; i++) {
-g_render_3d.cos_offsets[i]= cosf(offsets[i]);
-g_render_3d.sin_offsets[i]= sinf(offsets[i]);
+r->cos_offsets[i]= cosf(offsets[i]);
+r->sin_offsets[i]= sinf(offsets[i]);
 }
-g_render_3d.offsets_cap= sw;
+r->offsets_cap= sw;
 }
-render_3d_draw_debug_overlays(&g_render_3d);
+render_3d_draw_debug_overlays(r);
 float icx, icy, ica;
-camera_get_interpolated_position(g_render_3d.camera, &icx, &icy);
-ica= camera_get_interpolated_angle(g_render_3d.camera);
+camera_get_interpolated_position(r->camera, &icx, &icy);
+ica= camera_get_interpolated_angle(r->camera);
 float cos_c= cosf(ica), sin_c= sinf(ica);
 Decal* d_p= NULL;
 TileBucket* b_p= NULL;
 int d_c= 0;
-render_3d_setup_floor_decals(&g_render_3d, gs, &d_p, &b_p, &d_c);
-render_3d_draw_floor_ceiling_pass(&g_render_3d, sw, sh, horizon, icx, icy, cos_c, sin_c, d_p, b_p, d_c);
-render_3d_draw_walls_pass(&g_render_3d, sw, sh, horizon, icx, icy, ica, cos_c, sin_c);
-if(g_render_3d.sprite_renderer) {
-sprite_clear(g_render_3d.sprite_renderer);
-for(int i= 0; i < gs->food_count; i++) sprite_add_color_shaded(g_render_3d.sprite_renderer, (float)gs->food[i].x + 0.5f, (float)gs->food[i].y + 0.5f, 0.25f, -0.5f, true, -1, 0, render_3d_sdl_color(255, 0, 0, 255));
+TRACE_BEGIN("decals");
+uint64_t t_pass= render_timing_begin();
+render_3d_setup_floor_decals(r, gs, &d_p, &b_p, &d_c);
+if(r->config.floor_reprojection) render_3d_track_decal_changes(r, gs, d_p, b_p);
+render_timing_end(RENDER_PASS_DECALS, t_pass);
+TRACE_END("decals");
+TRACE_BEGIN("floor");
+t_pass= render_timing_begin();
+render_3d_draw_floor_ceiling_pass(r, sw, sh, horizon, icx, icy, ica, cos_c, sin_c, d_p, b_p, d_c);
+render_timing_end(RENDER_PASS_FLOOR, t_pass);
+TRACE_END("floor");
+TRACE_BEGIN("walls");
+t_pass= render_timing_begin();
+render_3d_draw_walls_pass(r, sw, sh, horizon, icx, icy, ica, cos_c, sin_c);
+render_timing_end(RENDER_PASS_WALLS, t_pass);
+TRACE_END("walls");
+if(r->sprite_renderer) {
+TRACE_BEGIN("sprites");
+t_pass= render_timing_begin();
+sprite_clear(r->sprite_renderer);
+for(int i= 0; i < gs->food_count; i++) sprite_add_color_shaded(r->sprite_renderer, (float)gs->food[i].x + 0.5f, (float)gs->food[i].y + 0.5f, 0.25f, -0.5f, true, -1, 0, render_3d_sdl_color(255, 0, 0, 255));
 for(int p= 0; p < gs->num_players; p++) {
 PlayerState* pl= (PlayerState*)&gs->players[p]; /* non-const for interp_time update */
-if(!pl->active || pl->length == 0 || p == g_render_3d.config.active_player) continue;
+if(!pl->active || pl->length == 0 || p == r->config.active_player) continue;
 /* Update per-player interpolation timer */
-float tick_interval= camera_get_update_interval(g_render_3d.camera);
+float tick_interval= camera_get_update_interval(r->camera);
+/* Offscreen and viewport renders pass dt 0 and leave the shared state untouched */
+if(c_dt > 0.0f) {
 pl->interp_time+= c_dt;
 if(pl->interp_time > tick_interval) pl->interp_time= tick_interval;
+}
 float p_interp= tick_interval > 0.0f ? pl->interp_time / tick_interval : 1.0f;
 if(p_interp > 1.0f) p_interp= 1.0f;
 /* Interpolate from prev to current using per-player timer */
 float hx= pl->prev_head.x + (((float)pl->body[0].x + 0.5f) - pl->prev_head.x) * p_interp;
 float hy= pl->prev_head.y + (((float)pl->body[0].y + 0.5f) - pl->prev_head.y) * p_interp;
-sprite_add_color_shaded(g_render_3d.sprite_renderer, hx, hy, 1.0f, 0.0f, true, -1, 0, pl->color ? pl->color : render_3d_sdl_color(0, 128, 0, 255));
+sprite_add_color_shaded(r->sprite_renderer, hx, hy, 1.0f, 0.0f, true, -1, 0, pl->color ? pl->color : render_3d_sdl_color(0, 128, 0, 255));
 }
 for(int p= 0; p < gs->num_players; p++) {
 const PlayerState* pl= &gs->players[p];
 if(!pl->active || pl->length <= 1) continue;
 uint32_t bc= pl->color ? render_3d_shade_color(pl->color, 60) : render_3d_sdl_color(0, 128, 0, 255);
 /* Calculate per-player interpolation fraction */
-float tick_interval= camera_get_update_interval(g_render_3d.camera);
+float tick_interval= camera_get_update_interval(r->camera);
 float p_interp= tick_interval > 0.0f ? pl->interp_time / tick_interval : 1.0f;
 if(p_interp > 1.0f) p_interp= 1.0f;
 /* Local player uses camera interp; remote players use their own timer */
-float s_interp= (p == g_render_3d.config.active_player) ? f_interp : p_interp;
+float s_interp= (p == r->config.active_player) ? f_interp : p_interp;
 for(int bi= 1; bi < pl->length; bi++) {
 float sx= pl->prev_segment[bi].x + (((float)pl->body[bi].x + 0.5f) - pl->prev_segment[bi].x) * s_interp;
 float sy= pl->prev_segment[bi].y + (((float)pl->body[bi].y + 0.5f) - pl->prev_segment[bi].y) * s_interp;
-sprite_add_color(g_render_3d.sprite_renderer, sx, sy, g_render_3d.config.tail_height_scale, 0.0f, true, -1, 0, bc);
+sprite_add_color(r->sprite_renderer, sx, sy, r->config.tail_height_scale, 0.0f, true, -1, 0, bc);
+}
 }
+sprite_project_all(r->sprite_renderer);
+sprite_sort_by_depth(r->sprite_renderer);
+sprite_draw(r->sprite_renderer, r->display, r->column_depths);
+render_timing_end(RENDER_PASS_SPRITES, t_pass);
+TRACE_END("sprites");
 }
-sprite_project_all(g_render_3d.sprite_renderer);
-sprite_sort_by_depth(g_render_3d.sprite_renderer);
-sprite_draw(g_render_3d.sprite_renderer, g_render_3d.display, g_render_3d.column_depths);
+TRACE_BEGIN("minimap");
+t_pass= render_timing_begin();
+render_3d_draw_minimap(r, f_interp);
+render_timing_end(RENDER_PASS_MINIMAP, t_pass);
+TRACE_END("minimap");
 }
-render_3d_draw_minimap(&g_render_3d, f_interp);
-render_3d_draw_fps_counter();
+void render_3d_draw(const GameState* gs, const char* name, const void* sc, int scc, float dt) {
+(void)name;
+(void)sc;
+(void)scc;
+if(!g_render_3d.initialized || !gs) return;
+g_render_3d.game_state= gs;
+float c_dt= dt > 0.5f ? 0.5f : dt;
+render_3d_cache_env(&g_render_3d);
+render_timing_poll();
+TRACE_BEGIN("render_3d_draw");
+uint64_t t_frame= render_timing_begin();
+double t0= g_render_3d.config.target_fps > 0 ? render_3d_now() : 0.0;
+camera_update_interpolation(g_render_3d.camera, c_dt);
+render_3d_update_fps(&g_render_3d, dt);
+render_3d_draw_scene(&g_render_3d, gs, c_dt);
+render_3d_draw_fps_counter(&g_render_3d);
+TRACE_BEGIN("present");
+uint64_t t_present= render_timing_begin();
 (void)render_3d_sdl_present(g_render_3d.display);
-if(g_render_3d.cached_debug_timing) { render_3d_log("3D_TIMING: total=%.2fms screen=%dx%d map=%dx%d\n", (render_3d_now() - t0) * 1000.0, sw, sh, gs->width, gs->height); }
+render_timing_end(RENDER_PASS_PRESENT, t_present);
+TRACE_END("present");
+if(g_render_3d.config.target_fps > 0) render_3d_update_render_scale(&g_render_3d, (float)((render_3d_now() - t0) * 1000.0));
+render_timing_end(RENDER_PASS_FRAME, t_frame);
+TRACE_END("render_3d_draw");
 }
 void render_3d_set_active_player(int player_index) __attribute__((used));
 void render_3d_set_active_player(int player_index) {
@@ -800,61 +1164,247 @@ if(ms <= 0) ms= 1;
 camera_set_update_interval(g_render_3d.camera, (float)ms / 1000.0f);
 if(camera_get_interp_time(g_render_3d.camera) > camera_get_update_interval(g_render_3d.camera)) camera_set_interpolation_time(g_render_3d.camera, camera_get_update_interval(g_render_3d.camera));
 }
+static void render_3d_workers_stop(struct Render3DWorkers* w);
+static void render_3d_release(Render3DContext* r) {
+render_3d_workers_stop(r->workers);
+r->workers= NULL;
+for(int i= 0; i < RENDER_3D_MAX_VIEWPORTS; i++) {
+render_3d_context_destroy(r->views[i]);
+r->views[i]= NULL;
+}
+render_3d_sdl_destroy(r->display);
+r->display= NULL;
+free(r->floor_cache);
+r->floor_cache= NULL;
+free(r->floor_row_span);
+r->floor_row_span= NULL;
+free(r->cell_sig);
+r->cell_sig= NULL;
+r->cell_sig_cap= 0;
+r->floor_cache_valid= false;
+if(r->column_depths) {
+free(r->column_depths);
+r->column_depths= NULL;
+}
+if(r->cos_offsets) {
+free(r->cos_offsets);
+r->cos_offsets= NULL;
+}
+if(r->sin_offsets) {
+free(r->sin_offsets);
+r->sin_offsets= NULL;
+}
+r->offsets_cap= 0;
+/* Free pre-allocated pools */
+if(r->decal_pool) {
+free(r->decal_pool);
+r->decal_pool= NULL;
+}
+r->decal_pool_cap= 0;
+if(r->bucket_pool) {
+free(r->bucket_pool);
+r->bucket_pool= NULL;
+}
+r->bucket_pool_cap= 0;
+r->env_cached= false;
+sprite_destroy(r->sprite_renderer);
+r->sprite_renderer= NULL;
+r->wall_texture= NULL;
+r->floor_texture= NULL;
+r->texture= NULL;
+render_3d_shared_release(r->shared);
+r->shared= NULL;
+if(r->projector) {
+projection_destroy(r->projector);
+r->projector= NULL;
+}
+if(r->raycaster) {
+raycaster_destroy(r->raycaster);
+r->raycaster= NULL;
+}
+if(r->camera) {
+camera_destroy(r->camera);
+r->camera= NULL;
+}
+r->initialized= false;
+r->game_state= NULL;
+}
 void render_3d_shutdown(void) {
 if(!g_render_3d.initialized) return;
-render_3d_sdl_destroy(g_render_3d.display);
-g_render_3d.display= NULL;
-if(g_render_3d.column_depths) {
-free(g_render_3d.column_depths);
-g_render_3d.column_depths= NULL;
-}
-if(g_render_3d.cos_offsets) {
-free(g_render_3d.cos_offsets);
-g_render_3d.cos_offsets= NULL;
+render_3d_release(&g_render_3d);
+}
+Render3DContext* render_3d_context_create(const Render3DConfig* config) { return render_3d_context_create_shared(config, NULL); }
+Render3DContext* render_3d_context_create_shared(const Render3DConfig* config, Render3DShared* shared) {
+Render3DContext* r= calloc(1, sizeof *r);
+if(!r) return NULL;
+if(config)
+r->config= *config;
+else
+render_3d_default_config(&r->config);
+if(r->config.wall_texture_scale <= 0.0f) r->config.wall_texture_scale= 1.0f;
+if(r->config.floor_texture_scale <= 0.0f) r->config.floor_texture_scale= 1.0f;
+r->raycaster= raycaster_create(0, 0, NULL);
+r->projector= projection_create(1, 1, r->config.fov_degrees * 3.14159265359f / 180.0f, r->config.wall_height_scale);
+if(!r->raycaster || !r->projector || !render_3d_load_resources(r, shared)) {
+render_3d_release(r);
+free(r);
+return NULL;
+}
+r->initialized= true;
+return r;
+}
+void render_3d_context_destroy(Render3DContext* r) {
+if(!r) return;
+/* Camera is borrowed per frame, never owned */
+r->camera= NULL;
+render_3d_release(r);
+free(r);
+}
+static bool render_3d_render_region(Render3DContext* r, const GameState* gs, Camera3D* camera, uint32_t* pixels, int width, int height, int pitch) {
+if(!r || !r->initialized || !gs || !camera || !pixels || width <= 1 || height <= 0) return false;
+if(!r->display || render_3d_sdl_get_pixels(r->display) != pixels || render_3d_sdl_get_width(r->display) != width || render_3d_sdl_get_height(r->display) != height || render_3d_sdl_get_pitch(r->display) != pitch) {
+render_3d_sdl_destroy(r->display);
+r->display= render_3d_sdl_create_offscreen(width, height, pitch, pixels);
+if(!r->display) return false;
+float* depths= realloc(r->column_depths, (size_t)width * sizeof *depths);
+if(!depths) return false;
+r->column_depths= depths;
+projection_init(r->projector, width, height, r->config.fov_degrees * 3.14159265359f / 180.0f, r->config.wall_height_scale);
+}
+/* Angle tables are cached per width; a different camera may use a different FOV */
+if(r->camera != camera) r->offsets_cap= 0;
+r->camera= camera;
+sprite_set_view(r->sprite_renderer, camera, r->projector);
+raycast_init(r->raycaster, gs->width, gs->height, NULL);
+r->game_state= gs;
+render_3d_cache_env(r);
+render_3d_draw_scene(r, gs, 0.0f);
+return true;
 }
-if(g_render_3d.sin_offsets) {
-free(g_render_3d.sin_offsets);
-g_render_3d.sin_offsets= NULL;
+bool render_3d_render_offscreen(Render3DContext* r, const GameState* gs, Camera3D* camera, uint32_t* pixels, int width, int height) { return render_3d_render_region(r, gs, camera, pixels, width, height, width); }
+int render_3d_context_get_floor_rows_reused(const Render3DContext* r) { return r ? r->floor_rows_reused : 0; }
+typedef struct {
+Render3DContext* view;
+const GameState* gs;
+Camera3D* camera;
+uint32_t* pixels;
+int width, height, pitch;
+bool ok;
+} ViewportJob;
+static void* render_3d_viewport_job(void* arg) {
+ViewportJob* job= arg;
+job->ok= render_3d_render_region(job->view, job->gs, job->camera, job->pixels, job->width, job->height, job->pitch);
+return NULL;
 }
-g_render_3d.offsets_cap= 0;
-/* Free pre-allocated pools */
-if(g_render_3d.decal_pool) {
-free(g_render_3d.decal_pool);
-g_render_3d.decal_pool= NULL;
-}
-g_render_3d.decal_pool_cap= 0;
-if(g_render_3d.bucket_pool) {
-free(g_render_3d.bucket_pool);
-g_render_3d.bucket_pool= NULL;
-}
-g_render_3d.bucket_pool_cap= 0;
-g_render_3d.env_cached= false;
-sprite_destroy(g_render_3d.sprite_renderer);
-g_render_3d.sprite_renderer= NULL;
-if(g_render_3d.wall_texture) {
-texture_destroy(g_render_3d.wall_texture);
-g_render_3d.wall_texture= NULL;
-}
-if(g_render_3d.floor_texture) {
-texture_destroy(g_render_3d.floor_texture);
-g_render_3d.floor_texture= NULL;
-}
-if(g_render_3d.texture) {
-texture_destroy(g_render_3d.texture);
-g_render_3d.texture= NULL;
-}
-if(g_render_3d.projector) {
-projection_destroy(g_render_3d.projector);
-g_render_3d.projector= NULL;
-}
-if(g_render_3d.raycaster) {
-raycaster_destroy(g_render_3d.raycaster);
-g_render_3d.raycaster= NULL;
-}
-if(g_render_3d.camera) {
-camera_destroy(g_render_3d.camera);
-g_render_3d.camera= NULL;
-}
-g_render_3d.initialized= false;
-g_render_3d.game_state= NULL;
+typedef struct {
+struct Render3DWorkers* w;
+int job;
+} ViewportWorker;
+/* Worker i renders viewport i + 1 of every frame; viewport 0 stays on the calling thread */
+typedef struct Render3DWorkers {
+pthread_mutex_t lock;
+pthread_cond_t cond;
+pthread_t threads[RENDER_3D_MAX_VIEWPORTS - 1];
+ViewportWorker args[RENDER_3D_MAX_VIEWPORTS - 1];
+int started;
+ViewportJob* jobs;
+int count;
+unsigned frame; /* bumped to hand out a frame's jobs */
+int pending;    /* handed-out jobs not yet finished */
+bool stop;
+} Render3DWorkers;
+static void* render_3d_viewport_worker(void* arg) {
+const ViewportWorker* self= arg;
+Render3DWorkers* w= self->w;
+const int index= self->job;
+unsigned seen= 0;
+pthread_mutex_lock(&w->lock);
+for(;;) {
+while(!w->stop && w->frame == seen) pthread_cond_wait(&w->cond, &w->lock);
+if(w->stop) break;
+seen= w->frame;
+if(index >= w->count) continue;
+ViewportJob* job= &w->jobs[index];
+pthread_mutex_unlock(&w->lock);
+render_3d_viewport_job(job);
+pthread_mutex_lock(&w->lock);
+if(--w->pending == 0) pthread_cond_broadcast(&w->cond);
+}
+pthread_mutex_unlock(&w->lock);
+return NULL;
+}
+static Render3DWorkers* render_3d_workers_start(void) {
+Render3DWorkers* w= calloc(1, sizeof *w);
+if(!w) return NULL;
+if(pthread_mutex_init(&w->lock, NULL) != 0) {
+free(w);
+return NULL;
+}
+if(pthread_cond_init(&w->cond, NULL) != 0) {
+pthread_mutex_destroy(&w->lock);
+free(w);
+return NULL;
+}
+for(int i= 0; i < RENDER_3D_MAX_VIEWPORTS - 1; i++) {
+w->args[w->started].w= w;
+w->args[w->started].job= i + 1;
+if(pthread_create(&w->threads[w->started], NULL, render_3d_viewport_worker, &w->args[w->started]) != 0) break;
+w->started++;
+}
+return w;
+}
+static void render_3d_workers_stop(Render3DWorkers* w) {
+if(!w) return;
+pthread_mutex_lock(&w->lock);
+w->stop= true;
+pthread_cond_broadcast(&w->cond);
+pthread_mutex_unlock(&w->lock);
+for(int i= 0; i < w->started; i++) pthread_join(w->threads[i], NULL);
+pthread_cond_destroy(&w->cond);
+pthread_mutex_destroy(&w->lock);
+free(w);
+}
+bool render_3d_render_viewports(Render3DContext* r, const GameState* gs, const Render3DViewport* viewports, int count, uint32_t* pixels, int width, int height, bool parallel) {
+if(!r || !r->initialized || !gs || !viewports || count <= 0 || count > RENDER_3D_MAX_VIEWPORTS || !pixels || width <= 0 || height <= 0) return false;
+ViewportJob jobs[RENDER_3D_MAX_VIEWPORTS];
+for(int i= 0; i < count; i++) {
+const Render3DViewport* vp= &viewports[i];
+if(!vp->camera || vp->x < 0 || vp->y < 0 || vp->width <= 1 || vp->height <= 0 || vp->x + vp->width > width || vp->y + vp->height > height) return false;
+if(parallel) {
+for(int j= 0; j < i; j++) {
+if(viewports[j].camera == vp->camera) return false; /* cameras cache per-frame state */
+}
+}
+if(!r->views[i]) {
+r->views[i]= render_3d_context_create_shared(&r->config, r->shared);
+if(!r->views[i]) return false;
+}
+r->views[i]->config.active_player= vp->player;
+jobs[i]= (ViewportJob){r->views[i], gs, vp->camera, pixels + (size_t)vp->y * (size_t)width + (size_t)vp->x, vp->width, vp->height, width, false};
+}
+if(parallel && count > 1 && !r->workers) r->workers= render_3d_workers_start();
+Render3DWorkers* w= parallel && count > 1 ? r->workers : NULL;
+/* Viewports without a started worker render on the calling thread, as every viewport does serially */
+int handed= 0;
+if(w) {
+pthread_mutex_lock(&w->lock);
+handed= count - 1 < w->started ? count - 1 : w->started;
+w->jobs= jobs;
+w->count= 1 + handed;
+w->pending= handed;
+w->frame++;
+pthread_cond_broadcast(&w->cond);
+pthread_mutex_unlock(&w->lock);
+}
+for(int i= 0; i < count; i++) {
+if(i == 0 || i > handed) render_3d_viewport_job(&jobs[i]);
+}
+if(w) {
+pthread_mutex_lock(&w->lock);
+while(w->pending > 0) pthread_cond_wait(&w->cond, &w->lock);
+pthread_mutex_unlock(&w->lock);
+}
+bool ok= true;
+for(int i= 0; i < count; i++) ok= ok && jobs[i].ok;
+return ok;
 }
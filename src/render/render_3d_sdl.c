@@ -3,6 +3,7 @@
 #include <SDL2/SDL.h>
 #include <dlfcn.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -20,6 +21,12 @@ if(fn) fn();
 }
 #define LSAN_DISABLE() call_lsan_disable()
 #define LSAN_ENABLE() call_lsan_enable()
+#define SDL3D_MAX_DIRTY_RECTS 8
+#define SDL3D_FRAME_RING 3
+typedef struct {
+SDL_Rect rects[SDL3D_MAX_DIRTY_RECTS];
+int count;
+} DirtyList;
 typedef struct {
 SDL_Window* window;
 SDL_Renderer* renderer;
@@ -30,12 +37,43 @@ int height;
 struct SDL3DContext {
 int width;
 int height;
+int pitch; /* pixels per row; equals width unless wrapping a region of a larger buffer */
+/* Allocated buffer and texture size; width/height may be set smaller for dynamic resolution */
+int max_width;
+int max_height;
 uint32_t* pixels;
 SDL_Window* window;
 SDL_Renderer* renderer;
 SDL_Texture* texture;
 Uint32 texture_format;
 bool initialized;
+bool offscreen; /* wraps caller-owned pixels; never touches SDL */
+/* Regions written since the last present; collapsed to their bounding box when the list fills up */
+DirtyList dirty;
+bool force_full;
+/* Async presentation: pixels always points at frames[back]. Each buffer's stale list holds the
+   regions where it lags behind frames[last_submitted]; they are copied in lazily on first write. */
+uint32_t* frames[SDL3D_FRAME_RING];
+DirtyList stale[SDL3D_FRAME_RING];
+int back;
+int last_submitted;
+bool needs_sync;
+bool async;
+/* Copier thread state, guarded by lock. Only the copy into locked texture memory runs there; every SDL call stays on
+   the thread that presents. */
+pthread_t copier;
+pthread_mutex_t lock;
+pthread_cond_t cond;
+bool stop;
+int copying; /* frame being copied into the locked texture, -1 when idle */
+SDL_Rect copy_rect;
+void* copy_dst;
+int copy_dst_pitch;
+/* Presenting thread only: the texture is locked for a copy that has yet to be presented */
+bool in_flight;
+int flight_w;
+int flight_h;
+int async_presented; /* frames the copier filled and finish_copy presented */
 };
 SDL3DContext* render_3d_sdl_create(int width, int height, int vsync) {
 SDL3DContext* ctx= calloc(1, sizeof *ctx);
@@ -46,6 +84,22 @@ return NULL;
 }
 return ctx;
 }
+SDL3DContext* render_3d_sdl_create_offscreen(int width, int height, int pitch, uint32_t* pixels) {
+if(width <= 0 || height <= 0 || pitch < width || !pixels) return NULL;
+SDL3DContext* ctx= calloc(1, sizeof *ctx);
+if(!ctx) return NULL;
+ctx->width= width;
+ctx->height= height;
+ctx->pitch= pitch;
+ctx->max_width= width;
+ctx->max_height= height;
+ctx->pixels= pixels;
+ctx->frames[0]= pixels;
+ctx->offscreen= true;
+ctx->initialized= true;
+render_3d_sdl_mark_all_dirty(ctx);
+return ctx;
+}
 void render_3d_sdl_destroy(SDL3DContext* ctx) {
 if(!ctx) return;
 render_3d_sdl_shutdown(ctx);
@@ -53,11 +107,61 @@ free(ctx);
 }
 int render_3d_sdl_get_width(const SDL3DContext* ctx) { return ctx ? ctx->width : 0; }
 int render_3d_sdl_get_height(const SDL3DContext* ctx) { return ctx ? ctx->height : 0; }
-uint32_t* render_3d_sdl_get_pixels(SDL3DContext* ctx) { return ctx ? ctx->pixels : NULL; }
+int render_3d_sdl_get_pitch(const SDL3DContext* ctx) { return ctx ? ctx->pitch : 0; }
+int render_3d_sdl_get_max_width(const SDL3DContext* ctx) { return ctx ? ctx->max_width : 0; }
+int render_3d_sdl_get_max_height(const SDL3DContext* ctx) { return ctx ? ctx->max_height : 0; }
+static void sync_back_buffer(SDL3DContext* ctx);
+uint32_t* render_3d_sdl_get_pixels(SDL3DContext* ctx) {
+if(!ctx) return NULL;
+if(ctx->needs_sync) sync_back_buffer(ctx);
+return ctx->pixels;
+}
+static void log_sdl_error(const char* what) {
+FILE* f= fopen("logs/sdl_error.log", "a");
+if(f) {
+fprintf(f, "%s failed: %s\n", what, SDL_GetError());
+fclose(f);
+}
+}
+static bool create_targets(SDL3DContext* ctx) {
+ctx->renderer= SDL_CreateRenderer(ctx->window, -1, SDL_RENDERER_ACCELERATED);
+if(!ctx->renderer) {
+log_sdl_error("SDL_CreateRenderer");
+return false;
+}
+SDL_SetRenderDrawColor(ctx->renderer, 0, 0, 0, 255);
+SDL_RenderClear(ctx->renderer);
+SDL_RenderPresent(ctx->renderer);
+SDL_RendererInfo info;
+Uint32 fmt= SDL_PIXELFORMAT_ARGB8888;
+if(SDL_GetRendererInfo(ctx->renderer, &info) == 0 && info.num_texture_formats > 0) fmt= info.texture_formats[0];
+/* Reduced render sizes are stretched to the window, so filter rather than duplicate pixels */
+SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
+ctx->texture= SDL_CreateTexture(ctx->renderer, fmt, SDL_TEXTUREACCESS_STREAMING, ctx->max_width, ctx->max_height);
+if(!ctx->texture) {
+SDL_DestroyRenderer(ctx->renderer);
+ctx->renderer= NULL;
+return false;
+}
+ctx->texture_format= fmt;
+return true;
+}
+static void destroy_targets(SDL3DContext* ctx) {
+if(ctx->texture) {
+SDL_DestroyTexture(ctx->texture);
+ctx->texture= NULL;
+ctx->texture_format= 0;
+}
+if(ctx->renderer) {
+SDL_DestroyRenderer(ctx->renderer);
+ctx->renderer= NULL;
+}
+}
 bool render_3d_sdl_init(int width, int height, int vsync, SDL3DContext* ctx_out) {
+(void)vsync;
 if(!ctx_out || width <= 0 || height <= 0) return false;
 if(ctx_out->initialized) return true;
-if(width > (int)(SIZE_MAX / ((size_t)height * sizeof(uint32_t)))) return false;
+if((size_t)width > SIZE_MAX / ((size_t)height * sizeof(uint32_t))) return false;
 LSAN_DISABLE();
 int err= 0;
 int sdl_inited= 0;
@@ -65,32 +169,26 @@ ctx_out->pixels= NULL;
 ctx_out->window= NULL;
 ctx_out->renderer= NULL;
 ctx_out->texture= NULL;
+ctx_out->width= width;
+ctx_out->height= height;
+ctx_out->pitch= width;
+ctx_out->max_width= width;
+ctx_out->max_height= height;
 if(SDL_Init(SDL_INIT_VIDEO) < 0) {
-FILE* f= fopen("logs/sdl_error.log", "a");
-if(f) {
-fprintf(f, "SDL_Init failed: %s\n", SDL_GetError());
-fclose(f);
-}
+log_sdl_error("SDL_Init");
 /* SDL unavailable: fall back to a plain pixel buffer if possible */
 ctx_out->pixels= malloc((size_t)width * (size_t)height * sizeof *ctx_out->pixels);
 if(!ctx_out->pixels) {
 err= 1;
 goto out;
 }
-ctx_out->width= width;
-ctx_out->height= height;
-ctx_out->initialized= true;
-goto out;
+goto done;
 }
 sdl_inited= 1;
 SDL_SetHint(SDL_HINT_VIDEO_HIGHDPI_DISABLED, "0");
 ctx_out->window= SDL_CreateWindow("SNAKE 3D", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width, height, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALWAYS_ON_TOP);
 if(!ctx_out->window) {
-FILE* f= fopen("logs/sdl_error.log", "a");
-if(f) {
-fprintf(f, "SDL_CreateWindow failed: %s\n", SDL_GetError());
-fclose(f);
-}
+log_sdl_error("SDL_CreateWindow");
 err= 2;
 goto out;
 }
@@ -98,53 +196,28 @@ SDL_ShowWindow(ctx_out->window);
 SDL_SetWindowAlwaysOnTop(ctx_out->window, SDL_TRUE);
 SDL_RaiseWindow(ctx_out->window);
 SDL_PumpEvents();
-ctx_out->renderer= SDL_CreateRenderer(ctx_out->window, -1, SDL_RENDERER_ACCELERATED);
-if(!ctx_out->renderer) {
-FILE* f= fopen("logs/sdl_error.log", "a");
-if(f) {
-fprintf(f, "SDL_CreateRenderer failed: %s\n", SDL_GetError());
-fclose(f);
-}
+if(!create_targets(ctx_out)) {
 err= 3;
 goto out;
 }
-SDL_SetRenderDrawColor(ctx_out->renderer, 0, 0, 0, 255);
-SDL_RenderClear(ctx_out->renderer);
-SDL_RenderPresent(ctx_out->renderer);
-{
-SDL_RendererInfo info;
-SDL_GetRendererInfo(ctx_out->renderer, &info);
-Uint32 fmt= SDL_PIXELFORMAT_ARGB8888;
-if(info.num_texture_formats > 0) fmt= info.texture_formats[0];
-ctx_out->texture= SDL_CreateTexture(ctx_out->renderer, fmt, SDL_TEXTUREACCESS_STREAMING, width, height);
-if(!ctx_out->texture) {
-err= 4;
-goto out;
-}
-ctx_out->texture_format= fmt;
-}
 ctx_out->pixels= malloc((size_t)width * (size_t)height * sizeof *ctx_out->pixels);
 if(!ctx_out->pixels) {
 err= 5;
 goto out;
 }
-ctx_out->width= width;
-ctx_out->height= height;
+done:
+ctx_out->frames[0]= ctx_out->pixels;
+ctx_out->back= 0;
+ctx_out->last_submitted= 0;
 ctx_out->initialized= true;
+render_3d_sdl_mark_all_dirty(ctx_out);
 out:
 if(err) {
 if(ctx_out->pixels) {
 free(ctx_out->pixels);
 ctx_out->pixels= NULL;
 }
-if(ctx_out->texture) {
-SDL_DestroyTexture(ctx_out->texture);
-ctx_out->texture= NULL;
-}
-if(ctx_out->renderer) {
-SDL_DestroyRenderer(ctx_out->renderer);
-ctx_out->renderer= NULL;
-}
+destroy_targets(ctx_out);
 if(ctx_out->window) {
 SDL_DestroyWindow(ctx_out->window);
 ctx_out->window= NULL;
@@ -152,26 +225,30 @@ ctx_out->window= NULL;
 if(sdl_inited) SDL_Quit();
 ctx_out->width= 0;
 ctx_out->height= 0;
+ctx_out->pitch= 0;
+ctx_out->max_width= 0;
+ctx_out->max_height= 0;
 ctx_out->initialized= false;
 }
 LSAN_ENABLE();
 return ctx_out->initialized;
 }
+static void stop_copier(SDL3DContext* ctx);
 void render_3d_sdl_shutdown(SDL3DContext* ctx) {
 if(!ctx || !ctx->initialized) return;
-if(ctx->pixels) {
-free(ctx->pixels);
+if(ctx->offscreen) {
 ctx->pixels= NULL;
+ctx->frames[0]= NULL;
+ctx->initialized= false;
+return;
 }
-if(ctx->texture) {
-SDL_DestroyTexture(ctx->texture);
-ctx->texture= NULL;
-ctx->texture_format= 0;
-}
-if(ctx->renderer) {
-SDL_DestroyRenderer(ctx->renderer);
-ctx->renderer= NULL;
+stop_copier(ctx);
+for(int i= 0; i < SDL3D_FRAME_RING; i++) {
+free(ctx->frames[i]);
+ctx->frames[i]= NULL;
 }
+ctx->pixels= NULL;
+destroy_targets(ctx);
 if(ctx->window) {
 SDL_DestroyWindow(ctx->window);
 ctx->window= NULL;
@@ -179,11 +256,107 @@ ctx->window= NULL;
 SDL_Quit();
 ctx->width= 0;
 ctx->height= 0;
+ctx->pitch= 0;
+ctx->max_width= 0;
+ctx->max_height= 0;
+ctx->dirty.count= 0;
+ctx->force_full= false;
 ctx->initialized= false;
 }
+static bool rects_touch(const SDL_Rect* a, const SDL_Rect* b) { return a->x <= b->x + b->w && b->x <= a->x + a->w && a->y <= b->y + b->h && b->y <= a->y + a->h; }
+static bool rect_contains(const SDL_Rect* a, const SDL_Rect* b) { return b->x >= a->x && b->y >= a->y && b->x + b->w <= a->x + a->w && b->y + b->h <= a->y + a->h; }
+static void rect_union(SDL_Rect* a, const SDL_Rect* b) {
+int x1= a->x + a->w > b->x + b->w ? a->x + a->w : b->x + b->w;
+int y1= a->y + a->h > b->y + b->h ? a->y + a->h : b->y + b->h;
+if(b->x < a->x) a->x= b->x;
+if(b->y < a->y) a->y= b->y;
+a->w= x1 - a->x;
+a->h= y1 - a->y;
+}
+static void dirty_list_add(DirtyList* l, const SDL_Rect* rc) {
+for(int i= 0; i < l->count; i++) {
+if(rect_contains(&l->rects[i], rc)) return;
+}
+for(int i= 0; i < l->count; i++) {
+if(rects_touch(&l->rects[i], rc)) {
+rect_union(&l->rects[i], rc);
+return;
+}
+}
+if(l->count < SDL3D_MAX_DIRTY_RECTS) {
+l->rects[l->count++]= *rc;
+return;
+}
+/* List full: collapse everything into one bounding rectangle */
+for(int i= 1; i < l->count; i++) rect_union(&l->rects[0], &l->rects[i]);
+rect_union(&l->rects[0], rc);
+l->count= 1;
+}
+static void dirty_list_merge(DirtyList* dst, const DirtyList* src) {
+for(int i= 0; i < src->count; i++) dirty_list_add(dst, &src->rects[i]);
+}
+/* Bring the back buffer up to date with the last submitted frame before anything reads or writes it */
+static void sync_back_buffer(SDL3DContext* ctx) {
+DirtyList* st= &ctx->stale[ctx->back];
+const uint32_t* src= ctx->frames[ctx->last_submitted];
+for(int i= 0; i < st->count; i++) {
+const SDL_Rect* rc= &st->rects[i];
+for(int y= rc->y; y < rc->y + rc->h; y++) {
+size_t off= (size_t)y * (size_t)ctx->pitch + (size_t)rc->x;
+memcpy(ctx->pixels + off, src + off, (size_t)rc->w * sizeof(uint32_t));
+}
+}
+st->count= 0;
+ctx->needs_sync= false;
+}
+void render_3d_sdl_mark_dirty(SDL3DContext* ctx, int x, int y, int w, int h) {
+if(!ctx || w <= 0 || h <= 0) return;
+int x1= x + w, y1= y + h;
+if(x < 0) x= 0;
+if(y < 0) y= 0;
+if(x1 > ctx->width) x1= ctx->width;
+if(y1 > ctx->height) y1= ctx->height;
+if(x >= x1 || y >= y1) return;
+if(ctx->needs_sync) sync_back_buffer(ctx);
+SDL_Rect rc= {x, y, x1 - x, y1 - y};
+dirty_list_add(&ctx->dirty, &rc);
+}
+bool render_3d_sdl_set_render_size(SDL3DContext* ctx, int width, int height) {
+if(!ctx || !ctx->initialized) return false;
+if(width < 1) width= 1;
+if(height < 1) height= 1;
+if(width > ctx->max_width) width= ctx->max_width;
+if(height > ctx->max_height) height= ctx->max_height;
+if(width == ctx->width && height == ctx->height) return false;
+ctx->width= width;
+ctx->height= height;
+/* Old contents are at the wrong scale: every buffer is redrawn in full rather than patched */
+for(int i= 0; i < SDL3D_FRAME_RING; i++) ctx->stale[i].count= 0;
+render_3d_sdl_mark_all_dirty(ctx);
+ctx->force_full= true;
+return true;
+}
+void render_3d_sdl_mark_all_dirty(SDL3DContext* ctx) {
+if(!ctx) return;
+/* The whole frame is about to be overwritten, so stale regions need no copy */
+ctx->stale[ctx->back].count= 0;
+ctx->needs_sync= false;
+ctx->dirty.rects[0]= (SDL_Rect){0, 0, ctx->width, ctx->height};
+ctx->dirty.count= (ctx->width > 0 && ctx->height > 0) ? 1 : 0;
+}
+int render_3d_sdl_get_dirty_count(const SDL3DContext* ctx) { return ctx ? ctx->dirty.count : 0; }
+bool render_3d_sdl_get_dirty_rect(const SDL3DContext* ctx, int idx, int* x, int* y, int* w, int* h) {
+if(!ctx || idx < 0 || idx >= ctx->dirty.count) return false;
+if(x) *x= ctx->dirty.rects[idx].x;
+if(y) *y= ctx->dirty.rects[idx].y;
+if(w) *w= ctx->dirty.rects[idx].w;
+if(h) *h= ctx->dirty.rects[idx].h;
+return true;
+}
 void render_3d_sdl_set_pixel(SDL3DContext* ctx, int x, int y, uint32_t col) {
 if(!ctx || !ctx->pixels || x < 0 || x >= ctx->width || y < 0 || y >= ctx->height) return;
-ctx->pixels[y * ctx->width + x]= col;
+render_3d_sdl_mark_dirty(ctx, x, y, 1, 1);
+ctx->pixels[y * ctx->pitch + x]= col;
 }
 static inline uint32_t blend_px(uint32_t dst, uint32_t src) {
 uint8_t sa= (uint8_t)((src >> 24) & 0xFFu);
@@ -200,7 +373,8 @@ return (0xFFu << 24) | ((uint32_t)rr << 16) | ((uint32_t)rg << 8) | (uint32_t)rb
 }
 void render_3d_sdl_blend_pixel(SDL3DContext* ctx, int x, int y, uint32_t src_col) {
 if(!ctx || !ctx->pixels || x < 0 || x >= ctx->width || y < 0 || y >= ctx->height) return;
-uint32_t* p= &ctx->pixels[y * ctx->width + x];
+render_3d_sdl_mark_dirty(ctx, x, y, 1, 1);
+uint32_t* p= &ctx->pixels[y * ctx->pitch + x];
 *p= blend_px(*p, src_col);
 }
 void render_3d_sdl_draw_column(SDL3DContext* ctx, int x, int y_start, int y_end, uint32_t col) {
@@ -208,11 +382,12 @@ if(!ctx || !ctx->pixels || x < 0 || x >= ctx->width) return;
 if(y_start < 0) y_start= 0;
 if(y_end >= ctx->height) y_end= ctx->height - 1;
 if(y_start > y_end) return;
-uint32_t* dst= &ctx->pixels[y_start * ctx->width + x];
+uint32_t* dst= &ctx->pixels[y_start * ctx->pitch + x];
 int count= y_end - y_start + 1;
+render_3d_sdl_mark_dirty(ctx, x, y_start, 1, count);
 for(int i= 0; i < count; i++) {
 *dst= col;
-dst+= ctx->width;
+dst+= ctx->pitch;
 }
 }
 void render_3d_sdl_draw_filled_circle(SDL3DContext* ctx, int center_x, int center_y, int radius, uint32_t col) {
@@ -225,11 +400,14 @@ if(x1 < 0) x1= 0;
 if(x2 >= ctx->width) x2= ctx->width - 1;
 if(y1 < 0) y1= 0;
 if(y2 >= ctx->height) y2= ctx->height - 1;
+if(x1 > x2 || y1 > y2) return;
+render_3d_sdl_mark_dirty(ctx, x1, y1, x2 - x1 + 1, y2 - y1 + 1);
 for(int y= y1; y <= y2; y++) {
+uint32_t* row= &ctx->pixels[y * ctx->pitch];
 for(int x= x1; x <= x2; x++) {
 int dx= x - center_x;
 int dy= y - center_y;
-if(dx * dx + dy * dy <= radius * radius) render_3d_sdl_blend_pixel(ctx, x, y, col);
+if(dx * dx + dy * dy <= radius * radius) row[x]= blend_px(row[x], col);
 }
 }
 }
@@ -243,75 +421,260 @@ if(x0 < 0) x0= 0;
 if(y0 < 0) y0= 0;
 if(x1 >= ctx->width) x1= ctx->width - 1;
 if(y1 >= ctx->height) y1= ctx->height - 1;
+if(x0 > x1 || y0 > y1) return;
+render_3d_sdl_mark_dirty(ctx, x0, y0, x1 - x0 + 1, y1 - y0 + 1);
 uint8_t alpha= (uint8_t)((col >> 24) & 0xFFu);
 if(alpha == 255) {
 for(int yy= y0; yy <= y1; ++yy) {
-uint32_t* row= &ctx->pixels[yy * ctx->width + x0];
+uint32_t* row= &ctx->pixels[yy * ctx->pitch + x0];
 int count= x1 - x0 + 1;
 for(int i= 0; i < count; i++) row[i]= col;
 }
 } else if(alpha > 0) {
 for(int yy= y0; yy <= y1; ++yy) {
-for(int xx= x0; xx <= x1; ++xx) { render_3d_sdl_blend_pixel(ctx, xx, yy, col); }
+uint32_t* row= &ctx->pixels[yy * ctx->pitch];
+for(int xx= x0; xx <= x1; ++xx) row[xx]= blend_px(row[xx], col);
 }
 }
 }
 void render_3d_sdl_clear(SDL3DContext* ctx, uint32_t col) {
 if(!ctx || !ctx->pixels) return;
-int total= ctx->width * ctx->height;
-for(int i= 0; i < total; i++) ctx->pixels[i]= col;
-}
-bool render_3d_sdl_present(SDL3DContext* ctx) {
-if(!ctx || !ctx->renderer || !ctx->texture) return false;
-SDL_PumpEvents();
-SDL_Event event;
-while(SDL_PollEvent(&event)) {
-switch(event.type) {
-case SDL_QUIT: return false;
-case SDL_KEYDOWN:
-if(event.key.keysym.sym == SDLK_ESCAPE) return false;
-break;
-default: break;
-}
-}
-/* Try lock+write path first; fall back to SDL_UpdateTexture if needed. */
-void* tex_pixels= NULL;
-int tex_pitch= 0;
-if(SDL_LockTexture(ctx->texture, NULL, &tex_pixels, &tex_pitch) == 0) {
+render_3d_sdl_mark_all_dirty(ctx);
+for(int y= 0; y < ctx->height; y++) {
+uint32_t* row= &ctx->pixels[y * ctx->pitch];
+for(int x= 0; x < ctx->width; x++) row[x]= col;
+}
+}
+/* Writes one framebuffer region into texture memory at `dst`, converting when the texture is not ARGB8888. Touches no
+   SDL state, so the copier thread can run it. */
+static void copy_rect(const SDL3DContext* ctx, const uint32_t* pixels, const SDL_Rect* rc, void* dst_pixels, int dst_pitch) {
+const size_t src_pitch= (size_t)ctx->pitch * sizeof(uint32_t);
+const uint32_t* src= pixels + (size_t)rc->y * (size_t)ctx->pitch + (size_t)rc->x;
+const size_t row_bytes= (size_t)rc->w * sizeof(uint32_t);
 if(ctx->texture_format == SDL_PIXELFORMAT_ARGB8888) {
-size_t row_bytes= (size_t)ctx->width * sizeof(uint32_t);
-/* Fast path: single memcpy when pitch matches */
-if(tex_pitch == (int)row_bytes) {
-memcpy(tex_pixels, ctx->pixels, row_bytes * (size_t)ctx->height);
+/* Fast path: single memcpy when both sides are contiguous */
+if(dst_pitch == (int)row_bytes && row_bytes == src_pitch) {
+memcpy(dst_pixels, src, row_bytes * (size_t)rc->h);
 } else {
-uint8_t* dst= (uint8_t*)tex_pixels;
-uint8_t* src= (uint8_t*)ctx->pixels;
-for(int y= 0; y < ctx->height; ++y) {
-memcpy(dst, src + (size_t)y * row_bytes, row_bytes);
-dst+= tex_pitch;
+uint8_t* dst= (uint8_t*)dst_pixels;
+const uint8_t* s= (const uint8_t*)src;
+for(int y= 0; y < rc->h; ++y) {
+memcpy(dst, s, row_bytes);
+dst+= dst_pitch;
+s+= src_pitch;
 }
 }
 } else {
-SDL_ConvertPixels(ctx->width, ctx->height, SDL_PIXELFORMAT_ARGB8888, ctx->pixels, ctx->width * (int)sizeof(uint32_t), ctx->texture_format, tex_pixels, tex_pitch);
+SDL_ConvertPixels(rc->w, rc->h, SDL_PIXELFORMAT_ARGB8888, src, (int)src_pitch, ctx->texture_format, dst_pixels, dst_pitch);
 }
+}
+/* Upload one framebuffer region. Try lock+write first; fall back to SDL_UpdateTexture if needed. */
+static void upload_rect(SDL3DContext* ctx, const uint32_t* pixels, const SDL_Rect* rc) {
+const size_t src_pitch= (size_t)ctx->pitch * sizeof(uint32_t);
+const uint32_t* src= pixels + (size_t)rc->y * (size_t)ctx->pitch + (size_t)rc->x;
+const size_t row_bytes= (size_t)rc->w * sizeof(uint32_t);
+void* tex_pixels= NULL;
+int tex_pitch= 0;
+if(SDL_LockTexture(ctx->texture, rc, &tex_pixels, &tex_pitch) == 0) {
+copy_rect(ctx, pixels, rc, tex_pixels, tex_pitch);
 SDL_UnlockTexture(ctx->texture);
-} else {
+return;
+}
 if(ctx->texture_format == SDL_PIXELFORMAT_ARGB8888) {
-SDL_UpdateTexture(ctx->texture, NULL, ctx->pixels, ctx->width * (int)sizeof(uint32_t));
-} else {
-size_t bufsize= (size_t)ctx->width * (size_t)ctx->height * 4;
-uint8_t* tmp= malloc(bufsize);
+SDL_UpdateTexture(ctx->texture, rc, src, (int)src_pitch);
+return;
+}
+uint8_t* tmp= malloc(row_bytes * (size_t)rc->h);
 if(tmp) {
-SDL_ConvertPixels(ctx->width, ctx->height, SDL_PIXELFORMAT_ARGB8888, ctx->pixels, ctx->width * (int)sizeof(uint32_t), ctx->texture_format, tmp, ctx->width * 4);
-SDL_UpdateTexture(ctx->texture, NULL, tmp, ctx->width * 4);
+SDL_ConvertPixels(rc->w, rc->h, SDL_PIXELFORMAT_ARGB8888, src, (int)src_pitch, ctx->texture_format, tmp, (int)row_bytes);
+SDL_UpdateTexture(ctx->texture, rc, tmp, (int)row_bytes);
 free(tmp);
 } else {
-SDL_UpdateTexture(ctx->texture, NULL, ctx->pixels, ctx->width * (int)sizeof(uint32_t));
+SDL_UpdateTexture(ctx->texture, rc, src, (int)src_pitch);
 }
 }
+static void upload_and_present(SDL3DContext* ctx, const uint32_t* pixels, const DirtyList* d, int w, int h) {
+for(int i= 0; i < d->count; i++) upload_rect(ctx, pixels, &d->rects[i]);
+/* Only the rendered corner of the texture is stretched over the whole target; no need to clear the renderer first */
+SDL_Rect src= {0, 0, w, h};
+SDL_RenderCopy(ctx->renderer, ctx->texture, &src, NULL);
+SDL_RenderPresent(ctx->renderer);
 }
-/* texture covers full target; no need to clear the renderer first */
-SDL_RenderCopy(ctx->renderer, ctx->texture, NULL, NULL);
+static void* copier_main(void* arg) {
+SDL3DContext* ctx= arg;
+pthread_mutex_lock(&ctx->lock);
+for(;;) {
+while(!ctx->stop && ctx->copying < 0) pthread_cond_wait(&ctx->cond, &ctx->lock);
+if(ctx->copying < 0) break;
+const uint32_t* src= ctx->frames[ctx->copying];
+SDL_Rect rc= ctx->copy_rect;
+void* dst= ctx->copy_dst;
+int dst_pitch= ctx->copy_dst_pitch;
+pthread_mutex_unlock(&ctx->lock);
+copy_rect(ctx, src, &rc, dst, dst_pitch);
+pthread_mutex_lock(&ctx->lock);
+ctx->copying= -1;
+pthread_cond_broadcast(&ctx->cond);
+}
+pthread_mutex_unlock(&ctx->lock);
+return NULL;
+}
+/* Waits for the copy in flight, then unlocks the texture and presents it */
+static void finish_copy(SDL3DContext* ctx) {
+if(!ctx->in_flight) return;
+pthread_mutex_lock(&ctx->lock);
+while(ctx->copying >= 0) pthread_cond_wait(&ctx->cond, &ctx->lock);
+pthread_mutex_unlock(&ctx->lock);
+SDL_UnlockTexture(ctx->texture);
+ctx->in_flight= false;
+SDL_Rect src= {0, 0, ctx->flight_w, ctx->flight_h};
+SDL_RenderCopy(ctx->renderer, ctx->texture, &src, NULL);
 SDL_RenderPresent(ctx->renderer);
+ctx->async_presented++;
+}
+static void free_spare_frames(SDL3DContext* ctx) {
+for(int i= 0; i < SDL3D_FRAME_RING; i++) {
+if(i == ctx->back) continue;
+free(ctx->frames[i]);
+ctx->frames[i]= NULL;
+ctx->stale[i].count= 0;
+}
+/* Keep the live back buffer in slot 0 for the synchronous path */
+ctx->frames[ctx->back]= NULL;
+ctx->frames[0]= ctx->pixels;
+ctx->back= 0;
+ctx->last_submitted= 0;
+}
+static void stop_copier(SDL3DContext* ctx) {
+if(!ctx->async) return;
+finish_copy(ctx);
+pthread_mutex_lock(&ctx->lock);
+ctx->stop= true;
+pthread_cond_broadcast(&ctx->cond);
+pthread_mutex_unlock(&ctx->lock);
+pthread_join(ctx->copier, NULL);
+pthread_cond_destroy(&ctx->cond);
+pthread_mutex_destroy(&ctx->lock);
+ctx->async= false;
+if(ctx->needs_sync) sync_back_buffer(ctx);
+free_spare_frames(ctx);
+}
+bool render_3d_sdl_set_async_present(SDL3DContext* ctx, bool enable) {
+if(!ctx || !ctx->initialized) return false;
+if(enable == ctx->async) return ctx->async;
+if(!enable) {
+stop_copier(ctx);
+return false;
+}
+/* Bare buffer fallback (no SDL or dummy driver without a renderer): keep presenting synchronously */
+if(!ctx->window || !ctx->renderer || !ctx->texture) return false;
+size_t frame_bytes= (size_t)ctx->pitch * (size_t)ctx->max_height * sizeof(uint32_t);
+for(int i= 1; i < SDL3D_FRAME_RING; i++) {
+ctx->frames[i]= malloc(frame_bytes);
+if(!ctx->frames[i]) {
+free_spare_frames(ctx);
+return false;
+}
+memcpy(ctx->frames[i], ctx->pixels, frame_bytes);
+ctx->stale[i].count= 0;
+}
+if(pthread_mutex_init(&ctx->lock, NULL) != 0) {
+free_spare_frames(ctx);
+return false;
+}
+if(pthread_cond_init(&ctx->cond, NULL) != 0) {
+pthread_mutex_destroy(&ctx->lock);
+free_spare_frames(ctx);
+return false;
+}
+ctx->stop= false;
+ctx->copying= -1;
+ctx->in_flight= false;
+ctx->last_submitted= ctx->back;
+if(pthread_create(&ctx->copier, NULL, copier_main, ctx) != 0) {
+pthread_cond_destroy(&ctx->cond);
+pthread_mutex_destroy(&ctx->lock);
+free_spare_frames(ctx);
+return false;
+}
+ctx->async= true;
+return true;
+}
+bool render_3d_sdl_is_async_present(const SDL3DContext* ctx) { return ctx ? ctx->async : false; }
+bool render_3d_sdl_has_renderer(const SDL3DContext* ctx) { return ctx && ctx->renderer && ctx->texture; }
+int render_3d_sdl_get_async_presented(const SDL3DContext* ctx) { return ctx ? ctx->async_presented : 0; }
+/* Locks the texture over the back buffer's changes, hands the copy to the copier and moves on to a buffer it is not
+   reading. The frame is presented by the next finish_copy. */
+static void submit_frame(SDL3DContext* ctx) {
+if(ctx->needs_sync) sync_back_buffer(ctx);
+int b= ctx->back;
+DirtyList d= ctx->dirty;
+if(ctx->force_full) {
+d.rects[0]= (SDL_Rect){0, 0, ctx->width, ctx->height};
+d.count= 1;
+}
+/* One lock covers every change; a locked region must be written in full, which the frame buffer can do */
+SDL_Rect box= d.rects[0];
+for(int i= 1; i < d.count; i++) rect_union(&box, &d.rects[i]);
+void* dst= NULL;
+int dst_pitch= 0;
+if(SDL_LockTexture(ctx->texture, &box, &dst, &dst_pitch) != 0) {
+upload_and_present(ctx, ctx->pixels, &d, ctx->width, ctx->height);
+ctx->dirty.count= 0;
+ctx->force_full= false;
+return;
+}
+for(int i= 0; i < SDL3D_FRAME_RING; i++) {
+if(i != b) dirty_list_merge(&ctx->stale[i], &ctx->dirty);
+}
+pthread_mutex_lock(&ctx->lock);
+ctx->copying= b;
+ctx->copy_rect= box;
+ctx->copy_dst= dst;
+ctx->copy_dst_pitch= dst_pitch;
+pthread_cond_broadcast(&ctx->cond);
+pthread_mutex_unlock(&ctx->lock);
+ctx->in_flight= true;
+ctx->flight_w= ctx->width;
+ctx->flight_h= ctx->height;
+int next= (b + 1) % SDL3D_FRAME_RING;
+ctx->last_submitted= b;
+ctx->back= next;
+ctx->pixels= ctx->frames[next];
+ctx->needs_sync= ctx->stale[next].count > 0;
+ctx->dirty.count= 0;
+ctx->force_full= false;
+}
+bool render_3d_sdl_present(SDL3DContext* ctx) {
+if(!ctx) return false;
+if(!ctx->renderer || !ctx->texture) {
+/* Bare buffer fallback: nothing to upload to */
+ctx->dirty.count= 0;
+return false;
+}
+SDL_PumpEvents();
+SDL_Event event;
+while(SDL_PollEvent(&event)) {
+switch(event.type) {
+case SDL_QUIT: return false;
+case SDL_KEYDOWN:
+if(event.key.keysym.sym == SDLK_ESCAPE) return false;
+break;
+case SDL_WINDOWEVENT: ctx->force_full= true; break;
+default: break;
+}
+}
+/* The previous frame's copy has had a whole frame of drawing to finish in; show it */
+if(ctx->async) finish_copy(ctx);
+/* Nothing drawn since the last present: keep the previous frame on screen */
+if(ctx->dirty.count == 0 && !ctx->force_full) return true;
+if(ctx->async) {
+submit_frame(ctx);
+return true;
+}
+if(ctx->force_full) render_3d_sdl_mark_all_dirty(ctx);
+upload_and_present(ctx, ctx->pixels, &ctx->dirty, ctx->width, ctx->height);
+ctx->dirty.count= 0;
+ctx->force_full= false;
 return true;
 }
@@ -0,0 +1,127 @@
+#include "render_3d_timing.h"
+#include "env.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+/* Log-linear buckets: values below 2*SUB are exact, above that each power of two is split into SUB buckets */
+#define TIMING_SUB_BITS 5
+#define TIMING_SUB (1 << TIMING_SUB_BITS)
+#define TIMING_MAX_SHIFT 35
+#define TIMING_BUCKETS (2 * TIMING_SUB + TIMING_MAX_SHIFT * TIMING_SUB)
+typedef struct {
+uint64_t counts[TIMING_BUCKETS];
+uint64_t total;
+uint64_t sum_ns;
+} TimingHist;
+static TimingHist timing_hist[RENDER_PASS_COUNT];
+static int timing_on= 0;
+static pthread_once_t timing_once= PTHREAD_ONCE_INIT;
+static volatile sig_atomic_t timing_dump_requested= 0;
+static const char* const timing_names[RENDER_PASS_COUNT]= {"decals", "floor", "walls", "sprites", "sprite_project", "sprite_sort", "sprite_draw", "minimap", "present", "frame"};
+static void timing_sigusr1_handler(int sig) {
+(void)sig;
+timing_dump_requested= 1;
+}
+static void timing_atexit_dump(void) {
+if(render_timing_enabled()) (void)render_timing_write_json(RENDER_TIMING_DEFAULT_PATH);
+}
+static void timing_init(void) {
+if(!env_bool("SNAKE_DEBUG_3D_TIMING", 0) && !env_bool("SNAKE_SPRITE_PROFILE", 0)) return;
+__atomic_store_n(&timing_on, 1, __ATOMIC_RELAXED);
+if(signal(SIGUSR1, timing_sigusr1_handler) == SIG_ERR) perror("signal(SIGUSR1)");
+(void)atexit(timing_atexit_dump);
+}
+bool render_timing_enabled(void) {
+(void)pthread_once(&timing_once, timing_init);
+return __atomic_load_n(&timing_on, __ATOMIC_RELAXED) != 0;
+}
+void render_timing_set_enabled(bool enabled) {
+(void)pthread_once(&timing_once, timing_init);
+__atomic_store_n(&timing_on, enabled ? 1 : 0, __ATOMIC_RELAXED);
+}
+uint64_t render_timing_now_ns(void) {
+struct timespec t;
+clock_gettime(CLOCK_MONOTONIC, &t);
+return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+static int timing_bucket(uint64_t v) {
+if(v < 2 * TIMING_SUB) return (int)v;
+int shift= 63 - __builtin_clzll(v) - TIMING_SUB_BITS;
+if(shift > TIMING_MAX_SHIFT) return TIMING_BUCKETS - 1;
+return 2 * TIMING_SUB + (shift - 1) * TIMING_SUB + (int)(v >> shift) - TIMING_SUB;
+}
+/* Midpoint of the values a bucket covers */
+static uint64_t timing_bucket_value(int idx) {
+if(idx < 2 * TIMING_SUB) return (uint64_t)idx;
+int shift= (idx - 2 * TIMING_SUB) / TIMING_SUB + 1;
+uint64_t mant= (uint64_t)((idx - 2 * TIMING_SUB) % TIMING_SUB + TIMING_SUB);
+return (mant << shift) + ((1ull << shift) >> 1);
+}
+void render_timing_record(RenderPass pass, uint64_t ns) {
+if((unsigned)pass >= RENDER_PASS_COUNT) return;
+TimingHist* h= &timing_hist[pass];
+__atomic_fetch_add(&h->counts[timing_bucket(ns)], 1, __ATOMIC_RELAXED);
+__atomic_fetch_add(&h->total, 1, __ATOMIC_RELAXED);
+__atomic_fetch_add(&h->sum_ns, ns, __ATOMIC_RELAXED);
+}
+uint64_t render_timing_begin(void) { return render_timing_enabled() ? render_timing_now_ns() : 0; }
+void render_timing_end(RenderPass pass, uint64_t start) {
+if(start) render_timing_record(pass, render_timing_now_ns() - start);
+}
+const char* render_timing_pass_name(RenderPass pass) { return (unsigned)pass < RENDER_PASS_COUNT ? timing_names[pass] : "unknown"; }
+uint64_t render_timing_count(RenderPass pass) { return (unsigned)pass < RENDER_PASS_COUNT ? __atomic_load_n(&timing_hist[pass].total, __ATOMIC_RELAXED) : 0; }
+uint64_t render_timing_percentile_ns(RenderPass pass, double pct) {
+if((unsigned)pass >= RENDER_PASS_COUNT) return 0;
+const TimingHist* h= &timing_hist[pass];
+uint64_t total= __atomic_load_n(&h->total, __ATOMIC_RELAXED);
+if(total == 0) return 0;
+if(pct < 0.0) pct= 0.0;
+if(pct > 100.0) pct= 100.0;
+uint64_t rank= (uint64_t)(pct / 100.0 * (double)total + 0.5);
+if(rank < 1) rank= 1;
+uint64_t seen= 0;
+for(int i= 0; i < TIMING_BUCKETS; i++) {
+seen+= __atomic_load_n(&h->counts[i], __ATOMIC_RELAXED);
+if(seen >= rank) return timing_bucket_value(i);
+}
+return timing_bucket_value(TIMING_BUCKETS - 1);
+}
+void render_timing_reset(void) { memset(timing_hist, 0, sizeof timing_hist); }
+bool render_timing_write_json(const char* path) {
+if(!path) return false;
+char tmp[512];
+if(snprintf(tmp, sizeof tmp, "%s.tmp", path) >= (int)sizeof tmp) return false;
+FILE* f= fopen(tmp, "w");
+if(!f) return false;
+bool ok= fprintf(f, "{\"unit\":\"ns\",\"passes\":{") >= 0;
+for(int p= 0; p < RENDER_PASS_COUNT && ok; p++) {
+const TimingHist* h= &timing_hist[p];
+uint64_t total= __atomic_load_n(&h->total, __ATOMIC_RELAXED);
+uint64_t sum= __atomic_load_n(&h->sum_ns, __ATOMIC_RELAXED);
+ok= fprintf(f, "%s\n\"%s\":{\"count\":%llu,\"mean\":%llu,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu,\"buckets\":[", p ? "," : "", timing_names[p], (unsigned long long)total, (unsigned long long)(total ? sum / total : 0), (unsigned long long)render_timing_percentile_ns((RenderPass)p, 50.0), (unsigned long long)render_timing_percentile_ns((RenderPass)p, 90.0), (unsigned long long)render_timing_percentile_ns((RenderPass)p, 99.0), (unsigned long long)render_timing_percentile_ns((RenderPass)p, 99.9), (unsigned long long)render_timing_percentile_ns((RenderPass)p, 100.0)) >= 0;
+/* Only occupied buckets, as [value, count] pairs */
+bool first= true;
+for(int i= 0; i < TIMING_BUCKETS && ok; i++) {
+uint64_t c= __atomic_load_n(&h->counts[i], __ATOMIC_RELAXED);
+if(!c) continue;
+ok= fprintf(f, "%s[%llu,%llu]", first ? "" : ",", (unsigned long long)timing_bucket_value(i), (unsigned long long)c) >= 0;
+first= false;
+}
+if(ok) ok= fprintf(f, "]}") >= 0;
+}
+if(ok) ok= fprintf(f, "\n}}\n") >= 0;
+if(fclose(f) != 0) ok= false;
+if(!ok || rename(tmp, path) != 0) {
+remove(tmp);
+return false;
+}
+return true;
+}
+void render_timing_poll(void) {
+if(!timing_dump_requested) return;
+timing_dump_requested= 0;
+(void)render_timing_write_json(RENDER_TIMING_DEFAULT_PATH);
+}
@@ -3,11 +3,12 @@
 #include "render_3d_sdl.h"
 #include "render_3d_sprite.h"
 #include "render_3d_sprite_internal.h"
+#include "render_3d_timing.h"
+#include <pthread.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
 /* Small helper: clamp float to 0..255 and return uint8_t */
 static inline uint8_t clamp_u8(float v) {
 if(v <= 0.0f) return 0;
@@ -20,6 +21,7 @@ int max_sprites;
 int count;
 const Camera3D* camera;
 const Projection3D* proj;
+const SpriteLighting* lighting;
 bool overlap_dirty;
 };
 #include "math_fast.h"
@@ -43,6 +45,12 @@ sr->camera= camera;
 sr->proj= proj;
 sr->overlap_dirty= true;
 }
+void sprite_set_view(SpriteRenderer3D* sr, const Camera3D* camera, const Projection3D* proj) {
+if(!sr) return;
+sr->camera= camera;
+sr->proj= proj;
+sr->overlap_dirty= true;
+}
 void sprite_clear(SpriteRenderer3D* sr) {
 if(!sr) return;
 sr->count= 0;
@@ -118,30 +126,20 @@ Sprite3D* s= &sr->sprites[sr->count - 1];
 s->shaded= true;
 return true;
 }
-/* Profiling helpers */
-static inline uint64_t now_ns(void) {
-struct timespec t;
-clock_gettime(CLOCK_MONOTONIC, &t);
-return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
-}
-/* Pre-computed lighting table for shaded spheres (32x32) */
-#define LIGHT_TABLE_SIZE 32
-static float lighting_table[LIGHT_TABLE_SIZE][LIGHT_TABLE_SIZE];
-static bool lighting_table_initialized= false;
-static void init_lighting_table(void) {
-if(lighting_table_initialized) return;
+void sprite_lighting_build(SpriteLighting* lt) {
+if(!lt) return;
 const float lnx= -0.40825f, lny= -0.40825f, lnz= 0.81650f;
 const float hnx= -0.26726f, hny= -0.26726f, hnz= 0.92582f;
 const float ambient= 0.25f;
 const float spec_strength= 0.5f;
-for(int yi= 0; yi < LIGHT_TABLE_SIZE; yi++) {
-for(int xi= 0; xi < LIGHT_TABLE_SIZE; xi++) {
+for(int yi= 0; yi < SPRITE_LIGHT_TABLE_SIZE; yi++) {
+for(int xi= 0; xi < SPRITE_LIGHT_TABLE_SIZE; xi++) {
 /* Map indices to -1..1 range */
-float nx= ((float)xi / (float)(LIGHT_TABLE_SIZE - 1)) * 2.0f - 1.0f;
-float ny= ((float)yi / (float)(LIGHT_TABLE_SIZE - 1)) * 2.0f - 1.0f;
+float nx= ((float)xi / (float)(SPRITE_LIGHT_TABLE_SIZE - 1)) * 2.0f - 1.0f;
+float ny= ((float)yi / (float)(SPRITE_LIGHT_TABLE_SIZE - 1)) * 2.0f - 1.0f;
 float n2= nx * nx + ny * ny;
 if(n2 > 1.0f) {
-lighting_table[yi][xi]= 0.0f; /* Outside sphere */
+lt->intensity[yi][xi]= 0.0f; /* Outside sphere */
 continue;
 }
 float nz= (1.0f - n2) * fast_inv_sqrt(1.0f - n2);
@@ -153,20 +151,26 @@ float sp2= spec * spec, sp4= sp2 * sp2, sp8= sp4 * sp4;
 spec= sp8 * sp8 * sp8 * spec_strength;
 float intensity= ambient + (1.0f - ambient) * diffuse + spec;
 if(intensity > 1.0f) intensity= 1.0f;
-lighting_table[yi][xi]= intensity;
+lt->intensity[yi][xi]= intensity;
 }
 }
-lighting_table_initialized= true;
 }
-/* Accumulators (nanoseconds) */
-static uint64_t sprite_time_project_ns= 0;
-static uint64_t sprite_time_sort_ns= 0;
-static uint64_t sprite_time_draw_ns= 0;
+/* Fallback for renderers not given a table (render_3d contexts share theirs through Render3DShared) */
+static SpriteLighting default_lighting;
+static pthread_once_t default_lighting_once= PTHREAD_ONCE_INIT;
+static void build_default_lighting(void) { sprite_lighting_build(&default_lighting); }
+void sprite_set_lighting(SpriteRenderer3D* sr, const SpriteLighting* lt) {
+if(sr) sr->lighting= lt;
+}
+static const SpriteLighting* sprite_lighting(SpriteRenderer3D* sr) {
+if(sr->lighting) return sr->lighting;
+(void)pthread_once(&default_lighting_once, build_default_lighting);
+sr->lighting= &default_lighting;
+return sr->lighting;
+}
 void sprite_project_all(SpriteRenderer3D* sr) {
 if(!sr || !sr->camera || !sr->proj) return;
-uint64_t start= 0;
-int do_profile= getenv("SNAKE_SPRITE_PROFILE") != NULL;
-if(do_profile) start= now_ns();
+uint64_t start= render_timing_begin();
 float cam_x, cam_y;
 camera_get_interpolated_position(sr->camera, &cam_x, &cam_y);
 float cam_angle= camera_get_interpolated_angle(sr->camera);
@@ -233,7 +237,7 @@ s->screen_h= screen_h;
 s->screen_y_top= top;
 s->visible= true;
 }
-if(do_profile) sprite_time_project_ns+= now_ns() - start;
+render_timing_end(RENDER_PASS_SPRITE_PROJECT, start);
 /* Only run expensive overlap check when sprites have changed */
 if(sr->overlap_dirty) {
 for(int i= 0; i < sr->count; ++i) {
@@ -288,23 +292,20 @@ arr[j + 1]= key;
 }
 void sprite_sort_by_depth(SpriteRenderer3D* sr) {
 if(!sr) return;
-uint64_t start= 0;
-int do_profile= getenv("SNAKE_SPRITE_PROFILE") != NULL;
-if(do_profile) start= now_ns();
+uint64_t start= render_timing_begin();
 if(sr->count <= SPRITE_SORT_INSERTION_THRESHOLD) {
 sprite_insertion_sort(sr->sprites, sr->count);
 } else {
 qsort(sr->sprites, (size_t)sr->count, sizeof(Sprite3D), sprite_cmp);
 }
-if(do_profile) sprite_time_sort_ns+= now_ns() - start;
+render_timing_end(RENDER_PASS_SPRITE_SORT, start);
 }
 void sprite_draw(SpriteRenderer3D* sr, SDL3DContext* ctx, const float* column_depths) {
 if(!sr || !ctx || !column_depths) return;
-uint64_t start= 0;
-int do_profile= getenv("SNAKE_SPRITE_PROFILE") != NULL;
-if(do_profile) start= now_ns();
+uint64_t start= render_timing_begin();
 const int scr_w= render_3d_sdl_get_width(ctx);
 const int scr_h= render_3d_sdl_get_height(ctx);
+const SpriteLighting* lighting= sprite_lighting(sr);
 for(int i= 0; i < sr->count; ++i) {
 Sprite3D* s= &sr->sprites[i];
 if(!s->visible) continue;
@@ -368,17 +369,16 @@ if(dx * dx + dy2 <= r2) {
 if(s->perp_distance < column_depths[xx]) {
 if(s->shaded) {
 /* Use pre-computed lighting table */
-if(!lighting_table_initialized) init_lighting_table();
 float nx= (float)dx / (float)radius;
 float ny= (float)dy / (float)radius;
-/* Map to table indices [0, LIGHT_TABLE_SIZE-1] */
-int xi= (int)((nx + 1.0f) * 0.5f * (float)(LIGHT_TABLE_SIZE - 1) + 0.5f);
-int yi= (int)((ny + 1.0f) * 0.5f * (float)(LIGHT_TABLE_SIZE - 1) + 0.5f);
+/* Map to table indices [0, SPRITE_LIGHT_TABLE_SIZE-1] */
+int xi= (int)((nx + 1.0f) * 0.5f * (float)(SPRITE_LIGHT_TABLE_SIZE - 1) + 0.5f);
+int yi= (int)((ny + 1.0f) * 0.5f * (float)(SPRITE_LIGHT_TABLE_SIZE - 1) + 0.5f);
 if(xi < 0) xi= 0;
-if(xi >= LIGHT_TABLE_SIZE) xi= LIGHT_TABLE_SIZE - 1;
+if(xi >= SPRITE_LIGHT_TABLE_SIZE) xi= SPRITE_LIGHT_TABLE_SIZE - 1;
 if(yi < 0) yi= 0;
-if(yi >= LIGHT_TABLE_SIZE) yi= LIGHT_TABLE_SIZE - 1;
-float intensity= lighting_table[yi][xi];
+if(yi >= SPRITE_LIGHT_TABLE_SIZE) yi= SPRITE_LIGHT_TABLE_SIZE - 1;
+float intensity= lighting->intensity[yi][xi];
 if(intensity <= 0.0f) continue; /* Outside sphere in table */
 uint8_t a= (uint8_t)((col >> 24) & 0xFFu);
 uint8_t br= (uint8_t)((col >> 16) & 0xFFu);
@@ -403,18 +403,7 @@ if(s->perp_distance < column_depths[x]) { render_3d_sdl_draw_column(ctx, x, y0,
 }
 }
 }
-if(do_profile) {
-sprite_time_draw_ns+= now_ns() - start;
-/* Append raw profile to a log file and also print to stderr for quick inspection */
-FILE* f= fopen("logs/sprite_profile.log", "a");
-if(f) {
-fprintf(f, "sprite_profile: project_ns=%llu sort_ns=%llu draw_ns=%llu count=%d\n", (unsigned long long)sprite_time_project_ns, (unsigned long long)sprite_time_sort_ns, (unsigned long long)sprite_time_draw_ns, sr->count);
-fclose(f);
-}
-fprintf(stderr, "sprite_profile: project_ns=%llu sort_ns=%llu draw_ns=%llu count=%d\n", (unsigned long long)sprite_time_project_ns, (unsigned long long)sprite_time_sort_ns, (unsigned long long)sprite_time_draw_ns, sr->count);
-/* Reset accumulators for next frame */
-sprite_time_project_ns= sprite_time_sort_ns= sprite_time_draw_ns= 0;
-}
+render_timing_end(RENDER_PASS_SPRITE_DRAW, start);
 }
 void sprite_shutdown(SpriteRenderer3D* sr) {
 if(!sr) return;
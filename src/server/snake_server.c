@@ -0,0 +1,778 @@
+/* pthread_setaffinity_np */
+#define _GNU_SOURCE
+#include "snake_server.h"
+#include "game.h"
+#include "input.h"
+#include "msg_ring.h"
+#include "net.h"
+#include "platform.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+/* Client frames are a few bytes; a longer one is a protocol error */
+#define SERVER_FRAME_MAX 256
+/* A client with this much still unsent is skipped for new states until it catches up: each state is complete, so
+   nothing is lost by sending only the newest */
+#define SERVER_OUT_MAX (64u << 10)
+#define SERVER_EVENTS 256
+#define SERVER_BACKLOG 128
+/* Joins in flight from one shard to another; a full queue drops the connection */
+#define SERVER_HANDOFF_RING (8u << 10)
+typedef struct Shard Shard;
+typedef struct Session Session;
+typedef struct Client Client;
+struct Client {
+int fd;
+/* Every connection, joined or not, is on its shard's client list */
+Client* prev;
+Client* next;
+Session* session;
+/* Index in session->clients and, while the round lasts, in the session's players */
+int slot;
+int player;
+bool dead;
+char name[PERSIST_PLAYER_NAME_MAX];
+unsigned char in_buf[4 + SERVER_FRAME_MAX];
+size_t in_len;
+unsigned char* out_buf;
+size_t out_off;
+size_t out_len;
+size_t out_cap;
+bool want_out;
+};
+struct Session {
+char name[SNAKE_SERVER_SESSION_MAX];
+/* Created for a join without a session name; only those are filled by auto-matching */
+bool open;
+Game* game;
+Client* clients[SNAKE_MAX_PLAYERS];
+int num_clients;
+int tick;
+uint64_t next_ms;
+/* Positions in the tick heap and in the session list */
+int heap_idx;
+int list_idx;
+};
+/* One worker thread and everything it touches: its listener, epoll set, clients, sessions and their games. Nothing
+   here is shared except `inbox`, `cpu` and `pub`. */
+struct Shard {
+SnakeServer* srv;
+int idx;
+int cpu;
+pthread_t thread;
+GameConfig* cfg;
+int listen_fd;
+int epfd;
+int wakefd;
+uint32_t seed;
+unsigned next_session_id;
+Client* clients;
+Session** sessions;
+/* Min-heap of the same sessions by next tick deadline */
+Session** heap;
+int num_sessions;
+int cap_sessions;
+/* One packed state per tick, length prefix included, queued to every client of the session */
+unsigned char* pack_buf;
+/* inbox[k] carries joins handed over by shard k: one producer and one consumer each, so no locks */
+MsgRing** inbox;
+/* Counters kept by the shard thread, and the copy it publishes for other threads after every loop pass */
+SnakeServerStats stats;
+SnakeServerStats pub;
+};
+struct SnakeServer {
+int port;
+int tick_ms;
+/* Per-receiver state filtering; radius 0 sends every client the same packed state */
+NetInterest interest;
+int running;
+bool started;
+int num_shards;
+Shard* shards;
+};
+/* A handed-over join: the socket, the join frame's payload, then whatever the client sent after it */
+typedef struct {
+int fd;
+uint32_t join_len;
+} Handoff;
+static int set_nonblocking(int fd) {
+int fl= fcntl(fd, F_GETFL, 0);
+return fl < 0 ? -1 : fcntl(fd, F_SETFL, fl | O_NONBLOCK);
+}
+static void put_u32(unsigned char* p, uint32_t v) {
+v= htonl(v);
+memcpy(p, &v, 4);
+}
+static uint64_t now_ns(void) {
+struct timespec ts;
+clock_gettime(CLOCK_MONOTONIC, &ts);
+return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+/* SnakeServerStats is all uint64_t, copied word by word with atomic accesses so readers see whole counters */
+static void stats_publish(SnakeServerStats* dst, const SnakeServerStats* src) {
+uint64_t* d= (uint64_t*)dst;
+const uint64_t* w= (const uint64_t*)src;
+for(size_t i= 0; i < sizeof *dst / sizeof(uint64_t); i++) __atomic_store_n(&d[i], w[i], __ATOMIC_RELAXED);
+}
+static void stats_read(SnakeServerStats* dst, const SnakeServerStats* src) {
+uint64_t* d= (uint64_t*)dst;
+const uint64_t* w= (const uint64_t*)src;
+for(size_t i= 0; i < sizeof *dst / sizeof(uint64_t); i++) d[i]= __atomic_load_n(&w[i], __ATOMIC_RELAXED);
+}
+/* The shard that owns a named session (FNV-1a of the name) */
+static int session_owner(const SnakeServer* srv, const char* name) {
+uint32_t h= 2166136261u;
+for(const char* p= name; *p; p++) h= (h ^ (unsigned char)*p) * 16777619u;
+return (int)(h % (uint32_t)srv->num_shards);
+}
+/* Tick heap */
+static void heap_set(Shard* sh, int i, Session* x) {
+sh->heap[i]= x;
+x->heap_idx= i;
+}
+static void heap_up(Shard* sh, int i) {
+Session* x= sh->heap[i];
+while(i > 0) {
+int parent= (i - 1) / 2;
+if(sh->heap[parent]->next_ms <= x->next_ms) break;
+heap_set(sh, i, sh->heap[parent]);
+i= parent;
+}
+heap_set(sh, i, x);
+}
+static void heap_down(Shard* sh, int i) {
+Session* x= sh->heap[i];
+for(;;) {
+int child= 2 * i + 1;
+if(child >= sh->num_sessions) break;
+if(child + 1 < sh->num_sessions && sh->heap[child + 1]->next_ms < sh->heap[child]->next_ms) child++;
+if(sh->heap[child]->next_ms >= x->next_ms) break;
+heap_set(sh, i, sh->heap[child]);
+i= child;
+}
+heap_set(sh, i, x);
+}
+/* Clients */
+static void client_watch(Shard* sh, Client* c, bool want_out) {
+if(c->want_out == want_out) return;
+struct epoll_event ev= {0};
+ev.events= EPOLLIN | (want_out ? (uint32_t)EPOLLOUT : 0u);
+ev.data.ptr= c;
+if(epoll_ctl(sh->epfd, EPOLL_CTL_MOD, c->fd, &ev) == 0) c->want_out= want_out;
+}
+/* Writes as much of the queue as the socket takes; marks the client dead on a hard error */
+static void client_flush(Shard* sh, Client* c) {
+while(c->out_off < c->out_len) {
+ssize_t n= send(c->fd, c->out_buf + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+if(n > 0) {
+c->out_off+= (size_t)n;
+sh->stats.bytes_out+= (uint64_t)n;
+continue;
+}
+if(n < 0 && errno == EINTR) continue;
+if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+c->dead= true;
+return;
+}
+if(c->out_off == c->out_len) c->out_off= c->out_len= 0;
+client_watch(sh, c, c->out_off < c->out_len);
+}
+/* Queues one frame (`frame` already carries its length prefix) and tries to send it right away */
+static bool client_queue(Shard* sh, Client* c, const unsigned char* frame, size_t n) {
+if(c->dead || c->out_len - c->out_off > SERVER_OUT_MAX) return false;
+if(c->out_off > 0 && c->out_len + n > c->out_cap) {
+memmove(c->out_buf, c->out_buf + c->out_off, c->out_len - c->out_off);
+c->out_len-= c->out_off;
+c->out_off= 0;
+}
+if(c->out_len + n > c->out_cap) {
+size_t cap= c->out_cap ? c->out_cap : 4096;
+while(cap < c->out_len + n) cap*= 2;
+unsigned char* nb= realloc(c->out_buf, cap);
+if(!nb) return false;
+c->out_buf= nb;
+c->out_cap= cap;
+}
+memcpy(c->out_buf + c->out_len, frame, n);
+c->out_len+= n;
+client_flush(sh, c);
+return true;
+}
+/* Takes over a connected socket; NULL (socket closed) when it cannot be watched */
+static Client* client_add(Shard* sh, int fd) {
+Client* c= calloc(1, sizeof *c);
+struct epoll_event ev= {0};
+ev.events= EPOLLIN;
+ev.data.ptr= c;
+if(!c || epoll_ctl(sh->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+free(c);
+close(fd);
+return NULL;
+}
+c->fd= fd;
+c->next= sh->clients;
+if(c->next) c->next->prev= c;
+sh->clients= c;
+sh->stats.clients++;
+return c;
+}
+/* Forgets a client without closing its socket */
+static void client_detach(Shard* sh, Client* c) {
+if(c->prev)
+c->prev->next= c->next;
+else
+sh->clients= c->next;
+if(c->next) c->next->prev= c->prev;
+epoll_ctl(sh->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+free(c->out_buf);
+free(c);
+sh->stats.clients--;
+}
+/* Sessions */
+static Session* session_open(Shard* sh, const char* name, bool open) {
+if(sh->num_sessions == sh->cap_sessions) {
+int cap= sh->cap_sessions ? sh->cap_sessions * 2 : 16;
+Session** list= realloc(sh->sessions, (size_t)cap * sizeof *list);
+if(!list) return NULL;
+sh->sessions= list;
+Session** heap= realloc(sh->heap, (size_t)cap * sizeof *heap);
+if(!heap) return NULL;
+sh->heap= heap;
+sh->cap_sessions= cap;
+}
+Session* ss= calloc(1, sizeof *ss);
+if(!ss) return NULL;
+if(name[0]) {
+snprintf(ss->name, sizeof ss->name, "%s", name);
+} else {
+/* Generated names are picked so that they route back to this shard */
+do
+snprintf(ss->name, sizeof ss->name, "S%u", ++sh->next_session_id);
+while(session_owner(sh->srv, ss->name) != sh->idx);
+}
+ss->open= open;
+ss->next_ms= platform_now_ms() + (uint64_t)sh->srv->tick_ms;
+ss->list_idx= sh->num_sessions;
+sh->sessions[sh->num_sessions]= ss;
+sh->heap[sh->num_sessions]= ss;
+sh->num_sessions++;
+heap_up(sh, ss->list_idx);
+sh->stats.sessions= (uint64_t)sh->num_sessions;
+return ss;
+}
+static void session_close(Shard* sh, Session* ss) {
+int last= sh->num_sessions - 1;
+Session* moved= sh->sessions[last];
+sh->sessions[ss->list_idx]= moved;
+moved->list_idx= ss->list_idx;
+int h= ss->heap_idx;
+Session* tail= sh->heap[last];
+sh->num_sessions--;
+if(h != last) {
+heap_set(sh, h, tail);
+heap_up(sh, h);
+heap_down(sh, tail->heap_idx);
+}
+sh->stats.sessions= (uint64_t)sh->num_sessions;
+game_destroy(ss->game);
+free(ss);
+}
+/* A new round with the current roster: players are the occupied slots in order */
+static void session_rebuild(Shard* sh, Session* ss) {
+game_destroy(ss->game);
+ss->game= NULL;
+if(ss->num_clients == 0) return;
+int n= 0;
+for(int i= 0; i < SNAKE_MAX_PLAYERS; i++) {
+Client* c= ss->clients[i];
+if(!c) continue;
+c->player= n;
+game_config_set_player_name_for(sh->cfg, n, c->name);
+n++;
+}
+game_config_set_num_players(sh->cfg, n);
+ss->game= game_create(sh->cfg, ++sh->seed);
+}
+static Session* session_find(Shard* sh, const char* name) {
+for(int i= 0; i < sh->num_sessions; i++) {
+Session* ss= sh->sessions[i];
+if(name[0] ? strcmp(ss->name, name) == 0 : (ss->open && ss->num_clients < SNAKE_MAX_PLAYERS)) return ss;
+}
+return NULL;
+}
+static bool name_taken(const Session* ss, const char* name) {
+for(int i= 0; i < SNAKE_MAX_PLAYERS; i++)
+if(ss->clients[i] && strcmp(ss->clients[i]->name, name) == 0) return true;
+return false;
+}
+static void client_close(Shard* sh, Client* c) {
+Session* ss= c->session;
+if(ss) {
+ss->clients[c->slot]= NULL;
+ss->num_clients--;
+if(ss->num_clients == 0)
+session_close(sh, ss);
+else
+session_rebuild(sh, ss);
+}
+int fd= c->fd;
+client_detach(sh, c);
+close(fd);
+}
+/* The session name of a 'J' frame, or false when the frame is malformed */
+static bool join_session_name(const unsigned char* p, size_t n, char out[SNAKE_SERVER_SESSION_MAX]) {
+if(n < 2 || p[0] != 'J' || p[1] >= SNAKE_SERVER_SESSION_MAX || (size_t)p[1] + 2 > n) return false;
+memcpy(out, p + 2, p[1]);
+out[p[1]]= '\0';
+return strlen(out) == p[1];
+}
+/* 'J' len session name: places the client in a session of this shard and answers with a welcome frame */
+static bool client_join(Shard* sh, Client* c, const unsigned char* p, size_t n) {
+char sess_name[SNAKE_SERVER_SESSION_MAX];
+/* Room left for a de-duplicating digit */
+char base[PERSIST_PLAYER_NAME_MAX - 4];
+if(!join_session_name(p, n, sess_name)) return false;
+size_t name_len= n - 2 - p[1];
+if(name_len >= sizeof base) return false;
+memcpy(base, p + 2 + p[1], name_len);
+base[name_len]= '\0';
+if(strlen(base) != name_len) return false;
+Session* ss= session_find(sh, sess_name);
+if(!ss) ss= session_open(sh, sess_name, sess_name[0] == '\0');
+if(!ss || ss->num_clients >= SNAKE_MAX_PLAYERS) return false;
+if(!base[0]) snprintf(base, sizeof base, "Player");
+snprintf(c->name, sizeof c->name, "%s", base);
+/* At most SNAKE_MAX_PLAYERS - 1 others can hold the name, so one digit always suffices */
+for(int k= 2; name_taken(ss, c->name); k++) snprintf(c->name, sizeof c->name, "%s%c", base, (char)('0' + k));
+int slot= 0;
+while(ss->clients[slot]) slot++;
+ss->clients[slot]= c;
+ss->num_clients++;
+c->session= ss;
+c->slot= slot;
+session_rebuild(sh, ss);
+if(!ss->game) return false;
+unsigned char w[4 + 3 + SNAKE_SERVER_SESSION_MAX + PERSIST_PLAYER_NAME_MAX];
+size_t sl= strlen(ss->name), nl= strlen(c->name);
+w[4]= 'W';
+w[5]= (unsigned char)sl;
+memcpy(w + 6, ss->name, sl);
+memcpy(w + 6 + sl, c->name, nl);
+put_u32(w, (uint32_t)(2 + sl + nl));
+return client_queue(sh, c, w, 6 + sl + nl);
+}
+/* Moves a client whose join names a session owned by another shard over to that shard, together with any bytes it
+   sent after the join; the socket itself keeps the rest. The client is gone from this shard either way. */
+static void client_handoff(Shard* sh, Client* c, int owner, const unsigned char* join, size_t join_len,
+                           const unsigned char* rest, size_t rest_len) {
+unsigned char msg[sizeof(Handoff) + 2 * SERVER_FRAME_MAX + 4];
+Handoff h= {c->fd, (uint32_t)join_len};
+memcpy(msg, &h, sizeof h);
+memcpy(msg + sizeof h, join, join_len);
+memcpy(msg + sizeof h + join_len, rest, rest_len);
+int fd= c->fd;
+client_detach(sh, c);
+Shard* dst= &sh->srv->shards[owner];
+if(!msg_ring_push(dst->inbox[sh->idx], (const char*)msg, sizeof h + join_len + rest_len)) {
+sh->stats.handoffs_dropped++;
+close(fd);
+return;
+}
+sh->stats.handoffs_out++;
+uint64_t one= 1;
+ssize_t rc= write(dst->wakefd, &one, sizeof one);
+(void)rc;
+}
+static bool client_frame(Shard* sh, Client* c, const unsigned char* p, size_t n) {
+if(!c->session) return client_join(sh, c, p, n);
+if(n != 1) return true;
+InputState in;
+if(!net_unpack_input(p, n, &in)) return false;
+if(in.quit) return false;
+/* Clients steer their own snake only: restart and pause would act on the whole session */
+in.restart= false;
+in.pause_toggle= false;
+sh->stats.inputs++;
+if(c->session->game) game_enqueue_input(c->session->game, c->player, &in);
+return true;
+}
+typedef enum { PARSE_OK, PARSE_DROP, PARSE_MOVED } ParseResult;
+/* Handles every complete frame in the input buffer */
+static ParseResult client_parse(Shard* sh, Client* c) {
+size_t off= 0;
+ParseResult res= PARSE_OK;
+while(c->in_len - off >= 4) {
+uint32_t len;
+memcpy(&len, c->in_buf + off, 4);
+len= ntohl(len);
+if(len == 0 || len > SERVER_FRAME_MAX) return PARSE_DROP;
+if(c->in_len - off < 4 + (size_t)len) break;
+const unsigned char* p= c->in_buf + off + 4;
+off+= 4 + (size_t)len;
+char sess_name[SNAKE_SERVER_SESSION_MAX];
+if(!c->session && sh->srv->num_shards > 1 && join_session_name(p, len, sess_name) && sess_name[0]) {
+int owner= session_owner(sh->srv, sess_name);
+if(owner != sh->idx) {
+client_handoff(sh, c, owner, p, len, c->in_buf + off, c->in_len - off);
+return PARSE_MOVED;
+}
+}
+if(!client_frame(sh, c, p, len)) {
+res= PARSE_DROP;
+break;
+}
+}
+memmove(c->in_buf, c->in_buf + off, c->in_len - off);
+c->in_len-= off;
+return res;
+}
+/* Reads everything available; PARSE_DROP when the client is gone or misbehaved */
+static ParseResult client_read(Shard* sh, Client* c) {
+for(;;) {
+ssize_t n= recv(c->fd, c->in_buf + c->in_len, sizeof c->in_buf - c->in_len, 0);
+if(n == 0) return PARSE_DROP;
+if(n < 0) {
+if(errno == EINTR) continue;
+return errno == EAGAIN || errno == EWOULDBLOCK ? PARSE_OK : PARSE_DROP;
+}
+c->in_len+= (size_t)n;
+ParseResult res= client_parse(sh, c);
+if(res != PARSE_OK) return res;
+}
+}
+/* Joins handed over by other shards */
+static void shard_drain_inbox(Shard* sh) {
+for(int k= 0; k < sh->srv->num_shards; k++) {
+MsgRing* ring= sh->inbox[k];
+if(!ring) continue;
+size_t len;
+const char* m;
+while((m= msg_ring_peek(ring, &len)) != NULL) {
+Handoff h;
+memcpy(&h, m, sizeof h);
+const unsigned char* join= (const unsigned char*)m + sizeof h;
+size_t rest_len= len - sizeof h - h.join_len;
+Client* c= client_add(sh, h.fd);
+sh->stats.handoffs_in++;
+if(c) {
+memcpy(c->in_buf, join + h.join_len, rest_len);
+c->in_len= rest_len;
+if(!client_join(sh, c, join, h.join_len) || client_parse(sh, c) != PARSE_OK) c->dead= true;
+}
+msg_ring_pop(ring);
+if(c && c->dead) client_close(sh, c);
+}
+}
+}
+static void shard_accept(Shard* sh) {
+for(;;) {
+int fd= accept(sh->listen_fd, NULL, NULL);
+if(fd < 0) {
+if(errno == EINTR) continue;
+return;
+}
+int one= 1;
+if(set_nonblocking(fd) != 0) {
+close(fd);
+continue;
+}
+setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+(void)client_add(sh, fd);
+}
+}
+static void session_tick(Shard* sh, Session* ss) {
+Game* g= ss->game;
+if(!g) return;
+game_step(g, NULL);
+ss->tick++;
+sh->stats.ticks++;
+const GameState* gs= game_get_state(g);
+const NetInterest* in= &sh->srv->interest;
+bool filtered= in->radius > 0;
+/* One state for everyone, or with interest management one per client as its own snake sees the board */
+size_t n= filtered ? 0 : net_pack_state(gs, ss->tick, sh->pack_buf + 4, NET_STATE_MAX_PACKED);
+for(int i= 0; i < SNAKE_MAX_PLAYERS; i++) {
+Client* c= ss->clients[i];
+if(!c) continue;
+if(filtered) n= net_pack_state_for(gs, ss->tick, c->player, in, sh->pack_buf + 4, NET_STATE_MAX_PACKED);
+if(n == 0) continue;
+put_u32(sh->pack_buf, (uint32_t)n);
+if(client_queue(sh, c, sh->pack_buf, n + 4))
+sh->stats.states_sent++;
+else
+sh->stats.states_dropped++;
+}
+/* The finished round has been sent once; start the next */
+if(game_get_status(g) == GAME_STATUS_GAME_OVER) game_reset(g);
+}
+/* Closes the clients a tick found dead; the session may go with them */
+static void session_reap(Shard* sh, Session* ss) {
+Client* dead[SNAKE_MAX_PLAYERS];
+int n= 0;
+for(int i= 0; i < SNAKE_MAX_PLAYERS; i++)
+if(ss->clients[i] && ss->clients[i]->dead) dead[n++]= ss->clients[i];
+for(int i= 0; i < n; i++) client_close(sh, dead[i]);
+}
+/* One pass of a shard's loop: waits for I/O or its next session tick, then handles both */
+static int shard_poll(Shard* sh, int max_wait_ms) {
+uint64_t now= platform_now_ms();
+int wait= max_wait_ms;
+if(sh->num_sessions > 0) {
+uint64_t due= sh->heap[0]->next_ms;
+int until= due <= now ? 0 : (due - now > (uint64_t)max_wait_ms ? max_wait_ms : (int)(due - now));
+if(until < wait) wait= until;
+}
+struct epoll_event evs[SERVER_EVENTS];
+int n= epoll_wait(sh->epfd, evs, SERVER_EVENTS, wait);
+if(n < 0 && errno != EINTR) return -1;
+for(int i= 0; i < n; i++) {
+void* tag= evs[i].data.ptr;
+if(!tag) {
+shard_accept(sh);
+continue;
+}
+if(tag == sh) {
+uint64_t v;
+while(read(sh->wakefd, &v, sizeof v) == (ssize_t)sizeof v) {}
+shard_drain_inbox(sh);
+continue;
+}
+Client* c= tag;
+if(evs[i].events & EPOLLOUT) client_flush(sh, c);
+if(!c->dead && (evs[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))) {
+ParseResult res= client_read(sh, c);
+if(res == PARSE_MOVED) continue;
+if(res == PARSE_DROP) c->dead= true;
+}
+if(c->dead) client_close(sh, c);
+}
+now= platform_now_ms();
+while(sh->num_sessions > 0 && sh->heap[0]->next_ms <= now) {
+Session* ss= sh->heap[0];
+uint64_t lag= now - ss->next_ms;
+if(lag > sh->stats.lag_ms_max) sh->stats.lag_ms_max= lag;
+uint64_t t0= now_ns();
+session_tick(sh, ss);
+uint64_t spent= now_ns() - t0;
+sh->stats.tick_ns_total+= spent;
+if(spent > sh->stats.tick_ns_max) sh->stats.tick_ns_max= spent;
+/* A session that fell more than a tick behind skips ahead instead of bursting */
+ss->next_ms+= (uint64_t)sh->srv->tick_ms;
+if(ss->next_ms <= now) ss->next_ms= now + (uint64_t)sh->srv->tick_ms;
+heap_down(sh, 0);
+session_reap(sh, ss);
+}
+stats_publish(&sh->pub, &sh->stats);
+return 0;
+}
+static void* shard_main(void* arg) {
+Shard* sh= arg;
+long ncpu= sysconf(_SC_NPROCESSORS_ONLN);
+if(ncpu > 0) {
+cpu_set_t set;
+CPU_ZERO(&set);
+int cpu= (int)(sh->idx % ncpu);
+CPU_SET((size_t)cpu, &set);
+if(pthread_setaffinity_np(pthread_self(), sizeof set, &set) == 0) __atomic_store_n(&sh->cpu, cpu, __ATOMIC_RELAXED);
+}
+while(__atomic_load_n(&sh->srv->running, __ATOMIC_ACQUIRE))
+if(shard_poll(sh, 1000) != 0) break;
+return NULL;
+}
+static void shard_free(Shard* sh) {
+/* Sessions go with their last client */
+while(sh->clients) client_close(sh, sh->clients);
+for(int k= 0; sh->inbox && k < sh->srv->num_shards; k++) {
+size_t len;
+const char* m;
+while(sh->inbox[k] && (m= msg_ring_peek(sh->inbox[k], &len)) != NULL) {
+Handoff h;
+memcpy(&h, m, sizeof h);
+close(h.fd);
+msg_ring_pop(sh->inbox[k]);
+}
+msg_ring_destroy(sh->inbox[k]);
+}
+free(sh->inbox);
+if(sh->listen_fd >= 0) close(sh->listen_fd);
+if(sh->epfd >= 0) close(sh->epfd);
+if(sh->wakefd >= 0) close(sh->wakefd);
+free(sh->sessions);
+free(sh->heap);
+free(sh->pack_buf);
+game_config_destroy(sh->cfg);
+}
+/* Every shard listens on the same port with SO_REUSEPORT, so the kernel spreads new connections across them */
+static int shard_listen(Shard* sh, int port) {
+sh->listen_fd= socket(AF_INET, SOCK_STREAM, 0);
+if(sh->listen_fd < 0) return -1;
+int one= 1;
+setsockopt(sh->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+setsockopt(sh->listen_fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof one);
+struct sockaddr_in addr= {0};
+socklen_t alen= sizeof addr;
+addr.sin_family= AF_INET;
+addr.sin_addr.s_addr= htonl(INADDR_ANY);
+addr.sin_port= htons((uint16_t)port);
+if(bind(sh->listen_fd, (struct sockaddr*)&addr, sizeof addr) != 0 || listen(sh->listen_fd, SERVER_BACKLOG) != 0) return -1;
+if(getsockname(sh->listen_fd, (struct sockaddr*)&addr, &alen) != 0 || set_nonblocking(sh->listen_fd) != 0) return -1;
+return ntohs(addr.sin_port);
+}
+static int shard_init(Shard* sh, const GameConfig* cfg, int port) {
+sh->cfg= game_config_create();
+sh->pack_buf= malloc(4 + NET_STATE_MAX_PACKED);
+sh->inbox= calloc((size_t)sh->srv->num_shards, sizeof *sh->inbox);
+if(!sh->cfg || !sh->pack_buf || !sh->inbox) return -1;
+for(int k= 0; k < sh->srv->num_shards; k++)
+if(k != sh->idx && (sh->inbox[k]= msg_ring_create(SERVER_HANDOFF_RING)) == NULL) return -1;
+if(cfg) {
+int w= 0, h= 0;
+game_config_get_board_size(cfg, &w, &h);
+game_config_set_board_size(sh->cfg, w, h);
+game_config_set_tick_rate_ms(sh->cfg, game_config_get_tick_rate_ms(cfg));
+game_config_set_max_food(sh->cfg, game_config_get_max_food(cfg));
+game_config_set_max_length(sh->cfg, game_config_get_max_length(cfg));
+sh->seed= game_config_get_seed(cfg);
+}
+sh->seed+= (uint32_t)sh->idx * 0x9E3779B9u;
+game_config_set_max_players(sh->cfg, SNAKE_MAX_PLAYERS);
+int bound= shard_listen(sh, port);
+if(bound < 0) return -1;
+sh->epfd= epoll_create1(0);
+sh->wakefd= eventfd(0, EFD_NONBLOCK);
+if(sh->epfd < 0 || sh->wakefd < 0) return -1;
+/* data.ptr is a Client; NULL marks the listener and the shard itself the wake fd */
+struct epoll_event ev= {0};
+ev.events= EPOLLIN;
+ev.data.ptr= NULL;
+if(epoll_ctl(sh->epfd, EPOLL_CTL_ADD, sh->listen_fd, &ev) != 0) return -1;
+ev.data.ptr= sh;
+if(epoll_ctl(sh->epfd, EPOLL_CTL_ADD, sh->wakefd, &ev) != 0) return -1;
+return bound;
+}
+SnakeServer* snake_server_create(const GameConfig* cfg, int port, int shards) {
+if(shards <= 0) {
+long ncpu= sysconf(_SC_NPROCESSORS_ONLN);
+shards= ncpu > 0 ? (int)ncpu : 1;
+}
+if(shards > SNAKE_SERVER_MAX_SHARDS) shards= SNAKE_SERVER_MAX_SHARDS;
+SnakeServer* s= calloc(1, sizeof *s);
+if(!s) return NULL;
+s->shards= calloc((size_t)shards, sizeof *s->shards);
+if(!s->shards) {
+free(s);
+return NULL;
+}
+s->num_shards= shards;
+for(int i= 0; i < shards; i++) {
+Shard* sh= &s->shards[i];
+sh->srv= s;
+sh->idx= i;
+sh->cpu= -1;
+sh->listen_fd= sh->epfd= sh->wakefd= -1;
+}
+s->tick_ms= cfg ? game_config_get_tick_rate_ms(cfg) : 0;
+if(cfg) {
+s->interest.radius= game_config_get_server_interest_radius(cfg);
+s->interest.view_range= game_config_get_server_interest_view(cfg);
+s->interest.far_ticks= game_config_get_server_interest_far_ticks(cfg);
+}
+if(s->tick_ms < 1) {
+GameConfig* def= game_config_create();
+s->tick_ms= def ? game_config_get_tick_rate_ms(def) : 100;
+game_config_destroy(def);
+if(s->tick_ms < 1) s->tick_ms= 1;
+}
+/* The first shard picks the port (any free one for 0) and the others bind the same */
+for(int i= 0; i < shards; i++) {
+int bound= shard_init(&s->shards[i], cfg, i == 0 ? port : s->port);
+if(bound < 0) {
+snake_server_destroy(s);
+return NULL;
+}
+s->port= bound;
+}
+return s;
+}
+int snake_server_start(SnakeServer* s) {
+if(!s || s->started) return -1;
+__atomic_store_n(&s->running, 1, __ATOMIC_RELEASE);
+for(int i= 0; i < s->num_shards; i++) {
+if(pthread_create(&s->shards[i].thread, NULL, shard_main, &s->shards[i]) == 0) continue;
+/* Stop the threads already running; the server stays unusable */
+__atomic_store_n(&s->running, 0, __ATOMIC_RELEASE);
+for(int k= 0; k < i; k++) {
+uint64_t one= 1;
+ssize_t rc= write(s->shards[k].wakefd, &one, sizeof one);
+(void)rc;
+pthread_join(s->shards[k].thread, NULL);
+}
+return -1;
+}
+s->started= true;
+return 0;
+}
+void snake_server_stop(SnakeServer* s) {
+if(!s || !s->started) return;
+__atomic_store_n(&s->running, 0, __ATOMIC_RELEASE);
+for(int i= 0; i < s->num_shards; i++) {
+uint64_t one= 1;
+ssize_t rc= write(s->shards[i].wakefd, &one, sizeof one);
+(void)rc;
+}
+for(int i= 0; i < s->num_shards; i++) pthread_join(s->shards[i].thread, NULL);
+s->started= false;
+}
+void snake_server_destroy(SnakeServer* s) {
+if(!s) return;
+snake_server_stop(s);
+for(int i= 0; i < s->num_shards; i++) shard_free(&s->shards[i]);
+free(s->shards);
+free(s);
+}
+int snake_server_get_port(const SnakeServer* s) { return s ? s->port : 0; }
+int snake_server_get_shard_count(const SnakeServer* s) { return s ? s->num_shards : 0; }
+int snake_server_get_shard_cpu(const SnakeServer* s, int shard) {
+if(!s || shard < 0 || shard >= s->num_shards) return -1;
+return __atomic_load_n(&s->shards[shard].cpu, __ATOMIC_RELAXED);
+}
+void snake_server_get_shard_stats(const SnakeServer* s, int shard, SnakeServerStats* out) {
+if(!out) return;
+memset(out, 0, sizeof *out);
+if(!s || shard < 0 || shard >= s->num_shards) return;
+stats_read(out, &s->shards[shard].pub);
+}
+void snake_server_get_stats(const SnakeServer* s, SnakeServerStats* out) {
+if(!out) return;
+memset(out, 0, sizeof *out);
+for(int i= 0; s && i < s->num_shards; i++) {
+SnakeServerStats sh;
+stats_read(&sh, &s->shards[i].pub);
+out->sessions+= sh.sessions;
+out->clients+= sh.clients;
+out->ticks+= sh.ticks;
+out->inputs+= sh.inputs;
+out->states_sent+= sh.states_sent;
+out->states_dropped+= sh.states_dropped;
+out->bytes_out+= sh.bytes_out;
+out->tick_ns_total+= sh.tick_ns_total;
+if(sh.tick_ns_max > out->tick_ns_max) out->tick_ns_max= sh.tick_ns_max;
+if(sh.lag_ms_max > out->lag_ms_max) out->lag_ms_max= sh.lag_ms_max;
+out->handoffs_in+= sh.handoffs_in;
+out->handoffs_out+= sh.handoffs_out;
+out->handoffs_dropped+= sh.handoffs_dropped;
+}
+}
@@ -4,350 +4,35 @@
 #include "game_internal.h"
 #include "input.h"
 #include "mpapi_client.h"
+#include "net.h"
+#include "net_delta.h"
+#include "net_json.h"
 #include "net_log.h"
+#include "net_predict.h"
 #include "persist.h"
 #include "platform.h"
 #include "render.h"
 #include "render_3d.h"
+#include "trace.h"
 #include "tty.h"
 #include "types.h"
-#include <ctype.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-/* Remote snake data received from other clients - now integrated into GameState directly */
-/* Simple JSON field extraction (reusable) */
-static int parse_json_int(const char* json, const char* key) {
-char needle[64];
-snprintf(needle, sizeof(needle), "\"%s\"", key);
-const char* p= strstr(json, needle);
-if(!p) return 0;
-p= strchr(p, ':');
-if(!p) return 0;
-p++;
-while(*p && isspace((unsigned char)*p)) p++;
-return atoi(p);
-}
-static void parse_json_str(const char* json, const char* key, char* out, int maxlen) {
-out[0]= '\0';
-char needle[64];
-snprintf(needle, sizeof(needle), "\"%s\"", key);
-const char* p= strstr(json, needle);
-if(!p) return;
-p= strchr(p, ':');
-if(!p) return;
-p++;
-while(*p && isspace((unsigned char)*p)) p++;
-if(*p != '"') return;
-p++;
-int i= 0;
-while(*p && *p != '"' && i < maxlen - 1) {
-if(*p == '\\' && p[1]) { p++; }
-out[i++]= *p++;
-}
-out[i]= '\0';
-}
-/* Parse incoming game state JSON from another client */
-static void parse_remote_game_state(Game* g, const char* json, bool is_host) {
-if(!json || !strstr(json, "\"type\":\"state\"")) return;
-net_log_info("parse_remote_game_state: RECEIVED state message (is_host=%d)", is_host);
-GameState* gs= (GameState*)game_get_state(g);
-if(!gs) return;
-/* Find players array */
-const char* players_field= strstr(json, "\"players\":[");
-if(players_field) {
-players_field= strchr(players_field, '[');
-if(players_field) {
-players_field++;
-while(*players_field) {
-const char* obj_start= strchr(players_field, '{');
-if(!obj_start) break;
-const char* p= obj_start + 1;
-int depth= 1;
-while(*p && depth > 0) {
-if(*p == '{' || *p == '[')
-depth++;
-else if(*p == '}' || *p == ']')
-depth--;
-p++;
-}
-if(depth != 0) break;
-const char* obj_end= p - 1;
-int len= (int)(obj_end - obj_start + 1);
-if(len > 0 && len < 8192) {
-char* obj= malloc((size_t)len + 1);
-if(!obj) break;
-memcpy(obj, obj_start, (size_t)len);
-obj[len]= '\0';
-char name[PERSIST_PLAYER_NAME_MAX];
-parse_json_str(obj, "name", name, (int)sizeof(name));
-/* Skip if this is our own player state reflected back */
-bool is_self= false;
-for(int i= 0; i < gs->num_players; i++) {
-if(!gs->players[i].is_remote && strcmp(gs->players[i].name, name) == 0) {
-is_self= true;
-break;
-}
-}
-if(!is_self) {
-int player_idx= -1;
-for(int i= 0; i < gs->num_players; i++) {
-if(gs->players[i].is_remote && strcmp(gs->players[i].name, name) == 0) {
-player_idx= i;
-break;
-}
-}
-uint32_t color= (uint32_t)parse_json_int(obj, "color");
-if(player_idx == -1) {
-player_idx= game_add_remote_player(g, name, color);
-net_log_info("parse_remote_game_state: ADDED new remote player '%s' at idx %d", name, player_idx);
-}
-if(player_idx != -1) {
-PlayerState* pl= &gs->players[player_idx];
-/* Force active to true initially if found in state */
-if(!pl->active) {
-pl->active= true;
-/* net_log_info("parse_remote_game_state: SET player %d ('%s') to ACTIVE (found in
-                                 * state)", player_idx, name); */
-}
-pl->score= parse_json_int(obj, "score");
-/* Parse direction */
-int dir_val= parse_json_int(obj, "dir");
-if(dir_val >= 0 && dir_val <= 3) pl->current_dir= (SnakeDir)dir_val;
-/* Update body */
-const char* body_arr= strstr(obj, "\"body\":[");
-if(body_arr) {
-body_arr= strchr(body_arr, '[');
-if(body_arr) {
-body_arr++;
-/* First, parse new positions into temporary storage */
-SnakePoint new_body[SNAKE_BODY_MAX_LEN];
-int new_length= 0;
-const char* scan= body_arr;
-while(*scan && *scan != ']' && new_length < SNAKE_BODY_MAX_LEN) {
-const char* seg= strchr(scan, '{');
-if(!seg || (strchr(scan, ']') && seg > strchr(scan, ']'))) break;
-const char* seg_end= strchr(seg, '}');
-if(!seg_end) break;
-int seg_len= (int)(seg_end - seg + 1);
-if(seg_len > 0 && seg_len < 128) {
-char seg_buf[128];
-memcpy(seg_buf, seg, (size_t)seg_len);
-seg_buf[seg_len]= '\0';
-new_body[new_length].x= parse_json_int(seg_buf, "x");
-new_body[new_length].y= parse_json_int(seg_buf, "y");
-new_length++;
-}
-scan= seg_end + 1;
-}
-/* Only update prev positions if the head actually moved */
-bool head_moved= (new_length > 0 && pl->length > 0 && (new_body[0].x != pl->body[0].x || new_body[0].y != pl->body[0].y));
-bool first_update= (pl->length == 0 && new_length > 0);
-if(head_moved) {
-/* Save current to prev for interpolation */
-pl->prev_head.x= (float)pl->body[0].x + 0.5f;
-pl->prev_head.y= (float)pl->body[0].y + 0.5f;
-for(int bi= 0; bi < pl->length && bi < SNAKE_BODY_MAX_LEN; bi++) {
-pl->prev_segment[bi].x= (float)pl->body[bi].x + 0.5f;
-pl->prev_segment[bi].y= (float)pl->body[bi].y + 0.5f;
-}
-pl->interp_time= 0.0f; /* Reset interpolation timer for this player */
-}
-/* Copy new positions to body */
-for(int bi= 0; bi < new_length; bi++) {
-pl->body[bi]= new_body[bi];
-/* Init prev for new segments or first update */
-if(first_update || bi >= pl->length) {
-pl->prev_segment[bi].x= (float)new_body[bi].x + 0.5f;
-pl->prev_segment[bi].y= (float)new_body[bi].y + 0.5f;
-}
-}
-pl->length= new_length;
-pl->active= (pl->length > 0);
-if(pl->active && pl->length > 0) {
-net_log_info("parse: Player %d '%s' updated. Len=%d Head=(%d,%d)", player_idx, name, pl->length, pl->body[0].x, pl->body[0].y);
-} else {
-net_log_info("parse: Player %d '%s' inactive or empty body", player_idx, name);
-}
-if(first_update && pl->length > 0) {
-pl->prev_head.x= (float)pl->body[0].x + 0.5f;
-pl->prev_head.y= (float)pl->body[0].y + 0.5f;
-}
-}
-}
-}
-}
-free(obj);
-}
-players_field= p;
-}
-}
-}
-/* Parse Food (Sync only if we are client) */
-if(!is_host && gs) {
-const char* food_arr= strstr(json, "\"food\":[");
-if(food_arr) {
-food_arr= strchr(food_arr, '[');
-if(food_arr) {
-food_arr++;
-int old_count= gs->food_count;
-gs->food_count= 0;
-while(*food_arr && *food_arr != ']' && gs->food_count < gs->max_food) {
-const char* fseg= strchr(food_arr, '{');
-if(!fseg || (strchr(food_arr, ']') && fseg > strchr(food_arr, ']'))) break;
-const char* fseg_end= strchr(fseg, '}');
-if(!fseg_end) break;
-int flen= (int)(fseg_end - fseg + 1);
-if(flen > 0 && flen < 64) {
-char buf[64];
-memcpy(buf, fseg, (size_t)flen);
-buf[flen]= '\0';
-gs->food[gs->food_count].x= parse_json_int(buf, "x");
-gs->food[gs->food_count].y= parse_json_int(buf, "y");
-gs->food_count++;
-}
-food_arr= fseg_end + 1;
-}
-if(gs->food_count != old_count) net_log_info("parse_remote_game_state: SYNCED food (count: %d -> %d)", old_count, gs->food_count);
-}
-}
-}
-}
-/* JSON helpers for lightweight serialization of GameState */
-static char* escape_json_str(const char* s) {
-if(!s) return strdup("");
-size_t need= 1;
-for(const unsigned char* p= (const unsigned char*)s; *p; ++p) {
-if(*p == '"' || *p == '\\' || *p == '\n' || *p == '\r' || *p == '\t')
-need+= 2; /* escape */
-else if(*p < 0x20)
-need+= 6; /* \u00xx */
-else
-need+= 1;
-}
-char* out= malloc(need);
-if(!out) return NULL;
-char* q= out;
-for(const unsigned char* p= (const unsigned char*)s; *p; ++p) {
-unsigned char c= *p;
-if(c == '"') {
-*q++= '\\';
-*q++= '"';
-} else if(c == '\\') {
-*q++= '\\';
-*q++= '\\';
-} else if(c == '\n') {
-*q++= '\\';
-*q++= 'n';
-} else if(c == '\r') {
-*q++= '\\';
-*q++= 'r';
-} else if(c == '\t') {
-*q++= '\\';
-*q++= 't';
-} else if(c < 0x20) {
-int n= snprintf(q, 7, "\\u%04x", c);
-q+= n;
-} else {
-*q++= (char)c;
-}
-}
-*q= '\0';
-return out;
-}
-static char* game_state_to_json(const GameState* gs, int tick) {
-if(!gs) return strdup("{}");
-/* build JSON in a dynamic buffer */
-size_t cap= 1024;
-char* buf= malloc(cap);
-if(!buf) return NULL;
-size_t len= 0;
-int n= snprintf(buf + len, cap - len, "{\"type\":\"state\",\"tick\":%d,\"w\":%d,\"h\":%d,\"players\":[", tick, gs->width, gs->height);
-if(n < 0) {
-free(buf);
-return NULL;
-}
-len+= (size_t)n;
-for(int i= 0; i < gs->num_players; ++i) {
-const PlayerState* p= &gs->players[i];
-if(!p->active) continue;
-int hx= p->length > 0 ? p->body[0].x : 0;
-int hy= p->length > 0 ? p->body[0].y : 0;
-char* escaped= NULL;
-if(p->name[0]) escaped= escape_json_str(p->name);
-if(!escaped) escaped= strdup("");
-n= snprintf(buf + len, cap - len, "%s{\"id\":%d,\"name\":\"%s\",\"x\":%d,\"y\":%d,\"len\":%d,\"score\":%d,\"color\":%d,\"dir\":%d,\"body\":[", (len > 0 && buf[len - 1] != '[') ? "," : "", i, escaped, hx, hy, p->length, p->score, (int)p->color, (int)p->current_dir);
-free(escaped);
-if(n < 0) {
-free(buf);
-return NULL;
-}
-len+= (size_t)n;
-if(len + (size_t)(p->length * 24) + 128 > cap) {
-cap= len + (size_t)(p->length * 24) + 256;
-char* nb= realloc(buf, cap);
-if(!nb) {
-free(buf);
-return NULL;
-}
-buf= nb;
-}
-for(int bi= 0; bi < p->length; ++bi) {
-n= snprintf(buf + len, cap - len, "%s{\"x\":%d,\"y\":%d}", (bi > 0) ? "," : "", p->body[bi].x, p->body[bi].y);
-if(n < 0) {
-free(buf);
-return NULL;
-}
-len+= (size_t)n;
-}
-n= snprintf(buf + len, cap - len, "]}");
-if(n < 0) {
-free(buf);
-return NULL;
-}
-len+= (size_t)n;
-}
-n= snprintf(buf + len, cap - len, "],\"food\":[");
-if(n < 0) {
-free(buf);
-return NULL;
-}
-len+= (size_t)n;
-for(int i= 0; i < gs->food_count; ++i) {
-n= snprintf(buf + len, cap - len, "%s{\"x\":%d,\"y\":%d}", (i > 0) ? "," : "", gs->food[i].x, gs->food[i].y);
-if(n < 0) {
-free(buf);
-return NULL;
-}
-len+= (size_t)n;
-if(len + 128 > cap) {
-cap*= 2;
-char* nb= realloc(buf, cap);
-if(!nb) {
-free(buf);
-return NULL;
-}
-buf= nb;
-}
-}
-n= snprintf(buf + len, cap - len, "]}");
-if(n < 0) {
-free(buf);
-return NULL;
-}
-len+= (size_t)n;
-/* shrink to fit */
-char* out= realloc(buf, len + 1);
-return out ? out : buf;
-}
 struct SnakeGame {
 GameConfig* cfg;
 Game* game;
 bool has_3d;
 bool headless;
 bool autoplay;
+/* Reused for every outgoing state message */
+NetJsonWriter* state_writer;
+/* Delta history against what each peer acknowledged */
+NetDelta* state_delta;
+/* Extrapolates remote snakes between their snapshots */
+NetPredict* predict;
 };
 /* Headless mode: print minimal game state to stdout */
 static void headless_print_state(const GameState* gs, int tick) {
@@ -368,6 +53,9 @@ if(err_out) *err_out= 1;
 if(!config_in) return NULL;
 SnakeGame* s= malloc(sizeof *s);
 if(!s) return NULL;
+s->state_writer= NULL;
+s->state_delta= NULL;
+s->predict= NULL;
 s->cfg= game_config_create();
 if(!s->cfg) {
 free(s);
@@ -457,6 +145,10 @@ config_3d.wall_height_scale= game_config_get_wall_height_scale(config_in);
 config_3d.tail_height_scale= game_config_get_tail_height_scale(config_in);
 config_3d.wall_texture_scale= game_config_get_wall_texture_scale(config_in);
 config_3d.floor_texture_scale= game_config_get_floor_texture_scale(config_in);
+config_3d.target_fps= game_config_get_target_fps(config_in);
+config_3d.render_scale_min= game_config_get_render_scale_min(config_in);
+config_3d.render_scale_max= game_config_get_render_scale_max(config_in);
+config_3d.floor_reprojection= (game_config_get_floor_reprojection(config_in) != 0);
 int sw3= 0, sh3= 0;
 game_config_get_screen_size(config_in, &sw3, &sh3);
 config_3d.screen_width= sw3;
@@ -509,10 +201,25 @@ out_err:
 if(err_out) *err_out= err ? err : 1;
 if(s) {
 if(s->cfg) game_config_destroy(s->cfg);
+net_json_writer_destroy(s->state_writer);
+net_delta_destroy(s->state_delta);
+net_predict_destroy(s->predict);
 free(s);
 }
 return NULL;
 }
+/* Session negotiation finishes while the game is already running; a client takes its food from the host */
+static void snake_game_on_session(mpclient* mpc, int ok, const char* session, int is_host, void* user) {
+SnakeGame* s= (SnakeGame*)user;
+(void)mpc;
+if(!ok) {
+net_log_error("snake_game: no multiplayer session, playing offline");
+if(!s->headless) render_push_mp_message("No session: playing offline");
+return;
+}
+net_log_info("snake_game: session %s ready (%s)", session, is_host ? "host" : "client");
+if(!is_host && !game_config_get_mp_is_host(s->cfg)) game_set_food_sync_only(s->game, true);
+}
 static mpclient* snake_game_init_multiplayer(SnakeGame* s) {
 GameConfig* cfg= s->cfg;
 if(!game_config_get_mp_enabled(cfg)) return NULL;
@@ -522,20 +229,41 @@ const char* ident= game_config_get_mp_identifier(cfg);
 if(!ident) ident= "67bdb04f-6e7c-4d76-81a3-191f7d78dd45";
 mpclient* mpc= mpclient_create(host ? host : "127.0.0.1", (uint16_t)(port ? port : 9001), ident);
 if(mpc) {
+mpclient_set_send_rate(mpc, game_config_get_mp_send_hz(cfg));
+mpclient_set_tcp_options(mpc, game_config_get_mp_tcp_nodelay(cfg), game_config_get_mp_tcp_cork(cfg));
+NetShaperConfig sim= {game_config_get_mp_sim_delay_ms(cfg), game_config_get_mp_sim_jitter_ms(cfg), game_config_get_mp_sim_kbps(cfg),
+                     game_config_get_mp_sim_drop_pct(cfg), game_config_get_mp_sim_reorder_pct(cfg)};
+if(net_shaper_config_active(&sim)) mpclient_set_conditions(mpc, &sim);
+mpclient_set_session_callback(mpc, snake_game_on_session, s);
+/* Neither the connect nor the request waits for the server: the game starts now and the loop polls for the session */
 if(mpclient_connect_and_start(mpc) == 0) {
 const char* forced= game_config_get_mp_session(cfg);
 if(forced && forced[0]) {
 (void)mpclient_join(mpc, forced, game_config_get_player_name(cfg));
 if(!s->headless) render_set_session_id(forced);
-if(!game_config_get_mp_is_host(cfg)) game_set_food_sync_only(s->game, true);
 } else {
-mpclient_auto_join_or_host(mpc, game_config_get_player_name(cfg));
-if(!mpclient_is_host(mpc)) game_set_food_sync_only(s->game, true);
+(void)mpclient_auto_join_or_host(mpc, game_config_get_player_name(cfg));
+}
 }
 }
+if(mpc && !s->state_writer) {
+s->state_writer= net_json_writer_create();
+net_json_writer_set_caps(s->state_writer, NET_DELTA_CAPS);
+s->state_delta= net_delta_create(game_config_get_player_name(cfg));
+s->predict= net_predict_create(game_config_get_mp_predict_ticks(cfg));
 }
 return mpc;
 }
+/* Deltas or full binary once every peer has advertised it, JSON for older peers or when the state does not fit */
+static const char* snake_game_encode_state(SnakeGame* s, mpclient* mpc, int tick) {
+const GameState* gs= game_get_state(s->game);
+const char* out= NULL;
+int caps= mpclient_peer_caps(mpc);
+if(caps >= NET_DELTA_CAPS) out= net_json_write_delta_state(s->state_writer, s->state_delta, gs, tick, NULL);
+if(!out && caps >= NET_STATE_VERSION) out= net_json_write_packed_state(s->state_writer, gs, tick, NULL);
+if(!out) out= net_json_write_state(s->state_writer, gs, tick, NULL);
+return out;
+}
 static void snake_game_run_headless(SnakeGame* s, mpclient* mpc) {
 Game* game= s->game;
 GameConfig* cfg= s->cfg;
@@ -552,18 +280,20 @@ auto_in.turn_right= 1;
 }
 GameEvents events= {0};
 game_step(game, &events);
+net_predict_step(s->predict, game);
 headless_print_state(game_get_state(game), tick);
 if(mpc) {
-char mpbuf[8192];
-while(mpclient_poll_message(mpc, mpbuf, (int)sizeof(mpbuf))) {
-if(strstr(mpbuf, "\"type\":\"state\"")) parse_remote_game_state(game, mpbuf, mpclient_is_host(mpc));
+const char* msg;
+size_t msg_len;
+(void)mpclient_poll_session(mpc);
+while((msg= mpclient_peek_message(mpc, &msg_len)) != NULL) {
+(void)net_json_apply_state(game, s->state_delta, msg, msg_len, mpclient_is_host(mpc));
+net_predict_reconcile(s->predict, game);
+mpclient_release_message(mpc);
 }
 if(mpclient_has_session(mpc)) {
-char* state_json= game_state_to_json(game_get_state(game), tick);
-if(state_json) {
-(void)mpclient_send_game(mpc, state_json);
-free(state_json);
-}
+const char* state_json= snake_game_encode_state(s, mpc, tick);
+if(state_json) (void)mpclient_send_state(mpc, state_json);
 }
 }
 const GameState* gs= game_get_state(game);
@@ -726,6 +456,7 @@ if(platform_was_resized()) snake_game_handle_resize(s, bw, bh, highscores, highs
 if(snake_game_process_inputs(s, tick)) goto clean_done;
 GameEvents events= {0};
 game_step(game, &events);
+net_predict_step(s->predict, game);
 if(s->has_3d) render_3d_on_tick(game_get_state(game));
 for(int ei= 0; ei < events.died_count; ei++) {
 snake_game_append_score_if_qualifies(events.died_scores[ei], events.died_players[ei], game_config_get_player_name(cfg));
@@ -767,12 +498,13 @@ if(snake_game_process_inputs(s, tick)) goto clean_done;
 render_draw(game_get_state(game), game_config_get_player_name(cfg), highscores, highscore_count);
 if(s->has_3d) render_3d_draw(game_get_state(game), game_config_get_player_name(cfg), highscores, highscore_count, delta_s);
 if(mpc) {
-char mpbuf[8192];
-while(mpclient_poll_message(mpc, mpbuf, (int)sizeof(mpbuf))) {
-if(strstr(mpbuf, "\"type\":\"state\""))
-parse_remote_game_state(game, mpbuf, mpclient_is_host(mpc));
-else
-render_push_mp_message(mpbuf);
+const char* msg;
+size_t msg_len;
+(void)mpclient_poll_session(mpc);
+while((msg= mpclient_peek_message(mpc, &msg_len)) != NULL) {
+if(!net_json_apply_state(game, s->state_delta, msg, msg_len, mpclient_is_host(mpc))) render_push_mp_message(msg);
+net_predict_reconcile(s->predict, game);
+mpclient_release_message(mpc);
 }
 char cur_sess[16]= {0};
 if(mpclient_get_session(mpc, cur_sess, (int)sizeof(cur_sess)) && strcmp(prev_session, cur_sess) != 0) {
@@ -782,10 +514,9 @@ render_set_session_id(prev_session);
 }
 /* Throttled state send: once per tick */
 if(mpclient_has_session(mpc) && (now - last_send_time) >= (uint64_t)game_config_get_tick_rate_ms(cfg)) {
-char* state_json= game_state_to_json(game_get_state(game), tick);
+const char* state_json= snake_game_encode_state(s, mpc, tick);
 if(state_json) {
-(void)mpclient_send_game(mpc, state_json);
-free(state_json);
+(void)mpclient_send_state(mpc, state_json);
 last_send_time= now;
 }
 }
@@ -825,5 +556,8 @@ input_shutdown();
 render_shutdown();
 if(s->has_3d) render_3d_shutdown();
 if(s->cfg) game_config_destroy(s->cfg);
+net_json_writer_destroy(s->state_writer);
+net_delta_destroy(s->state_delta);
+net_predict_destroy(s->predict);
 free(s);
 }
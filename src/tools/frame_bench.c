@@ -0,0 +1,173 @@
+#include "game_internal.h"
+#include "render_3d.h"
+#include "render_3d_camera.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_MAP_W 40
+#define BENCH_MAP_H 24
+#define BENCH_FRAMES 120
+
+typedef struct {
+    const char* name;
+    int players;
+    int length;
+    int food;
+} BenchScene;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+static int cmp_double(const void* a, const void* b) {
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+/* Lay each snake out as a boustrophedon inside its own horizontal band so bodies never overlap */
+static void build_scene(GameState* gs, PlayerState* players, SnakePoint* food, const BenchScene* sc) {
+    static const uint32_t colors[SNAKE_MAX_PLAYERS] = {0xFF00C000u, 0xFFC0C000u, 0xFF00C0C0u, 0xFFC000C0u};
+    memset(gs, 0, sizeof *gs);
+    memset(players, 0, sizeof(PlayerState) * SNAKE_MAX_PLAYERS);
+    gs->width = BENCH_MAP_W;
+    gs->height = BENCH_MAP_H;
+    gs->status = GAME_STATUS_RUNNING;
+    gs->players = players;
+    gs->num_players = sc->players;
+    gs->max_players = SNAKE_MAX_PLAYERS;
+    gs->food = food;
+    gs->food_count = sc->food;
+    gs->max_food = sc->food;
+    gs->max_length = SNAKE_BODY_MAX_LEN;
+    int band = BENCH_MAP_H / SNAKE_MAX_PLAYERS;
+    for (int p = 0; p < sc->players; p++) {
+        PlayerState* pl = &players[p];
+        pl->active = true;
+        pl->color = colors[p];
+        pl->current_dir = SNAKE_DIR_RIGHT;
+        pl->length = sc->length;
+        for (int i = 0; i < sc->length; i++) {
+            int row = i / (BENCH_MAP_W - 2);
+            int col = i % (BENCH_MAP_W - 2);
+            if (row & 1) col = BENCH_MAP_W - 3 - col;
+            pl->body[i].x = 1 + col;
+            pl->body[i].y = 1 + p * band + row % band;
+            pl->prev_segment[i].x = (float)pl->body[i].x + 0.5f;
+            pl->prev_segment[i].y = (float)pl->body[i].y + 0.5f;
+        }
+        pl->prev_head = pl->prev_segment[0];
+    }
+    for (int i = 0; i < sc->food; i++) {
+        food[i].x = 3 + i * 7;
+        food[i].y = BENCH_MAP_H / 2;
+    }
+}
+
+/* Four-way split screen of the busiest scene, timed with serial and threaded viewports */
+static int bench_split(Render3DContext* r, const GameState* gs, int w, int h, bool parallel, double* samples) {
+    uint32_t* pixels = malloc((size_t)w * (size_t)h * sizeof *pixels);
+    Camera3D* cams[RENDER_3D_MAX_VIEWPORTS] = {NULL};
+    Render3DViewport vps[RENDER_3D_MAX_VIEWPORTS];
+    int rc = pixels ? 0 : 1;
+    for (int i = 0; i < RENDER_3D_MAX_VIEWPORTS && rc == 0; i++) {
+        cams[i] = camera_create(90.0f, w / 2, 0.5f);
+        if (!cams[i]) rc = 1;
+        vps[i] = (Render3DViewport){(i % 2) * (w / 2), (i / 2) * (h / 2), w / 2, h / 2, cams[i], i};
+    }
+    for (int f = 0; rc == 0 && f <= BENCH_FRAMES; f++) {
+        float t = (float)f / (float)BENCH_FRAMES;
+        for (int i = 0; i < RENDER_3D_MAX_VIEWPORTS; i++) {
+            float x = 2.5f + (float)i * 8.0f + t * 4.0f;
+            float y = 2.5f + (float)i * 4.0f + t * 2.0f;
+            camera_set_position(cams[i], x, y);
+            camera_set_prev_position(cams[i], x, y);
+            camera_set_angle(cams[i], t * 6.2831853f + (float)i);
+            camera_set_prev_angle(cams[i], t * 6.2831853f + (float)i);
+        }
+        double t0 = now_ms();
+        (void)render_3d_render_viewports(r, gs, vps, RENDER_3D_MAX_VIEWPORTS, pixels, w, h, parallel);
+        /* Frame 0 warms up the per-viewport contexts */
+        if (f > 0) samples[f - 1] = now_ms() - t0;
+    }
+    for (int i = 0; i < RENDER_3D_MAX_VIEWPORTS; i++) camera_destroy(cams[i]);
+    free(pixels);
+    return rc;
+}
+
+static void report(const char* scene, int w, int h, double* samples) {
+    qsort(samples, BENCH_FRAMES, sizeof(samples[0]), cmp_double);
+    double sum = 0.0;
+    for (int f = 0; f < BENCH_FRAMES; f++) sum += samples[f];
+    printf("frame_bench: scene=%s screen=%dx%d frames=%d avg_ms=%.3f p50_ms=%.3f p99_ms=%.3f\n", scene, w, h, BENCH_FRAMES,
+           sum / BENCH_FRAMES, samples[BENCH_FRAMES / 2], samples[(BENCH_FRAMES * 99) / 100]);
+}
+
+int main(void) {
+    static const BenchScene scenes[] = {
+        {"solo", 1, 5, 1},
+        {"busy", 4, 64, 3},
+        {"long", 4, 256, 3},
+    };
+    static const int resolutions[][2] = {{320, 200}, {640, 480}, {1280, 720}, {1920, 1080}};
+    static PlayerState players[SNAKE_MAX_PLAYERS];
+    SnakePoint food[SNAKE_MAX_FOOD];
+    GameState gs;
+    double samples[BENCH_FRAMES];
+
+    Render3DContext* r = render_3d_context_create(NULL);
+    if (!r) {
+        fprintf(stderr, "frame_bench: failed to create render context\n");
+        return 1;
+    }
+    int rc = 0;
+    for (size_t si = 0; si < sizeof(scenes) / sizeof(scenes[0]) && rc == 0; si++) {
+        build_scene(&gs, players, food, &scenes[si]);
+        for (size_t ri = 0; ri < sizeof(resolutions) / sizeof(resolutions[0]); ri++) {
+            int w = resolutions[ri][0];
+            int h = resolutions[ri][1];
+            uint32_t* pixels = malloc((size_t)w * (size_t)h * sizeof *pixels);
+            Camera3D* cam = camera_create(90.0f, w, 0.5f);
+            if (!pixels || !cam) {
+                fprintf(stderr, "frame_bench: out of memory at %dx%d\n", w, h);
+                free(pixels);
+                camera_destroy(cam);
+                rc = 1;
+                break;
+            }
+            /* Warm up caches and per-width tables before timing */
+            camera_set_position(cam, 2.5f, 2.5f);
+            (void)render_3d_render_offscreen(r, &gs, cam, pixels, w, h);
+            for (int f = 0; f < BENCH_FRAMES; f++) {
+                /* Scripted walk along the arena with a slow turn */
+                float t = (float)f / (float)BENCH_FRAMES;
+                camera_set_position(cam, 2.5f + t * (float)(BENCH_MAP_W - 5), 2.5f + t * (float)(BENCH_MAP_H - 5));
+                camera_set_angle(cam, t * 6.2831853f);
+                camera_set_prev_position(cam, 2.5f + t * (float)(BENCH_MAP_W - 5), 2.5f + t * (float)(BENCH_MAP_H - 5));
+                camera_set_prev_angle(cam, t * 6.2831853f);
+                double t0 = now_ms();
+                (void)render_3d_render_offscreen(r, &gs, cam, pixels, w, h);
+                samples[f] = now_ms() - t0;
+            }
+            report(scenes[si].name, w, h, samples);
+            camera_destroy(cam);
+            free(pixels);
+        }
+    }
+    build_scene(&gs, players, food, &scenes[1]);
+    for (size_t ri = 0; ri < sizeof(resolutions) / sizeof(resolutions[0]) && rc == 0; ri++) {
+        int w = resolutions[ri][0];
+        int h = resolutions[ri][1];
+        rc = bench_split(r, &gs, w, h, false, samples);
+        if (rc == 0) report("split4_serial", w, h, samples);
+        if (rc == 0) rc = bench_split(r, &gs, w, h, true, samples);
+        if (rc == 0) report("split4_threads", w, h, samples);
+    }
+    render_3d_context_destroy(r);
+    return rc;
+}
@@ -0,0 +1,586 @@
+#include "game.h"
+#include "net_json.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Synthetic mpapi load: build/mp_loadgen.out [host] [port] [clients] [hz] [seconds] [per_session]
+
+   Every simulated client is a non-blocking socket on one epoll loop and talks to the relay exactly like mpclient:
+   "list" on connect, then the first client of each group of `per_session` hosts and the others join its session.
+   Once everyone is in, each client runs its own autoplayed Game and sends its state as a "game" command `hz` times a
+   second. Every state carries "lg":"<client>.<seq>.<send_us>" after the state members, so receivers measure the
+   end-to-end latency of each relayed state and count the ones that never arrive. */
+
+#define LG_DEFAULT_PORT 9001
+#define LG_DEFAULT_CLIENTS 8
+#define LG_DEFAULT_HZ 30
+#define LG_DEFAULT_SECONDS 10
+#define LG_IDENTIFIER "67bdb04f-6e7c-4d76-81a3-191f7d78dd45"
+/* Give up waiting for hosts and joins after this long and measure whoever made it */
+#define LG_SETUP_MS 5000
+/* States still in flight when sending stops get this long to arrive before they count as lost */
+#define LG_DRAIN_MS 1000
+#define LG_READ_CHUNK 65536
+#define LG_LINE_MAX (1u << 20)
+/* A client whose socket has this much unsent skips its state instead of queueing it, like mpclient's latest-wins slot */
+#define LG_OUT_MAX (256u * 1024u)
+#define LG_SESSION_MAX 64
+/* Same layout as mpclient's MP_CMD_FMT: identifier, optional ",\"session\":\"<id>\"" in three parts, cmd, data */
+#define LG_CMD_FMT "{\"identifier\":\"%s\"%s%s%s,\"cmd\":\"%s\",\"data\":%s}\n"
+#define LG_TAG "\"lg\":\""
+
+enum { LG_CONNECTED, LG_LISTED, LG_WAITING, LG_JOINED, LG_CLOSED };
+
+typedef struct {
+    int fd;
+    int idx;
+    int phase;
+    char name[16];
+    char session[LG_SESSION_MAX];
+    char* in_buf;
+    size_t in_len;
+    size_t in_cap;
+    int in_skip;
+    char* out_buf;
+    size_t out_off;
+    size_t out_len;
+    size_t out_cap;
+    int want_out;
+    Game* game;
+    NetJsonWriter* writer;
+    int tick;
+    uint32_t seq;
+    /* Per sender slot in the group: its seq when we joined, states from it received, and the highest seq seen */
+    uint32_t* base;
+    uint32_t* got;
+    uint32_t* high;
+} LgClient;
+
+typedef struct {
+    LgClient* clients;
+    int n;
+    int per_session;
+    int epfd;
+    char* scratch;
+    size_t scratch_cap;
+    uint32_t* lat_us;
+    size_t lat_len;
+    size_t lat_cap;
+    uint64_t sent;
+    uint64_t skipped;
+    uint64_t received;
+    uint64_t reordered;
+    uint64_t foreign;
+    uint64_t lists;
+    uint64_t bytes_out;
+    uint64_t bytes_in;
+    uint64_t ticks_late;
+    int joined;
+    int closed;
+} LoadGen;
+
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static int lg_connect(const char* host, int port) {
+    char portstr[16];
+    snprintf(portstr, sizeof portstr, "%d", port);
+    struct addrinfo hints, *res = NULL;
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, portstr, &hints, &res) != 0) return -1;
+    int fd = -1;
+    for (struct addrinfo* ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd < 0) return -1;
+    int on = 1;
+    (void)setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+    int fl = fcntl(fd, F_GETFL, 0);
+    if (fl < 0 || fcntl(fd, F_SETFL, fl | O_NONBLOCK) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void lg_close(LoadGen* lg, LgClient* c) {
+    if (c->fd < 0) return;
+    epoll_ctl(lg->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+    if (c->phase == LG_JOINED) lg->joined--;
+    c->phase = LG_CLOSED;
+    lg->closed++;
+}
+
+static void lg_watch(LoadGen* lg, LgClient* c, int want_out) {
+    if (c->want_out == want_out) return;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof ev);
+    ev.events = EPOLLIN | (want_out ? (uint32_t)EPOLLOUT : 0u);
+    ev.data.u32 = (uint32_t)c->idx;
+    epoll_ctl(lg->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->want_out = want_out;
+}
+
+/* Sends what the socket takes and watches for EPOLLOUT while anything is left */
+static void lg_flush(LoadGen* lg, LgClient* c) {
+    while (c->fd >= 0 && c->out_off < c->out_len) {
+        ssize_t rc = send(c->fd, c->out_buf + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+        if (rc < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) lg_close(lg, c);
+            break;
+        }
+        c->out_off += (size_t)rc;
+        lg->bytes_out += (uint64_t)rc;
+    }
+    if (c->fd < 0) return;
+    if (c->out_off == c->out_len) c->out_off = c->out_len = 0;
+    lg_watch(lg, c, c->out_off < c->out_len);
+}
+
+static int lg_command(LoadGen* lg, LgClient* c, const char* cmd, const char* session, const char* data) {
+    int has_session = session && session[0];
+    int n = snprintf(NULL, 0, LG_CMD_FMT, LG_IDENTIFIER, has_session ? ",\"session\":\"" : "", has_session ? session : "",
+                     has_session ? "\"" : "", cmd, data);
+    if (n < 0 || c->fd < 0) return -1;
+    size_t need = c->out_len + (size_t)n + 1;
+    if (need > c->out_cap) {
+        if (c->out_off > 0) {
+            memmove(c->out_buf, c->out_buf + c->out_off, c->out_len - c->out_off);
+            c->out_len -= c->out_off;
+            c->out_off = 0;
+            need = c->out_len + (size_t)n + 1;
+        }
+        if (need > c->out_cap) {
+            size_t cap = c->out_cap ? c->out_cap : 4096;
+            while (cap < need) cap *= 2;
+            char* grown = realloc(c->out_buf, cap);
+            if (!grown) return -1;
+            c->out_buf = grown;
+            c->out_cap = cap;
+        }
+    }
+    snprintf(c->out_buf + c->out_len, (size_t)n + 1, LG_CMD_FMT, LG_IDENTIFIER, has_session ? ",\"session\":\"" : "",
+             has_session ? session : "", has_session ? "\"" : "", cmd, data);
+    c->out_len += (size_t)n;
+    lg_flush(lg, c);
+    return c->fd >= 0 ? 0 : -1;
+}
+
+/* Copies the string value of "key" (the first one in the line) into out; returns 0 when there is none */
+static int json_string(const char* line, const char* key, char* out, size_t size) {
+    char needle[32];
+    snprintf(needle, sizeof needle, "\"%s\"", key);
+    const char* p = strstr(line, needle);
+    if (!p) return 0;
+    p += strlen(needle);
+    while (*p == ' ' || *p == ':') p++;
+    if (*p != '"') return 0;
+    const char* end = strchr(++p, '"');
+    if (!end || (size_t)(end - p) >= size || end == p) return 0;
+    memcpy(out, p, (size_t)(end - p));
+    out[end - p] = '\0';
+    return 1;
+}
+
+static int is_cmd(const char* line, const char* cmd) {
+    char needle[32];
+    snprintf(needle, sizeof needle, "\"cmd\":\"%s\"", cmd);
+    if (strstr(line, needle)) return 1;
+    snprintf(needle, sizeof needle, "\"cmd\": \"%s\"", cmd);
+    return strstr(line, needle) != NULL;
+}
+
+static void lg_join_members(LoadGen* lg, int leader);
+
+/* A host or join reply: the client is in the session and the senders it will hear from are baselined */
+static void lg_joined(LoadGen* lg, LgClient* c, const char* session) {
+    snprintf(c->session, sizeof c->session, "%s", session);
+    if (c->phase != LG_JOINED) lg->joined++;
+    c->phase = LG_JOINED;
+    int group = c->idx / lg->per_session * lg->per_session;
+    for (int s = 0; s < lg->per_session && group + s < lg->n; s++) {
+        c->base[s] = lg->clients[group + s].seq;
+        c->high[s] = c->base[s];
+        c->got[s] = 0;
+    }
+    if (c->idx == group) lg_join_members(lg, group);
+}
+
+static void lg_send_join(LoadGen* lg, LgClient* c, const char* session) {
+    char payload[64];
+    snprintf(payload, sizeof payload, "{\"name\":\"%s\"}", c->name);
+    if (lg_command(lg, c, "join", session, payload) == 0) c->phase = LG_WAITING;
+}
+
+/* Members join once their list reply is in and their leader has a session */
+static void lg_join_members(LoadGen* lg, int leader) {
+    LgClient* l = &lg->clients[leader];
+    if (l->phase != LG_JOINED) return;
+    for (int i = leader + 1; i < leader + lg->per_session && i < lg->n; i++) {
+        LgClient* c = &lg->clients[i];
+        if (c->phase == LG_LISTED) lg_send_join(lg, c, l->session);
+    }
+}
+
+static void lg_record(LoadGen* lg, uint64_t us) {
+    if (lg->lat_len == lg->lat_cap) {
+        size_t cap = lg->lat_cap ? lg->lat_cap * 2 : 65536;
+        uint32_t* grown = realloc(lg->lat_us, cap * sizeof *grown);
+        if (!grown) return;
+        lg->lat_us = grown;
+        lg->lat_cap = cap;
+    }
+    lg->lat_us[lg->lat_len++] = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+static void lg_game(LoadGen* lg, LgClient* c, const char* line, uint64_t now) {
+    /* The tag is the last member of the data object, so search from the end of the line */
+    const char* tag = NULL;
+    for (const char* p = strstr(line, LG_TAG); p; p = strstr(p + 1, LG_TAG)) tag = p;
+    if (!tag) {
+        lg->foreign++;
+        return;
+    }
+    unsigned from = 0, seq = 0;
+    unsigned long long sent = 0;
+    if (sscanf(tag + strlen(LG_TAG), "%u.%u.%llu", &from, &seq, &sent) != 3 || from >= (unsigned)lg->n) {
+        lg->foreign++;
+        return;
+    }
+    /* Our own state reflected back */
+    if ((int)from == c->idx) return;
+    int group = c->idx / lg->per_session * lg->per_session;
+    int slot = (int)from - group;
+    if (slot < 0 || slot >= lg->per_session || c->phase != LG_JOINED) {
+        lg->foreign++;
+        return;
+    }
+    lg->received++;
+    lg_record(lg, now > sent ? now - sent : 0);
+    if (seq <= c->base[slot]) return;
+    c->got[slot]++;
+    if (seq < c->high[slot])
+        lg->reordered++;
+    else
+        c->high[slot] = seq;
+}
+
+static void lg_line(LoadGen* lg, LgClient* c, const char* line, uint64_t now) {
+    char session[LG_SESSION_MAX];
+    if (is_cmd(line, "game")) {
+        lg_game(lg, c, line, now);
+    } else if (is_cmd(line, "host") || is_cmd(line, "join")) {
+        if (json_string(line, "session", session, sizeof session)) lg_joined(lg, c, session);
+    } else if (is_cmd(line, "list")) {
+        lg->lists++;
+        if (c->phase != LG_CONNECTED) return;
+        c->phase = LG_LISTED;
+        int leader = c->idx / lg->per_session * lg->per_session;
+        if (c->idx == leader) {
+            char payload[64];
+            snprintf(payload, sizeof payload, "{\"name\":\"%s\",\"private\":false}", c->name);
+            if (lg_command(lg, c, "host", NULL, payload) == 0) c->phase = LG_WAITING;
+        } else if (lg->clients[leader].phase == LG_JOINED) {
+            lg_send_join(lg, c, lg->clients[leader].session);
+        }
+    }
+}
+
+/* Reads everything the socket has and handles each complete line, like mpclient's io_read */
+static void lg_read(LoadGen* lg, LgClient* c) {
+    while (c->fd >= 0) {
+        if (c->in_cap - c->in_len < LG_READ_CHUNK) {
+            size_t cap = c->in_cap ? c->in_cap * 2 : 2 * LG_READ_CHUNK;
+            if (cap > LG_LINE_MAX + LG_READ_CHUNK) {
+                c->in_len = 0;
+                c->in_skip = 1;
+            } else {
+                char* grown = realloc(c->in_buf, cap);
+                if (!grown) {
+                    lg_close(lg, c);
+                    return;
+                }
+                c->in_buf = grown;
+                c->in_cap = cap;
+            }
+        }
+        ssize_t rc = recv(c->fd, c->in_buf + c->in_len, c->in_cap - c->in_len - 1, 0);
+        if (rc <= 0) {
+            if (rc < 0 && errno == EINTR) continue;
+            if (rc == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) lg_close(lg, c);
+            return;
+        }
+        lg->bytes_in += (uint64_t)rc;
+        uint64_t now = now_us();
+        char* line = c->in_buf;
+        char* scan = c->in_buf + c->in_len;
+        char* end = scan + rc;
+        char* nl;
+        while ((nl = memchr(scan, '\n', (size_t)(end - scan))) != NULL) {
+            *nl = '\0';
+            if (c->in_skip)
+                c->in_skip = 0;
+            else if (nl > line)
+                lg_line(lg, c, line, now);
+            line = scan = nl + 1;
+        }
+        c->in_len = (size_t)(end - line);
+        if (c->in_skip)
+            c->in_len = 0;
+        else if (line != c->in_buf && c->in_len)
+            memmove(c->in_buf, line, c->in_len);
+    }
+}
+
+/* One tick of a client: steps its game the way headless autoplay does and sends the tagged state */
+static void lg_tick(LoadGen* lg, LgClient* c) {
+    if (c->phase != LG_JOINED) return;
+    if (c->tick % 3 == 0) {
+        InputState in = {0};
+        in.turn_right = 1;
+        (void)game_enqueue_input(c->game, 0, &in);
+    }
+    GameEvents events = {0};
+    game_step(c->game, &events);
+    if (game_get_status(c->game) == GAME_STATUS_GAME_OVER) game_reset(c->game);
+    c->tick++;
+    if (c->out_len - c->out_off > LG_OUT_MAX) {
+        lg->skipped++;
+        return;
+    }
+    size_t len = 0;
+    const char* state = net_json_write_state(c->writer, game_get_state(c->game), c->tick, &len);
+    if (!state || len < 2) return;
+    size_t need = len + 64;
+    if (need > lg->scratch_cap) {
+        char* grown = realloc(lg->scratch, need);
+        if (!grown) return;
+        lg->scratch = grown;
+        lg->scratch_cap = need;
+    }
+    /* The state object with its closing brace swapped for the tag */
+    memcpy(lg->scratch, state, len - 1);
+    snprintf(lg->scratch + len - 1, lg->scratch_cap - (len - 1), ",%s%d.%u.%llu\"}", LG_TAG, c->idx, c->seq + 1,
+             (unsigned long long)now_us());
+    if (lg_command(lg, c, "game", c->session, lg->scratch) != 0) return;
+    c->seq++;
+    lg->sent++;
+}
+
+static int cmp_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static double pct_ms(const LoadGen* lg, double p) {
+    if (!lg->lat_len) return 0.0;
+    size_t i = (size_t)(p * (double)(lg->lat_len - 1) + 0.5);
+    return (double)lg->lat_us[i] / 1000.0;
+}
+
+static void lg_report(LoadGen* lg, double run_s) {
+    /* Expected: every state a group mate sent after we joined, for each receiver still connected */
+    uint64_t expected = 0, got = 0;
+    for (int i = 0; i < lg->n; i++) {
+        LgClient* c = &lg->clients[i];
+        if (c->phase != LG_JOINED) continue;
+        int group = i / lg->per_session * lg->per_session;
+        for (int s = 0; s < lg->per_session && group + s < lg->n; s++) {
+            if (group + s == i) continue;
+            uint32_t sent = lg->clients[group + s].seq;
+            if (sent > c->base[s]) expected += sent - c->base[s];
+            got += c->got[s];
+        }
+    }
+    uint64_t lost = expected > got ? expected - got : 0;
+    qsort(lg->lat_us, lg->lat_len, sizeof *lg->lat_us, cmp_u32);
+    double mean = 0.0;
+    for (size_t i = 0; i < lg->lat_len; i++) mean += (double)lg->lat_us[i];
+    if (lg->lat_len) mean /= (double)lg->lat_len * 1000.0;
+    printf("mp_loadgen: clients=%d joined=%d closed=%d per_session=%d lists=%llu run_s=%.1f\n", lg->n, lg->joined, lg->closed,
+           lg->per_session, (unsigned long long)lg->lists, run_s);
+    printf("mp_loadgen: states sent=%llu skipped=%llu ticks_late=%llu sent_per_sec=%.0f bytes_out=%llu bytes_in=%llu\n",
+           (unsigned long long)lg->sent, (unsigned long long)lg->skipped, (unsigned long long)lg->ticks_late,
+           run_s > 0 ? (double)lg->sent / run_s : 0.0, (unsigned long long)lg->bytes_out, (unsigned long long)lg->bytes_in);
+    printf("mp_loadgen: states received=%llu expected=%llu lost=%llu loss=%.3f%% reordered=%llu foreign=%llu\n",
+           (unsigned long long)lg->received, (unsigned long long)expected, (unsigned long long)lost,
+           expected ? 100.0 * (double)lost / (double)expected : 0.0, (unsigned long long)lg->reordered,
+           (unsigned long long)lg->foreign);
+    printf("mp_loadgen: latency_ms samples=%zu mean=%.3f p50=%.3f p90=%.3f p99=%.3f p999=%.3f max=%.3f\n", lg->lat_len, mean,
+           pct_ms(lg, 0.50), pct_ms(lg, 0.90), pct_ms(lg, 0.99), pct_ms(lg, 0.999), pct_ms(lg, 1.0));
+}
+
+static void lg_poll(LoadGen* lg, int timeout_ms) {
+    struct epoll_event evs[256];
+    int n = epoll_wait(lg->epfd, evs, 256, timeout_ms);
+    for (int i = 0; i < n; i++) {
+        LgClient* c = &lg->clients[evs[i].data.u32];
+        if (evs[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) lg_read(lg, c);
+        if (c->fd >= 0 && (evs[i].events & EPOLLOUT)) lg_flush(lg, c);
+    }
+}
+
+static int lg_setup(LoadGen* lg, const char* host, int port) {
+    GameConfig* cfg = game_config_create();
+    if (!cfg) return -1;
+    game_config_set_num_players(cfg, 1);
+    game_config_set_max_players(cfg, SNAKE_MAX_PLAYERS);
+    int rc = 0;
+    for (int i = 0; i < lg->n && rc == 0; i++) {
+        LgClient* c = &lg->clients[i];
+        c->idx = i;
+        c->fd = -1;
+        snprintf(c->name, sizeof c->name, "lg%d", i);
+        game_config_set_player_name(cfg, c->name);
+        c->game = game_create(cfg, (uint32_t)i + 1);
+        c->writer = net_json_writer_create();
+        c->base = calloc((size_t)lg->per_session, sizeof *c->base);
+        c->got = calloc((size_t)lg->per_session, sizeof *c->got);
+        c->high = calloc((size_t)lg->per_session, sizeof *c->high);
+        if (!c->game || !c->writer || !c->base || !c->got || !c->high) {
+            rc = -1;
+            break;
+        }
+        c->fd = lg_connect(host, port);
+        if (c->fd < 0) {
+            fprintf(stderr, "mp_loadgen: client %d cannot connect to %s:%d\n", i, host, port);
+            rc = -1;
+            break;
+        }
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof ev);
+        ev.events = EPOLLIN;
+        ev.data.u32 = (uint32_t)i;
+        epoll_ctl(lg->epfd, EPOLL_CTL_ADD, c->fd, &ev);
+        /* Look around first, as mpclient_auto_join_or_host does; the reply decides host or join */
+        lg_command(lg, c, "list", NULL, "{\"type\":\"sessions\"}");
+    }
+    game_config_destroy(cfg);
+    return rc;
+}
+
+static void lg_free(LoadGen* lg) {
+    for (int i = 0; i < lg->n; i++) {
+        LgClient* c = &lg->clients[i];
+        if (c->fd >= 0) close(c->fd);
+        game_destroy(c->game);
+        net_json_writer_destroy(c->writer);
+        free(c->in_buf);
+        free(c->out_buf);
+        free(c->base);
+        free(c->got);
+        free(c->high);
+    }
+    free(lg->clients);
+    free(lg->scratch);
+    free(lg->lat_us);
+    if (lg->epfd >= 0) close(lg->epfd);
+}
+
+/* Each client needs a descriptor; lift the soft limit as far as the hard one allows */
+static void raise_fd_limit(int clients) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0) return;
+    rlim_t want = (rlim_t)clients + 64;
+    if (rl.rlim_cur >= want) return;
+    rl.rlim_cur = want < rl.rlim_max ? want : rl.rlim_max;
+    (void)setrlimit(RLIMIT_NOFILE, &rl);
+}
+
+int main(int argc, char** argv) {
+    const char* host = argc > 1 ? argv[1] : "127.0.0.1";
+    int port = argc > 2 ? atoi(argv[2]) : LG_DEFAULT_PORT;
+    int clients = argc > 3 ? atoi(argv[3]) : LG_DEFAULT_CLIENTS;
+    int hz = argc > 4 ? atoi(argv[4]) : LG_DEFAULT_HZ;
+    int seconds = argc > 5 ? atoi(argv[5]) : LG_DEFAULT_SECONDS;
+    int per_session = argc > 6 ? atoi(argv[6]) : SNAKE_MAX_PLAYERS;
+    if (clients < 1 || hz < 1 || hz > 1000 || seconds < 1 || per_session < 1) {
+        fprintf(stderr, "usage: %s [host] [port] [clients] [hz 1-1000] [seconds] [per_session]\n", argv[0]);
+        return 2;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+    raise_fd_limit(clients);
+    LoadGen lg;
+    memset(&lg, 0, sizeof lg);
+    lg.n = clients;
+    lg.per_session = per_session;
+    lg.epfd = epoll_create1(0);
+    lg.clients = calloc((size_t)clients, sizeof *lg.clients);
+    if (lg.epfd < 0 || !lg.clients || lg_setup(&lg, host, port) != 0) {
+        fprintf(stderr, "mp_loadgen: setup failed (is the server running? make mpapi-start)\n");
+        lg_free(&lg);
+        return 1;
+    }
+    uint64_t setup_end = now_us() + LG_SETUP_MS * 1000u;
+    while (!stop && lg.joined < lg.n - lg.closed && now_us() < setup_end) lg_poll(&lg, 10);
+    printf("mp_loadgen: %d/%d clients joined, sending %d Hz for %d s\n", lg.joined, lg.n, hz, seconds);
+
+    /* Ticks are staggered evenly across the period, so the next client due is always the one after the last */
+    uint64_t period = 1000000u / (uint64_t)hz;
+    uint64_t start = now_us();
+    uint64_t run_end = start + (uint64_t)seconds * 1000000u;
+    uint64_t round = start;
+    int next = 0;
+    while (!stop) {
+        uint64_t now = now_us();
+        if (now >= run_end) break;
+        uint64_t due = round + period * (uint64_t)next / (uint64_t)lg.n;
+        if (due <= now) {
+            if (now - due > period) {
+                /* Too far behind to catch up: this client's tick is dropped rather than bunched */
+                lg.ticks_late++;
+            } else {
+                lg_tick(&lg, &lg.clients[next]);
+            }
+            if (++next == lg.n) {
+                next = 0;
+                round += period;
+                if (now > round + period) round = now;
+            }
+            continue;
+        }
+        uint64_t wait = due - now;
+        lg_poll(&lg, wait >= 1000 ? (int)(wait / 1000) : 0);
+    }
+    double run_s = (double)(now_us() - start) / 1e6;
+    uint64_t drain_end = now_us() + LG_DRAIN_MS * 1000u;
+    while (!stop && now_us() < drain_end) lg_poll(&lg, 10);
+    lg_report(&lg, run_s);
+    lg_free(&lg);
+    return 0;
+}
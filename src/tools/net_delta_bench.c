@@ -0,0 +1,192 @@
+#include "collision.h"
+#include "direction.h"
+#include "game_internal.h"
+#include "net_delta.h"
+#include "net_json.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_PLAYERS 4
+#define BENCH_TICKS 10000
+/* Ticks a message spends in flight each way, so acks trail the sender by a round trip */
+#define BENCH_LAG 2
+
+static uint32_t rng = 0x9E3779B9u;
+static uint32_t bench_rand(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static Game* bench_game(int players, const char* prefix) {
+    GameConfig* cfg = game_config_create();
+    if (!cfg) return NULL;
+    game_config_set_num_players(cfg, players);
+    game_config_set_max_players(cfg, SNAKE_MAX_PLAYERS);
+    Game* g = game_create(cfg, 42);
+    game_config_destroy(cfg);
+    if (!g) return NULL;
+    GameState* gs = (GameState*)game_get_state(g);
+    for (int i = 0; i < gs->num_players; i++) snprintf(gs->players[i].name, sizeof gs->players[i].name, "%s%d", prefix, i);
+    return g;
+}
+
+static bool occupied(const GameState* gs, SnakePoint pt) {
+    if (collision_is_wall(pt, gs->width, gs->height)) return true;
+    for (int i = 0; i < gs->num_players; i++)
+        for (int k = 0; k < gs->players[i].length; k++)
+            if (gs->players[i].body[k].x == pt.x && gs->players[i].body[k].y == pt.y) return true;
+    return false;
+}
+
+/* Heads for the nearest food along a free cell, with the odd random turn, so snakes grow and live like real players */
+static SnakeDir steer(const GameState* gs, const PlayerState* pl) {
+    static const int dx[4] = {0, 0, -1, 1};
+    static const int dy[4] = {-1, 1, 0, 0};
+    SnakeDir options[3] = {pl->current_dir, snake_dir_turn_left(pl->current_dir), snake_dir_turn_right(pl->current_dir)};
+    SnakeDir best = pl->current_dir;
+    long best_score = -1;
+    for (int o = 0; o < 3; o++) {
+        SnakePoint next = {pl->body[0].x + dx[options[o]], pl->body[0].y + dy[options[o]]};
+        if (occupied(gs, next)) continue;
+        long dist = 1L << 20;
+        for (int f = 0; f < gs->food_count; f++) {
+            long d = labs((long)(gs->food[f].x - next.x)) + labs((long)(gs->food[f].y - next.y));
+            if (d < dist) dist = d;
+        }
+        long score = (1L << 21) - dist * 4 + (long)(bench_rand() % 6);
+        if (score > best_score) {
+            best_score = score;
+            best = options[o];
+        }
+    }
+    return best;
+}
+
+/* Whether `peer` holds every active snake of `host` other than its own exactly */
+static bool in_sync(const GameState* host, const GameState* peer) {
+    for (int i = 0; i < host->num_players; i++) {
+        const PlayerState* h = &host->players[i];
+        if (!h->active) continue;
+        bool found = false;
+        for (int j = 0; j < peer->num_players && !found; j++) {
+            const PlayerState* p = &peer->players[j];
+            if (strcmp(p->name, h->name) != 0) continue;
+            found = !p->is_remote || (p->length == h->length && p->score == h->score &&
+                    memcmp(p->body, h->body, (size_t)h->length * sizeof(SnakePoint)) == 0);
+        }
+        if (!found) return false;
+    }
+    return true;
+}
+
+typedef struct {
+    char* msg[BENCH_LAG + 1];
+    size_t len[BENCH_LAG + 1];
+} Pipe;
+
+/* Queues `msg` and returns the one sent BENCH_LAG ticks ago, or NULL while the pipe fills */
+static const char* pipe_push(Pipe* p, int tick, const char* msg, size_t len, size_t* out_len) {
+    int slot = tick % (BENCH_LAG + 1);
+    int head = (tick + 1) % (BENCH_LAG + 1);
+    free(p->msg[slot]);
+    p->msg[slot] = malloc(len + 1);
+    if (p->msg[slot]) memcpy(p->msg[slot], msg, len + 1);
+    p->len[slot] = len;
+    *out_len = p->len[head];
+    return tick >= BENCH_LAG ? p->msg[head] : NULL;
+}
+
+int main(void) {
+    Game* host = bench_game(BENCH_PLAYERS, "P");
+    /* The receiving client plays P0 itself, leaving room for the other three as remote players */
+    Game* peer = bench_game(1, "P");
+    NetJsonWriter* json = net_json_writer_create();
+    NetJsonWriter* peer_json = net_json_writer_create();
+    NetDelta* host_delta = net_delta_create("host");
+    NetDelta* peer_delta = net_delta_create("peer");
+    if (!host || !peer || !json || !peer_json || !host_delta || !peer_delta) {
+        fprintf(stderr, "setup failed\n");
+        return 1;
+    }
+    Pipe down = {{0}, {0}}, up = {{0}, {0}};
+    unsigned long long json_bytes = 0, packed_bytes = 0, delta_bytes = 0;
+    size_t delta_max = 0;
+    long long segments = 0, snakes = 0;
+    int applied = 0, rejected = 0, out_of_sync = 0;
+    for (int tick = 0; tick < BENCH_TICKS; tick++) {
+        /* Deaths still happen when a snake is boxed in and respawn through the game's own rules */
+        const GameState* before = game_get_state(host);
+        for (int i = 0; i < BENCH_PLAYERS; i++) {
+            if (!before->players[i].active || before->players[i].length == 0) continue;
+            SnakeDir d = steer(before, &before->players[i]);
+            InputState in = {0};
+            in.move_up = (d == SNAKE_DIR_UP);
+            in.move_down = (d == SNAKE_DIR_DOWN);
+            in.move_left = (d == SNAKE_DIR_LEFT);
+            in.move_right = (d == SNAKE_DIR_RIGHT);
+            (void)game_enqueue_input(host, i, &in);
+        }
+        GameEvents events = {0};
+        game_step(host, &events);
+        if (game_get_status(host) == GAME_STATUS_GAME_OVER) game_reset(host);
+        const GameState* gs = game_get_state(host);
+        for (int i = 0; i < gs->num_players; i++)
+            if (gs->players[i].active) {
+                segments += gs->players[i].length;
+                snakes++;
+            }
+
+        size_t len = 0;
+        if (net_json_write_state(json, gs, tick, &len)) json_bytes += len;
+        if (net_json_write_packed_state(json, gs, tick, &len)) packed_bytes += len;
+        const char* msg = net_json_write_delta_state(json, host_delta, gs, tick, &len);
+        if (!msg) continue;
+        delta_bytes += len;
+        if (len > delta_max) delta_max = len;
+
+        size_t in_len = 0;
+        const char* in = pipe_push(&down, tick, msg, len, &in_len);
+        if (in) {
+            if (net_json_apply_state(peer, peer_delta, in, in_len, false))
+                applied++;
+            else
+                rejected++;
+        }
+        /* The peer's own state carries its acks back */
+        const char* reply = net_json_write_delta_state(peer_json, peer_delta, game_get_state(peer), tick, &len);
+        in = reply ? pipe_push(&up, tick, reply, len, &in_len) : NULL;
+        if (in) (void)net_json_apply_state(host, host_delta, in, in_len, true);
+    }
+    /* Drain the pipe so the last states land, then check the peer matches the host */
+    for (int tick = BENCH_TICKS; tick < BENCH_TICKS + BENCH_LAG; tick++) {
+        size_t in_len = 0;
+        const char* in = pipe_push(&down, tick, "", 0, &in_len);
+        if (in && in_len && net_json_apply_state(peer, peer_delta, in, in_len, false)) applied++;
+    }
+    if (!in_sync(game_get_state(host), game_get_state(peer))) out_of_sync++;
+    int keyframes = 0, deltas = 0;
+    net_delta_get_stats(host_delta, &keyframes, &deltas);
+    printf("net_delta_bench: %d players, %d ticks, ack lag %d ticks each way, mean snake length %.1f\n", BENCH_PLAYERS,
+           BENCH_TICKS, BENCH_LAG, snakes ? (double)segments / (double)snakes : 0.0);
+    printf("  json state:   %8.1f bytes/tick\n", (double)json_bytes / BENCH_TICKS);
+    printf("  bstate:       %8.1f bytes/tick\n", (double)packed_bytes / BENCH_TICKS);
+    printf("  dstate:       %8.1f bytes/tick (max %zu, %.1fx smaller than json)\n", (double)delta_bytes / BENCH_TICKS, delta_max,
+           delta_bytes ? (double)json_bytes / (double)delta_bytes : 0.0);
+    printf("  keyframes %d, deltas %d; peer applied %d, rejected %d, final state %s\n", keyframes, deltas, applied, rejected,
+           out_of_sync ? "OUT OF SYNC" : "in sync");
+    for (int i = 0; i <= BENCH_LAG; i++) {
+        free(down.msg[i]);
+        free(up.msg[i]);
+    }
+    net_delta_destroy(peer_delta);
+    net_delta_destroy(host_delta);
+    net_json_writer_destroy(peer_json);
+    net_json_writer_destroy(json);
+    game_destroy(peer);
+    game_destroy(host);
+    return out_of_sync ? 1 : 0;
+}
@@ -0,0 +1,109 @@
+#include "game_internal.h"
+#include "net.h"
+#include "net_json.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_PLAYERS 4
+#define BENCH_BODY 256
+#define BENCH_MSGS 20000
+#define BENCH_MSG_CAP (BENCH_PLAYERS * BENCH_BODY * 24 + 4096)
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+/* A state message in the shape game_state_to_json emits; `shift` moves every head so the interpolation path runs */
+static size_t build_msg(char* buf, size_t cap, int shift) {
+    size_t len = 0;
+    len += (size_t)snprintf(buf + len, cap - len, "{\"type\":\"state\",\"tick\":%d,\"w\":64,\"h\":64,\"players\":[", shift);
+    for (int p = 0; p < BENCH_PLAYERS; p++) {
+        len += (size_t)snprintf(buf + len, cap - len,
+                                "%s{\"id\":%d,\"name\":\"P%d\",\"x\":%d,\"y\":%d,\"len\":%d,\"score\":%d,\"color\":%d,\"dir\":3,\"body\":[",
+                                p ? "," : "", p, p, shift, p * 16, BENCH_BODY, 100 + p, -16776961 + p);
+        for (int i = 0; i < BENCH_BODY; i++) {
+            /* Boustrophedon path so consecutive segments are always neighbours, as in a real game */
+            int t = shift + BENCH_BODY - i;
+            int row = t / 60, col = t % 60;
+            int x = 1 + ((row & 1) ? 59 - col : col);
+            int y = 1 + p * 16 + row;
+            len += (size_t)snprintf(buf + len, cap - len, "%s{\"x\":%d,\"y\":%d}", i ? "," : "", x, y);
+        }
+        len += (size_t)snprintf(buf + len, cap - len, "]}");
+    }
+    len += (size_t)snprintf(buf + len, cap - len, "],\"food\":[{\"x\":3,\"y\":4},{\"x\":10,\"y\":20}]}");
+    return len;
+}
+
+static Game* bench_game(const char* local_name) {
+    GameConfig* cfg = game_config_create();
+    if (!cfg) return NULL;
+    game_config_set_num_players(cfg, 1);
+    game_config_set_max_players(cfg, SNAKE_MAX_PLAYERS);
+    Game* g = game_create(cfg, 0);
+    game_config_destroy(cfg);
+    if (g) {
+        /* Our own player as seen by a client: one entry of the message is skipped, the other three are applied */
+        PlayerState* self = &((GameState*)game_get_state(g))->players[0];
+        snprintf(self->name, sizeof self->name, "%s", local_name);
+    }
+    return g;
+}
+
+int main(void) {
+    static char msgs[2][BENCH_MSG_CAP];
+    size_t lens[2];
+    lens[0] = build_msg(msgs[0], sizeof msgs[0], 0);
+    lens[1] = build_msg(msgs[1], sizeof msgs[1], 1);
+    Game* g = bench_game("P0");
+    if (!g) {
+        fprintf(stderr, "net_json_bench: failed to create game\n");
+        return 1;
+    }
+    /* Warm up: adds the remote players */
+    for (int i = 0; i < 16; i++) (void)net_json_apply_state(g, NULL, msgs[i & 1], lens[i & 1], false);
+    double t0 = now_ms();
+    for (int i = 0; i < BENCH_MSGS; i++) {
+        if (!net_json_apply_state(g, NULL, msgs[i & 1], lens[i & 1], false)) {
+            fprintf(stderr, "net_json_bench: message %d rejected\n", i);
+            game_destroy(g);
+            return 1;
+        }
+    }
+    double ms = now_ms() - t0;
+    const GameState* gs = game_get_state(g);
+    int applied = 0;
+    for (int p = 0; p < gs->num_players; p++)
+        if (gs->players[p].is_remote && gs->players[p].length == BENCH_BODY) applied++;
+    printf("net_json_bench: apply players=%d body=%d msg_bytes=%zu msgs=%d remote_applied=%d total_ms=%.1f msgs_per_sec=%.0f MB_per_sec=%.1f\n",
+           BENCH_PLAYERS, BENCH_BODY, lens[0], BENCH_MSGS, applied, ms, (double)BENCH_MSGS * 1000.0 / ms,
+           (double)BENCH_MSGS * (double)lens[0] / 1e3 / ms);
+    /* Serialize the applied state back out through a reused writer, as the send path does every tick */
+    NetJsonWriter* w = net_json_writer_create();
+    size_t out_len = 0;
+    t0 = now_ms();
+    for (int i = 0; i < BENCH_MSGS && w; i++) {
+        if (!net_json_write_state(w, gs, i, &out_len)) break;
+    }
+    ms = now_ms() - t0;
+    printf("net_json_bench: write msg_bytes=%zu msgs=%d total_ms=%.1f msgs_per_sec=%.0f MB_per_sec=%.1f\n", out_len, BENCH_MSGS, ms,
+           (double)BENCH_MSGS * 1000.0 / ms, (double)BENCH_MSGS * (double)out_len / 1e3 / ms);
+    /* The same state in the binary encoding, wrapped and applied the way peers that advertise caps exchange it */
+    size_t packed_len = 0;
+    const char* packed = w ? net_json_write_packed_state(w, gs, 0, &packed_len) : NULL;
+    static char packed_msg[BENCH_MSG_CAP];
+    if (packed) memcpy(packed_msg, packed, packed_len);
+    t0 = now_ms();
+    for (int i = 0; i < BENCH_MSGS && packed; i++) (void)net_json_apply_state(g, NULL, packed_msg, packed_len, false);
+    ms = now_ms() - t0;
+    printf("net_json_bench: bstate msg_bytes=%zu msgs=%d total_ms=%.1f msgs_per_sec=%.0f\n", packed_len, BENCH_MSGS, ms,
+           (double)BENCH_MSGS * 1000.0 / ms);
+    net_json_writer_destroy(w);
+    game_destroy(g);
+    return applied == BENCH_PLAYERS - 1 && out_len > 0 ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+#include "console.h"
+#include "persist.h"
+#include "platform.h"
+#include "snake_server.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Authoritative session server: build/snakeserver.out [port] [config] [shards] */
+
+#define STATS_INTERVAL_MS 5000
+
+static SnakeServer* server = NULL;
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static void report(void) {
+    SnakeServerStats st;
+    snake_server_get_stats(server, &st);
+    console_info("sessions=%llu clients=%llu ticks=%llu inputs=%llu states=%llu dropped=%llu bytes_out=%llu\n",
+                 (unsigned long long)st.sessions, (unsigned long long)st.clients, (unsigned long long)st.ticks,
+                 (unsigned long long)st.inputs, (unsigned long long)st.states_sent, (unsigned long long)st.states_dropped,
+                 (unsigned long long)st.bytes_out);
+    for (int i = 0; i < snake_server_get_shard_count(server); i++) {
+        snake_server_get_shard_stats(server, i, &st);
+        console_info("  shard %d cpu %d: sessions=%llu clients=%llu tick avg=%.1fus max=%.1fus lag max=%llums handoffs in=%llu out=%llu\n",
+                     i, snake_server_get_shard_cpu(server, i), (unsigned long long)st.sessions,
+                     (unsigned long long)st.clients, st.ticks ? (double)st.tick_ns_total / (double)st.ticks / 1000.0 : 0.0,
+                     (double)st.tick_ns_max / 1000.0, (unsigned long long)st.lag_ms_max,
+                     (unsigned long long)st.handoffs_in, (unsigned long long)st.handoffs_out);
+    }
+}
+
+int main(int argc, char** argv) {
+    int port = argc > 1 ? atoi(argv[1]) : SNAKE_SERVER_DEFAULT_PORT;
+    int shards = argc > 3 ? atoi(argv[3]) : 0;
+    GameConfig* cfg = NULL;
+    if (argc > 2 && !persist_load_config(argv[2], &cfg)) console_info("No config file '%s'; using defaults\n", argv[2]);
+    if (!cfg) cfg = game_config_create();
+    if (!cfg) return 1;
+    server = snake_server_create(cfg, port, shards);
+    game_config_destroy(cfg);
+    if (!server || snake_server_start(server) != 0) {
+        console_error("snakeserver: cannot listen on port %d\n", port);
+        snake_server_destroy(server);
+        return 1;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+    console_info("snakeserver listening on port %d with %d shards\n", snake_server_get_port(server),
+                 snake_server_get_shard_count(server));
+    uint64_t next_report = platform_now_ms() + STATS_INTERVAL_MS;
+    while (!stop) {
+        platform_sleep_ms(100);
+        if (platform_now_ms() < next_report) continue;
+        report();
+        next_report += STATS_INTERVAL_MS;
+    }
+    snake_server_stop(server);
+    report();
+    snake_server_destroy(server);
+    return 0;
+}
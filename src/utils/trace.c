@@ -0,0 +1,138 @@
+#include "trace.h"
+#ifdef SNAKE_TRACE
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#define TRACE_RING_CAP 16384 /* events per ring; power of two */
+typedef struct {
+const char* name;
+uint64_t ts_ns;
+int tid;
+char ph;
+} TraceEvent;
+/* Single producer (the owning thread), any number of readers. head only grows; a reader keeps the events that were
+   not overwritten while it copied them. Rings of exited threads are handed to the next new thread. */
+typedef struct TraceRing {
+TraceEvent ev[TRACE_RING_CAP];
+uint64_t head;
+int owner_tid; /* 0 when free */
+const char* thread_name;
+struct TraceRing* next;
+} TraceRing;
+static TraceRing* trace_rings= NULL;
+static int trace_next_tid= 0;
+static uint64_t trace_epoch_ns= 0;
+static pthread_key_t trace_key;
+static pthread_once_t trace_once= PTHREAD_ONCE_INIT;
+static __thread TraceRing* trace_tls= NULL;
+static __thread int trace_tid= 0;
+static uint64_t trace_now_ns(void) {
+struct timespec t;
+clock_gettime(CLOCK_MONOTONIC, &t);
+return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+static void trace_thread_exit(void* arg) {
+TraceRing* r= arg;
+__atomic_store_n(&r->owner_tid, 0, __ATOMIC_RELEASE);
+}
+static void trace_atexit_flush(void) { (void)trace_flush(NULL); }
+static void trace_init(void) {
+trace_epoch_ns= trace_now_ns();
+(void)pthread_key_create(&trace_key, trace_thread_exit);
+(void)atexit(trace_atexit_flush);
+}
+static TraceRing* trace_ring(void) {
+if(trace_tls) return trace_tls;
+(void)pthread_once(&trace_once, trace_init);
+trace_tid= __atomic_add_fetch(&trace_next_tid, 1, __ATOMIC_RELAXED);
+TraceRing* r= NULL;
+/* Reuse a ring whose thread has exited before allocating */
+for(TraceRing* it= __atomic_load_n(&trace_rings, __ATOMIC_ACQUIRE); it && !r; it= it->next) {
+int expected= 0;
+if(__atomic_compare_exchange_n(&it->owner_tid, &expected, trace_tid, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) r= it;
+}
+if(!r) {
+r= calloc(1, sizeof *r);
+if(!r) return NULL;
+r->owner_tid= trace_tid;
+r->next= __atomic_load_n(&trace_rings, __ATOMIC_RELAXED);
+while(!__atomic_compare_exchange_n(&trace_rings, &r->next, r, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {}
+}
+__atomic_store_n(&r->thread_name, NULL, __ATOMIC_RELAXED);
+(void)pthread_setspecific(trace_key, r);
+trace_tls= r;
+return r;
+}
+static void trace_push(const char* name, char ph) {
+TraceRing* r= trace_ring();
+if(!r) return;
+uint64_t h= r->head;
+TraceEvent* e= &r->ev[h & (TRACE_RING_CAP - 1)];
+__atomic_store_n(&e->name, name, __ATOMIC_RELAXED);
+__atomic_store_n(&e->ts_ns, trace_now_ns(), __ATOMIC_RELAXED);
+__atomic_store_n(&e->tid, trace_tid, __ATOMIC_RELAXED);
+__atomic_store_n(&e->ph, ph, __ATOMIC_RELAXED);
+__atomic_store_n(&r->head, h + 1, __ATOMIC_RELEASE);
+}
+void trace_begin(const char* name) { trace_push(name, 'B'); }
+void trace_end(const char* name) { trace_push(name, 'E'); }
+void trace_set_thread_name(const char* name) {
+TraceRing* r= trace_ring();
+if(r) __atomic_store_n(&r->thread_name, name, __ATOMIC_RELAXED);
+}
+bool trace_flush(const char* path) {
+if(!path) path= getenv("SNAKE_TRACE_FILE");
+if(!path) {
+path= "logs/trace.json";
+mkdir("logs", 0755);
+}
+(void)pthread_once(&trace_once, trace_init);
+TraceEvent* snap= malloc(sizeof(TraceEvent) * TRACE_RING_CAP);
+if(!snap) return false;
+FILE* f= fopen(path, "w");
+if(!f) {
+free(snap);
+return false;
+}
+int pid= (int)getpid();
+bool ok= fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"snake\"}}", pid) >= 0;
+for(TraceRing* r= __atomic_load_n(&trace_rings, __ATOMIC_ACQUIRE); r && ok; r= r->next) {
+int owner= __atomic_load_n(&r->owner_tid, __ATOMIC_ACQUIRE);
+const char* tname= __atomic_load_n(&r->thread_name, __ATOMIC_RELAXED);
+if(owner && tname) ok= fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", pid, owner, tname) >= 0;
+uint64_t end= __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+uint64_t start= end > TRACE_RING_CAP ? end - TRACE_RING_CAP : 0;
+for(uint64_t i= start; i < end; i++) {
+const TraceEvent* e= &r->ev[i & (TRACE_RING_CAP - 1)];
+TraceEvent* s= &snap[i - start];
+s->name= __atomic_load_n(&e->name, __ATOMIC_RELAXED);
+s->ts_ns= __atomic_load_n(&e->ts_ns, __ATOMIC_RELAXED);
+s->tid= __atomic_load_n(&e->tid, __ATOMIC_RELAXED);
+s->ph= __atomic_load_n(&e->ph, __ATOMIC_RELAXED);
+}
+/* Drop whatever the producer lapped while we were copying, and slot `now`, which it may be writing right now (it is
+   the same slot as now - TRACE_RING_CAP) */
+uint64_t now= __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+uint64_t first= now >= TRACE_RING_CAP ? now - TRACE_RING_CAP + 1 : 0;
+if(first < start) first= start;
+for(uint64_t i= first; i < end && ok; i++) {
+const TraceEvent* s= &snap[i - start];
+double ts_us= (double)(s->ts_ns - trace_epoch_ns) / 1000.0;
+ok= fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f}", s->name, s->ph, pid, s->tid, ts_us) >= 0;
+}
+}
+if(ok) ok= fprintf(f, "\n]}\n") >= 0;
+if(fclose(f) != 0) ok= false;
+free(snap);
+return ok;
+}
+#else
+bool trace_flush(const char* path) {
+(void)path;
+return false;
+}
+#endif
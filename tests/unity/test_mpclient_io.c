@@ -0,0 +1,159 @@
+#include "unity.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "mpapi_client.h"
+
+#define BIG_DATA 100000
+#define QUEUED_CMDS 200
+#define QUEUED_DATA 16000
+
+static void send_all(int fd, const char* buf, size_t n) {
+    while (n > 0) {
+        ssize_t rc = send(fd, buf, n, 0);
+        TEST_ASSERT_TRUE(rc > 0);
+        buf += rc;
+        n -= (size_t)rc;
+    }
+}
+
+/* The I/O thread delivers asynchronously, so poll until a message shows up */
+static const char* wait_message(mpclient* c, size_t* len) {
+    for (int i = 0; i < 400; i++) {
+        const char* m = mpclient_peek_message(c, len);
+        if (m) return m;
+        struct timespec ts = {0, 5 * 1000 * 1000};
+        nanosleep(&ts, NULL);
+    }
+    return NULL;
+}
+
+/* A game line whose data is a JSON string of `n` copies of `fill` */
+static size_t game_line(char* buf, size_t n, char fill) {
+    static const char head[] = "{\"cmd\":\"game\",\"clientId\":\"p1\",\"data\":\"";
+    memcpy(buf, head, sizeof head - 1);
+    memset(buf + sizeof head - 1, fill, n);
+    memcpy(buf + sizeof head - 1 + n, "\"}\n", 3);
+    return sizeof head - 1 + n + 3;
+}
+
+TEST(test_mpclient_io) {
+    int l = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_ASSERT_TRUE(l >= 0);
+    struct sockaddr_in addr = {0};
+    socklen_t alen = sizeof addr;
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TEST_ASSERT_TRUE(bind(l, (struct sockaddr*)&addr, sizeof addr) == 0);
+    TEST_ASSERT_TRUE(listen(l, 1) == 0);
+    TEST_ASSERT_TRUE(getsockname(l, (struct sockaddr*)&addr, &alen) == 0);
+
+    mpclient* c = mpclient_create("127.0.0.1", ntohs(addr.sin_port), "test-ident");
+    TEST_ASSERT_TRUE(c != NULL);
+    TEST_ASSERT_EQUAL_INT(0, mpclient_connect_and_start(c));
+    int s = accept(l, NULL, NULL);
+    TEST_ASSERT_TRUE(s >= 0);
+
+    /* A line far larger than one read arrives intact, and two lines sharing a segment with its tail come out separately */
+    char* buf = malloc((2u << 20) + 64);
+    TEST_ASSERT_TRUE(buf != NULL);
+    size_t n = game_line(buf, BIG_DATA, 'x');
+    n += game_line(buf + n, 3, 'a');
+    n += game_line(buf + n, 4, 'b');
+    send_all(s, buf, 777);
+    send_all(s, buf + 777, n - 777);
+    size_t len = 0;
+    const char* m = wait_message(c, &len);
+    TEST_ASSERT_TRUE(m != NULL);
+    /* A string payload is handed over without its quotes */
+    TEST_ASSERT_EQUAL_INT(BIG_DATA, (int)len);
+    TEST_ASSERT_TRUE(m[0] == 'x' && m[BIG_DATA - 1] == 'x' && m[BIG_DATA] == '\0');
+    mpclient_release_message(c);
+    TEST_ASSERT_EQUAL_STRING("aaa", wait_message(c, &len));
+    mpclient_release_message(c);
+    TEST_ASSERT_EQUAL_STRING("bbbb", wait_message(c, &len));
+    mpclient_release_message(c);
+
+    /* A line over the 1 MiB limit is skipped whole; the next one still gets through */
+    n = game_line(buf, (1u << 20) + 100, 'y');
+    n += game_line(buf + n, 2, 'c');
+    send_all(s, buf, n);
+    TEST_ASSERT_EQUAL_STRING("cc", wait_message(c, &len));
+    mpclient_release_message(c);
+    TEST_ASSERT_TRUE(mpclient_peek_message(c, &len) == NULL);
+
+    /* With the server not reading, the socket fills and later commands pile up in the queue; each write then carries many
+       of them, and all arrive in order */
+    static char data[QUEUED_DATA + 16];
+    for (int i = 0; i < QUEUED_CMDS; i++) {
+        int k = snprintf(data, sizeof data, "\"%03d", i);
+        memset(data + k, 'q', QUEUED_DATA);
+        memcpy(data + k + QUEUED_DATA, "\"", 2);
+        TEST_ASSERT_EQUAL_INT(0, mpclient_send_game(c, data));
+    }
+    size_t got = 0;
+    int lines = 0, in_order = 1;
+    while (lines < QUEUED_CMDS) {
+        ssize_t rc = recv(s, buf + got, (2u << 20) - got, 0);
+        TEST_ASSERT_TRUE(rc > 0);
+        got += (size_t)rc;
+        char* line = buf;
+        char* nl;
+        while ((nl = memchr(line, '\n', (size_t)(buf + got - line))) != NULL) {
+            char want[8];
+            snprintf(want, sizeof want, "\"%03d", lines);
+            *nl = '\0';
+            const char* scan = strstr(line, "\"data\":");
+            if (!scan || strncmp(scan + 7, want, 4) != 0) in_order = 0;
+            lines++;
+            line = nl + 1;
+        }
+        got = (size_t)(buf + got - line);
+        memmove(buf, line, got);
+    }
+    TEST_ASSERT_TRUE(in_order);
+    MpClientSendStats st;
+    mpclient_get_send_stats(c, &st);
+    TEST_ASSERT_EQUAL_INT(QUEUED_CMDS, (int)st.cmds);
+    TEST_ASSERT_TRUE(st.writes > 0 && st.writes < st.cmds);
+
+    /* States go through the latest-wins slot: under a 5/s cap a burst sends the first at once, collapses the rest into
+       the newest, and that one follows when the cap allows */
+    mpclient_set_send_rate(c, 5);
+    mpclient_set_tcp_options(c, 1, 1);
+    for (int i = 0; i < 10; i++) {
+        snprintf(data, sizeof data, "{\"s\":%d}", i);
+        TEST_ASSERT_EQUAL_INT(0, mpclient_send_state(c, data));
+        if (i == 0) {
+            struct timespec ts = {0, 50 * 1000 * 1000};
+            nanosleep(&ts, NULL);
+        }
+    }
+    got = 0;
+    lines = 0;
+    while (lines < 2) {
+        ssize_t rc = recv(s, buf + got, (2u << 20) - got, 0);
+        TEST_ASSERT_TRUE(rc > 0);
+        got += (size_t)rc;
+        buf[got] = '\0';
+        lines = 0;
+        for (const char* p = buf; (p = strchr(p, '\n')) != NULL; p++) lines++;
+    }
+    TEST_ASSERT_TRUE(strstr(buf, "{\"s\":0}") != NULL && strstr(buf, "{\"s\":9}") != NULL);
+    TEST_ASSERT_TRUE(strstr(buf, "{\"s\":5}") == NULL);
+    mpclient_get_send_stats(c, &st);
+    TEST_ASSERT_EQUAL_INT(2, (int)st.states_sent);
+    TEST_ASSERT_EQUAL_INT(8, (int)st.states_replaced);
+
+    mpclient_stop(c);
+    /* Once stopped nothing more is queued */
+    TEST_ASSERT_EQUAL_INT(-1, mpclient_send_game(c, "{}"));
+    mpclient_destroy(c);
+    free(buf);
+    close(s);
+    close(l);
+}
@@ -0,0 +1,169 @@
+#include "unity.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "mpapi_client.h"
+#include "platform.h"
+
+typedef struct {
+    int calls;
+    int ok;
+    int is_host;
+    char session[16];
+} SessionResult;
+
+static void on_session(mpclient* c, int ok, const char* session, int is_host, void* user) {
+    SessionResult* r = (SessionResult*)user;
+    (void)c;
+    r->calls++;
+    r->ok = ok;
+    r->is_host = is_host;
+    snprintf(r->session, sizeof r->session, "%s", session);
+}
+
+/* Reads one command line from the client, failing after 2 s */
+static void read_command(int fd, char* out, size_t cap) {
+    size_t n = 0;
+    uint64_t t0 = platform_now_ms();
+    while (n + 1 < cap && platform_now_ms() - t0 < 2000) {
+        ssize_t rc = recv(fd, out + n, 1, 0);
+        TEST_ASSERT_TRUE(rc == 1);
+        if (out[n] == '\n') break;
+        n++;
+    }
+    out[n] = '\0';
+}
+
+static void reply(int fd, const char* line) {
+    size_t n = strlen(line);
+    TEST_ASSERT_EQUAL_INT((int)n, (int)send(fd, line, n, 0));
+}
+
+/* Polls like the game loop does until the request is no longer waiting */
+static MpClientSessionState wait_done(mpclient* c) {
+    MpClientSessionState st = mpclient_poll_session(c);
+    uint64_t t0 = platform_now_ms();
+    while ((st == MPCLIENT_SESSION_CONNECTING || st == MPCLIENT_SESSION_LISTING || st == MPCLIENT_SESSION_HOSTING || st == MPCLIENT_SESSION_JOINING) &&
+           platform_now_ms() - t0 < 2000) {
+        platform_sleep_ms(2);
+        st = mpclient_poll_session(c);
+    }
+    return st;
+}
+
+static mpclient* connect_client(int l, int* srv, SessionResult* r) {
+    struct sockaddr_in addr = {0};
+    socklen_t alen = sizeof addr;
+    TEST_ASSERT_TRUE(getsockname(l, (struct sockaddr*)&addr, &alen) == 0);
+    mpclient* c = mpclient_create("127.0.0.1", ntohs(addr.sin_port), "test-ident");
+    TEST_ASSERT_TRUE(c != NULL);
+    mpclient_set_session_callback(c, on_session, r);
+    TEST_ASSERT_EQUAL_INT(0, mpclient_connect_and_start(c));
+    *srv = accept(l, NULL, NULL);
+    TEST_ASSERT_TRUE(*srv >= 0);
+    return c;
+}
+
+TEST(test_mpclient_session) {
+    int l = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TEST_ASSERT_TRUE(bind(l, (struct sockaddr*)&addr, sizeof addr) == 0);
+    TEST_ASSERT_TRUE(listen(l, 4) == 0);
+    char line[512];
+    int srv;
+
+    /* A listed session is joined; the start call returns before the server has said anything */
+    SessionResult r = {0};
+    mpclient* c = connect_client(l, &srv, &r);
+    TEST_ASSERT_EQUAL_INT(MPCLIENT_SESSION_IDLE, mpclient_session_state(c));
+    uint64_t t0 = platform_now_ms();
+    TEST_ASSERT_EQUAL_INT(0, mpclient_auto_join_or_host(c, "p1"));
+    TEST_ASSERT_TRUE(platform_now_ms() - t0 < 100);
+    MpClientSessionState st = mpclient_session_state(c);
+    TEST_ASSERT_TRUE(st == MPCLIENT_SESSION_CONNECTING || st == MPCLIENT_SESSION_LISTING);
+    TEST_ASSERT_FALSE(mpclient_has_session(c));
+    /* A second request cannot start while this one is waiting */
+    TEST_ASSERT_EQUAL_INT(-1, mpclient_join(c, "XYZ", "p1"));
+    read_command(srv, line, sizeof line);
+    TEST_ASSERT_TRUE(strstr(line, "\"cmd\":\"list\"") != NULL);
+    reply(srv, "{\"cmd\":\"list\",\"data\":{\"list\":[{\"id\":\"ABC\",\"name\":\"h\"}]}}\n");
+    read_command(srv, line, sizeof line);
+    TEST_ASSERT_TRUE(strstr(line, "\"cmd\":\"join\"") != NULL && strstr(line, "\"session\":\"ABC\"") != NULL);
+    TEST_ASSERT_TRUE(strstr(line, "\"name\":\"p1\"") != NULL);
+    /* Listing a session is not joining it */
+    TEST_ASSERT_FALSE(mpclient_has_session(c));
+    reply(srv, "{\"cmd\":\"join\",\"session\":\"ABC\",\"clientId\":\"c2\"}\n");
+    TEST_ASSERT_EQUAL_INT(MPCLIENT_SESSION_READY, wait_done(c));
+    TEST_ASSERT_EQUAL_INT(1, r.calls);
+    TEST_ASSERT_EQUAL_INT(1, r.ok);
+    TEST_ASSERT_EQUAL_INT(0, r.is_host);
+    TEST_ASSERT_EQUAL_STRING("ABC", r.session);
+    TEST_ASSERT_TRUE(mpclient_has_session(c) && !mpclient_is_host(c));
+    /* The callback runs once per request */
+    TEST_ASSERT_EQUAL_INT(MPCLIENT_SESSION_READY, mpclient_poll_session(c));
+    TEST_ASSERT_EQUAL_INT(1, r.calls);
+    mpclient_destroy(c);
+    close(srv);
+
+    /* An empty list means hosting */
+    memset(&r, 0, sizeof r);
+    c = connect_client(l, &srv, &r);
+    TEST_ASSERT_EQUAL_INT(0, mpclient_auto_join_or_host(c, "p1"));
+    read_command(srv, line, sizeof line);
+    reply(srv, "{\"cmd\":\"list\",\"data\":{\"list\":[]}}\n");
+    read_command(srv, line, sizeof line);
+    TEST_ASSERT_TRUE(strstr(line, "\"cmd\":\"host\"") != NULL);
+    TEST_ASSERT_EQUAL_INT(MPCLIENT_SESSION_HOSTING, mpclient_session_state(c));
+    reply(srv, "{\"cmd\":\"host\",\"session\":\"H1\",\"clientId\":\"c1\"}\n");
+    TEST_ASSERT_EQUAL_INT(MPCLIENT_SESSION_READY, wait_done(c));
+    TEST_ASSERT_EQUAL_INT(1, r.calls);
+    TEST_ASSERT_TRUE(r.ok && r.is_host);
+    TEST_ASSERT_EQUAL_STRING("H1", r.session);
+    TEST_ASSERT_TRUE(mpclient_is_host(c));
+    mpclient_destroy(c);
+    close(srv);
+
+    /* A join the server never answers fails as soon as the connection drops */
+    memset(&r, 0, sizeof r);
+    c = connect_client(l, &srv, &r);
+    TEST_ASSERT_EQUAL_INT(0, mpclient_join(c, "GONE", "p1"));
+    st = mpclient_session_state(c);
+    TEST_ASSERT_TRUE(st == MPCLIENT_SESSION_CONNECTING || st == MPCLIENT_SESSION_JOINING);
+    read_command(srv, line, sizeof line);
+    TEST_ASSERT_TRUE(strstr(line, "\"session\":\"GONE\"") != NULL);
+    close(srv);
+    TEST_ASSERT_EQUAL_INT(MPCLIENT_SESSION_FAILED, wait_done(c));
+    TEST_ASSERT_EQUAL_INT(1, r.calls);
+    TEST_ASSERT_EQUAL_INT(0, r.ok);
+    TEST_ASSERT_FALSE(mpclient_has_session(c));
+    mpclient_destroy(c);
+
+    /* Nobody listening: starting does not wait for the connect, and its failure reaches the callback */
+    struct sockaddr_in gone = {0};
+    socklen_t alen = sizeof gone;
+    int g = socket(AF_INET, SOCK_STREAM, 0);
+    gone.sin_family = AF_INET;
+    gone.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TEST_ASSERT_TRUE(bind(g, (struct sockaddr*)&gone, sizeof gone) == 0);
+    TEST_ASSERT_TRUE(getsockname(g, (struct sockaddr*)&gone, &alen) == 0);
+    close(g);
+    memset(&r, 0, sizeof r);
+    c = mpclient_create("127.0.0.1", ntohs(gone.sin_port), "test-ident");
+    TEST_ASSERT_TRUE(c != NULL);
+    mpclient_set_session_callback(c, on_session, &r);
+    t0 = platform_now_ms();
+    TEST_ASSERT_EQUAL_INT(0, mpclient_connect_and_start(c));
+    /* The refusal may already have stopped the client, which fails the request on the spot */
+    (void)mpclient_auto_join_or_host(c, "p1");
+    TEST_ASSERT_TRUE(platform_now_ms() - t0 < 100);
+    TEST_ASSERT_EQUAL_INT(MPCLIENT_SESSION_FAILED, wait_done(c));
+    TEST_ASSERT_EQUAL_INT(1, r.calls);
+    TEST_ASSERT_EQUAL_INT(0, r.ok);
+    mpclient_destroy(c);
+    close(l);
+}
@@ -0,0 +1,112 @@
+#include "unity.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include "msg_ring.h"
+
+#define STRESS_MSGS 200000
+
+/* Message `i` is its decimal index repeated to a length that varies with i, so a torn or misordered read shows up */
+static size_t stress_msg(char* buf, size_t cap, unsigned i) {
+    size_t len = 1 + (i * 7919u) % 300u;
+    char num[16];
+    int n = snprintf(num, sizeof num, "%u,", i);
+    for (size_t k = 0; k < len && k < cap; k++) buf[k] = num[k % (size_t)n];
+    return len;
+}
+
+static void* stress_producer(void* arg) {
+    MsgRing* r = arg;
+    char buf[512];
+    for (unsigned i = 0; i < STRESS_MSGS; i++) {
+        size_t len = stress_msg(buf, sizeof buf, i);
+        while (!msg_ring_push(r, buf, len)) {
+        }
+    }
+    return NULL;
+}
+
+TEST(test_msg_ring) {
+    TEST_ASSERT_TRUE(msg_ring_create(4) == NULL);
+    MsgRing* r = msg_ring_create(100);
+    TEST_ASSERT_TRUE(r != NULL);
+    size_t len = 0;
+    TEST_ASSERT_TRUE(msg_ring_peek(r, &len) == NULL);
+    TEST_ASSERT_FALSE(msg_ring_push(r, "", 0));
+
+    /* Capacity rounds to 104: three 16-byte records plus a 48-byte one fit, then a fifth does not */
+    TEST_ASSERT_TRUE(msg_ring_push(r, "one", 3));
+    TEST_ASSERT_TRUE(msg_ring_push(r, "two", 3));
+    TEST_ASSERT_TRUE(msg_ring_push(r, "three", 5));
+    char big[128];
+    memset(big, 'x', sizeof big);
+    TEST_ASSERT_TRUE(msg_ring_push(r, big, 32));
+    TEST_ASSERT_FALSE(msg_ring_push(r, "four", 4));
+    const char* m = msg_ring_peek(r, &len);
+    TEST_ASSERT_EQUAL_STRING("one", m);
+    TEST_ASSERT_EQUAL_INT(3, (int)len);
+    /* Peeking again returns the same view until it is popped */
+    TEST_ASSERT_TRUE(msg_ring_peek(r, NULL) == m);
+    msg_ring_pop(r);
+    TEST_ASSERT_EQUAL_STRING("two", msg_ring_peek(r, &len));
+    msg_ring_pop(r);
+
+    /* The 8 bytes left at the end are too few for this record: it wraps to the front behind a marker */
+    TEST_ASSERT_TRUE(msg_ring_push(r, "wrapped!", 8));
+    TEST_ASSERT_EQUAL_STRING("three", msg_ring_peek(r, &len));
+    msg_ring_pop(r);
+    m = msg_ring_peek(r, &len);
+    TEST_ASSERT_TRUE(m != NULL && len == 32 && m[32] == '\0' && memcmp(m, big, 32) == 0);
+    msg_ring_pop(r);
+    TEST_ASSERT_EQUAL_STRING("wrapped!", msg_ring_peek(r, &len));
+    msg_ring_pop(r);
+    TEST_ASSERT_TRUE(msg_ring_peek(r, &len) == NULL);
+    /* A message larger than the whole arena is dropped, not truncated */
+    TEST_ASSERT_FALSE(msg_ring_push(r, big, 100));
+
+    MsgRingStats st;
+    msg_ring_get_stats(r, &st);
+    TEST_ASSERT_EQUAL_INT(5, (int)st.pushed);
+    TEST_ASSERT_EQUAL_INT(5, (int)st.popped);
+    TEST_ASSERT_EQUAL_INT(3, (int)st.dropped);
+    TEST_ASSERT_EQUAL_INT(104, (int)st.capacity);
+    TEST_ASSERT_EQUAL_INT(96, (int)st.high_water_bytes);
+    TEST_ASSERT_EQUAL_INT(4, (int)st.high_water_msgs);
+    msg_ring_destroy(r);
+
+    /* Up to half the arena fits an empty ring wherever the last record ended, even when it needs wrap padding */
+    r = msg_ring_create(96);
+    TEST_ASSERT_FALSE(msg_ring_push(r, big, 40));
+    TEST_ASSERT_TRUE(msg_ring_push(r, big, 24));
+    TEST_ASSERT_TRUE(msg_ring_push(r, "pad", 3));
+    msg_ring_pop(r);
+    msg_ring_pop(r);
+    TEST_ASSERT_TRUE(msg_ring_push(r, big, 39));
+    m = msg_ring_peek(r, &len);
+    TEST_ASSERT_TRUE(m != NULL && len == 39 && memcmp(m, big, 39) == 0);
+    msg_ring_pop(r);
+    /* Just over half is refused the same way here as at the front of a fresh ring */
+    TEST_ASSERT_FALSE(msg_ring_push(r, big, 40));
+    msg_ring_destroy(r);
+
+    /* Producer and consumer on separate threads: every message arrives once, in order and intact */
+    r = msg_ring_create(4096);
+    pthread_t th;
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&th, NULL, stress_producer, r));
+    char want[512];
+    unsigned bad = 0;
+    for (unsigned i = 0; i < STRESS_MSGS;) {
+        m = msg_ring_peek(r, &len);
+        if (!m) continue;
+        size_t wl = stress_msg(want, sizeof want, i);
+        if (len != wl || memcmp(m, want, wl) != 0 || m[len] != '\0') bad++;
+        msg_ring_pop(r);
+        i++;
+    }
+    pthread_join(th, NULL);
+    TEST_ASSERT_EQUAL_INT(0, (int)bad);
+    msg_ring_get_stats(r, &st);
+    TEST_ASSERT_TRUE(st.pushed == STRESS_MSGS && st.popped == STRESS_MSGS);
+    TEST_ASSERT_TRUE(st.high_water_bytes <= st.capacity);
+    msg_ring_destroy(r);
+}
@@ -0,0 +1,63 @@
+#include "unity.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "mpapi_client.h"
+
+static void send_line(int fd, const char* line) {
+    size_t n = strlen(line);
+    TEST_ASSERT_EQUAL_INT((int)n, (int)send(fd, line, n, 0));
+}
+
+/* The receive thread applies lines asynchronously, so poll until the expected value shows up */
+static int wait_caps(mpclient* c, int want) {
+    int got = -1;
+    for (int i = 0; i < 200; i++) {
+        got = mpclient_peer_caps(c);
+        if (got == want) break;
+        struct timespec ts = {0, 5 * 1000 * 1000};
+        nanosleep(&ts, NULL);
+    }
+    return got;
+}
+
+TEST(test_net_caps) {
+    int l = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_ASSERT_TRUE(l >= 0);
+    struct sockaddr_in addr = {0};
+    socklen_t alen = sizeof addr;
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TEST_ASSERT_TRUE(bind(l, (struct sockaddr*)&addr, sizeof addr) == 0);
+    TEST_ASSERT_TRUE(listen(l, 1) == 0);
+    TEST_ASSERT_TRUE(getsockname(l, (struct sockaddr*)&addr, &alen) == 0);
+
+    mpclient* c = mpclient_create("127.0.0.1", ntohs(addr.sin_port), "test-ident");
+    TEST_ASSERT_TRUE(c != NULL);
+    TEST_ASSERT_EQUAL_INT(0, mpclient_connect_and_start(c));
+    int s = accept(l, NULL, NULL);
+    TEST_ASSERT_TRUE(s >= 0);
+
+    /* No peers yet: JSON */
+    send_line(s, "{\"cmd\":\"host\",\"session\":\"S1\",\"clientId\":\"me\"}\n");
+    TEST_ASSERT_EQUAL_INT(0, wait_caps(c, 0));
+    /* An old peer without caps keeps us on JSON until it upgrades */
+    send_line(s, "{\"cmd\":\"game\",\"clientId\":\"p1\",\"data\":{\"type\":\"state\",\"tick\":1}}\n");
+    send_line(s, "{\"cmd\":\"game\",\"clientId\":\"me\",\"data\":{\"type\":\"state\",\"caps\":1}}\n");
+    TEST_ASSERT_EQUAL_INT(0, wait_caps(c, 0));
+    send_line(s, "{\"cmd\":\"game\",\"clientId\":\"p1\",\"data\":{\"type\":\"state\",\"caps\":1,\"tick\":2}}\n");
+    TEST_ASSERT_EQUAL_INT(1, wait_caps(c, 1));
+    /* A newcomer is unknown until it speaks; once it leaves we are back to binary */
+    send_line(s, "{\"cmd\":\"joined\",\"clientId\":\"p2\",\"data\":{\"name\":\"two\"}}\n");
+    TEST_ASSERT_EQUAL_INT(0, wait_caps(c, 0));
+    send_line(s, "{\"cmd\":\"left\",\"clientId\":\"p2\"}\n");
+    TEST_ASSERT_EQUAL_INT(1, wait_caps(c, 1));
+
+    mpclient_stop(c);
+    mpclient_destroy(c);
+    close(s);
+    close(l);
+}
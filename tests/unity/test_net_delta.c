@@ -0,0 +1,148 @@
+#include "unity.h"
+#include <stdlib.h>
+#include <string.h>
+#include "game.h"
+#include "game_internal.h"
+#include "net_delta.h"
+
+static bool same_player(const Game* g, const PlayerState* want) {
+    const GameState* gs = game_get_state(g);
+    for (int i = 0; i < gs->num_players; i++) {
+        const PlayerState* p = &gs->players[i];
+        if (strcmp(p->name, want->name) != 0) continue;
+        return p->length == want->length && p->score == want->score && p->current_dir == want->current_dir &&
+               memcmp(p->body, want->body, (size_t)want->length * sizeof(SnakePoint)) == 0;
+    }
+    return false;
+}
+
+/* One tick: A slides right, B grows upwards */
+static void advance(PlayerState* players) {
+    memmove(players[0].body + 1, players[0].body, (size_t)(players[0].length - 1) * sizeof(SnakePoint));
+    players[0].body[0].x++;
+    memmove(players[1].body + 1, players[1].body, (size_t)players[1].length * sizeof(SnakePoint));
+    players[1].body[0].y--;
+    players[1].length++;
+    players[1].score++;
+}
+
+TEST(test_net_delta) {
+    static PlayerState players[SNAKE_MAX_PLAYERS];
+    static unsigned char buf[NET_DELTA_MAX_PACKED];
+    SnakePoint food[SNAKE_MAX_FOOD] = {{7, 8}};
+    GameState gs;
+    memset(&gs, 0, sizeof gs);
+    memset(players, 0, sizeof players);
+    gs.width = 40;
+    gs.height = 40;
+    gs.players = players;
+    gs.num_players = 2;
+    gs.max_players = SNAKE_MAX_PLAYERS;
+    gs.food = food;
+    gs.food_count = 1;
+    gs.max_food = SNAKE_MAX_FOOD;
+    strcpy(players[0].name, "A");
+    players[0].active = true;
+    players[0].current_dir = SNAKE_DIR_RIGHT;
+    players[0].length = 3;
+    for (int i = 0; i < 3; i++) players[0].body[i] = (SnakePoint){10 - i, 5};
+    strcpy(players[1].name, "B");
+    players[1].active = true;
+    players[1].color = 0xFF00FF00u;
+    players[1].current_dir = SNAKE_DIR_UP;
+    players[1].length = 2;
+    players[1].body[0] = (SnakePoint){20, 30};
+    players[1].body[1] = (SnakePoint){20, 31};
+
+    NetDelta* host = net_delta_create("Host");
+    NetDelta* peer = net_delta_create("Peer");
+    GameConfig* cfg = game_config_create();
+    game_config_set_num_players(cfg, 1);
+    game_config_set_max_players(cfg, 4);
+    Game* host_game = game_create(cfg, 0);
+    Game* peer_game = game_create(cfg, 0);
+    TEST_ASSERT_TRUE(host && peer && host_game && peer_game);
+    TEST_ASSERT_EQUAL_INT(0, (int)net_delta_encode(host, &gs, 1, buf, sizeof buf - 1));
+
+    /* Nobody has acknowledged anything yet: keyframe */
+    size_t n = net_delta_encode(host, &gs, 1, buf, sizeof buf);
+    TEST_ASSERT_TRUE(n > 0);
+    TEST_ASSERT_TRUE(net_delta_apply(peer, peer_game, buf, n, false));
+    TEST_ASSERT_TRUE(same_player(peer_game, &players[0]) && same_player(peer_game, &players[1]));
+    TEST_ASSERT_EQUAL_INT(7, game_get_state(peer_game)->food[0].x);
+    /* A repeat is harmless and our own message is refused */
+    TEST_ASSERT_TRUE(net_delta_apply(peer, peer_game, buf, n, false));
+    TEST_ASSERT_FALSE(net_delta_apply(host, host_game, buf, n, false));
+
+    /* The peer's next message acknowledges it, so the host switches to deltas */
+    n = net_delta_encode(peer, game_get_state(peer_game), 1, buf, sizeof buf);
+    TEST_ASSERT_TRUE(net_delta_apply(host, host_game, buf, n, true));
+    for (int t = 2; t < 10; t++) {
+        advance(players);
+        if (t == 5) food[0] = (SnakePoint){3, 3};
+        if (t == 6) players[0].current_dir = SNAKE_DIR_DOWN;
+        n = net_delta_encode(host, &gs, t, buf, sizeof buf);
+        /* Every prefix of the message is rejected without touching the peer */
+        for (size_t cut = 0; cut < n; cut++) TEST_ASSERT_FALSE(net_delta_apply(peer, peer_game, buf, cut, false));
+        TEST_ASSERT_TRUE(net_delta_apply(peer, peer_game, buf, n, false));
+        TEST_ASSERT_TRUE(same_player(peer_game, &players[0]) && same_player(peer_game, &players[1]));
+        TEST_ASSERT_EQUAL_INT(food[0].x, game_get_state(peer_game)->food[0].x);
+        /* The peer acknowledges every other tick; deltas are built against whatever it last confirmed */
+        if (t & 1) {
+            size_t m = net_delta_encode(peer, game_get_state(peer_game), t, buf, sizeof buf);
+            TEST_ASSERT_TRUE(net_delta_apply(host, host_game, buf, m, true));
+        }
+    }
+    int keyframes = 0, deltas = 0;
+    net_delta_get_stats(host, &keyframes, &deltas);
+    TEST_ASSERT_EQUAL_INT(1, keyframes);
+    TEST_ASSERT_EQUAL_INT(8, deltas);
+    TEST_ASSERT_TRUE(n < 64);
+
+    /* A jump that is not a head run (a respawn) still reconstructs, as a full entry */
+    players[0].length = 1;
+    players[0].body[0] = (SnakePoint){1, 1};
+    n = net_delta_encode(host, &gs, 10, buf, sizeof buf);
+    TEST_ASSERT_TRUE(net_delta_apply(peer, peer_game, buf, n, false));
+    TEST_ASSERT_TRUE(same_player(peer_game, &players[0]) && same_player(peer_game, &players[1]));
+
+    /* A receiver without the base waits; once it speaks up with no ack the host sends it a keyframe */
+    NetDelta* late = net_delta_create("Late");
+    Game* late_game = game_create(cfg, 0);
+    advance(players);
+    n = net_delta_encode(host, &gs, 11, buf, sizeof buf);
+    TEST_ASSERT_FALSE(net_delta_apply(late, late_game, buf, n, false));
+    n = net_delta_encode(late, game_get_state(late_game), 1, buf, sizeof buf);
+    TEST_ASSERT_TRUE(net_delta_apply(host, host_game, buf, n, true));
+    advance(players);
+    n = net_delta_encode(host, &gs, 12, buf, sizeof buf);
+    TEST_ASSERT_TRUE(net_delta_apply(late, late_game, buf, n, false));
+    TEST_ASSERT_TRUE(same_player(late_game, &players[0]) && same_player(late_game, &players[1]));
+    net_delta_get_stats(host, &keyframes, &deltas);
+    TEST_ASSERT_EQUAL_INT(2, keyframes);
+
+    /* Truncated messages from a name we have not heard from are refused without registering it as a peer, which
+       would hold every send at a keyframe until it idled out */
+    n = net_delta_encode(late, game_get_state(late_game), 2, buf, sizeof buf);
+    TEST_ASSERT_TRUE(net_delta_apply(host, host_game, buf, n, true));
+    NetDelta* ghost = net_delta_create("Ghost");
+    n = net_delta_encode(ghost, &gs, 1, buf, sizeof buf);
+    for (size_t cut = 0; cut < n; cut++) TEST_ASSERT_FALSE(net_delta_apply(host, host_game, buf, cut, true));
+    net_delta_destroy(ghost);
+    advance(players);
+    n = net_delta_encode(host, &gs, 13, buf, sizeof buf);
+    net_delta_get_stats(host, &keyframes, &deltas);
+    TEST_ASSERT_EQUAL_INT(2, keyframes);
+
+    /* Garbage is refused */
+    memset(buf, 0xA5, 64);
+    TEST_ASSERT_FALSE(net_delta_apply(peer, peer_game, buf, 64, false));
+
+    net_delta_destroy(late);
+    net_delta_destroy(peer);
+    net_delta_destroy(host);
+    game_destroy(late_game);
+    game_destroy(peer_game);
+    game_destroy(host_game);
+    game_config_destroy(cfg);
+}
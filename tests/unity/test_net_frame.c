@@ -0,0 +1,89 @@
+#include "unity.h"
+#include <stdlib.h>
+#include <string.h>
+#include "net_frame.h"
+
+#define BIG_FRAME 200000
+
+/* Appends a frame carrying `len` bytes of `fill` */
+static size_t put_frame(unsigned char* p, size_t len, unsigned char fill) {
+    p[0] = (unsigned char)(len >> 24);
+    p[1] = (unsigned char)(len >> 16);
+    p[2] = (unsigned char)(len >> 8);
+    p[3] = (unsigned char)len;
+    memset(p + 4, fill, len);
+    return 4 + len;
+}
+
+/* Takes every complete frame, checking each is `len` bytes of its own index */
+static int take(NetFrameDecoder* d, int next, const size_t* lens) {
+    const unsigned char* p;
+    size_t n;
+    int rc;
+    while ((rc = net_frame_decoder_next(d, &p, &n)) == 1) {
+        TEST_ASSERT_EQUAL_INT((int)lens[next], (int)n);
+        TEST_ASSERT_TRUE(p[0] == (unsigned char)next && p[n - 1] == (unsigned char)next);
+        next++;
+    }
+    TEST_ASSERT_EQUAL_INT(0, rc);
+    return next;
+}
+
+TEST(test_net_frame) {
+    /* Small frames, one big enough to grow the arena, and more small ones behind it */
+    static const size_t lens[] = {1, 5, 300, BIG_FRAME, 2, 4096, 1, 77};
+    const int count = (int)(sizeof lens / sizeof lens[0]);
+    unsigned char* stream = malloc(BIG_FRAME + 8192);
+    size_t total = 0;
+    for (int i = 0; i < count; i++) total += put_frame(stream + total, lens[i], (unsigned char)i);
+
+    /* Fed a byte at a time, then in uneven chunks: every frame comes out whole and in order */
+    NetFrameDecoder* d = net_frame_decoder_create(BIG_FRAME);
+    TEST_ASSERT_TRUE(d != NULL);
+    int got = 0;
+    for (size_t i = 0; i < total; i++) {
+        TEST_ASSERT_TRUE(net_frame_decoder_feed(d, stream + i, 1));
+        got = take(d, got, lens);
+    }
+    TEST_ASSERT_EQUAL_INT(count, got);
+    TEST_ASSERT_EQUAL_INT(0, (int)net_frame_decoder_pending(d));
+    got = 0;
+    for (size_t off = 0, step = 3; off < total; off += step, step = step * 7 % 9973 + 1) {
+        size_t n = total - off < step ? total - off : step;
+        TEST_ASSERT_TRUE(net_frame_decoder_feed(d, stream + off, n));
+        got = take(d, got, lens);
+    }
+    TEST_ASSERT_EQUAL_INT(count, got);
+
+    /* Reads straight into the arena: the space offered always lets a started frame complete */
+    got = 0;
+    size_t off = 0;
+    while (off < total) {
+        size_t avail = 0;
+        unsigned char* dst = net_frame_decoder_space(d, &avail);
+        TEST_ASSERT_TRUE(dst != NULL && avail > 0);
+        size_t n = total - off < avail ? total - off : avail;
+        if (n > 1000) n = 1000;
+        memcpy(dst, stream + off, n);
+        net_frame_decoder_commit(d, n);
+        off += n;
+        got = take(d, got, lens);
+    }
+    TEST_ASSERT_EQUAL_INT(count, got);
+    net_frame_decoder_destroy(d);
+
+    /* Empty and oversized frames break the stream */
+    d = net_frame_decoder_create(16);
+    unsigned char bad[4 + 17];
+    put_frame(bad, 17, 1);
+    TEST_ASSERT_TRUE(net_frame_decoder_feed(d, bad, 4));
+    TEST_ASSERT_EQUAL_INT(-1, net_frame_decoder_next(d, NULL, NULL));
+    TEST_ASSERT_EQUAL_INT(-1, net_frame_decoder_next(d, NULL, NULL));
+    net_frame_decoder_destroy(d);
+    d = net_frame_decoder_create(16);
+    memset(bad, 0, 4);
+    TEST_ASSERT_TRUE(net_frame_decoder_feed(d, bad, 4));
+    TEST_ASSERT_EQUAL_INT(-1, net_frame_decoder_next(d, NULL, NULL));
+    net_frame_decoder_destroy(d);
+    free(stream);
+}
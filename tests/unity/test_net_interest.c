@@ -0,0 +1,116 @@
+#include "unity.h"
+#include <stdlib.h>
+#include <string.h>
+#include "game.h"
+#include "game_internal.h"
+#include "net.h"
+
+/* Plays "me", so its own snake coming back is skipped and the three others fit */
+static Game* make_viewer(void) {
+    GameConfig* cfg = game_config_create();
+    game_config_set_player_name(cfg, "me");
+    game_config_set_num_players(cfg, 1);
+    game_config_set_max_players(cfg, SNAKE_MAX_PLAYERS);
+    Game* g = game_create(cfg, 0);
+    game_config_destroy(cfg);
+    return g;
+}
+
+static const PlayerState* find_player(const Game* g, const char* name) {
+    const GameState* gs = game_get_state(g);
+    for (int i = 0; i < gs->num_players; i++)
+        if (gs->players[i].active && strcmp(gs->players[i].name, name) == 0) return &gs->players[i];
+    return NULL;
+}
+
+/* A straight snake of `len` segments with its head at (x, y), its body trailing away from `dir` */
+static void place(PlayerState* pl, const char* name, int x, int y, SnakeDir dir, int len) {
+    memset(pl, 0, sizeof *pl);
+    strcpy(pl->name, name);
+    pl->active = true;
+    pl->current_dir = dir;
+    pl->length = len;
+    int dx = dir == SNAKE_DIR_RIGHT ? -1 : (dir == SNAKE_DIR_LEFT ? 1 : 0);
+    int dy = dir == SNAKE_DIR_DOWN ? -1 : (dir == SNAKE_DIR_UP ? 1 : 0);
+    for (int k = 0; k < len; k++) pl->body[k] = (SnakePoint){x + dx * k, y + dy * k};
+}
+
+TEST(test_net_interest) {
+    static PlayerState players[SNAKE_MAX_PLAYERS];
+    GameState gs;
+    memset(&gs, 0, sizeof gs);
+    gs.width = 200;
+    gs.height = 200;
+    gs.players = players;
+    gs.num_players = 4;
+    gs.max_players = SNAKE_MAX_PLAYERS;
+    gs.max_food = SNAKE_MAX_FOOD;
+    place(&players[0], "me", 50, 50, SNAKE_DIR_RIGHT, 3);
+    place(&players[1], "near", 53, 54, SNAKE_DIR_UP, 4);
+    place(&players[2], "ahead", 80, 60, SNAKE_DIR_DOWN, 20);
+    place(&players[3], "far", 150, 150, SNAKE_DIR_LEFT, 40);
+    NetInterest in = {5, 40, 4};
+
+    /* Off (or no interest) is byte for byte the shared state */
+    static unsigned char full[NET_STATE_MAX_PACKED], view[NET_STATE_MAX_PACKED];
+    size_t full_len = net_pack_state(&gs, 1, full, sizeof full);
+    TEST_ASSERT_TRUE(full_len > 0);
+    NetInterest off = {0, 40, 4};
+    TEST_ASSERT_EQUAL_INT((int)full_len, (int)net_pack_state_for(&gs, 1, 0, &off, view, sizeof view));
+    TEST_ASSERT_TRUE(memcmp(full, view, full_len) == 0);
+    TEST_ASSERT_EQUAL_INT((int)full_len, (int)net_pack_state_for(&gs, 1, 0, NULL, view, sizeof view));
+
+    /* Within the radius or the view cone: full detail; far behind: left out between summaries */
+    size_t n = net_pack_state_for(&gs, 1, 0, &in, view, sizeof view);
+    TEST_ASSERT_TRUE(n > 0 && n < full_len);
+    Game* g = make_viewer();
+    TEST_ASSERT_TRUE(net_apply_packed_state(g, view, n, false));
+    TEST_ASSERT_EQUAL_INT(4, find_player(g, "near")->length);
+    TEST_ASSERT_EQUAL_INT(20, find_player(g, "ahead")->length);
+    TEST_ASSERT_TRUE(find_player(g, "far") == NULL);
+
+    /* Facing the other way, the snake ahead is now behind and only the radius counts */
+    players[0].current_dir = SNAKE_DIR_LEFT;
+    size_t behind = net_pack_state_for(&gs, 1, 0, &in, view, sizeof view);
+    TEST_ASSERT_TRUE(behind > 0 && behind < n);
+    players[0].current_dir = SNAKE_DIR_RIGHT;
+
+    /* On the receiver's summary tick the far snake is its head alone, whatever its length */
+    n = net_pack_state_for(&gs, 4, 0, &in, view, sizeof view);
+    TEST_ASSERT_TRUE(net_apply_packed_state(g, view, n, false));
+    const PlayerState* far = find_player(g, "far");
+    TEST_ASSERT_TRUE(far != NULL);
+    TEST_ASSERT_EQUAL_INT(1, far->length);
+    TEST_ASSERT_EQUAL_INT(150, far->body[0].x);
+    /* Summaries are staggered: receiver 1 gets its summary a tick earlier */
+    size_t n1 = net_pack_state_for(&gs, 3, 1, &in, view, sizeof view);
+    size_t n1_off = net_pack_state_for(&gs, 4, 1, &in, view, sizeof view);
+    TEST_ASSERT_TRUE(n1 > n1_off);
+
+    /* With the full body known, a summary moves it along behind the new head */
+    TEST_ASSERT_TRUE(net_apply_packed_state(g, full, full_len, false));
+    TEST_ASSERT_EQUAL_INT(40, far->length);
+    place(&players[3], "far", 148, 150, SNAKE_DIR_LEFT, 40);
+    n = net_pack_state_for(&gs, 8, 0, &in, view, sizeof view);
+    TEST_ASSERT_TRUE(net_apply_packed_state(g, view, n, false));
+    TEST_ASSERT_EQUAL_INT(40, far->length);
+    TEST_ASSERT_EQUAL_INT(148, far->body[0].x);
+    TEST_ASSERT_EQUAL_INT(150, far->body[1].x);
+    TEST_ASSERT_EQUAL_INT(151, far->body[2].x);
+    TEST_ASSERT_EQUAL_INT(150, far->body[1].y);
+
+    /* A viewer without a live snake sees everything */
+    players[0].active = false;
+    TEST_ASSERT_TRUE(net_pack_state_for(&gs, 1, 0, &in, view, sizeof view) == net_pack_state(&gs, 1, full, sizeof full));
+    players[0].active = true;
+
+    /* Every truncation of a state with a summary in it is rejected */
+    n = net_pack_state_for(&gs, 4, 0, &in, view, sizeof view);
+    for (size_t cut = 0; cut < n; cut++) {
+        unsigned char* copy = malloc(cut ? cut : 1);
+        memcpy(copy, view, cut);
+        TEST_ASSERT_FALSE(net_apply_packed_state(g, copy, cut, false));
+        free(copy);
+    }
+    game_destroy(g);
+}
@@ -0,0 +1,78 @@
+#include "unity.h"
+#include <string.h>
+#include "game.h"
+#include "game_internal.h"
+#include "net_json.h"
+#include "player.h"
+
+static bool apply(Game* g, const char* json, bool is_host) { return net_json_apply_state(g, NULL, json, strlen(json), is_host); }
+
+static int find_player(const GameState* gs, const char* name) {
+    for (int i = 0; i < gs->num_players; i++)
+        if (strcmp(gs->players[i].name, name) == 0) return i;
+    return -1;
+}
+
+TEST(test_net_json) {
+    GameConfig* cfg = game_config_create();
+    game_config_set_num_players(cfg, 1);
+    game_config_set_max_players(cfg, 4);
+    Game* g = game_create(cfg, 0);
+    TEST_ASSERT_TRUE(g != NULL);
+    PlayerCfg* pc = player_cfg_create();
+    player_cfg_set_name(pc, "Me");
+    int me = game_add_player(g, pc);
+    TEST_ASSERT_TRUE(me >= 0);
+    const GameState* gs = game_get_state(g);
+    int base = gs->num_players;
+    int my_len = gs->players[me].length;
+
+    /* Not state messages: chat lines and other JSON leave the game alone */
+    TEST_ASSERT_FALSE(apply(g, "Player joined: abc", false));
+    TEST_ASSERT_FALSE(apply(g, "{\"type\":\"chat\",\"players\":[{\"name\":\"X\",\"body\":[{\"x\":1,\"y\":1}]}]}", false));
+    TEST_ASSERT_EQUAL_INT(base, gs->num_players);
+
+    /* Our own reflection is skipped, a new remote is added with its body filled in place */
+    const char* msg1 = "{\"type\":\"state\",\"tick\":1,\"w\":40,\"h\":20,\"players\":["
+                       "{\"id\":0,\"name\":\"Me\",\"x\":9,\"y\":9,\"len\":1,\"score\":99,\"color\":1,\"dir\":0,\"body\":[{\"x\":9,\"y\":9}]},"
+                       "{\"id\":1,\"name\":\"R\\u0061\\\"s\",\"x\":5,\"y\":6,\"len\":3,\"score\":7,\"color\":-16776961,\"dir\":3,"
+                       "\"body\":[{\"x\":5,\"y\":6},{\"x\":4,\"y\":6},{\"x\":3,\"y\":6}]}],"
+                       "\"food\":[{\"x\":10,\"y\":11},{\"x\":12,\"y\":13}]}";
+    TEST_ASSERT_TRUE(apply(g, msg1, false));
+    TEST_ASSERT_EQUAL_INT(base + 1, gs->num_players);
+    TEST_ASSERT_EQUAL_INT(my_len, gs->players[me].length);
+    int r = find_player(gs, "Ra\"s");
+    TEST_ASSERT_TRUE(r >= 0);
+    const PlayerState* pl = &gs->players[r];
+    TEST_ASSERT_TRUE(pl->is_remote && pl->active);
+    TEST_ASSERT_EQUAL_INT(0xFF0000FF, pl->color);
+    TEST_ASSERT_EQUAL_INT(7, pl->score);
+    TEST_ASSERT_EQUAL_INT(SNAKE_DIR_RIGHT, pl->current_dir);
+    TEST_ASSERT_EQUAL_INT(3, pl->length);
+    TEST_ASSERT_EQUAL_INT(3, pl->body[2].x);
+    TEST_ASSERT_TRUE(pl->prev_head.x == 5.5f && pl->prev_segment[2].x == 3.5f);
+    TEST_ASSERT_EQUAL_INT(2, gs->food_count);
+    TEST_ASSERT_EQUAL_INT(13, gs->food[1].y);
+
+    /* Head moves and the body shrinks: prev holds the whole old body, including the dropped tail */
+    const char* msg2 = "{ \"type\" : \"state\", \"players\" : [ { \"name\" : \"Ra\\\"s\", \"body\" : [ {\"y\":6, \"x\":6}, {\"x\":5,\"y\":6} ] } ] }";
+    TEST_ASSERT_TRUE(apply(g, msg2, true));
+    TEST_ASSERT_EQUAL_INT(base + 1, gs->num_players);
+    TEST_ASSERT_EQUAL_INT(2, pl->length);
+    TEST_ASSERT_EQUAL_INT(6, pl->body[0].x);
+    TEST_ASSERT_TRUE(pl->prev_head.x == 5.5f);
+    TEST_ASSERT_TRUE(pl->prev_segment[0].x == 5.5f && pl->prev_segment[1].x == 4.5f && pl->prev_segment[2].x == 3.5f);
+    /* Hosts keep their own food */
+    TEST_ASSERT_EQUAL_INT(2, gs->food_count);
+
+    /* "players" ahead of "type" is still applied; a truncated message keeps what parsed */
+    TEST_ASSERT_TRUE(apply(g, "{\"players\":[{\"name\":\"Late\",\"body\":[{\"x\":1,\"y\":2}]}],\"type\":\"state\"}", false));
+    TEST_ASSERT_TRUE(find_player(gs, "Late") >= 0);
+    TEST_ASSERT_TRUE(apply(g, "{\"type\":\"state\",\"players\":[{\"name\":\"Ra\\\"s\",\"body\":[{\"x\":7,\"y\":6},{\"x\":6", false));
+    TEST_ASSERT_EQUAL_INT(1, pl->length);
+    TEST_ASSERT_EQUAL_INT(7, pl->body[0].x);
+
+    player_cfg_destroy(pc);
+    game_destroy(g);
+    game_config_destroy(cfg);
+}
@@ -0,0 +1,75 @@
+#include "unity.h"
+#include <string.h>
+#include "game.h"
+#include "game_internal.h"
+#include "net_json.h"
+
+TEST(test_net_json_writer) {
+    static PlayerState players[SNAKE_MAX_PLAYERS];
+    SnakePoint food[SNAKE_MAX_FOOD] = {{10, 11}, {-3, 2147483647}};
+    GameState gs;
+    memset(&gs, 0, sizeof gs);
+    memset(players, 0, sizeof players);
+    gs.width = 40;
+    gs.height = 20;
+    gs.players = players;
+    gs.num_players = 3;
+    gs.max_players = SNAKE_MAX_PLAYERS;
+    gs.food = food;
+    gs.food_count = 2;
+    gs.max_food = SNAKE_MAX_FOOD;
+    players[0].active = true;
+    strcpy(players[0].name, "A\"b\\\n\x01");
+    players[0].color = 0xFF0000FFu;
+    players[0].score = -5;
+    players[0].current_dir = SNAKE_DIR_LEFT;
+    players[0].length = 2;
+    players[0].body[0] = (SnakePoint){5, 6};
+    players[0].body[1] = (SnakePoint){4, 6};
+    /* Inactive players are left out */
+    players[1].active = false;
+    players[1].length = 1;
+    players[2].active = true;
+    strcpy(players[2].name, "Z");
+
+    NetJsonWriter* w = net_json_writer_create();
+    TEST_ASSERT_TRUE(w != NULL);
+    size_t len = 0;
+    const char* out = net_json_write_state(w, &gs, -2147483647 - 1, &len);
+    const char* want = "{\"type\":\"state\",\"tick\":-2147483648,\"w\":40,\"h\":20,\"players\":["
+                       "{\"id\":0,\"name\":\"A\\\"b\\\\\\n\\u0001\",\"x\":5,\"y\":6,\"len\":2,\"score\":-5,\"color\":-16776961,\"dir\":2,"
+                       "\"body\":[{\"x\":5,\"y\":6},{\"x\":4,\"y\":6}]},"
+                       "{\"id\":2,\"name\":\"Z\",\"x\":0,\"y\":0,\"len\":0,\"score\":0,\"color\":0,\"dir\":0,\"body\":[]}],"
+                       "\"food\":[{\"x\":10,\"y\":11},{\"x\":-3,\"y\":2147483647}]}";
+    TEST_ASSERT_EQUAL_STRING(want, out);
+    TEST_ASSERT_EQUAL_INT((int)strlen(want), (int)len);
+
+    /* The buffer is reused across ticks and a renamed player gets a fresh escape */
+    strcpy(players[2].name, "Y");
+    const char* again = net_json_write_state(w, &gs, 1, NULL);
+    TEST_ASSERT_TRUE(again == out);
+    TEST_ASSERT_TRUE(strstr(again, "\"name\":\"Y\"") != NULL);
+
+    /* Full bodies still fit and read back through the parser */
+    players[2].length = SNAKE_BODY_MAX_LEN;
+    for (int i = 0; i < SNAKE_BODY_MAX_LEN; i++) players[2].body[i] = (SnakePoint){i % 40, 1000000 + i};
+    out = net_json_write_state(w, &gs, 2, &len);
+    TEST_ASSERT_TRUE(out != NULL && len == strlen(out));
+
+    GameConfig* cfg = game_config_create();
+    game_config_set_num_players(cfg, 1);
+    game_config_set_max_players(cfg, 4);
+    Game* g = game_create(cfg, 0);
+    TEST_ASSERT_TRUE(net_json_apply_state(g, NULL, out, len, false));
+    const GameState* rs = game_get_state(g);
+    const PlayerState* rp = NULL;
+    for (int i = 0; i < rs->num_players; i++)
+        if (strcmp(rs->players[i].name, "Y") == 0) rp = &rs->players[i];
+    TEST_ASSERT_TRUE(rp != NULL);
+    TEST_ASSERT_EQUAL_INT(SNAKE_BODY_MAX_LEN, rp->length);
+    TEST_ASSERT_EQUAL_INT(1000000 + SNAKE_BODY_MAX_LEN - 1, rp->body[SNAKE_BODY_MAX_LEN - 1].y);
+
+    game_destroy(g);
+    game_config_destroy(cfg);
+    net_json_writer_destroy(w);
+}
@@ -0,0 +1,87 @@
+#include "unity.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "net_log.h"
+
+#define LOG_THREADS 4
+#define LOG_LINES 500
+
+static int evaluated = 0;
+
+static int bump(void) { return ++evaluated; }
+
+static void* log_thread(void* arg) {
+    int t = (int)(size_t)arg;
+    unsigned char payload[4] = {1, 2, 3, 4};
+    for (int i = 0; i < LOG_LINES; i++) {
+        net_log_info("net_log_test t%d n%d", t, i);
+        net_log_debug("net_log_test debug t%d n%d", t, i);
+        net_log_send(t, payload, sizeof payload, "net_log_test io");
+    }
+    return NULL;
+}
+
+/* Reads the whole log and counts lines containing `needle` */
+static int count_lines(const char* path, const char* needle) {
+    FILE* f = fopen(path, "r");
+    if (!f) return -1;
+    char line[1024];
+    int n = 0;
+    while (fgets(line, sizeof line, f))
+        if (strstr(line, needle)) n++;
+    fclose(f);
+    return n;
+}
+
+TEST(test_net_log) {
+    char path[64];
+    snprintf(path, sizeof path, "/tmp/snake_test_net_log_%d.log", (int)getpid());
+    unlink(path);
+    /* Start over on our own file; the next record opens it */
+    net_log_close();
+    setenv("SNAKE_NET_LOG", path, 1);
+
+    /* Several threads log through their own rings; the writer interleaves them into whole lines */
+    net_log_set_level(NET_LOG_INFO);
+    TEST_ASSERT_EQUAL_INT(NET_LOG_INFO, net_log_get_level());
+    TEST_ASSERT_TRUE(net_log_enabled(NET_LOG_ERROR) && !net_log_enabled(NET_LOG_DEBUG) && !net_log_enabled(NET_LOG_OFF));
+    pthread_t th[LOG_THREADS];
+    for (int t = 0; t < LOG_THREADS; t++) TEST_ASSERT_EQUAL_INT(0, pthread_create(&th[t], NULL, log_thread, (void*)(size_t)t));
+    for (int t = 0; t < LOG_THREADS; t++) pthread_join(th[t], NULL);
+    net_log_flush();
+    TEST_ASSERT_EQUAL_INT(LOG_THREADS * LOG_LINES, count_lines(path, "] INFO net_log_test t"));
+    TEST_ASSERT_EQUAL_INT(LOG_LINES, count_lines(path, "net_log_test t3 n"));
+    TEST_ASSERT_EQUAL_INT(0, count_lines(path, "net_log_test debug"));
+    TEST_ASSERT_EQUAL_INT(0, count_lines(path, "net_log_test io"));
+
+    /* Hex dumps are formatted by the writer, in the same layout as before */
+    net_log_set_level(NET_LOG_IO);
+    unsigned char bytes[2] = {0x01, 0xab};
+    net_log_recv(7, bytes, sizeof bytes, "net_log_test dump");
+    net_log_error("net_log_test error %d", 42);
+    net_log_flush();
+    TEST_ASSERT_EQUAL_INT(1, count_lines(path, "RECV fd=7 len=2 net_log_test dump"));
+    TEST_ASSERT_EQUAL_INT(1, count_lines(path, "data(hex,2): 01 ab"));
+    TEST_ASSERT_EQUAL_INT(1, count_lines(path, "] ERROR net_log_test error 42"));
+
+    /* Switched off, a record is skipped before its arguments are evaluated */
+    net_log_set_level(NET_LOG_OFF);
+    net_log_error("net_log_test off %d", bump());
+    TEST_ASSERT_EQUAL_INT(0, evaluated);
+
+    /* Closing writes out what is left, and logging again reopens the file */
+    net_log_set_level(NET_LOG_INFO);
+    net_log_info("net_log_test before close");
+    net_log_close();
+    TEST_ASSERT_EQUAL_INT(1, count_lines(path, "net_log_test before close"));
+    net_log_info("net_log_test after close");
+    net_log_close();
+    TEST_ASSERT_EQUAL_INT(1, count_lines(path, "net_log_test after close"));
+
+    unsetenv("SNAKE_NET_LOG");
+    net_log_set_level(NET_LOG_IO);
+    unlink(path);
+}
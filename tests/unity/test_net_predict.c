@@ -0,0 +1,137 @@
+#include "unity.h"
+#include <string.h>
+#include "collision.h"
+#include "game.h"
+#include "game_internal.h"
+#include "net_json.h"
+#include "net_predict.h"
+
+/* The owner's simulation of one snake "R", sent as JSON state the way a peer would */
+typedef struct {
+    PlayerState players[1];
+    GameState gs;
+    NetJsonWriter* w;
+    int tick;
+} Owner;
+
+static void owner_move(Owner* o, SnakeDir dir) {
+    PlayerState* pl = &o->players[0];
+    pl->current_dir = dir;
+    memmove(pl->body + 1, pl->body, (size_t)(pl->length - 1) * sizeof(SnakePoint));
+    pl->body[0] = collision_next_head(pl->body[0], dir);
+    o->tick++;
+}
+
+static void deliver(Owner* o, Game* g, NetPredict* p) {
+    size_t len = 0;
+    const char* msg = net_json_write_state(o->w, &o->gs, o->tick, &len);
+    TEST_ASSERT_TRUE(msg != NULL);
+    TEST_ASSERT_TRUE(net_json_apply_state(g, NULL, msg, len, false));
+    net_predict_reconcile(p, g);
+}
+
+static const PlayerState* remote(const Game* g) {
+    const GameState* gs = game_get_state(g);
+    for (int i = 0; i < gs->num_players; i++)
+        if (gs->players[i].is_remote) return &gs->players[i];
+    return NULL;
+}
+
+static bool shows(const Game* g, const Owner* o, int dx) {
+    const PlayerState* r = remote(g);
+    const PlayerState* want = &o->players[0];
+    if (!r || r->length != want->length) return false;
+    for (int k = 0; k < want->length; k++) {
+        SnakePoint s = k < dx ? (SnakePoint){want->body[0].x + dx - k, want->body[0].y} : want->body[k - dx];
+        if (r->body[k].x != s.x || r->body[k].y != s.y) return false;
+    }
+    return true;
+}
+
+TEST(test_net_predict) {
+    Owner o;
+    memset(&o, 0, sizeof o);
+    o.gs.width = 40;
+    o.gs.height = 40;
+    o.gs.players = o.players;
+    o.gs.num_players = 1;
+    o.gs.max_players = 1;
+    strcpy(o.players[0].name, "R");
+    o.players[0].active = true;
+    o.players[0].current_dir = SNAKE_DIR_RIGHT;
+    o.players[0].length = 4;
+    for (int i = 0; i < 4; i++) o.players[0].body[i] = (SnakePoint){10 - i, 20};
+    o.w = net_json_writer_create();
+
+    GameConfig* cfg = game_config_create();
+    game_config_set_num_players(cfg, 1);
+    game_config_set_max_players(cfg, 4);
+    game_config_set_board_size(cfg, 40, 40);
+    Game* g = game_create(cfg, 0);
+    game_config_destroy(cfg);
+    NetPredict* p = net_predict_create(2);
+    TEST_ASSERT_TRUE(o.w && g && p);
+
+    /* First sight: shown as received */
+    deliver(&o, g, p);
+    TEST_ASSERT_TRUE(shows(g, &o, 0));
+    /* Each local tick the snake carries on along its direction, at most two ticks past the snapshot */
+    net_predict_step(p, g);
+    TEST_ASSERT_TRUE(shows(g, &o, 1));
+    net_predict_step(p, g);
+    net_predict_step(p, g);
+    TEST_ASSERT_TRUE(shows(g, &o, 2));
+
+    /* Snapshots that confirm the prediction leave what is shown alone, interpolation included */
+    owner_move(&o, SNAKE_DIR_RIGHT);
+    PlayerState* r = (PlayerState*)remote(g);
+    r->interp_time = 0.1f;
+    deliver(&o, g, p);
+    TEST_ASSERT_TRUE(shows(g, &o, 1));
+    TEST_ASSERT_TRUE(r->interp_time == 0.1f);
+    size_t old_len = 0;
+    char old[4096];
+    const char* msg = net_json_write_state(o.w, &o.gs, o.tick, &old_len);
+    memcpy(old, msg, old_len + 1);
+    owner_move(&o, SNAKE_DIR_RIGHT);
+    deliver(&o, g, p);
+    TEST_ASSERT_TRUE(shows(g, &o, 0));
+    NetPredictStats st;
+    net_predict_get_stats(p, &st);
+    TEST_ASSERT_EQUAL_INT(2, (int)st.predicted);
+    TEST_ASSERT_EQUAL_INT(2, (int)st.confirmed);
+    TEST_ASSERT_EQUAL_INT(0, (int)st.corrected);
+
+    /* A snapshot older than the one applied, say relayed late by another peer, is ignored */
+    TEST_ASSERT_TRUE(net_json_apply_state(g, NULL, old, old_len, false));
+    net_predict_reconcile(p, g);
+    TEST_ASSERT_TRUE(shows(g, &o, 0));
+    net_predict_get_stats(p, &st);
+    TEST_ASSERT_EQUAL_INT(1, (int)st.stale);
+
+    /* A turn the prediction missed is corrected, starting from the predicted pose */
+    net_predict_step(p, g);
+    SnakePoint predicted = remote(g)->body[0];
+    owner_move(&o, SNAKE_DIR_UP);
+    deliver(&o, g, p);
+    r = (PlayerState*)remote(g);
+    TEST_ASSERT_EQUAL_INT(o.players[0].body[0].x, r->body[0].x);
+    TEST_ASSERT_EQUAL_INT(o.players[0].body[0].y, r->body[0].y);
+    TEST_ASSERT_TRUE(r->prev_head.x == (float)predicted.x + 0.5f && r->interp_time == 0.0f);
+    net_predict_get_stats(p, &st);
+    TEST_ASSERT_EQUAL_INT(1, (int)st.corrected);
+    /* and prediction resumes along the new direction */
+    net_predict_step(p, g);
+    TEST_ASSERT_EQUAL_INT(o.players[0].body[0].y - 1, remote(g)->body[0].y);
+
+    /* Prediction never runs a snake into a wall */
+    o.players[0].current_dir = SNAKE_DIR_LEFT;
+    for (int i = 0; i < 4; i++) o.players[0].body[i] = (SnakePoint){i, 5};
+    deliver(&o, g, p);
+    net_predict_step(p, g);
+    TEST_ASSERT_EQUAL_INT(0, remote(g)->body[0].x);
+
+    net_predict_destroy(p);
+    game_destroy(g);
+    net_json_writer_destroy(o.w);
+}
@@ -0,0 +1,150 @@
+#include "unity.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "mpapi_client.h"
+#include "net_shaper.h"
+#include "platform.h"
+
+#define SHAPED_MSGS 2000
+
+/* Pops everything due by `now`, checking each message is its index; returns how many came out and counts inversions */
+static int drain(NetShaper* s, uint64_t now, int* seen, int* inversions) {
+    int n = 0, last = -1;
+    size_t len = 0;
+    const char* m;
+    while ((m = net_shaper_peek(s, now, &len)) != NULL) {
+        int i = atoi(m);
+        TEST_ASSERT_TRUE(i >= 0 && i < SHAPED_MSGS && m[len] == '\0');
+        seen[i]++;
+        if (i < last) (*inversions)++;
+        last = i;
+        net_shaper_pop(s);
+        n++;
+    }
+    return n;
+}
+
+TEST(test_net_shaper) {
+    NetShaperConfig cfg = {0};
+    TEST_ASSERT_FALSE(net_shaper_config_active(&cfg));
+    TEST_ASSERT_FALSE(net_shaper_config_active(NULL));
+
+    /* Delay: due 50 ms after it was queued, and the timeout says so */
+    cfg.delay_ms = 50;
+    TEST_ASSERT_TRUE(net_shaper_config_active(&cfg));
+    NetShaper* s = net_shaper_create(&cfg, 1);
+    TEST_ASSERT_TRUE(s != NULL);
+    TEST_ASSERT_EQUAL_INT(-1, net_shaper_timeout_ms(s, 1000));
+    TEST_ASSERT_TRUE(net_shaper_push(s, "hello", 5, true, 1000));
+    TEST_ASSERT_EQUAL_INT(50, net_shaper_timeout_ms(s, 1000));
+    TEST_ASSERT_TRUE(net_shaper_peek(s, 1049, NULL) == NULL);
+    size_t len = 0;
+    TEST_ASSERT_EQUAL_STRING("hello", net_shaper_peek(s, 1050, &len));
+    TEST_ASSERT_EQUAL_INT(5, (int)len);
+    net_shaper_pop(s);
+    TEST_ASSERT_EQUAL_INT(-1, net_shaper_timeout_ms(s, 1050));
+    net_shaper_destroy(s);
+
+    /* Bandwidth: at 80 kbit/s each 100-byte message holds the link for 10 ms, one after another */
+    memset(&cfg, 0, sizeof cfg);
+    cfg.kbps = 80;
+    s = net_shaper_create(&cfg, 1);
+    char msg[100];
+    memset(msg, 'b', sizeof msg);
+    for (int i = 0; i < 3; i++) TEST_ASSERT_TRUE(net_shaper_push(s, msg, sizeof msg, false, 0));
+    TEST_ASSERT_EQUAL_INT(30, net_shaper_busy_ms(s, 0));
+    TEST_ASSERT_EQUAL_INT(10, net_shaper_timeout_ms(s, 0));
+    int seen[SHAPED_MSGS] = {0}, inversions = 0;
+    TEST_ASSERT_TRUE(net_shaper_peek(s, 19, NULL) != NULL);
+    net_shaper_pop(s);
+    TEST_ASSERT_TRUE(net_shaper_peek(s, 19, NULL) == NULL);
+    TEST_ASSERT_EQUAL_INT(0, net_shaper_busy_ms(s, 30));
+    net_shaper_destroy(s);
+
+    /* Jitter never reorders: a late message holds back the ones behind it */
+    memset(&cfg, 0, sizeof cfg);
+    cfg.delay_ms = 20;
+    cfg.jitter_ms = 15;
+    s = net_shaper_create(&cfg, 7);
+    char num[16];
+    int out = 0;
+    for (int i = 0; i < SHAPED_MSGS; i++) {
+        int n = snprintf(num, sizeof num, "%d", i);
+        TEST_ASSERT_TRUE(net_shaper_push(s, num, (size_t)n, true, (uint64_t)i));
+        out += drain(s, (uint64_t)i, seen, &inversions);
+    }
+    TEST_ASSERT_TRUE(out > 0 && out < SHAPED_MSGS);
+    out += drain(s, SHAPED_MSGS + 100, seen, &inversions);
+    TEST_ASSERT_EQUAL_INT(SHAPED_MSGS, out);
+    TEST_ASSERT_EQUAL_INT(0, inversions);
+    net_shaper_destroy(s);
+
+    /* Drops and reordering hit game messages at about the configured rates; the rest arrive exactly once */
+    memset(&cfg, 0, sizeof cfg);
+    memset(seen, 0, sizeof seen);
+    cfg.delay_ms = 5;
+    cfg.drop_pct = 20;
+    cfg.reorder_pct = 10;
+    s = net_shaper_create(&cfg, 42);
+    int kept = 0;
+    for (int i = 0; i < SHAPED_MSGS; i++) {
+        int n = snprintf(num, sizeof num, "%d", i);
+        kept += net_shaper_push(s, num, (size_t)n, true, (uint64_t)i);
+    }
+    NetShaperStats st;
+    net_shaper_get_stats(s, &st);
+    TEST_ASSERT_EQUAL_INT(SHAPED_MSGS - kept, (int)st.dropped);
+    TEST_ASSERT_TRUE(st.dropped > SHAPED_MSGS / 10 && st.dropped < SHAPED_MSGS * 3 / 10);
+    TEST_ASSERT_TRUE(st.reordered > 0);
+    inversions = 0;
+    TEST_ASSERT_EQUAL_INT(kept, drain(s, SHAPED_MSGS + 100, seen, &inversions));
+    TEST_ASSERT_TRUE(inversions > 0 && (uint64_t)inversions <= st.reordered);
+    for (int i = 0; i < SHAPED_MSGS; i++) TEST_ASSERT_TRUE(seen[i] <= 1);
+    /* Control messages are only ever delayed */
+    for (int i = 0; i < 200; i++) TEST_ASSERT_TRUE(net_shaper_push(s, "ctl", 3, false, 0));
+    net_shaper_destroy(s);
+
+    /* Wired into mpclient, both directions are held for the configured delay */
+    int l = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {0};
+    socklen_t alen = sizeof addr;
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TEST_ASSERT_TRUE(bind(l, (struct sockaddr*)&addr, sizeof addr) == 0);
+    TEST_ASSERT_TRUE(listen(l, 1) == 0);
+    TEST_ASSERT_TRUE(getsockname(l, (struct sockaddr*)&addr, &alen) == 0);
+    mpclient* c = mpclient_create("127.0.0.1", ntohs(addr.sin_port), "test-ident");
+    memset(&cfg, 0, sizeof cfg);
+    cfg.delay_ms = 60;
+    mpclient_set_conditions(c, &cfg);
+    TEST_ASSERT_EQUAL_INT(0, mpclient_connect_and_start(c));
+    int srv = accept(l, NULL, NULL);
+    TEST_ASSERT_TRUE(srv >= 0);
+    uint64_t t0 = platform_now_ms();
+    TEST_ASSERT_EQUAL_INT(0, mpclient_send_game(c, "{\"n\":1}"));
+    char buf[256];
+    ssize_t rc = recv(srv, buf, sizeof buf, 0);
+    TEST_ASSERT_TRUE(rc > 0 && memchr(buf, '\n', (size_t)rc) != NULL);
+    TEST_ASSERT_TRUE(platform_now_ms() - t0 >= 55);
+    static const char line[] = "{\"cmd\":\"game\",\"clientId\":\"p1\",\"data\":{\"n\":2}}\n";
+    t0 = platform_now_ms();
+    TEST_ASSERT_EQUAL_INT((int)sizeof line - 1, (int)send(srv, line, sizeof line - 1, 0));
+    const char* m = NULL;
+    while (!m && platform_now_ms() - t0 < 2000) {
+        m = mpclient_peek_message(c, &len);
+        if (!m) platform_sleep_ms(2);
+    }
+    TEST_ASSERT_TRUE(m != NULL);
+    TEST_ASSERT_EQUAL_STRING("{\"n\":2}", m);
+    TEST_ASSERT_TRUE(platform_now_ms() - t0 >= 55);
+    mpclient_release_message(c);
+    mpclient_destroy(c);
+    close(srv);
+    close(l);
+}
@@ -0,0 +1,124 @@
+#include "unity.h"
+#include <stdlib.h>
+#include <string.h>
+#include "game.h"
+#include "game_internal.h"
+#include "net.h"
+#include "net_json.h"
+
+static Game* make_game(void) {
+    GameConfig* cfg = game_config_create();
+    game_config_set_num_players(cfg, 1);
+    game_config_set_max_players(cfg, 4);
+    Game* g = game_create(cfg, 0);
+    game_config_destroy(cfg);
+    return g;
+}
+
+static const PlayerState* find_player(const GameState* gs, const char* name) {
+    for (int i = 0; i < gs->num_players; i++)
+        if (strcmp(gs->players[i].name, name) == 0) return &gs->players[i];
+    return NULL;
+}
+
+TEST(test_net_state_binary) {
+    /* RFC 4648 vectors */
+    static const char* plain[] = {"", "f", "fo", "foo", "foob", "fooba", "foobar"};
+    static const char* coded[] = {"", "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy"};
+    for (int i = 0; i < 7; i++) {
+        char enc[16];
+        unsigned char dec[16];
+        size_t n = 0;
+        TEST_ASSERT_EQUAL_INT((int)strlen(coded[i]), (int)net_base64_encode((const unsigned char*)plain[i], strlen(plain[i]), enc, sizeof enc));
+        TEST_ASSERT_EQUAL_STRING(coded[i], enc);
+        TEST_ASSERT_TRUE(net_base64_decode(coded[i], strlen(coded[i]), dec, sizeof dec, &n));
+        TEST_ASSERT_TRUE(n == strlen(plain[i]) && memcmp(dec, plain[i], n) == 0);
+    }
+    unsigned char dec[16];
+    size_t n = 0;
+    TEST_ASSERT_FALSE(net_base64_decode("Zm9", 3, dec, sizeof dec, &n));
+    TEST_ASSERT_FALSE(net_base64_decode("Zg==Zg==", 8, dec, sizeof dec, &n));
+    TEST_ASSERT_FALSE(net_base64_decode("Z!==", 4, dec, sizeof dec, &n));
+
+    /* A full-length contiguous snake, a non-contiguous one and food */
+    static PlayerState players[SNAKE_MAX_PLAYERS];
+    SnakePoint food[SNAKE_MAX_FOOD] = {{7, 8}, {-1, 9}};
+    GameState gs;
+    memset(&gs, 0, sizeof gs);
+    memset(players, 0, sizeof players);
+    gs.width = 40;
+    gs.height = 40;
+    gs.players = players;
+    gs.num_players = 2;
+    gs.max_players = SNAKE_MAX_PLAYERS;
+    gs.food = food;
+    gs.food_count = 2;
+    gs.max_food = SNAKE_MAX_FOOD;
+    strcpy(players[0].name, "Long");
+    players[0].active = true;
+    players[0].color = 0xFF112233u;
+    players[0].score = -3;
+    players[0].current_dir = SNAKE_DIR_DOWN;
+    players[0].length = SNAKE_BODY_MAX_LEN;
+    for (int i = 0; i < SNAKE_BODY_MAX_LEN; i++) {
+        int row = i / 30, col = i % 30;
+        players[0].body[i] = (SnakePoint){(row & 1) ? 30 - col : 1 + col, 2 + row};
+    }
+    strcpy(players[1].name, "Jumpy");
+    players[1].active = true;
+    players[1].length = 3;
+    players[1].body[0] = (SnakePoint){5, 5};
+    players[1].body[1] = (SnakePoint){5, 5};
+    players[1].body[2] = (SnakePoint){100000, -7};
+
+    NetJsonWriter* w = net_json_writer_create();
+    net_json_writer_set_caps(w, NET_STATE_VERSION);
+    size_t json_len = 0, bin_len = 0;
+    (void)net_json_write_state(w, &gs, 5, &json_len);
+    const char* msg = net_json_write_packed_state(w, &gs, 5, &bin_len);
+    TEST_ASSERT_TRUE(msg != NULL);
+    TEST_ASSERT_TRUE(strncmp(msg, "{\"type\":\"bstate\",\"caps\":1,\"b64\":\"", 33) == 0);
+    /* 2 bits per segment against ~20 bytes of JSON */
+    TEST_ASSERT_TRUE(bin_len * 10 < json_len);
+
+    Game* g = make_game();
+    TEST_ASSERT_TRUE(net_json_apply_state(g, NULL, msg, bin_len, false));
+    const GameState* rs = game_get_state(g);
+    const PlayerState* a = find_player(rs, "Long");
+    const PlayerState* b = find_player(rs, "Jumpy");
+    TEST_ASSERT_TRUE(a != NULL && b != NULL && a->is_remote);
+    TEST_ASSERT_EQUAL_INT(SNAKE_BODY_MAX_LEN, a->length);
+    TEST_ASSERT_TRUE(memcmp(a->body, players[0].body, sizeof players[0].body) == 0);
+    TEST_ASSERT_EQUAL_INT(0xFF112233u, a->color);
+    TEST_ASSERT_EQUAL_INT(-3, a->score);
+    TEST_ASSERT_EQUAL_INT(SNAKE_DIR_DOWN, a->current_dir);
+    TEST_ASSERT_EQUAL_INT(3, b->length);
+    TEST_ASSERT_EQUAL_INT(100000, b->body[2].x);
+    TEST_ASSERT_EQUAL_INT(-7, b->body[2].y);
+    TEST_ASSERT_EQUAL_INT(2, rs->food_count);
+    TEST_ASSERT_EQUAL_INT(-1, rs->food[1].x);
+
+    /* The JSON form carries caps too, and the parser ignores it */
+    const char* js = net_json_write_state(w, &gs, 6, &json_len);
+    TEST_ASSERT_TRUE(strncmp(js, "{\"type\":\"state\",\"caps\":1,\"tick\":6,", 34) == 0);
+    TEST_ASSERT_TRUE(net_json_apply_state(g, NULL, js, json_len, false));
+    TEST_ASSERT_EQUAL_INT(SNAKE_BODY_MAX_LEN, find_player(rs, "Long")->length);
+
+    /* Unknown versions and every truncation are rejected without reading past the end */
+    unsigned char packed[NET_STATE_MAX_PACKED];
+    size_t plen = net_pack_state(&gs, 7, packed, sizeof packed);
+    TEST_ASSERT_TRUE(plen > 0);
+    TEST_ASSERT_EQUAL_INT(0, (int)net_pack_state(&gs, 7, packed, plen - 1));
+    for (size_t cut = 0; cut < plen; cut++) {
+        unsigned char* copy = malloc(cut ? cut : 1);
+        memcpy(copy, packed, cut);
+        TEST_ASSERT_FALSE(net_apply_packed_state(g, copy, cut, false));
+        free(copy);
+    }
+    TEST_ASSERT_TRUE(net_apply_packed_state(g, packed, plen, true));
+    packed[1] = NET_STATE_VERSION + 1;
+    TEST_ASSERT_FALSE(net_apply_packed_state(g, packed, plen, true));
+
+    game_destroy(g);
+    net_json_writer_destroy(w);
+}
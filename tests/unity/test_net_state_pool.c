@@ -0,0 +1,85 @@
+#include "unity.h"
+#include <string.h>
+#include "game_internal.h"
+#include "net.h"
+
+/* Packs a state with `players` players and `food` food items */
+static size_t pack(unsigned char* buf, size_t size, int players, int food) {
+    static PlayerState ps[SNAKE_MAX_PLAYERS];
+    static SnakePoint fp[SNAKE_MAX_FOOD];
+    GameState gs;
+    memset(&gs, 0, sizeof gs);
+    gs.width = 20;
+    gs.height = 10;
+    gs.players = ps;
+    gs.num_players = players;
+    gs.food = fp;
+    gs.food_count = food;
+    for (int i = 0; i < players; i++) {
+        ps[i].score = 100 + i;
+        ps[i].length = 3 + i;
+    }
+    for (int i = 0; i < food; i++) fp[i] = (SnakePoint){i, food};
+    return net_pack_game_state(&gs, buf, size);
+}
+
+TEST(test_net_state_pool) {
+    unsigned char big[512], small[512], bad[512];
+    size_t big_len = pack(big, sizeof big, 4, SNAKE_MAX_FOOD);
+    size_t small_len = pack(small, sizeof small, 2, 1);
+    TEST_ASSERT_TRUE(big_len > 0 && small_len > 0);
+    memcpy(bad, big, big_len);
+    bad[3] = 0; /* width 0 */
+
+    /* Arrays grow to the largest state seen and are reused, not reallocated, below that */
+    GameState gs;
+    memset(&gs, 0, sizeof gs);
+    TEST_ASSERT_TRUE(net_unpack_game_state_into(big, big_len, &gs));
+    TEST_ASSERT_EQUAL_INT(4, gs.max_players);
+    TEST_ASSERT_EQUAL_INT(SNAKE_MAX_FOOD, gs.max_food);
+    PlayerState* players = gs.players;
+    SnakePoint* food = gs.food;
+    TEST_ASSERT_TRUE(net_unpack_game_state_into(small, small_len, &gs));
+    TEST_ASSERT_TRUE(gs.players == players && gs.food == food);
+    TEST_ASSERT_EQUAL_INT(2, gs.num_players);
+    TEST_ASSERT_EQUAL_INT(1, gs.food_count);
+    TEST_ASSERT_EQUAL_INT(101, gs.players[1].score);
+    TEST_ASSERT_EQUAL_INT(4, gs.max_players);
+    TEST_ASSERT_FALSE(net_unpack_game_state_into(bad, big_len, &gs));
+    TEST_ASSERT_EQUAL_INT(0, gs.num_players);
+    TEST_ASSERT_TRUE(gs.players == players && gs.max_players == 4);
+    TEST_ASSERT_FALSE(net_unpack_game_state_into(big, big_len - 1, &gs));
+    TEST_ASSERT_TRUE(net_unpack_game_state_into(big, big_len, &gs));
+    TEST_ASSERT_TRUE(gs.players == players && gs.food == food);
+    TEST_ASSERT_EQUAL_INT(SNAKE_MAX_FOOD, gs.food_count);
+    TEST_ASSERT_EQUAL_INT(SNAKE_MAX_FOOD, gs.food[SNAKE_MAX_FOOD - 1].y);
+    net_free_unpacked_game_state(&gs);
+    TEST_ASSERT_TRUE(gs.players == NULL && gs.food == NULL && gs.max_players == 0);
+
+    /* The pool hands out each slot once, and a released slot comes back with its arrays */
+    NetStatePool* pool = net_state_pool_create(2);
+    TEST_ASSERT_TRUE(pool != NULL);
+    GameState* a = net_state_pool_unpack(pool, big, big_len);
+    GameState* b = net_state_pool_unpack(pool, small, small_len);
+    TEST_ASSERT_TRUE(a != NULL && b != NULL && a != b);
+    TEST_ASSERT_EQUAL_INT(4, a->num_players);
+    TEST_ASSERT_TRUE(net_state_pool_acquire(pool) == NULL);
+    players = a->players;
+    net_state_pool_release(pool, a);
+    GameState* c = net_state_pool_unpack(pool, small, small_len);
+    TEST_ASSERT_TRUE(c == a && c->players == players);
+    TEST_ASSERT_EQUAL_INT(2, c->num_players);
+    /* A malformed state leaves the slot free */
+    net_state_pool_release(pool, c);
+    TEST_ASSERT_TRUE(net_state_pool_unpack(pool, bad, big_len) == NULL);
+    c = net_state_pool_acquire(pool);
+    TEST_ASSERT_TRUE(c == a && c->num_players == 0 && c->max_players == 4);
+    net_state_pool_release(pool, c);
+    net_state_pool_release(pool, b);
+    net_state_pool_release(pool, b);
+    TEST_ASSERT_TRUE(net_state_pool_acquire(pool) != NULL);
+    TEST_ASSERT_TRUE(net_state_pool_acquire(pool) != NULL);
+    TEST_ASSERT_TRUE(net_state_pool_acquire(pool) == NULL);
+    net_state_pool_destroy(pool);
+    TEST_ASSERT_TRUE(net_state_pool_create(0) == NULL);
+}
@@ -0,0 +1,209 @@
+#define _POSIX_C_SOURCE 200809L
+#include "unity.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+#include "game_internal.h"
+#include "net.h"
+#include "net_frame.h"
+
+/* Inputs per phase, and states streamed back */
+#define BENCH_INPUTS 20000
+#define BENCH_STATES 5000
+#define BENCH_BATCH 64
+
+static uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+typedef struct {
+    int listen_fd;
+    unsigned char state[NET_STATE_MAX_PACKED];
+    size_t state_len;
+    int inputs_ok;
+} BenchServer;
+
+/* Reads `count` input frames through a decoder, with whatever each recv returns */
+static int read_inputs(int fd, NetFrameDecoder* d, int count) {
+    int got = 0;
+    while (got < count) {
+        const unsigned char* p;
+        size_t n;
+        int rc;
+        while (got < count && (rc = net_frame_decoder_next(d, &p, &n)) == 1) {
+            InputState in;
+            if (n != 1 || !net_unpack_input(p, n, &in) || !in.move_right) return -1;
+            got++;
+        }
+        if (got == count) break;
+        size_t avail = 0;
+        unsigned char* dst = net_frame_decoder_space(d, &avail);
+        ssize_t r = dst ? recv(fd, dst, avail, 0) : -1;
+        if (r <= 0) return -1;
+        net_frame_decoder_commit(d, (size_t)r);
+    }
+    return got;
+}
+
+static void* bench_server(void* arg) {
+    BenchServer* b = arg;
+    int c = accept(b->listen_fd, NULL, NULL);
+    if (c < 0) return NULL;
+    NetFrameDecoder* d = net_frame_decoder_create(256);
+    static const unsigned char ack[5] = {0, 0, 0, 1, 'A'};
+    int ok = 1;
+    /* One acknowledgement per phase of inputs; the last phase comes on a second connection */
+    for (int phase = 0; phase < 2 && ok; phase++) {
+        ok = read_inputs(c, d, BENCH_INPUTS) == BENCH_INPUTS;
+        ok = ok && send(c, ack, sizeof ack, MSG_NOSIGNAL) == (ssize_t)sizeof ack;
+    }
+    int legacy = ok ? accept(b->listen_fd, NULL, NULL) : -1;
+    NetFrameDecoder* ld = net_frame_decoder_create(256);
+    ok = legacy >= 0 && read_inputs(legacy, ld, BENCH_INPUTS) == BENCH_INPUTS;
+    ok = ok && send(legacy, ack, sizeof ack, MSG_NOSIGNAL) == (ssize_t)sizeof ack;
+    net_frame_decoder_destroy(ld);
+    if (legacy >= 0) close(legacy);
+    b->inputs_ok = ok;
+    /* States go out as the server sends them: many frames per writev */
+    unsigned char hdr[BENCH_BATCH][4];
+    struct iovec iov[2 * BENCH_BATCH];
+    for (int sent = 0; ok && sent < BENCH_STATES; sent += BENCH_BATCH) {
+        int n = BENCH_STATES - sent < BENCH_BATCH ? BENCH_STATES - sent : BENCH_BATCH;
+        for (int i = 0; i < n; i++) {
+            uint32_t be = htonl((uint32_t)b->state_len);
+            memcpy(hdr[i], &be, 4);
+            iov[2 * i].iov_base = hdr[i];
+            iov[2 * i].iov_len = 4;
+            iov[2 * i + 1].iov_base = b->state;
+            iov[2 * i + 1].iov_len = b->state_len;
+        }
+        size_t want = (size_t)n * (4 + b->state_len), done = 0;
+        /* Blocking writes of a batch this size complete or fail */
+        ssize_t r = writev(c, iov, 2 * n);
+        if (r > 0) done = (size_t)r;
+        while (done < want && r > 0) {
+            size_t frame = 4 + b->state_len, k = done / frame, at = done % frame;
+            const unsigned char* part = at < 4 ? hdr[k] + at : b->state + (at - 4);
+            size_t part_len = at < 4 ? 4 - at : frame - at;
+            r = send(c, part, part_len, MSG_NOSIGNAL);
+            if (r > 0) done += (size_t)r;
+        }
+        ok = done == want;
+    }
+    net_frame_decoder_destroy(d);
+    close(c);
+    return NULL;
+}
+
+/* The old transport: length prefix and payload in separate sends */
+static int legacy_send_input(int fd, const InputState* in) {
+    unsigned char buf[16];
+    size_t sz = net_pack_input(in, buf, sizeof buf);
+    uint32_t nsz = htonl((uint32_t)sz);
+    if (send(fd, &nsz, sizeof nsz, 0) != (ssize_t)sizeof nsz) return 0;
+    return send(fd, buf, sz, 0) == (ssize_t)sz;
+}
+
+static double wait_ack(NetClient* c, uint64_t t0) {
+    size_t n = 0;
+    const unsigned char* ack = net_recv_frame_view(c, &n);
+    TEST_ASSERT_TRUE(ack != NULL && n == 1 && ack[0] == 'A');
+    return (double)(bench_now_ns() - t0) / 1e9;
+}
+
+TEST(test_net_throughput) {
+    static BenchServer b;
+    memset(&b, 0, sizeof b);
+    b.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {0};
+    socklen_t alen = sizeof addr;
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TEST_ASSERT_TRUE(bind(b.listen_fd, (struct sockaddr*)&addr, sizeof addr) == 0);
+    TEST_ASSERT_TRUE(listen(b.listen_fd, 2) == 0);
+    TEST_ASSERT_TRUE(getsockname(b.listen_fd, (struct sockaddr*)&addr, &alen) == 0);
+
+    /* A four-player state of mid-length snakes to stream back */
+    static PlayerState players[SNAKE_MAX_PLAYERS];
+    GameState gs;
+    memset(&gs, 0, sizeof gs);
+    gs.width = gs.height = 64;
+    gs.players = players;
+    gs.num_players = SNAKE_MAX_PLAYERS;
+    gs.max_players = SNAKE_MAX_PLAYERS;
+    gs.max_food = SNAKE_MAX_FOOD;
+    for (int i = 0; i < SNAKE_MAX_PLAYERS; i++) {
+        snprintf(players[i].name, sizeof players[i].name, "p%d", i);
+        players[i].active = true;
+        players[i].length = 40;
+        for (int k = 0; k < 40; k++) players[i].body[k] = (SnakePoint){k, 10 + i * 10};
+    }
+    b.state_len = net_pack_state(&gs, 1, b.state, sizeof b.state);
+    TEST_ASSERT_TRUE(b.state_len > 0);
+
+    pthread_t t;
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&t, NULL, bench_server, &b));
+    NetClient* c = net_connect("127.0.0.1", ntohs(addr.sin_port));
+    TEST_ASSERT_TRUE(c != NULL);
+    InputState in = {0};
+    in.move_right = true;
+    /* A bad frame in a later batch is refused before the batches ahead of it go out */
+    unsigned char packed[16];
+    static NetFrame bad[NET_SEND_FRAMES_MAX + 1];
+    for (int i = 0; i < NET_SEND_FRAMES_MAX; i++) bad[i] = (NetFrame){packed, net_pack_input(&in, packed, sizeof packed)};
+    bad[NET_SEND_FRAMES_MAX] = (NetFrame){NULL, 0};
+    TEST_ASSERT_FALSE(net_send_frames(c, bad, NET_SEND_FRAMES_MAX + 1));
+
+    /* Phase 1: one sendmsg per input */
+    uint64_t t0 = bench_now_ns();
+    for (int i = 0; i < BENCH_INPUTS; i++) TEST_ASSERT_TRUE(net_send_input(c, &in));
+    double single_s = wait_ack(c, t0);
+
+    /* Phase 2: inputs queued and flushed BENCH_BATCH at a time */
+    t0 = bench_now_ns();
+    for (int i = 0; i < BENCH_INPUTS; i++) {
+        TEST_ASSERT_TRUE(net_queue_input(c, &in));
+        if ((i + 1) % BENCH_BATCH == 0) TEST_ASSERT_TRUE(net_flush(c));
+    }
+    TEST_ASSERT_TRUE(net_flush(c));
+    double batch_s = wait_ack(c, t0);
+
+    /* Phase 3: the old two sends per input, on a plain socket of our own */
+    int legacy = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_ASSERT_TRUE(connect(legacy, (struct sockaddr*)&addr, sizeof addr) == 0);
+    t0 = bench_now_ns();
+    for (int i = 0; i < BENCH_INPUTS; i++) TEST_ASSERT_TRUE(legacy_send_input(legacy, &in));
+    unsigned char ack[5];
+    TEST_ASSERT_TRUE(recv(legacy, ack, sizeof ack, MSG_WAITALL) == (ssize_t)sizeof ack && ack[4] == 'A');
+    double legacy_s = (double)(bench_now_ns() - t0) / 1e9;
+    close(legacy);
+
+    /* States: every recv takes whatever has arrived and the frames are split in place */
+    t0 = bench_now_ns();
+    size_t bytes = 0;
+    for (int i = 0; i < BENCH_STATES; i++) {
+        size_t n = 0;
+        const unsigned char* st = net_recv_frame_view(c, &n);
+        TEST_ASSERT_TRUE(st != NULL && n == b.state_len && st[0] == b.state[0]);
+        bytes += n + 4;
+    }
+    double states_s = (double)(bench_now_ns() - t0) / 1e9;
+    pthread_join(t, NULL);
+    TEST_ASSERT_TRUE(b.inputs_ok);
+    net_disconnect(c);
+    close(b.listen_fd);
+
+    printf("net throughput: inputs %.0f/s one sendmsg each, %.0f/s batched by %d, %.0f/s two sends each; "
+           "states %.0f/s (%.1f MB/s, %zu bytes each)\n",
+           BENCH_INPUTS / single_s, BENCH_INPUTS / batch_s, BENCH_BATCH, BENCH_INPUTS / legacy_s, BENCH_STATES / states_s,
+           (double)bytes / states_s / 1e6, b.state_len);
+}
@@ -0,0 +1,65 @@
+#include "unity.h"
+#include "game_internal.h"
+#include "render_3d.h"
+#include "render_3d_sdl.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+TEST(test_render_async_present) {
+    setenv("SDL_VIDEODRIVER", "dummy", 0);
+    /* Opting in through the environment turns the async path on whenever there is a renderer to present with */
+    static PlayerState players[SNAKE_MAX_PLAYERS];
+    GameState gs;
+    memset(&gs, 0, sizeof gs);
+    gs.width = 8;
+    gs.height = 8;
+    gs.players = players;
+    gs.max_players = SNAKE_MAX_PLAYERS;
+    setenv("SNAKE_3D_ASYNC_PRESENT", "1", 1);
+    TEST_ASSERT_TRUE(render_3d_init(&gs, NULL));
+    SDL3DContext* display = render_3d_get_display();
+    bool has_renderer = render_3d_sdl_has_renderer(display);
+    TEST_ASSERT_TRUE(render_3d_sdl_is_async_present(display) == has_renderer);
+    render_3d_shutdown();
+    unsetenv("SNAKE_3D_ASYNC_PRESENT");
+    if (!has_renderer) {
+        printf("SKIP: no SDL renderer, async present not exercised\n");
+        return;
+    }
+
+    SDL3DContext* ctx = render_3d_sdl_create(32, 16, 0);
+    TEST_ASSERT_TRUE(ctx != NULL);
+    TEST_ASSERT_TRUE(render_3d_sdl_set_async_present(ctx, true));
+
+    /* A present hands the frame to the copier; the next one waits for the copy and shows it */
+    render_3d_sdl_clear(ctx, 0xFF000000u);
+    render_3d_sdl_set_pixel(ctx, 1, 1, 0xFFFF0000u);
+    TEST_ASSERT_TRUE(render_3d_sdl_present(ctx));
+    TEST_ASSERT_EQUAL_INT(0, render_3d_sdl_get_dirty_count(ctx));
+    TEST_ASSERT_EQUAL_INT(0, render_3d_sdl_get_async_presented(ctx));
+    render_3d_sdl_set_pixel(ctx, 5, 5, 0xFF00FF00u);
+    TEST_ASSERT_TRUE(render_3d_sdl_present(ctx));
+    TEST_ASSERT_EQUAL_INT(0, render_3d_sdl_get_dirty_count(ctx));
+    TEST_ASSERT_EQUAL_INT(1, render_3d_sdl_get_async_presented(ctx));
+    /* Nothing new drawn: the frame still in flight is shown and nothing else is submitted */
+    TEST_ASSERT_TRUE(render_3d_sdl_present(ctx));
+    TEST_ASSERT_EQUAL_INT(2, render_3d_sdl_get_async_presented(ctx));
+    TEST_ASSERT_TRUE(render_3d_sdl_present(ctx));
+    TEST_ASSERT_EQUAL_INT(2, render_3d_sdl_get_async_presented(ctx));
+
+    /* Whichever ring buffer is current must carry every earlier write */
+    const uint32_t* pix = render_3d_sdl_get_pixels(ctx);
+    TEST_ASSERT_TRUE(pix != NULL);
+    TEST_ASSERT_TRUE(pix[1 * 32 + 1] == 0xFFFF0000u);
+    TEST_ASSERT_TRUE(pix[5 * 32 + 5] == 0xFF00FF00u);
+    TEST_ASSERT_TRUE(pix[0] == 0xFF000000u);
+
+    render_3d_sdl_blend_pixel(ctx, 1, 1, 0x00FFFFFFu);
+    TEST_ASSERT_TRUE(render_3d_sdl_get_pixels(ctx)[1 * 32 + 1] == 0xFFFF0000u);
+
+    TEST_ASSERT_FALSE(render_3d_sdl_set_async_present(ctx, false));
+    pix = render_3d_sdl_get_pixels(ctx);
+    TEST_ASSERT_TRUE(pix[5 * 32 + 5] == 0xFF00FF00u);
+    render_3d_sdl_destroy(ctx);
+}
@@ -0,0 +1,58 @@
+#include "unity.h"
+#include "render_3d_sdl.h"
+#include <stdlib.h>
+
+TEST(test_render_dirty_rects) {
+    setenv("SDL_VIDEODRIVER", "dummy", 0);
+    SDL3DContext* ctx = render_3d_sdl_create(64, 48, 0);
+    TEST_ASSERT_TRUE(ctx != NULL);
+    int x = 0, y = 0, w = 0, h = 0;
+
+    /* A fresh context needs a full upload */
+    TEST_ASSERT_EQUAL_INT(1, render_3d_sdl_get_dirty_count(ctx));
+    TEST_ASSERT_TRUE(render_3d_sdl_get_dirty_rect(ctx, 0, &x, &y, &w, &h));
+    TEST_ASSERT_EQUAL_INT(64, w);
+    TEST_ASSERT_EQUAL_INT(48, h);
+    (void)render_3d_sdl_present(ctx);
+    TEST_ASSERT_EQUAL_INT(0, render_3d_sdl_get_dirty_count(ctx));
+
+    /* Adjacent writes merge into one rect */
+    render_3d_sdl_set_pixel(ctx, 1, 1, 0xFFFFFFFFu);
+    render_3d_sdl_set_pixel(ctx, 2, 1, 0xFFFFFFFFu);
+    TEST_ASSERT_EQUAL_INT(1, render_3d_sdl_get_dirty_count(ctx));
+    TEST_ASSERT_TRUE(render_3d_sdl_get_dirty_rect(ctx, 0, &x, &y, &w, &h));
+    TEST_ASSERT_EQUAL_INT(1, x);
+    TEST_ASSERT_EQUAL_INT(1, y);
+    TEST_ASSERT_EQUAL_INT(2, w);
+    TEST_ASSERT_EQUAL_INT(1, h);
+
+    /* Disjoint writes stay separate; clipping keeps rects inside the buffer */
+    render_3d_sdl_draw_filled_rect(ctx, 60, 40, 10, 10, 0xFF00FF00u);
+    TEST_ASSERT_EQUAL_INT(2, render_3d_sdl_get_dirty_count(ctx));
+    TEST_ASSERT_TRUE(render_3d_sdl_get_dirty_rect(ctx, 1, &x, &y, &w, &h));
+    TEST_ASSERT_EQUAL_INT(60, x);
+    TEST_ASSERT_EQUAL_INT(40, y);
+    TEST_ASSERT_EQUAL_INT(4, w);
+    TEST_ASSERT_EQUAL_INT(8, h);
+
+    /* Writes fully inside an existing rect add nothing */
+    render_3d_sdl_blend_pixel(ctx, 61, 41, 0x80FF0000u);
+    TEST_ASSERT_EQUAL_INT(2, render_3d_sdl_get_dirty_count(ctx));
+
+    /* Overflowing the list collapses it into one bounding rect */
+    for (int i = 0; i < 16; ++i) render_3d_sdl_draw_column(ctx, 4 + i * 3, 10, 12, 0xFF0000FFu);
+    TEST_ASSERT_EQUAL_INT(1, render_3d_sdl_get_dirty_count(ctx));
+    TEST_ASSERT_TRUE(render_3d_sdl_get_dirty_rect(ctx, 0, &x, &y, &w, &h));
+    TEST_ASSERT_EQUAL_INT(1, x);
+    TEST_ASSERT_EQUAL_INT(1, y);
+    TEST_ASSERT_EQUAL_INT(63, w);
+    TEST_ASSERT_EQUAL_INT(47, h);
+
+    (void)render_3d_sdl_present(ctx);
+    TEST_ASSERT_EQUAL_INT(0, render_3d_sdl_get_dirty_count(ctx));
+    render_3d_sdl_mark_dirty(ctx, -5, -5, 2, 2);
+    TEST_ASSERT_EQUAL_INT(0, render_3d_sdl_get_dirty_count(ctx));
+    render_3d_sdl_clear(ctx, 0xFF000000u);
+    TEST_ASSERT_EQUAL_INT(1, render_3d_sdl_get_dirty_count(ctx));
+    render_3d_sdl_destroy(ctx);
+}
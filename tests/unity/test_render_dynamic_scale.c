@@ -0,0 +1,61 @@
+#include "unity.h"
+#include "persist.h"
+#include "render_3d_sdl.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+TEST(test_render_dynamic_scale) {
+    setenv("SDL_VIDEODRIVER", "dummy", 0);
+    SDL3DContext* ctx = render_3d_sdl_create(64, 48, 0);
+    TEST_ASSERT_TRUE(ctx != NULL);
+    int x = 0, y = 0, w = 0, h = 0;
+    (void)render_3d_sdl_present(ctx);
+
+    /* Shrinking keeps the allocation and row pitch, and asks for a full redraw of the smaller area */
+    TEST_ASSERT_TRUE(render_3d_sdl_set_render_size(ctx, 32, 24));
+    TEST_ASSERT_EQUAL_INT(32, render_3d_sdl_get_width(ctx));
+    TEST_ASSERT_EQUAL_INT(24, render_3d_sdl_get_height(ctx));
+    TEST_ASSERT_EQUAL_INT(64, render_3d_sdl_get_pitch(ctx));
+    TEST_ASSERT_EQUAL_INT(64, render_3d_sdl_get_max_width(ctx));
+    TEST_ASSERT_EQUAL_INT(48, render_3d_sdl_get_max_height(ctx));
+    TEST_ASSERT_EQUAL_INT(1, render_3d_sdl_get_dirty_count(ctx));
+    TEST_ASSERT_TRUE(render_3d_sdl_get_dirty_rect(ctx, 0, &x, &y, &w, &h));
+    TEST_ASSERT_EQUAL_INT(32, w);
+    TEST_ASSERT_EQUAL_INT(24, h);
+    TEST_ASSERT_FALSE(render_3d_sdl_set_render_size(ctx, 32, 24));
+
+    /* Primitives clip to the render size and address rows by pitch */
+    (void)render_3d_sdl_present(ctx);
+    render_3d_sdl_set_pixel(ctx, 40, 10, 0xFFFFFFFFu);
+    TEST_ASSERT_EQUAL_INT(0, render_3d_sdl_get_dirty_count(ctx));
+    render_3d_sdl_clear(ctx, 0xFF112233u);
+    uint32_t* px = render_3d_sdl_get_pixels(ctx);
+    TEST_ASSERT_TRUE(px[23 * 64 + 31] == 0xFF112233u);
+
+    /* Requests beyond the allocation clamp to it */
+    TEST_ASSERT_TRUE(render_3d_sdl_set_render_size(ctx, 1000, 1000));
+    TEST_ASSERT_EQUAL_INT(64, render_3d_sdl_get_width(ctx));
+    TEST_ASSERT_EQUAL_INT(48, render_3d_sdl_get_height(ctx));
+    render_3d_sdl_destroy(ctx);
+
+    /* target_fps and the scale bounds come from the config file */
+    char template[] = "/tmp/snake_dynres.XXXXXX";
+    int fd = mkstemp(template);
+    TEST_ASSERT_TRUE(fd >= 0);
+    FILE* f = fdopen(fd, "w");
+    TEST_ASSERT_TRUE(f != NULL);
+    fputs("target_fps=60\n", f);
+    fputs("render_scale_min=0.40\n", f);
+    fputs("render_scale_max=0.90\n", f);
+    fclose(f);
+    GameConfig* cfg = NULL;
+    int ok = persist_load_config(template, &cfg);
+    unlink(template);
+    TEST_ASSERT_TRUE(ok);
+    TEST_ASSERT_TRUE(cfg != NULL);
+    TEST_ASSERT_EQUAL_INT(60, game_config_get_target_fps(cfg));
+    TEST_ASSERT_TRUE(game_config_get_render_scale_min(cfg) > 0.39f && game_config_get_render_scale_min(cfg) < 0.41f);
+    TEST_ASSERT_TRUE(game_config_get_render_scale_max(cfg) > 0.89f && game_config_get_render_scale_max(cfg) < 0.91f);
+    game_config_destroy(cfg);
+}
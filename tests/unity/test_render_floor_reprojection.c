@@ -0,0 +1,98 @@
+#include "unity.h"
+#include "game_internal.h"
+#include "render_3d.h"
+#include "render_3d_camera.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define RP_W 96
+#define RP_H 64
+
+static int count_diff(const uint32_t* a, const uint32_t* b) {
+    int n = 0;
+    for (int i = 0; i < RP_W * RP_H; i++) n += a[i] != b[i];
+    return n;
+}
+
+static void place_camera(Camera3D* cam, float x, float y, float angle) {
+    camera_set_position(cam, x, y);
+    camera_set_prev_position(cam, x, y);
+    camera_set_angle(cam, angle);
+    camera_set_prev_angle(cam, angle);
+}
+
+TEST(test_render_floor_reprojection) {
+    static PlayerState players[SNAKE_MAX_PLAYERS];
+    SnakePoint food[1] = {{6, 4}};
+    GameState gs;
+    memset(&gs, 0, sizeof gs);
+    memset(players, 0, sizeof players);
+    gs.width = 12;
+    gs.height = 8;
+    gs.players = players;
+    gs.num_players = 1;
+    gs.max_players = SNAKE_MAX_PLAYERS;
+    gs.food = food;
+    gs.food_count = 1;
+    players[0].active = true;
+    players[0].length = 2;
+    players[0].body[0] = (SnakePoint){3, 4};
+    players[0].body[1] = (SnakePoint){2, 4};
+
+    Render3DConfig cfg;
+    memset(&cfg, 0, sizeof cfg);
+    cfg.fov_degrees = 90.0f;
+    cfg.wall_height_scale = 1.5f;
+    cfg.tail_height_scale = 0.5f;
+    Render3DContext* ref = render_3d_context_create(&cfg);
+    cfg.floor_reprojection = true;
+    Render3DContext* rp = render_3d_context_create(&cfg);
+    TEST_ASSERT_TRUE(ref != NULL && rp != NULL);
+    Camera3D* cam = camera_create(90.0f, RP_W, 0.5f);
+    TEST_ASSERT_TRUE(cam != NULL);
+    uint32_t* want = calloc(RP_W * RP_H, sizeof *want);
+    uint32_t* got = calloc(RP_W * RP_H, sizeof *got);
+
+    /* First frame fills the cache; a still camera then reuses every floor row unchanged */
+    place_camera(cam, 1.5f, 4.5f, 0.0f);
+    TEST_ASSERT_TRUE(render_3d_render_offscreen(ref, &gs, cam, want, RP_W, RP_H));
+    TEST_ASSERT_TRUE(render_3d_render_offscreen(rp, &gs, cam, got, RP_W, RP_H));
+    TEST_ASSERT_EQUAL_INT(0, count_diff(want, got));
+    TEST_ASSERT_EQUAL_INT(0, render_3d_context_get_floor_rows_reused(rp));
+    TEST_ASSERT_TRUE(render_3d_render_offscreen(rp, &gs, cam, got, RP_W, RP_H));
+    TEST_ASSERT_EQUAL_INT(0, count_diff(want, got));
+    int floor_rows = render_3d_context_get_floor_rows_reused(rp);
+    TEST_ASSERT_TRUE(floor_rows >= RP_H / 3);
+    TEST_ASSERT_EQUAL_INT(0, render_3d_context_get_floor_rows_reused(ref));
+
+    /* Shadows that moved are resampled even though the camera did not */
+    food[0] = (SnakePoint){8, 3};
+    players[0].body[0] = (SnakePoint){4, 4};
+    players[0].body[1] = (SnakePoint){3, 4};
+    TEST_ASSERT_TRUE(render_3d_render_offscreen(ref, &gs, cam, want, RP_W, RP_H));
+    TEST_ASSERT_TRUE(render_3d_render_offscreen(rp, &gs, cam, got, RP_W, RP_H));
+    TEST_ASSERT_EQUAL_INT(0, count_diff(want, got));
+
+    /* Once the cache has settled, a small sideways slide shifts the cached rows instead of resampling them */
+    TEST_ASSERT_TRUE(render_3d_render_offscreen(rp, &gs, cam, got, RP_W, RP_H));
+    place_camera(cam, 1.5f, 4.53f, 0.0f);
+    TEST_ASSERT_TRUE(render_3d_render_offscreen(ref, &gs, cam, want, RP_W, RP_H));
+    TEST_ASSERT_TRUE(render_3d_render_offscreen(rp, &gs, cam, got, RP_W, RP_H));
+    int reused = render_3d_context_get_floor_rows_reused(rp);
+    TEST_ASSERT_TRUE(reused > 0 && reused < floor_rows);
+    /* Reused pixels sample within half a texel of the reference, so only those rows may differ, and then sparsely */
+    TEST_ASSERT_TRUE(count_diff(want, got) < reused * RP_W / 2);
+
+    /* Moves beyond the error bound fall back to full resampling */
+    place_camera(cam, 2.25f, 4.0f, 0.3f);
+    TEST_ASSERT_TRUE(render_3d_render_offscreen(ref, &gs, cam, want, RP_W, RP_H));
+    TEST_ASSERT_TRUE(render_3d_render_offscreen(rp, &gs, cam, got, RP_W, RP_H));
+    TEST_ASSERT_EQUAL_INT(0, render_3d_context_get_floor_rows_reused(rp));
+    TEST_ASSERT_EQUAL_INT(0, count_diff(want, got));
+
+    free(got);
+    free(want);
+    camera_destroy(cam);
+    render_3d_context_destroy(rp);
+    render_3d_context_destroy(ref);
+}
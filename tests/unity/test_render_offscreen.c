@@ -0,0 +1,53 @@
+#include "unity.h"
+#include "game_internal.h"
+#include "render_3d.h"
+#include "render_3d_camera.h"
+#include "render_3d_sdl.h"
+#include <stdlib.h>
+#include <string.h>
+
+TEST(test_render_offscreen) {
+    static PlayerState players[SNAKE_MAX_PLAYERS];
+    SnakePoint food[1] = {{6, 4}};
+    GameState gs;
+    memset(&gs, 0, sizeof gs);
+    memset(players, 0, sizeof players);
+    gs.width = 12;
+    gs.height = 8;
+    gs.players = players;
+    gs.num_players = 1;
+    gs.max_players = SNAKE_MAX_PLAYERS;
+    gs.food = food;
+    gs.food_count = 1;
+    players[0].active = true;
+    players[0].length = 2;
+    players[0].body[0] = (SnakePoint){3, 4};
+    players[0].body[1] = (SnakePoint){2, 4};
+
+    Render3DContext* r = render_3d_context_create(NULL);
+    TEST_ASSERT_TRUE(r != NULL);
+    Camera3D* cam = camera_create(90.0f, 64, 0.5f);
+    TEST_ASSERT_TRUE(cam != NULL);
+    camera_set_position(cam, 1.5f, 4.5f);
+    camera_set_prev_position(cam, 1.5f, 4.5f);
+
+    uint32_t* small = calloc(64 * 48, sizeof *small);
+    TEST_ASSERT_TRUE(render_3d_render_offscreen(r, &gs, cam, small, 64, 48));
+    /* Top-left is ceiling, bottom-left is floor; every pixel is opaque */
+    TEST_ASSERT_TRUE(small[0] == render_3d_sdl_color(65, 105, 225, 255));
+    int opaque = 0;
+    for (int i = 0; i < 64 * 48; i++) opaque += (small[i] >> 24) == 0xFFu;
+    TEST_ASSERT_EQUAL_INT(64 * 48, opaque);
+
+    /* Same context renders at another size into another buffer */
+    uint32_t* big = calloc(160 * 100, sizeof *big);
+    TEST_ASSERT_TRUE(render_3d_render_offscreen(r, &gs, cam, big, 160, 100));
+    TEST_ASSERT_TRUE(big[0] == small[0]);
+    TEST_ASSERT_TRUE(big[160 * 99] != 0u);
+
+    TEST_ASSERT_FALSE(render_3d_render_offscreen(r, &gs, cam, NULL, 64, 48));
+    free(big);
+    free(small);
+    camera_destroy(cam);
+    render_3d_context_destroy(r);
+}
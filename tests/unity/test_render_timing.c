@@ -0,0 +1,61 @@
+#include "unity.h"
+#include "render_3d_timing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static bool within_pct(uint64_t got, uint64_t want, double pct) {
+    double d = (double)got - (double)want;
+    if (d < 0) d = -d;
+    return d <= (double)want * pct / 100.0;
+}
+
+TEST(test_render_timing) {
+    render_timing_set_enabled(true);
+    render_timing_reset();
+    /* 1..1000 us, uniformly */
+    for (uint64_t i = 1; i <= 1000; i++) render_timing_record(RENDER_PASS_FLOOR, i * 1000u);
+    TEST_ASSERT_TRUE(render_timing_count(RENDER_PASS_FLOOR) == 1000u);
+    TEST_ASSERT_TRUE(within_pct(render_timing_percentile_ns(RENDER_PASS_FLOOR, 50.0), 500000u, 4.0));
+    TEST_ASSERT_TRUE(within_pct(render_timing_percentile_ns(RENDER_PASS_FLOOR, 99.0), 990000u, 4.0));
+    TEST_ASSERT_TRUE(within_pct(render_timing_percentile_ns(RENDER_PASS_FLOOR, 100.0), 1000000u, 4.0));
+    TEST_ASSERT_TRUE(render_timing_count(RENDER_PASS_WALLS) == 0u);
+
+    /* Small values are exact; out-of-range values land in the last bucket */
+    render_timing_record(RENDER_PASS_WALLS, 7u);
+    TEST_ASSERT_TRUE(render_timing_percentile_ns(RENDER_PASS_WALLS, 50.0) == 7u);
+    render_timing_record(RENDER_PASS_WALLS, UINT64_MAX);
+    TEST_ASSERT_TRUE(render_timing_count(RENDER_PASS_WALLS) == 2u);
+
+    /* begin/end pair records one sample; disabled timing records nothing */
+    uint64_t t = render_timing_begin();
+    TEST_ASSERT_TRUE(t != 0u);
+    render_timing_end(RENDER_PASS_PRESENT, t);
+    TEST_ASSERT_TRUE(render_timing_count(RENDER_PASS_PRESENT) == 1u);
+    render_timing_set_enabled(false);
+    TEST_ASSERT_TRUE(render_timing_begin() == 0u);
+    render_timing_end(RENDER_PASS_PRESENT, render_timing_begin());
+    TEST_ASSERT_TRUE(render_timing_count(RENDER_PASS_PRESENT) == 1u);
+
+    /* JSON dump names every pass */
+    char path[] = "/tmp/snake_timing.XXXXXX";
+    int fd = mkstemp(path);
+    TEST_ASSERT_TRUE(fd >= 0);
+    close(fd);
+    TEST_ASSERT_TRUE(render_timing_write_json(path));
+    FILE* f = fopen(path, "r");
+    TEST_ASSERT_TRUE(f != NULL);
+    static char buf[65536];
+    size_t n = fread(buf, 1, sizeof buf - 1, f);
+    buf[n] = '\0';
+    fclose(f);
+    unlink(path);
+    TEST_ASSERT_TRUE(strstr(buf, "\"floor\":{\"count\":1000") != NULL);
+    for (int p = 0; p < RENDER_PASS_COUNT; p++) {
+        char key[64];
+        snprintf(key, sizeof key, "\"%s\":", render_timing_pass_name((RenderPass)p));
+        TEST_ASSERT_TRUE(strstr(buf, key) != NULL);
+    }
+    render_timing_reset();
+}
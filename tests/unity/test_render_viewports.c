@@ -0,0 +1,82 @@
+#include "unity.h"
+#include "game_internal.h"
+#include "render_3d.h"
+#include "render_3d_camera.h"
+#include <stdlib.h>
+#include <string.h>
+
+TEST(test_render_viewports) {
+    static PlayerState players[SNAKE_MAX_PLAYERS];
+    SnakePoint food[1] = {{6, 4}};
+    GameState gs;
+    memset(&gs, 0, sizeof gs);
+    memset(players, 0, sizeof players);
+    gs.width = 12;
+    gs.height = 8;
+    gs.players = players;
+    gs.num_players = 4;
+    gs.max_players = SNAKE_MAX_PLAYERS;
+    gs.food = food;
+    gs.food_count = 1;
+    for (int p = 0; p < 4; p++) {
+        players[p].active = true;
+        players[p].length = 1;
+        players[p].body[0] = (SnakePoint){2 + p * 2, 2 + p};
+        players[p].color = 0xFF00FF00u;
+    }
+
+    Render3DShared* shared = render_3d_shared_create(NULL);
+    TEST_ASSERT_TRUE(shared != NULL);
+    Render3DContext* r = render_3d_context_create_shared(NULL, shared);
+    TEST_ASSERT_TRUE(r != NULL);
+    /* The context holds its own reference */
+    render_3d_shared_release(shared);
+
+    Camera3D* cams[4];
+    Render3DViewport vps[4];
+    for (int i = 0; i < 4; i++) {
+        cams[i] = camera_create(90.0f, 64, 0.5f);
+        TEST_ASSERT_TRUE(cams[i] != NULL);
+        camera_set_position(cams[i], 1.5f + (float)i * 2.0f, 1.5f + (float)i);
+        camera_set_prev_position(cams[i], 1.5f + (float)i * 2.0f, 1.5f + (float)i);
+        vps[i] = (Render3DViewport){(i % 2) * 64, (i / 2) * 48, 64, 48, cams[i], i};
+    }
+    uint32_t* serial = calloc(128 * 96, sizeof *serial);
+    uint32_t* threaded = calloc(128 * 96, sizeof *threaded);
+    TEST_ASSERT_TRUE(render_3d_render_viewports(r, &gs, vps, 4, serial, 128, 96, false));
+    TEST_ASSERT_TRUE(render_3d_render_viewports(r, &gs, vps, 4, threaded, 128, 96, true));
+    TEST_ASSERT_TRUE(memcmp(serial, threaded, 128 * 96 * sizeof *serial) == 0);
+    /* The workers are kept between frames, including frames with fewer viewports than workers */
+    for (int frame = 0; frame < 3; frame++) {
+        memset(threaded, 0, 128 * 96 * sizeof *threaded);
+        TEST_ASSERT_TRUE(render_3d_render_viewports(r, &gs, vps, frame == 1 ? 2 : 4, threaded, 128, 96, true));
+        TEST_ASSERT_TRUE(memcmp(serial, threaded, (frame == 1 ? 48u : 96u) * 128 * sizeof *serial) == 0);
+    }
+
+    /* Every viewport covers its quadrant */
+    int opaque = 0;
+    for (int i = 0; i < 128 * 96; i++) opaque += (serial[i] >> 24) == 0xFFu;
+    TEST_ASSERT_EQUAL_INT(128 * 96, opaque);
+
+    /* A viewport matches a standalone offscreen render of the same camera */
+    Render3DContext* solo = render_3d_context_create(NULL);
+    uint32_t* one = calloc(64 * 48, sizeof *one);
+    TEST_ASSERT_TRUE(render_3d_render_offscreen(solo, &gs, cams[3], one, 64, 48));
+    Render3DViewport corner = {64, 48, 64, 48, cams[3], 0};
+    TEST_ASSERT_TRUE(render_3d_render_viewports(r, &gs, &corner, 1, serial, 128, 96, false));
+    for (int y = 0; y < 48; y++) TEST_ASSERT_TRUE(memcmp(&serial[(48 + y) * 128 + 64], &one[y * 64], 64 * sizeof *one) == 0);
+
+    /* Out-of-bounds regions and shared cameras in parallel mode are rejected */
+    Render3DViewport bad = {100, 0, 64, 48, cams[0], 0};
+    TEST_ASSERT_FALSE(render_3d_render_viewports(r, &gs, &bad, 1, serial, 128, 96, false));
+    Render3DViewport dup[2] = {vps[0], vps[1]};
+    dup[1].camera = cams[0];
+    TEST_ASSERT_FALSE(render_3d_render_viewports(r, &gs, dup, 2, serial, 128, 96, true));
+
+    free(one);
+    free(threaded);
+    free(serial);
+    for (int i = 0; i < 4; i++) camera_destroy(cams[i]);
+    render_3d_context_destroy(solo);
+    render_3d_context_destroy(r);
+}
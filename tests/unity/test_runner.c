@@ -28,10 +28,36 @@ void test_net(void);
 void test_net_integration(void);
 void test_net_overflow(void);
 void test_net_unpack(void);
+void test_net_json(void);
+void test_net_json_writer(void);
+void test_net_state_binary(void);
+void test_net_interest(void);
+void test_net_frame(void);
+void test_net_throughput(void);
+void test_net_state_pool(void);
+void test_net_caps(void);
+void test_net_delta(void);
+void test_msg_ring(void);
+void test_mpclient_io(void);
+void test_mpclient_session(void);
+void test_net_shaper(void);
+void test_net_log(void);
+void test_net_predict(void);
+void test_snake_server(void);
 
 /* collision */
 void test_collision(void);
 
+/* render */
+void test_render_dirty_rects(void);
+void test_render_async_present(void);
+void test_render_offscreen(void);
+void test_render_viewports(void);
+void test_render_dynamic_scale(void);
+void test_render_floor_reprojection(void);
+void test_render_timing(void);
+void test_trace(void);
+
 /* game */
 void test_game_multi(void);
 void test_game_oom(void);
@@ -80,9 +106,34 @@ static test_entry tests[] = {
     {"test_net_integration", test_net_integration, 0},
     {"test_net_overflow", test_net_overflow, 0},
     {"test_net_unpack", test_net_unpack, 0},
+    {"test_net_json", test_net_json, 0},
+    {"test_net_json_writer", test_net_json_writer, 0},
+    {"test_net_state_binary", test_net_state_binary, 0},
+    {"test_net_interest", test_net_interest, 0},
+    {"test_net_frame", test_net_frame, 0},
+    {"test_net_throughput", test_net_throughput, 0},
+    {"test_net_state_pool", test_net_state_pool, 0},
+    {"test_net_caps", test_net_caps, 0},
+    {"test_net_delta", test_net_delta, 0},
+    {"test_msg_ring", test_msg_ring, 0},
+    {"test_mpclient_io", test_mpclient_io, 0},
+    {"test_mpclient_session", test_mpclient_session, 0},
+    {"test_net_shaper", test_net_shaper, 0},
+    {"test_net_log", test_net_log, 0},
+    {"test_net_predict", test_net_predict, 0},
+    {"test_snake_server", test_snake_server, 0},
 
     {"test_collision", test_collision, 0},
 
+    {"test_render_dirty_rects", test_render_dirty_rects, 0},
+    {"test_render_async_present", test_render_async_present, 0},
+    {"test_render_offscreen", test_render_offscreen, 0},
+    {"test_render_viewports", test_render_viewports, 0},
+    {"test_render_dynamic_scale", test_render_dynamic_scale, 0},
+    {"test_render_floor_reprojection", test_render_floor_reprojection, 0},
+    {"test_render_timing", test_render_timing, 0},
+    {"test_trace", test_trace, 0},
+
     {"test_game_multi", test_game_multi, 0},
     /* This test overrides malloc/free; run it isolated in its own process */
     {"test_game_oom", test_game_oom, 1},
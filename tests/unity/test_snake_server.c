@@ -0,0 +1,119 @@
+#include "unity.h"
+#include <string.h>
+#include <time.h>
+#include "game_internal.h"
+#include "net.h"
+#include "snake_server.h"
+
+/* Joins and checks the welcome frame: 'W', session length, session, name (any session when `want_session` is NULL) */
+static NetClient* join(int port, const char* session, const char* name, const char* want_session, const char* want_name) {
+    NetClient* c = net_connect("127.0.0.1", port);
+    TEST_ASSERT_TRUE(c != NULL);
+    TEST_ASSERT_TRUE(net_send_join(c, session, name));
+    unsigned char buf[64];
+    size_t n = net_recv_frame(c, buf, sizeof buf - 1);
+    TEST_ASSERT_TRUE(n >= 2 && buf[0] == 'W' && (size_t)buf[1] + 2 <= n);
+    buf[n] = '\0';
+    TEST_ASSERT_EQUAL_STRING(want_name, (const char*)buf + 2 + buf[1]);
+    buf[2 + buf[1]] = '\0';
+    if (want_session) TEST_ASSERT_EQUAL_STRING(want_session, (const char*)buf + 2);
+    return c;
+}
+
+/* Applies the next state frame to a viewer game; returns its tick */
+static int next_state(NetClient* c, Game* view) {
+    static unsigned char buf[NET_STATE_MAX_PACKED];
+    size_t n = net_recv_frame(c, buf, sizeof buf);
+    TEST_ASSERT_TRUE(n > 6 && buf[0] == 0x53);
+    TEST_ASSERT_TRUE(net_apply_packed_state(view, buf, n, false));
+    return (int)((uint32_t)buf[2] << 24 | (uint32_t)buf[3] << 16 | (uint32_t)buf[4] << 8 | buf[5]);
+}
+
+static const PlayerState* find(const Game* view, const char* name) {
+    const GameState* gs = game_get_state(view);
+    for (int i = 0; i < gs->num_players; i++)
+        if (strcmp(gs->players[i].name, name) == 0) return &gs->players[i];
+    return NULL;
+}
+
+TEST(test_snake_server) {
+    GameConfig* cfg = game_config_create();
+    game_config_set_board_size(cfg, 40, 40);
+    game_config_set_tick_rate_ms(cfg, 10);
+    /* Two shards: whichever one accepts a connection, joins to T1 end up in the one shard that owns it */
+    SnakeServer* s = snake_server_create(cfg, 0, 2);
+    TEST_ASSERT_TRUE(s != NULL);
+    TEST_ASSERT_EQUAL_INT(2, snake_server_get_shard_count(s));
+    TEST_ASSERT_EQUAL_INT(0, snake_server_start(s));
+    int port = snake_server_get_port(s);
+
+    /* Named sessions are shared and names made unique within them; an unnamed join opens a session of its own */
+    NetClient* a = join(port, "T1", "ann", "T1", "ann");
+    NetClient* b = join(port, "T1", "ann", "T1", "ann2");
+    NetClient* d = join(port, "", "", NULL, "Player");
+
+    /* Only the server moves snakes: the input steers `ann` in the next states */
+    game_config_set_player_name(cfg, "viewer");
+    game_config_set_num_players(cfg, 1);
+    game_config_set_max_players(cfg, SNAKE_MAX_PLAYERS);
+    Game* view = game_create(cfg, 1);
+    TEST_ASSERT_TRUE(view != NULL);
+    int tick = 0;
+    for (int i = 0; i < 50 && !(find(view, "ann") && find(view, "ann2")); i++) tick = next_state(a, view);
+    TEST_ASSERT_TRUE(next_state(a, view) == tick + 1);
+    const PlayerState* ann = find(view, "ann");
+    TEST_ASSERT_TRUE(ann != NULL && ann->length > 0 && find(view, "ann2") != NULL);
+    SnakeDir want = (ann->current_dir == SNAKE_DIR_UP || ann->current_dir == SNAKE_DIR_DOWN) ? SNAKE_DIR_LEFT : SNAKE_DIR_UP;
+    InputState in = {0};
+    in.move_left = want == SNAKE_DIR_LEFT;
+    in.move_up = want == SNAKE_DIR_UP;
+    TEST_ASSERT_TRUE(net_send_input(a, &in));
+    int turned = 0;
+    for (int i = 0; i < 20 && !turned; i++) {
+        next_state(a, view);
+        turned = ann->current_dir == want;
+    }
+    TEST_ASSERT_TRUE(turned);
+    /* The other session keeps ticking on its own */
+    next_state(d, view);
+    TEST_ASSERT_TRUE(find(view, "Player") != NULL);
+
+    /* A client that sends input before joining is dropped */
+    NetClient* e = net_connect("127.0.0.1", port);
+    TEST_ASSERT_TRUE(e != NULL);
+    TEST_ASSERT_TRUE(net_send_input(e, &in));
+    unsigned char buf[16];
+    TEST_ASSERT_EQUAL_INT(0, (int)net_recv_frame(e, buf, sizeof buf));
+
+    /* Counters are published by the shards as they run */
+    SnakeServerStats st, sh;
+    snake_server_get_stats(s, &st);
+    for (int i = 0; i < 100 && st.clients != 3; i++) {
+        struct timespec ts = {0, 10 * 1000 * 1000};
+        nanosleep(&ts, NULL);
+        snake_server_get_stats(s, &st);
+    }
+    TEST_ASSERT_EQUAL_INT(2, (int)st.sessions);
+    TEST_ASSERT_EQUAL_INT(3, (int)st.clients);
+    int sessions = 0;
+    for (int i = 0; i < 2; i++) {
+        snake_server_get_shard_stats(s, i, &sh);
+        sessions += (int)sh.sessions;
+        TEST_ASSERT_TRUE(sh.sessions == 0 || (sh.ticks > 0 && sh.tick_ns_max > 0 && sh.tick_ns_total >= sh.tick_ns_max));
+    }
+    TEST_ASSERT_EQUAL_INT(2, sessions);
+    TEST_ASSERT_EQUAL_INT((int)st.handoffs_out, (int)st.handoffs_in);
+    TEST_ASSERT_EQUAL_INT(0, (int)st.handoffs_dropped);
+
+    net_disconnect(a);
+    net_disconnect(b);
+    net_disconnect(d);
+    net_disconnect(e);
+    snake_server_stop(s);
+    snake_server_get_stats(s, &st);
+    TEST_ASSERT_EQUAL_INT(1, (int)st.inputs);
+    TEST_ASSERT_TRUE(st.ticks > 0 && st.states_sent > 0 && st.bytes_out > 0);
+    snake_server_destroy(s);
+    game_destroy(view);
+    game_config_destroy(cfg);
+}
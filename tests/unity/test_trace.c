@@ -0,0 +1,52 @@
+#include "unity.h"
+#include "trace.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef SNAKE_TRACE
+static void* trace_worker(void* arg) {
+    (void)arg;
+    TRACE_THREAD_NAME("worker");
+    for (int i = 0; i < 100; i++) {
+        TRACE_BEGIN("work");
+        TRACE_END("work");
+    }
+    return NULL;
+}
+#endif
+
+TEST(test_trace) {
+    char path[] = "/tmp/snake_trace.XXXXXX";
+    int fd = mkstemp(path);
+    TEST_ASSERT_TRUE(fd >= 0);
+    close(fd);
+#ifdef SNAKE_TRACE
+    pthread_t th;
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&th, NULL, trace_worker, NULL));
+    TRACE_BEGIN("outer");
+    TRACE_BEGIN("inner");
+    TRACE_END("inner");
+    TRACE_END("outer");
+    pthread_join(th, NULL);
+    TEST_ASSERT_TRUE(trace_flush(path));
+    FILE* f = fopen(path, "r");
+    TEST_ASSERT_TRUE(f != NULL);
+    static char buf[1 << 20];
+    size_t n = fread(buf, 1, sizeof buf - 1, f);
+    buf[n] = '\0';
+    fclose(f);
+    TEST_ASSERT_TRUE(strstr(buf, "\"traceEvents\"") != NULL);
+    TEST_ASSERT_TRUE(strstr(buf, "\"name\":\"outer\",\"ph\":\"B\"") != NULL);
+    TEST_ASSERT_TRUE(strstr(buf, "\"name\":\"inner\",\"ph\":\"E\"") != NULL);
+    TEST_ASSERT_TRUE(strstr(buf, "\"name\":\"work\",\"ph\":\"E\"") != NULL);
+#else
+    /* Compiled out: the macros are no-ops and nothing is written */
+    TRACE_BEGIN("outer");
+    TRACE_END("outer");
+    TEST_ASSERT_FALSE(trace_flush(path));
+#endif
+    unlink(path);
+}